@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-------------------------------------------
+// CRC throughput benchmark.
+// Build with different CONST_CRC_TABLE_SIZE values (0, 16, 256) to compare.
+//-------------------------------------------
+
+#include <stdmansos.h>
+#include <lib/codec/crc.h>
+#include <random.h>
+#include <assert.h>
+
+#define BUFFER_SIZE  128
+#if PLATFORM_PC
+#define ITERATIONS   500000u
+#else
+#define ITERATIONS   200
+#endif
+
+static uint8_t buffer[BUFFER_SIZE];
+
+// the byte-at-a-time reference implementation
+static uint16_t crc16Reference(const uint8_t *data, uint16_t len)
+{
+    uint16_t crc = 0;
+    while (len--) crc = crc16Add(crc, *data++);
+    return crc;
+}
+
+static uint8_t crc8Reference(const uint8_t *data, uint16_t len)
+{
+    uint8_t crc = 0;
+    while (len--) crc = crc8Add(crc, *data++);
+    return crc;
+}
+
+static void checkCorrectness(void)
+{
+    uint16_t len;
+    for (len = 0; len <= BUFFER_SIZE; ++len) {
+        ASSERT(crc16(buffer, len) == crc16Reference(buffer, len));
+        ASSERT(crc8(buffer, len) == crc8Reference(buffer, len));
+        // incremental calculation gives the same result
+        ASSERT(crc16Update(crc16(buffer, len / 2), buffer + len / 2, len - len / 2)
+                == crc16(buffer, len));
+    }
+}
+
+static void report(const char *name, uint32_t time)
+{
+    // bytes per millisecond == kilobytes per second
+    uint32_t bytes = (uint32_t) BUFFER_SIZE * ITERATIONS;
+    PRINTF("%s: %lu ms, %lu KB/s\n", name, time,
+            time ? bytes / time : 0);
+}
+
+void appMain(void)
+{
+    uint32_t i;
+    uint32_t start;
+    volatile uint16_t sink = 0;
+
+    for (i = 0; i < BUFFER_SIZE; ++i) {
+        buffer[i] = randomNumber();
+    }
+    checkCorrectness();
+
+    PRINTF("CRC benchmark, table size %u, slicing-by-8 %s, %lu x %u bytes\n",
+            CRC_TABLE_SIZE, CRC_SLICE_BY_8 ? "on" : "off",
+            (uint32_t) ITERATIONS, BUFFER_SIZE);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) sink += crc16Reference(buffer, BUFFER_SIZE);
+    report("crc16 reference", getTimeMs() - start);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) sink += crc16(buffer, BUFFER_SIZE);
+    report("crc16", getTimeMs() - start);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) sink += crc8Reference(buffer, BUFFER_SIZE);
+    report("crc8 reference", getTimeMs() - start);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) sink += crc8(buffer, BUFFER_SIZE);
+    report("crc8", getTimeMs() - start);
+}
@@ -28,14 +28,16 @@
 #include "algo.h"
 
 void appMain(void) {
-    uint8_t coeffs[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    static const uint8_t coeffs[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    static uint16_t history1[10], history2[10];
+    Average_t avg1, avg2, avg3;
 
     // Init with coefficients
-    Average_t avg1 = avgInitWithCoeffs(10, coeffs);
-    // Init with window 5
-    Average_t avg2 = avgInit(10);
+    avgInitWithCoeffs(&avg1, history1, 10, coeffs);
+    // Init with window 10
+    avgInit(&avg2, history2, 10);
     // Init with infinite window
-    Average_t avg3 = avgInit(0);
+    avgInit(&avg3, NULL, 0);
 
     while (true) {
         uint16_t temp = randomNumber();
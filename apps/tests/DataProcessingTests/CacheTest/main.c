@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Sensor cache test: a slow sensor read by two periodic "rules"
+// and by the main loop. On PC alarms run in their own thread,
+// so the main loop's reads overlap with the rules' conversions.
+// The main loop also does the refreshes marked by the cache.
+//
+
+#include "stdmansos.h"
+#include "cache.h"
+
+#define SLOW_SENSOR   0
+#define SLOW_READ_MS  300
+#define EXPIRE_MS     2000
+
+static uint16_t conversions;
+
+static int16_t slowSensorRead(bool *isFilteredOut)
+{
+    conversions++;
+    mdelay(SLOW_READ_MS);
+    return 1000 + conversions;
+}
+
+static int16_t readSlowSensor(void)
+{
+    return cacheReadSensor16(SLOW_SENSOR, slowSensorRead, EXPIRE_MS, NULL);
+}
+
+static Alarm_t rule1Alarm, rule2Alarm;
+
+static void rule1Callback(void *param)
+{
+    alarmSchedule(&rule1Alarm, 500);
+    PRINTF("rule1: %d\n", readSlowSensor());
+}
+
+static void rule2Callback(void *param)
+{
+    alarmSchedule(&rule2Alarm, 500);
+    PRINTF("rule2: %d\n", readSlowSensor());
+}
+
+void appMain(void)
+{
+    CacheStats_t stats;
+
+    alarmInit(&rule1Alarm, rule1Callback, NULL);
+    alarmInit(&rule2Alarm, rule2Callback, NULL);
+    alarmSchedule(&rule1Alarm, 100);
+    alarmSchedule(&rule2Alarm, 200);
+
+    for (;;) {
+        uint16_t i;
+        for (i = 0; i < 20; i++) {
+            mdelay(250);
+            cacheRefreshPoll();
+            readSlowSensor();
+        }
+        cacheGetStats(SLOW_SENSOR, &stats);
+        PRINTF("conversions=%u hits=%u misses=%u coalesced=%u refreshes=%u"
+                " conversion time=%u ms\n", conversions, stats.hits, stats.misses,
+                stats.coalesced, stats.refreshes, stats.conversionTime);
+    }
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-------------------------------------------
+// Data processing library test and benchmark.
+// Checks the results against straightforward calculations,
+// then prints the time per sample of each function.
+//-------------------------------------------
+
+#include "stdmansos.h"
+#include "average.h"
+#include "stdev.h"
+#include "minmax.h"
+#include "filter.h"
+#include "random.h"
+#include <assert.h>
+
+#define SAMPLES 500
+#define WINDOW  16
+
+#if PLATFORM_PC
+#define REPEAT  20000
+#else
+#define REPEAT  20
+#endif
+
+static uint16_t samples[SAMPLES];
+static uint16_t filtered[SAMPLES];
+static uint16_t history[WINDOW];
+static MinMaxEntry_t minMaxStorage[2 * WINDOW];
+static const uint8_t coeffs[WINDOW] = {
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16
+};
+
+// --------------------------------------------- correctness
+
+static void checkWindow(uint16_t last, Average_t *avg, Average_t *weighted,
+                        Stdev_t *stdev, MinMax_t *mm)
+{
+    uint16_t first = last + 1 > WINDOW ? last + 1 - WINDOW : 0;
+    uint16_t n = last + 1 - first;
+    uint32_t sum = 0, weightedSum = 0, weights = 0;
+    uint64_t squares = 0;
+    uint16_t min = 0xffff, max = 0;
+    uint16_t i;
+
+    for (i = first; i <= last; i++) {
+        uint16_t w = coeffs[WINDOW - 1 - (last - i)];
+        sum += samples[i];
+        squares += (uint32_t) samples[i] * samples[i];
+        weightedSum += (uint32_t) samples[i] * w;
+        weights += w;
+        if (samples[i] < min) min = samples[i];
+        if (samples[i] > max) max = samples[i];
+    }
+    // the weighted average treats missing values as zeros
+    for (i = n; i < WINDOW; i++) weights += coeffs[WINDOW - 1 - i];
+
+    ASSERT(getAverageValue(avg) == sum / n);
+    ASSERT(getAverageValue(weighted) == weightedSum / weights);
+    ASSERT(getVarianceValue(stdev)
+            == (uint32_t) ((n * squares - (uint64_t) sum * sum) / ((uint32_t) n * n)));
+    ASSERT(getMinValue(mm) == min);
+    ASSERT(getMaxValue(mm) == max);
+}
+
+static void checkCorrectness(void)
+{
+    static uint16_t history2[WINDOW], history3[WINDOW];
+    static MinMaxEntry_t storage2[2 * WINDOW];
+    Average_t avg, weighted;
+    Stdev_t stdev, stdev2;
+    MinMax_t mm, mm2;
+    Filter_t filter;
+    uint16_t i, j, passed;
+
+    avgInit(&avg, history, WINDOW);
+    avgInitWithCoeffs(&weighted, history2, WINDOW, coeffs);
+    stdevInit(&stdev, history3, WINDOW);
+    minMaxInit(&mm, minMaxStorage, WINDOW);
+    for (i = 0; i < SAMPLES; i++) {
+        addAverage(&avg, &samples[i]);
+        addAverage(&weighted, &samples[i]);
+        addStdev(&stdev, &samples[i]);
+        addMinMax(&mm, samples[i]);
+        checkWindow(i, &avg, &weighted, &stdev, &mm);
+    }
+
+    // batches of different sizes give the same results
+    stdevInit(&stdev2, history2, WINDOW);
+    minMaxInit(&mm2, storage2, WINDOW);
+    for (i = 0; i < SAMPLES; ) {
+        uint16_t count = MIN(1 + randomNumber() % (2 * WINDOW), SAMPLES - i);
+        stdevAddBatch(&stdev2, samples + i, count);
+        minMaxAddBatch(&mm2, samples + i, count);
+        i += count;
+        avgInit(&avg, history, WINDOW);
+        avgAddBatch(&avg, samples, i);
+        avgInitWithCoeffs(&weighted, history3, WINDOW, coeffs);
+        avgAddBatch(&weighted, samples, i);
+        checkWindow(i - 1, &avg, &weighted, &stdev2, &mm2);
+    }
+
+    filter = filterInit(LESS, 0x800);
+    passed = filterBatch(&filter, samples, SAMPLES, filtered);
+    for (i = 0, j = 0; i < SAMPLES; i++) {
+        if (samples[i] < 0x800) {
+            ASSERT(filtered[j++] == samples[i]);
+        }
+    }
+    ASSERT(j == passed);
+    PRINTF("results correct\n");
+}
+
+// --------------------------------------------- benchmark
+
+static void report(const char *name, uint32_t ms)
+{
+    // time in tenths of nanoseconds; REPEAT * SAMPLES is a multiple of 1000
+    uint32_t ns10 = ms * 10000 / ((uint32_t) REPEAT * SAMPLES / 1000);
+    PRINTF("%s: %lu.%lu ns/sample, %lu cycles/sample\n",
+            name, ns10 / 10, ns10 % 10, ns10 * CPU_MHZ / 10000);
+}
+
+#define BENCH(name, init, code) do {                    \
+        uint32_t start;                                 \
+        uint16_t r, i;                                  \
+        init;                                           \
+        start = getTimeMs();                            \
+        for (r = 0; r < REPEAT; r++) {                  \
+            for (i = 0; i < SAMPLES; i++) { code; }     \
+        }                                               \
+        report(name, getTimeMs() - start);              \
+    } while (0)
+
+#define BENCH_BATCH(name, init, code) do {              \
+        uint32_t start;                                 \
+        uint16_t r;                                     \
+        init;                                           \
+        start = getTimeMs();                            \
+        for (r = 0; r < REPEAT; r++) { code; }          \
+        report(name, getTimeMs() - start);              \
+    } while (0)
+
+void appMain(void)
+{
+    Average_t avg;
+    Stdev_t stdev;
+    MinMax_t mm;
+    Filter_t filter = filterInit(LESS, 0x800);
+    uint16_t i;
+
+    for (i = 0; i < SAMPLES; i++) {
+        samples[i] = randomNumber() & 0xfff; // like 12-bit ADC values
+    }
+    checkCorrectness();
+
+    PRINTF("window %u, %u x %u samples\n", WINDOW, REPEAT, SAMPLES);
+    BENCH("moving average", avgInit(&avg, history, WINDOW),
+            addAverage(&avg, &samples[i]));
+    BENCH_BATCH("moving average, batch", avgInit(&avg, history, WINDOW),
+            avgAddBatch(&avg, samples, SAMPLES));
+    BENCH("cumulative average", avgInit(&avg, NULL, 0),
+            addAverage(&avg, &samples[i]));
+    BENCH_BATCH("cumulative average, batch", avgInit(&avg, NULL, 0),
+            avgAddBatch(&avg, samples, SAMPLES));
+    BENCH("weighted average (read each time)",
+            avgInitWithCoeffs(&avg, history, WINDOW, coeffs),
+            addAverage(&avg, &samples[i]); getAverageValue(&avg));
+    BENCH("stdev", stdevInit(&stdev, history, WINDOW),
+            addStdev(&stdev, &samples[i]));
+    BENCH_BATCH("stdev, batch", stdevInit(&stdev, history, WINDOW),
+            stdevAddBatch(&stdev, samples, SAMPLES));
+    BENCH("min/max", minMaxInit(&mm, minMaxStorage, WINDOW),
+            addMinMax(&mm, samples[i]));
+    BENCH("filter", (void) 0, addFilter(&filter, &samples[i]));
+    BENCH_BATCH("filter, batch", (void) 0,
+            filterBatch(&filter, samples, SAMPLES, filtered));
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Sample two ADC channels in bursts and process the blocks
+// with the data processing library.
+//
+
+#include "stdmansos.h"
+#include "sampler.h"
+
+#define BLOCK_SIZE  16
+#define WINDOW      8
+
+static const uint8_t channels[] = { 0, 1 };
+static uint16_t buffer[sizeof(channels) * BLOCK_SIZE];
+
+static Sampler_t sampler;
+static SamplerStage_t stages[3];
+
+static uint16_t avgHistory[WINDOW];
+static Average_t avg;
+static MinMaxEntry_t minMaxStorage[2 * WINDOW];
+static MinMax_t minMax;
+static Filter_t filter;
+
+static void onBlock(Sampler_t *s)
+{
+    PRINTF("block: ch0[0]=%u ch1[0]=%u\n",
+            samplerChannelData(s, 0)[0], samplerChannelData(s, 1)[0]);
+}
+
+void appMain(void)
+{
+    avgInit(&avg, avgHistory, WINDOW);
+    minMaxInit(&minMax, minMaxStorage, WINDOW);
+    filter = filterInit(MORE, 100);
+
+    samplerInit(&sampler, channels, sizeof(channels), buffer, BLOCK_SIZE, onBlock);
+    samplerAddAverage(&sampler, &stages[0], 0, &avg);
+    // channel 1: only the values above the treshold reach the min/max stage
+    samplerAddFilter(&sampler, &stages[1], 1, &filter);
+    samplerAddMinMax(&sampler, &stages[2], 1, &minMax);
+    // 4 samples every 100 ms: a block every 400 ms
+    samplerStart(&sampler, 100, 4);
+
+    for (;;) {
+        mdelay(1000);
+        PRINTF("avg(ch0)=%u min(ch1)=%u max(ch1)=%u\n",
+                getAverageValue(&avg), getMinValue(&minMax), getMaxValue(&minMax));
+    }
+}
@@ -25,9 +25,11 @@
 #include "stdev.h"
 
 void appMain(void) {
-    Stdev_t stdev = stdevInit(8);
+    static uint16_t history[8];
+    Stdev_t stdev;
     uint16_t i = 2;
 
+    stdevInit(&stdev, history, 8);
     addStdev(&stdev, &i); // 2
     i=4;
     addStdev(&stdev,&i); // 4
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//----------------------------------------------------
+//      Read humidity sensor without blocking:
+//      both measurements are requested at once,
+//      the LED blinks while they are in progress
+//----------------------------------------------------
+
+#include "stdmansos.h"
+#include "dprint.h"
+#include "humidity.h"
+
+static void onHumidity(uint16_t value, bool ok, void *param)
+{
+    if (ok) {
+        PRINTF("hum = %u\n", value);
+    } else {
+        PRINTF("hum: read failed\n");
+    }
+}
+
+static void onTemperature(uint16_t value, bool ok, void *param)
+{
+    if (ok) {
+        PRINTF("temp = %u\n", value);
+    } else {
+        PRINTF("temp: read failed\n");
+    }
+}
+
+void appMain(void)
+{
+    PRINTF("Humidity async test app\n");
+
+    humidityOn();
+
+    // response time as per datasheet
+    sleep(8);
+
+    while (1) {
+        // the second request is queued until the first one completes
+        humidityReadAsync(onHumidity, NULL);
+        temperatureReadAsync(onTemperature, NULL);
+        redLedToggle();
+        mdelay(100);
+        redLedToggle();
+        sleep(1);
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-------------------------------------------
+// MAC header encoding/decoding benchmark.
+// Prints header size and encode/decode time for a few typical packets.
+// Build with and without CONST_MAC_COMPRESS_HEADER=1 to compare.
+//-------------------------------------------
+
+#include <stdmansos.h>
+#include <net/mac.h>
+#include <net/routing.h>
+#include <net/seal_networking.h>
+#include <assert.h>
+#include <string.h>
+
+#define ITERATIONS 1000
+
+#define LOCAL_ADDR     0x1234
+#define OTHER_ADDR     0x2222
+#define PARENT_ADDR    0x0003
+
+typedef struct Scenario_s {
+    const char *name;
+    uint16_t originalSrc;
+    uint16_t originalDst;
+    uint16_t immedSrc;
+    uint16_t immedDst;
+    uint8_t port;
+    uint8_t hoplimit;
+} Scenario_t;
+
+static const Scenario_t scenarios[] = {
+    { "one hop to base station", LOCAL_ADDR, MOS_ADDR_BASESTATION,
+      LOCAL_ADDR, MOS_ADDR_BASESTATION, SEAL_DATA_PORT, MAX_HOP_COUNT },
+    { "own packet via parent", LOCAL_ADDR, MOS_ADDR_BASESTATION,
+      LOCAL_ADDR, PARENT_ADDR, SEAL_DATA_PORT, MAX_HOP_COUNT },
+    { "forwarded packet", OTHER_ADDR, MOS_ADDR_BASESTATION,
+      LOCAL_ADDR, PARENT_ADDR, SEAL_DATA_PORT, MAX_HOP_COUNT - 1 },
+    { "routing broadcast", LOCAL_ADDR, MOS_ADDR_BROADCAST,
+      0, 0, ROUTING_PROTOCOL_PORT, 0 },
+};
+
+static void fillMacInfo(MacInfo_t *mi, const Scenario_t *s)
+{
+    memset(mi, 0, sizeof(*mi));
+    mi->originalSrc.shortAddr = s->originalSrc;
+    mi->originalDst.shortAddr = s->originalDst;
+    mi->immedSrc.shortAddr = s->immedSrc;
+    mi->immedDst.shortAddr = s->immedDst;
+    mi->srcPort = mi->dstPort = s->port;
+    mi->hoplimit = s->hoplimit;
+    mi->seqnum = 42;
+}
+
+static void runScenario(const Scenario_t *s)
+{
+    MacInfo_t mi, parsed;
+    uint8_t frame[32];
+    uint8_t *header;
+    uint16_t headerLength = 0;
+    uint32_t start, encodeTime, decodeTime;
+    uint16_t i;
+
+    fillMacInfo(&mi, s);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) {
+        defaultBuildHeader(&mi, &header, &headerLength);
+    }
+    encodeTime = getTimeMs() - start;
+    memcpy(frame, header, headerLength);
+
+    start = getTimeMs();
+    for (i = 0; i < ITERATIONS; ++i) {
+        defaultParseHeader(frame, headerLength, &parsed);
+    }
+    decodeTime = getTimeMs() - start;
+
+    // check that nothing was lost
+    ASSERT(parsed.originalSrc.shortAddr == mi.originalSrc.shortAddr);
+    ASSERT(parsed.originalDst.shortAddr == mi.originalDst.shortAddr);
+    ASSERT(parsed.immedSrc.shortAddr == mi.immedSrc.shortAddr);
+    ASSERT(parsed.immedDst.shortAddr == mi.immedDst.shortAddr);
+    ASSERT(parsed.srcPort == mi.srcPort && parsed.dstPort == mi.dstPort);
+    ASSERT(parsed.hoplimit == mi.hoplimit && parsed.seqnum == mi.seqnum);
+
+    PRINTF("%s: header %u bytes, encode %lu us, decode %lu us\n",
+            s->name, headerLength,
+            encodeTime * 1000 / ITERATIONS, decodeTime * 1000 / ITERATIONS);
+}
+
+void appMain(void)
+{
+    uint8_t i;
+
+    PRINTF("MAC header benchmark, compression %s\n",
+            MAC_COMPRESS_HEADER ? "on" : "off");
+    for (i = 0; i < sizeof(scenarios) / sizeof(*scenarios); ++i) {
+        runScenario(&scenarios[i]);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//-------------------------------------------
+// Serial transmission throughput test.
+// Reports bytes per second and the part of the time the CPU
+// is busy in serialSendData() / PRINTF(), as opposed to the time
+// the data takes to leave the serial port.
+// Build with and without USE_SERIAL_TX_BUFFER=y to compare.
+//-------------------------------------------
+
+#include <stdmansos.h>
+
+#define DATA_SIZE  1024
+#define LINE_COUNT 32
+
+static uint8_t data[DATA_SIZE];
+
+static void report(const char *what, uint32_t bytes,
+                   uint32_t start, uint32_t returned, uint32_t done)
+{
+    uint32_t total = done - start;
+    if (total == 0) total = 1;
+    PRINTF("\n%s: %lu bytes/s, CPU busy %lu%%\n", what,
+            bytes * 1000 / total, (returned - start) * 100 / total);
+}
+
+void appMain(void)
+{
+    uint32_t start, returned, done;
+    uint16_t i;
+
+    for (i = 0; i < DATA_SIZE; ++i) {
+        data[i] = 'a' + i % 26;
+    }
+
+    for (;;) {
+        // binary data
+        start = getTimeMs();
+        serialSendData(PRINTF_SERIAL_ID, data, DATA_SIZE);
+        returned = getTimeMs();
+        serialFlush(PRINTF_SERIAL_ID);
+        done = getTimeMs();
+        report("serialSendData", DATA_SIZE, start, returned, done);
+
+        // text lines
+        start = getTimeMs();
+        for (i = 0; i < LINE_COUNT; ++i) {
+            PRINTF("line %u: the quick brown fox jumps over the lazy dog\n", i);
+        }
+        returned = getTimeMs();
+        serialFlush(PRINTF_SERIAL_ID);
+        done = getTimeMs();
+        // each line is 56 or 57 bytes long including "\r\n"
+        report("PRINTF", LINE_COUNT * 56ul, start, returned, done);
+
+        mdelay(5000);
+    }
+}
@@ -39,6 +39,8 @@
 #define humidityRead()     sht11_read_humidity()
 #define temperatureRead()  sht11_read_temperature()
 #define humidityIsError()  sht11_is_error()
+#define humidityReadAsync(cb, param)     sht11ReadAsync(SHT11_CMD_HUM, cb, param)
+#define temperatureReadAsync(cb, param)  sht11ReadAsync(SHT11_CMD_TEMP, cb, param)
 
 // include driver header
 #include <sht11/sht11.h>
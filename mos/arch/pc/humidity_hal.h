@@ -31,5 +31,7 @@
 #define humidityRead() (0)
 #define temperatureRead() (0)
 #define humidityIsError() (0)
+#define humidityReadAsync(cb, param) ({ (cb)(0, true, (param)); true; })
+#define temperatureReadAsync(cb, param) ({ (cb)(0, true, (param)); true; })
 
 #endif
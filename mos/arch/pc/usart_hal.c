@@ -29,9 +29,11 @@
 #include <winsock.h>
 #endif
 #include <serial.h>
+#include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include "platform.h"
 
 //===========================================================
@@ -66,6 +68,58 @@ void serialSendByte(uint8_t id, uint8_t data)
     }
 }
 
+void serialSendData(uint8_t id, const uint8_t *data, uint16_t len)
+{
+    if (id >= SERIAL_COUNT) return;
+
+    // a single system call instead of one per byte
+    while (txEnabled[id] && len) {
+        ssize_t ret = write(STDOUT_FILENO, data, len);
+        if (ret <= 0) break;
+        data += ret;
+        len -= ret;
+    }
+}
+
+void serialSendString(uint8_t id, const char *s)
+{
+    static const char cr = '\r';
+    struct iovec iov[16];
+    uint_t count = 0;
+
+    if (id >= SERIAL_COUNT || !txEnabled[id]) return;
+
+    // HACK: fix the newlines. The lines and the inserted '\r' symbols
+    // are written out with a single system call.
+    while (*s) {
+        const char *newline = strchr(s, '\n');
+        size_t len = newline ? newline - s + 1 : strlen(s);
+        iov[count].iov_base = (void *) s;
+        iov[count].iov_len = len;
+        count++;
+        if (newline) {
+            iov[count].iov_base = (void *) &cr;
+            iov[count].iov_len = 1;
+            count++;
+        }
+        s += len;
+        if (count >= sizeof(iov) / sizeof(*iov) - 1) {
+            int ret = writev(STDOUT_FILENO, iov, count);
+            (void) ret;
+            count = 0;
+        }
+    }
+    if (count) {
+        int ret = writev(STDOUT_FILENO, iov, count);
+        (void) ret;
+    }
+}
+
+void serialFlush(uint8_t id)
+{
+    // nothing to do: the data is written out synchronously
+}
+
 void serialEnableTX( uint8_t id )
 {
     if (id >= SERIAL_COUNT) return;
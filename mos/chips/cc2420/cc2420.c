@@ -424,7 +424,7 @@ int_t cc2420Read(void *buf, uint16_t bufsize)
     uint8_t footer[2];
     uint8_t len;
 #if CC2420_CONF_CHECKSUM
-    uint16_t checksum;
+    uint16_t checksum, calcChecksum;
 #endif
     int_t result = -EIO;
 
@@ -466,13 +466,14 @@ int_t cc2420Read(void *buf, uint16_t bufsize)
     getrxdata(footer, FOOTER_LEN);
 
 #if CC2420_CONF_CHECKSUM
-    if (checksum != crc16(buf, len)) {
+    calcChecksum = crc16(buf, len);
+    if (checksum != calcChecksum) {
         RPRINTF("checksum failed 0x%04x != 0x%04x\n",
-                checksum, crc16(buf, len));
+                checksum, calcChecksum);
     }
 
     if ((footer[1] & FOOTER1_CRC_OK) &&
-            checksum == crc16(buf, len)) {
+            checksum == calcChecksum) {
 #else
     if ((footer[1] & FOOTER1_CRC_OK)) {
 #endif // CC2420_CONF_CHECKSUM
@@ -26,8 +26,9 @@
 //
 // Parasite power mode is not supported.
 //
-// TODO: Maybe split the measurement procedure into two parts (initiate
-// conversion and read result).
+// A measurement is split into two parts: starting the conversion and
+// reading the result. ds18b20ReadAsync() waits for the conversion
+// using an alarm instead of busy-waiting.
 //
 
 #define DS18B20_CHECK_CRC // Define to compute CRC sum of the received data
@@ -35,6 +36,9 @@
 #include <string.h>
 
 #include <sleep.h>
+#ifdef USE_ALARMS
+#include <alarms.h>
+#endif
 #include <lib/codec/crc.h>
 
 #include "ds18b20.h"
@@ -57,9 +61,6 @@ enum {
     CMD_READ_POWER   = 0xB4  // READ POWER SUPPLY
 };
 
-// See the data sheet
-#define MEASURE_WAIT_TIME ((750 >> (3 - DS18B20_RESOLUTION)) + 1)
-
 bool ds18b20Init(void)
 {
     Handle_t h;
@@ -81,34 +82,34 @@ bool ds18b20Init(void)
     return true;
 }
 
-int16_t ds18b20Measure(void)
+bool ds18b20StartConversion(void)
 {
-    Handle_t  h;
-    int16_t   res;
-    uint8_t  *data = (uint8_t *)&res;
-#ifdef DS18B20_CHECK_CRC
-    uint8_t   i, crc;
-    uint16_t  acc = 0;
-#endif
+    Handle_t h;
 
-    // Start conversion
     if (owreset())
     {
-        // Fail
-        return 0xDEAD; // This value is outside of possible measurement range
+        return false;
     }
     ATOMIC_START(h);
     owwriteb(CMD_SKIP_ROM);
     owwriteb(CMD_CONVERT);
     ATOMIC_END(h);
+    return true;
+}
 
-    // Wait
-    mdelay(MEASURE_WAIT_TIME);
+int16_t ds18b20ReadResult(void)
+{
+    Handle_t  h;
+    int16_t   res;
+    uint8_t  *data = (uint8_t *)&res;
+#ifdef DS18B20_CHECK_CRC
+    uint8_t   i, crc;
+    uint16_t  acc = 0;
+#endif
 
-    // Retrieve result
     if (owreset())
     {
-        return 0xDEAD;
+        return DS18B20_ERROR;
     }
     ATOMIC_START(h);
     owwriteb(CMD_SKIP_ROM);
@@ -128,9 +129,54 @@ int16_t ds18b20Measure(void)
 #ifdef DS18B20_CHECK_CRC
     if (acc != crc)
     {
-        return 0xDEAD;
+        return DS18B20_ERROR;
     }
 #endif
 
     return res;
 }
+
+int16_t ds18b20Measure(void)
+{
+    if (!ds18b20StartConversion())
+    {
+        return DS18B20_ERROR;
+    }
+    mdelay(DS18B20_CONVERSION_TIME);
+    return ds18b20ReadResult();
+}
+
+#ifdef USE_ALARMS
+
+static SensorReadyCallback readyCallback;
+static void *readyParam;
+
+static void conversionDone(void *param)
+{
+    SensorReadyCallback cb = readyCallback;
+    int16_t res = ds18b20ReadResult();
+
+    readyCallback = NULL;
+    cb(res, res != DS18B20_ERROR, readyParam);
+}
+
+static Alarm_t conversionAlarm = { .callback = conversionDone };
+
+bool ds18b20ReadAsync(SensorReadyCallback callback, void *param)
+{
+    if (readyCallback)
+    {
+        return false; // busy
+    }
+    if (!ds18b20StartConversion())
+    {
+        callback(DS18B20_ERROR, false, param);
+        return true;
+    }
+    readyCallback = callback;
+    readyParam = param;
+    alarmSchedule(&conversionAlarm, DS18B20_CONVERSION_TIME);
+    return true;
+}
+
+#endif // USE_ALARMS
@@ -29,6 +29,7 @@
 #define DS18B20_H
 
 #include <stdtypes.h>
+#include <sensor_async.h>
 
 //
 // Available conversion resolutions
@@ -43,8 +44,27 @@ enum {
 // Selected conversion resolution
 #define DS18B20_RESOLUTION BS18B20_9BIT
 
+// Conversion time, ms (see the data sheet)
+#define DS18B20_CONVERSION_TIME ((750 >> (3 - DS18B20_RESOLUTION)) + 1)
+
+// Returned on errors; this value is outside of possible measurement range
+#define DS18B20_ERROR ((int16_t) 0xDEAD)
+
 bool ds18b20Init(void);
 
+// Start a conversion and wait for the result (blocking)
 int16_t ds18b20Measure(void);
 
+// Start a conversion; returns false if the sensor does not respond
+bool ds18b20StartConversion(void);
+
+// Read the result (DS18B20_CONVERSION_TIME after the start)
+int16_t ds18b20ReadResult(void);
+
+#ifdef USE_ALARMS
+// Start a conversion and call 'callback' with the result when it is done.
+// Returns false if a conversion is already in progress.
+bool ds18b20ReadAsync(SensorReadyCallback callback, void *param);
+#endif
+
 #endif // DS18B20_H
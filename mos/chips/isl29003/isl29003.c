@@ -333,11 +333,26 @@ bool clearIslInterupt(void)
     return err;
 }
 
+// Read the result registers
+static bool islReadData(uint16_t *data)
+{
+    uint8_t val;
+    /* Reads register 5 - MSB */
+    if (readIslRegister(0x05, &val)) {
+        return false;    //fail!
+    }
+    *data = val << 8;
+    /* Reads register 4 - LSB*/
+    if (readIslRegister(0x04, &val)) {
+        return false;    //fail!
+    }
+    *data += val;
+    return true;
+}
+
 // Read ISL29003 sensor data
 bool islRead(uint16_t *data, bool checkInterupt)
 {
-    uint8_t val;
-	
 	/* Check if init went OK */
 	if (!islInitOk) {
 		*data = 0xffff;
@@ -357,16 +372,9 @@ bool islRead(uint16_t *data, bool checkInterupt)
     if (checkInterupt){
         while (!islInterupt(true));
     }
-    /* Reads register 5 - MSB */
-    if (readIslRegister(0x05, &val)) {
-        return false;    //fail!
-    }
-    *data = val << 8;
-    /* Reads register 4 - LSB*/
-    if (readIslRegister(0x04, &val)) {
+    if (!islReadData(data)) {
         return false;    //fail!
     }
-    *data+=val;
     /* Hide our tracks... */
     if (!on) {
         islOff();
@@ -385,3 +393,77 @@ uint16_t islReadSimple(void)
     }
     return result;
 }
+
+#ifdef USE_ALARMS
+
+//
+// Asynchronous read: the interrupt bit is polled from an alarm
+// instead of a busy loop, so other work can proceed meanwhile.
+//
+
+static SensorReadyCallback readyCallback;
+static void *readyParam;
+static bool wasOn, wasAwake;
+static uint16_t waitTime;
+
+static void islAsyncFinish(uint16_t value, bool ok)
+{
+    SensorReadyCallback cb = readyCallback;
+
+    if (!wasOn) {
+        islOff();
+    }
+    if (!wasAwake) {
+        islSleep();
+    }
+    readyCallback = NULL;
+    cb(value, ok, readyParam);
+}
+
+static void islPollAlarmCallback(void *);
+static Alarm_t islPollAlarm = { .callback = islPollAlarmCallback };
+
+static void islPollAlarmCallback(void *param)
+{
+    uint16_t data;
+
+    if (islInterupt(true)) {
+        if (islReadData(&data)) {
+            islAsyncFinish(data, true);
+        } else {
+            islAsyncFinish(0xffff, false);
+        }
+        return;
+    }
+    waitTime += ISL_POLL_INTERVAL;
+    if (waitTime >= ISL_ASYNC_TIMEOUT) {
+        islAsyncFinish(0xffff, false);
+        return;
+    }
+    alarmSchedule(&islPollAlarm, ISL_POLL_INTERVAL);
+}
+
+bool islReadAsync(SensorReadyCallback callback, void *param)
+{
+    if (readyCallback) return false; // busy
+    if (!islInitOk) {
+        callback(0xffff, false, param);
+        return true;
+    }
+
+    readyCallback = callback;
+    readyParam = param;
+    wasOn = isIslOn();
+    wasAwake = isIslWake();
+    if (!wasOn) {
+        islOn();
+    }
+    if (!wasAwake) {
+        islWake();
+    }
+    waitTime = 0;
+    alarmSchedule(&islPollAlarm, ISL_POLL_INTERVAL);
+    return true;
+}
+
+#endif // USE_ALARMS
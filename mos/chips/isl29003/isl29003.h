@@ -25,6 +25,7 @@
 #define MANSOS_ISL29003_H
 
 #include "i2c_soft.h"
+#include <sensor_async.h>
 
 /* ISL29003 soft I2C support */
 #define ISL_I2C_SDA_HI()   pinSet(SDA_PORT, SDA_PIN)
@@ -146,4 +147,19 @@ bool islRead(uint16_t *data, bool checkInterupt);
 
 uint16_t islReadSimple(void);
 
+#ifdef USE_ALARMS
+
+// How often to check for the end of an asynchronous conversion, ms
+#ifndef ISL_POLL_INTERVAL
+#define ISL_POLL_INTERVAL 10
+#endif
+// Give up after this time; a 16-bit conversion takes ~100 ms
+#define ISL_ASYNC_TIMEOUT 500
+
+// Start reading ISL29003 without blocking; 'callback' is called with
+// the value when the conversion is finished. Returns false if busy.
+bool islReadAsync(SensorReadyCallback callback, void *param);
+
+#endif
+
 #endif
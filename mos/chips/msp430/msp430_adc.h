@@ -77,6 +77,16 @@
 #define SREF_1      ADC12SREF_1
 #endif
 
+#ifndef CONSEQ_1
+#define CONSEQ_1    ADC12CONSEQ_1
+#define CONSEQ_3    ADC12CONSEQ_3
+#define MSC         ADC12MSC
+#define EOS         ADC12EOS
+#endif
+
+// the conversion start address field in ADC12CTL1
+#define ADC12_CSTARTADD_MASK 0xf000
+
 // pin to which ADC0 is connected. Used for external VRef
 #define ADC0_PORT 6
 #define ADC0_PIN 0
@@ -194,6 +204,47 @@ static inline bool hplAdcIsBusy(void)
     return ADC12CTL1 & ADC12BUSY;
 }
 
+//
+// Convert a sequence of channels at once, using the "sequence-of-channels"
+// mode: the conversions follow each other automatically (MSC bit), and the
+// CPU waits only for the end of the whole sequence.
+// Results are stored in out[0], out[stride], out[2 * stride], ...
+//
+#define ADC_HAS_SEQUENCE 1
+#define ADC_MAX_SEQUENCE 16
+
+static inline void hplAdcReadSequence(const uint8_t *channels, uint8_t count,
+                                      uint16_t *out, uint16_t stride)
+{
+    volatile uint8_t *mctl = (volatile uint8_t *) &ADC12MCTL0;
+    volatile uint16_t *mem = (volatile uint16_t *) &ADC12MEM0;
+    // keep the single-channel setup, it is restored afterwards
+    uint8_t mctl2 = ADC12MCTL2;
+    uint8_t ref = mctl2 & SREF_7;
+    bool wasEnabled = ADC12CTL0 & ENC;
+    uint8_t i;
+
+    ADC12CTL0 &= ~ENC;
+    for (i = 0; i < count; i++) {
+        mctl[i] = ref | channels[i];
+    }
+    mctl[count - 1] |= EOS;
+    ADC12CTL1 = (ADC12CTL1 & ~(ADC12_CSTARTADD_MASK | CONSEQ_3)) | CONSEQ_1;
+    ADC12CTL0 |= MSC | ENC;
+
+    ADC12CTL0 |= ADC12SC;
+    while (ADC12CTL1 & ADC12BUSY);
+    for (i = 0; i < count; i++, out += stride) {
+        *out = mem[i];
+    }
+
+    // back to single-channel conversions from ADC12MEM2
+    ADC12CTL0 &= ~(ENC | MSC);
+    ADC12CTL1 = (ADC12CTL1 & ~(ADC12_CSTARTADD_MASK | CONSEQ_3)) | CSTARTADD_2;
+    ADC12MCTL2 = mctl2;
+    if (wasEnabled) ADC12CTL0 |= ENC;
+}
+
 #endif // USE_ADC
 
 static inline bool hplAdcUsesSMCLK(void)
@@ -290,3 +290,35 @@ ISR(UART1RX, UART1InterruptHandler)
 }
 
 #endif // USE_SERIAL_RX
+
+#if USE_SERIAL_TX_BUFFER
+
+extern int16_t serialBufferNextByte(uint8_t id);
+
+ISR(UART0TX, UART0TxInterruptHandler)
+{
+    int16_t x = serialBufferNextByte(0);
+    if (x < 0) {
+        // all sent; keep the flag set, as it was cleared by servicing
+        // the interrupt, and the next transmission needs it to start
+        IE1 &= ~UTXIE0;
+        IFG1 |= UTXIFG0;
+    } else {
+        U0TXBUF = x;
+    }
+}
+
+ISR(UART1TX, UART1TxInterruptHandler)
+{
+    int16_t x = serialBufferNextByte(1);
+    if (x < 0) {
+        // all sent; keep the flag set, as it was cleared by servicing
+        // the interrupt, and the next transmission needs it to start
+        IE2 &= ~UTXIE1;
+        IFG2 |= UTXIFG1;
+    } else {
+        U1TXBUF = x;
+    }
+}
+
+#endif // USE_SERIAL_TX_BUFFER
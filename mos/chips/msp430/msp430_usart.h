@@ -68,10 +68,52 @@ static inline bool serialIsI2C(uint8_t id) {
     else return (U1CTL & SYNC) && (U1CTL & I2C);
 }
 
+#if USE_SERIAL_TX_BUFFER
+// TX interrupt driven buffered transmission (UART mode only)
+#define SERIAL_HAS_TX_BUFFER 1
+
+// implemented in hil/serial.c
+void serialBufferSendByte(uint8_t id, uint8_t data);
+
+// the buffer is used only in UART mode (not when the USART is used for SPI or I2C)
+static inline bool serialTxBufferUsable(uint8_t id) {
+    return serialIsUART(id);
+}
+
+// start TX interrupts; the interrupt handler fetches data from the buffer
+static inline void serialTxStart(uint8_t id) {
+    if (id == 0) IE1 |= UTXIE0;
+    else IE2 |= UTXIE1;
+}
+
+// send a byte without using interrupts (for use when they are disabled)
+static inline void serialTxPoll(uint8_t id, uint8_t data) {
+    if (id == 0) {
+        while (!(IFG1 & UTXIFG0));
+        U0TXBUF = data;
+    } else {
+        while (!(IFG2 & UTXIFG1));
+        U1TXBUF = data;
+    }
+}
+
+// true when the transmitter has nothing more to send
+static inline bool serialTxIdle(uint8_t id) {
+    if (id == 0) return U0TCTL & TXEPT;
+    else return U1TCTL & TXEPT;
+}
+#endif
+
 static inline void serialSendByte(uint8_t id, uint8_t data)
 {
 //    STACK_GUARD();
 
+#if USE_SERIAL_TX_BUFFER
+    if (serialTxBufferUsable(id)) {
+        serialBufferSendByte(id, data);
+        return;
+    }
+#endif
     if (id == 0) {
         U0TXBUF = data;
         while ((U0TCTL & TXEPT) == 0);  // Is byte sent ?
@@ -118,6 +160,11 @@ static inline bool serialUsesSMCLK(void ) {
     // to *transmit* anything while the MCU is sleeping
     if ((U0ME & URXE0) && (U0TCTL & SSEL_SMCLK)) return true;
     if ((U1ME & URXE1) && (U1TCTL & SSEL_SMCLK)) return true;
+#if USE_SERIAL_TX_BUFFER
+    // ...unless there is buffered data being transmitted in background
+    if ((IE1 & UTXIE0) && (U0TCTL & SSEL_SMCLK)) return true;
+    if ((IE2 & UTXIE1) && (U1TCTL & SSEL_SMCLK)) return true;
+#endif
     return false;
 }
 
@@ -27,6 +27,9 @@
 
 #include "sht11.h"
 #include <delay.h>
+#ifdef USE_ALARMS
+#include <alarms.h>
+#endif
 
 bool shtIsOn;
 
@@ -112,6 +115,23 @@ uint_t sht11_recv_ack() {
     return res;
 }
 
+// send the command and check the acknowledgment
+static bool sht11_start_cmd(uint_t cmd) {
+    SHT11_SEND_START_SEQ();
+    sht11_send_byte(cmd);
+    return sht11_recv_ack();
+}
+
+// read the result of a measurement, after the sensor has pulled data low
+static uint16_t sht11_read_result(void) {
+    uint16_t res = sht11_recv_byte() << 8;
+    SHT11_SEND_ACK();
+    res |= sht11_recv_byte();
+    SHT11_SKIP_ACK();
+    // CRC not used
+    return res;
+}
+
 // send read cmd, return result
 uint16_t sht11_cmd(uint_t cmd) {
     if (cmd != SHT11_CMD_TEMP
@@ -119,24 +139,114 @@ uint16_t sht11_cmd(uint_t cmd) {
         && cmd != SHT11_CMD_RESET) {
         return 0xffff;
     }
+#ifdef USE_ALARMS
+    // an asynchronous measurement is using the bus
+    // (the reset command is used when turning the sensor on for it)
+    if (cmd != SHT11_CMD_RESET && sht11AsyncBusy()) return 0xffff;
+#endif
 
-    SHT11_SEND_START_SEQ();
-    sht11_send_byte(cmd);
-
-    if (!sht11_recv_ack()) {
+    if (!sht11_start_cmd(cmd)) {
         return 0xffff;
     }
 
     uint16_t res = 0;
     if (cmd == SHT11_CMD_TEMP || cmd == SHT11_CMD_HUM) {
         SHT11_WAIT();
-
-        res = sht11_recv_byte() << 8;
-        SHT11_SEND_ACK();
-        res |= sht11_recv_byte();
-        SHT11_SKIP_ACK();
+        res = sht11_read_result();
     }
-    // CRC not used
 
     return res;
 }
+
+#ifdef USE_ALARMS
+
+//
+// Asynchronous measurements: the command is sent, and the data line
+// is polled from an alarm until the sensor signals completion.
+// One measurement can be in progress, one more can be queued.
+//
+
+typedef struct Sht11Request_s {
+    SensorReadyCallback callback;
+    void *param;
+    uint8_t cmd;
+} Sht11Request_t;
+
+static Sht11Request_t current, queued;
+static uint16_t waitTime;
+
+static void sht11AlarmCallback(void *);
+static Alarm_t sht11Alarm = { .callback = sht11AlarmCallback };
+
+static void sht11StartCurrent(void);
+
+static void sht11Finish(uint16_t value, bool ok) {
+    Sht11Request_t r = current;
+    bool startQueued = false;
+
+    // the queued request becomes current before the callback, so that
+    // a request made from the callback is queued behind it
+    current.callback = NULL;
+    if (queued.callback) {
+        current = queued;
+        queued.callback = NULL;
+        startQueued = true;
+    }
+    // the result is delivered before the next measurement touches the bus
+    r.callback(value, ok, r.param);
+    if (startQueued) sht11StartCurrent();
+}
+
+static void sht11StartCurrent(void) {
+    if (!shtIsOn) SHT11_ON();
+    if (!sht11_start_cmd(current.cmd)) {
+        sht11Finish(0xffff, false);
+        return;
+    }
+    waitTime = 0;
+    alarmSchedule(&sht11Alarm, SHT11_POLL_INTERVAL);
+}
+
+static void sht11AlarmCallback(void *param) {
+    if (!SHT11_SDA_GET()) {
+        sht11Finish(sht11_read_result(), true);
+        return;
+    }
+    waitTime += SHT11_POLL_INTERVAL;
+    if (waitTime >= SHT11_ASYNC_TIMEOUT) {
+        sht11_conn_reset();
+        sht11Finish(0xffff, false);
+        return;
+    }
+    alarmSchedule(&sht11Alarm, SHT11_POLL_INTERVAL);
+}
+
+bool sht11AsyncBusy(void) {
+    return current.callback != NULL;
+}
+
+bool sht11ReadAsync(uint_t cmd, SensorReadyCallback callback, void *param) {
+    bool start = false;
+    Handle_t h;
+
+    ATOMIC_START(h);
+    if (!current.callback) {
+        current.callback = callback;
+        current.param = param;
+        current.cmd = cmd;
+        start = true;
+    } else if (!queued.callback) {
+        queued.callback = callback;
+        queued.param = param;
+        queued.cmd = cmd;
+    } else {
+        ATOMIC_END(h);
+        return false;
+    }
+    ATOMIC_END(h);
+
+    if (start) sht11StartCurrent();
+    return true;
+}
+
+#endif // USE_ALARMS
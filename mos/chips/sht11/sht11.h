@@ -31,6 +31,7 @@
 #include <digital.h>
 #include <defines.h>
 #include "humidity_hal.h"
+#include <sensor_async.h>
 
 // -----------------------
 // internal stuff
@@ -126,6 +127,27 @@ static inline uint16_t sht11_read_humidity(void) {
     return sht11_cmd(SHT11_CMD_HUM);
 }
 
+#ifdef USE_ALARMS
+
+// how often to check for the end of an asynchronous measurement, ms
+#ifndef SHT11_POLL_INTERVAL
+#define SHT11_POLL_INTERVAL   10
+#endif
+// a 14-bit measurement takes up to 320 ms
+#define SHT11_ASYNC_TIMEOUT   500
+
+//
+// Start a measurement (SHT11_CMD_TEMP or SHT11_CMD_HUM) without blocking;
+// the callback is called when it is finished. If a measurement is already
+// in progress, the request is queued. Returns false if the queue is full.
+//
+bool sht11ReadAsync(uint_t cmd, SensorReadyCallback callback, void *param);
+
+// is an asynchronous measurement in progress?
+bool sht11AsyncBusy(void);
+
+#endif
+
 // TODO: improve this (use global variable?)
 #define sht11_is_error() \
     (sht11_read_humidity() == 0xffff)
@@ -36,6 +36,9 @@
 #include "tmp102.h"
 #include <platform.h>
 #include <platforms/z1/i2cmaster.h>
+#ifdef USE_ALARMS
+#include <alarms.h>
+#endif
 
 #define TMP102_DEBUG 0
 
@@ -135,3 +138,39 @@ int16_t tmp102ReadDegrees(void) {
     return (abstemp >> 8) * sign;
 }
 
+#ifdef USE_ALARMS
+
+//
+// Asynchronous read: a one-shot conversion is started with the sensor
+// in shutdown mode, and the result is read from an alarm when it is ready.
+// Continuous conversion mode is restored afterwards.
+//
+
+static SensorReadyCallback readyCallback;
+static void *readyParam;
+
+static void conversionDone(void *param)
+{
+    SensorReadyCallback cb = readyCallback;
+    uint16_t raw = tmp102ReadRaw();
+
+    tmp102_writeReg(TMP102_CONF, TMP102_CONF_DEFAULT);
+    readyCallback = NULL;
+    cb(raw, true, readyParam);
+}
+
+static Alarm_t conversionAlarm = { .callback = conversionDone };
+
+bool tmp102ReadAsync(SensorReadyCallback callback, void *param)
+{
+    if (readyCallback) return false; // busy
+
+    readyCallback = callback;
+    readyParam = param;
+    tmp102_writeReg(TMP102_CONF,
+            TMP102_CONF_DEFAULT | TMP102_CONF_ONESHOT | TMP102_CONF_SHUTDOWN);
+    alarmSchedule(&conversionAlarm, TMP102_CONVERSION_TIME);
+    return true;
+}
+
+#endif // USE_ALARMS
@@ -37,6 +37,7 @@
 #define MANSOS_TMP102_H
 
 #include <platform.h>
+#include <sensor_async.h>
 
 // TMP102 pins and I2C slave address must be defined in HAL level
 #ifndef TMP102_ADDR
@@ -73,6 +74,22 @@ int16_t tmp102ReadDegrees(void);
     tmp102_readReg(TMP102_TEMP)
 
 
+// configuration register values
+#define TMP102_CONF_DEFAULT   0x60A0 // 12-bit, 4 Hz continuous conversion
+#define TMP102_CONF_ONESHOT   0x8000 // start a single conversion
+#define TMP102_CONF_SHUTDOWN  0x0100 // no continuous conversion
+
+// one-shot conversion time, ms (26 typical, 35 max)
+#define TMP102_CONVERSION_TIME 35
+
+#ifdef USE_ALARMS
+/**
+ * Start a one-shot conversion and call 'callback' with the raw value
+ * when it is done, without blocking. Returns false if busy.
+ */
+bool tmp102ReadAsync(SensorReadyCallback callback, void *param);
+#endif
+
 //---------------------------------------------------------------
 // Internal functions
 //---------------------------------------------------------------
@@ -171,18 +171,6 @@ static void *blkOpen(const char *path, fsMode_t mode)
         return NULL;
 }
 
-/* TODO: Move it. */
-static uint16_t crc16Acc(const void *data, size_t len, uint16_t acc)
-{
-    const uint8_t *d = data;
-    size_t         i;
-
-    for (i = 0; i < len; i++)
-        acc = crc16Add(acc, d[i]);
-
-    return acc;
-}
-
 /* Should be called with the mutex locked. */
 static void doRead(struct fsBlockHandle * restrict handle, fsOff_t start,
                    void * restrict buf, size_t len)
@@ -225,7 +213,7 @@ static bool fillBuffer(struct fsBlockHandle *handle)
                             &crc, sizeof(crc));
         }
 
-        if (crc16Acc(handle->buf, end - handle->readEnd, 0) != crc)
+        if (crc16Update(0, handle->buf, end - handle->readEnd) != crc)
         {
             fsSetError(FS_ERR_IO);
             /* In case the block number was changed by doRead() */
@@ -337,8 +325,9 @@ static void doFlush(struct fsBlockHandle *handle)
     if (handle->mode & FS_CHECKSUM)
     {
         handle->fcb->crc =
-            crc16Acc(handle->buf + handle->fcb->size % CHUNK_DATA_SIZE,
-                     handle->pos - handle->fcb->size, handle->fcb->crc);
+            crc16Update(handle->fcb->crc,
+                        handle->buf + handle->fcb->size % CHUNK_DATA_SIZE,
+                        handle->pos - handle->fcb->size);
         if (handle->pos % CHUNK_DATA_SIZE == 0) /* Ending this chunk */
         {
             blkExtFlashWrite(serviceAddr(handle->curr, handle->fcb->size),
@@ -92,3 +92,24 @@ uint16_t adcRead(uint8_t ch)
 
     return retval;
 }
+
+void adcReadSequence(const uint8_t *channels, uint8_t count,
+                     uint16_t *out, uint16_t stride)
+{
+#if ADC_HAS_SEQUENCE
+    bool wasOn = hplAdcIsOn();
+    if (!wasOn) hplAdcOn();
+    while (count) {
+        uint8_t n = count > ADC_MAX_SEQUENCE ? ADC_MAX_SEQUENCE : count;
+        hplAdcReadSequence(channels, n, out, stride);
+        channels += n;
+        out += n * stride;
+        count -= n;
+    }
+    if (!wasOn) hplAdcOff();
+#else
+    for (; count; count--, out += stride) {
+        *out = adcRead(*channels++);
+    }
+#endif
+}
@@ -36,7 +36,116 @@ extern SerialCallback_t serialRecvCb[SERIAL_COUNT];
 // Procedures
 //===========================================================
 
+#if SERIAL_HAS_TX_BUFFER
+
+#if SERIAL_TX_BUFFER_SIZE & (SERIAL_TX_BUFFER_SIZE - 1)
+#error SERIAL_TX_BUFFER_SIZE must be a power of 2
+#endif
+
+#define TX_BUFFER_MASK (SERIAL_TX_BUFFER_SIZE - 1)
+
+//! Ring buffer of data waiting to be sent
+typedef struct SerialTxBuffer_s {
+    uint8_t data[SERIAL_TX_BUFFER_SIZE];
+    volatile uint16_t head; // written by senders
+    volatile uint16_t tail; // read by the TX interrupt handler
+} SerialTxBuffer_t;
+
+static SerialTxBuffer_t txBuffer[SERIAL_COUNT];
+
+// called from TX interrupt handler: the next byte to send or -1 if none
+int16_t serialBufferNextByte(uint8_t id)
+{
+    SerialTxBuffer_t *b = &txBuffer[id];
+    uint8_t x;
+
+    if (b->tail == b->head) return -1;
+    x = b->data[b->tail];
+    b->tail = (b->tail + 1) & TX_BUFFER_MASK;
+    return x;
+}
+
+static void serialBufferSend(uint8_t id, const uint8_t *data, uint16_t len)
+{
+    SerialTxBuffer_t *b = &txBuffer[id];
+    Handle_t h;
+
+    while (len) {
+        uint16_t space, chunk;
+
+        ATOMIC_START(h);
+        space = (b->tail - b->head - 1) & TX_BUFFER_MASK;
+        if (space) {
+            // copy as much as fits, in one go, so that the data is not
+            // interleaved with data sent from interrupts when there is room
+            do {
+                chunk = MIN(space, SERIAL_TX_BUFFER_SIZE - b->head);
+                chunk = MIN(chunk, len);
+                memcpy(b->data + b->head, data, chunk);
+                b->head = (b->head + chunk) & TX_BUFFER_MASK;
+                data += chunk;
+                len -= chunk;
+                space -= chunk;
+            } while (space && len);
+            serialTxStart(id);
+        } else if (!h) {
+            // buffer full and interrupts were disabled by the caller:
+            // make room by sending the oldest byte without interrupts
+            serialTxPoll(id, serialBufferNextByte(id));
+        }
+        ATOMIC_END(h);
+    }
+}
+
+void serialBufferSendByte(uint8_t id, uint8_t data)
+{
+    serialBufferSend(id, &data, 1);
+}
+
+void serialFlush(uint8_t id)
+{
+    SerialTxBuffer_t *b = &txBuffer[id];
+    Handle_t h;
+
+    if (id >= SERIAL_COUNT) return;
+    for (;;) {
+        bool empty;
+        ATOMIC_START(h);
+        empty = (b->tail == b->head);
+        if (!empty && !h) serialTxPoll(id, serialBufferNextByte(id));
+        ATOMIC_END(h);
+        if (empty) break;
+    }
+    while (!serialTxIdle(id));
+}
+
+#elif !SERIAL_HAS_BULK_SEND
+
+void serialFlush(uint8_t id) {
+    // nothing to do: all data is sent synchronously
+}
+
+#endif // SERIAL_HAS_TX_BUFFER
+
+#if !SERIAL_HAS_BULK_SEND
+
 void serialSendString(uint8_t id, const char *s) {
+#if SERIAL_HAS_TX_BUFFER
+    if (serialTxBufferUsable(id)) {
+        // buffer the text up to each newline at once
+        const char *line = s;
+        for (;; ++s) {
+            if (*s == '\n' || !*s) {
+                serialBufferSend(id, (const uint8_t *) line, s - line);
+                if (!*s) break;
+                // HACK: fix the newlines
+                serialBufferSend(id, (const uint8_t *) "\n\r", 2);
+                line = s + 1;
+            }
+        }
+        return;
+    }
+#endif
     for (; *s; ++s) {
         serialSendByte(id, *s);
         if (*s == '\n') {
@@ -48,11 +157,19 @@ void serialSendString(uint8_t id, const char *s) {
 
 void serialSendData(uint8_t id, const uint8_t *data, uint16_t len) {
     const uint8_t *p;
+#if SERIAL_HAS_TX_BUFFER
+    if (serialTxBufferUsable(id)) {
+        serialBufferSend(id, data, len);
+        return;
+    }
+#endif
     for (p = data; p < data + len; ++p) {
         serialSendByte(id, *p);
     }
 }
 
+#endif // !SERIAL_HAS_BULK_SEND
+
 uint_t serialSetReceiveHandle(uint8_t id, SerialCallback_t functionHandle) {
     if (id >= SERIAL_COUNT) return -1;
     serialRecvCb[id] = functionHandle;
@@ -52,6 +52,15 @@ static inline uint16_t adcReadFast(void)
     // return the result
     return hplAdcGetVal();
 }
+///
+/// Read a sequence of channels, storing the results in
+/// out[0], out[stride], out[2 * stride], ...
+/// On MSP430 ADC12 the conversions are done in the hardware
+/// sequence mode, without CPU intervention between them.
+///
+void adcReadSequence(const uint8_t *channels, uint8_t count,
+                     uint16_t *out, uint16_t stride);
+
 //! Get the number of total ADC channels
 static inline uint_t adcGetChannelCount(void) {
     return hplAdcGetChannelCount();
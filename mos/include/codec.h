@@ -36,6 +36,12 @@ uint16_t crc16(const uint8_t *data, uint16_t len);
 //! Calculate 8-bit checksum of data using ^8 + ^5 + ^4 + 1 polynomial
 uint8_t crc8(const uint8_t *data, uint16_t len);
 
+//! Continue 16-bit checksum calculation over more data (crc16Update(0, ...) == crc16(...))
+uint16_t crc16Update(uint16_t crc, const void *data, uint16_t len);
+
+//! Continue 8-bit checksum calculation over more data (crc8Update(0, ...) == crc8(...))
+uint8_t crc8Update(uint8_t crc, const void *data, uint16_t len);
+
 ///
 /// Encode a stream of 'length' bytes bufIn to a HDLC frame bufOut.
 ///   @return a pointer to the next byte after the last encoded
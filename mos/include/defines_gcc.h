@@ -90,6 +90,8 @@
 
 //! This function may be unused
 #define UNUSED __attribute__((unused))
+//! Do not call the profiling hooks in this function (see lib/profile.h)
+#define NO_INSTRUMENT __attribute__((no_instrument_function))
 
 #define PRINTF_LIKE __attribute__ ((format (printf, 1, 2)))
 
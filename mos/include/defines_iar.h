@@ -65,5 +65,6 @@
 #define NAKED // nothing
 #define NO_EPILOGUE PRAGMA(no_epilogue)
 #define WEAK_SYMBOL // nothing
+#define NO_INSTRUMENT // nothing
 
 #endif
@@ -43,5 +43,6 @@
 #define PRINTF_LIKE
 #define restrict
 #define UNUSED
+#define NO_INSTRUMENT
 
 #endif
@@ -29,6 +29,7 @@
 ///
 
 #include <stdtypes.h>
+#include <sensor_async.h>
 
 //! Turn on the humidity sensor
 extern inline void humidityOn(void);
@@ -42,6 +43,12 @@ extern inline bool humidityIsError(void);
 //! Humidity sensors also provide temperature measurements
 extern inline uint16_t temperatureRead(void);
 
+//! Start reading the humidity sensor without blocking (needs USE_ALARMS).
+//! The callback is called with the value. Returns false if the sensor is busy.
+extern inline bool humidityReadAsync(SensorReadyCallback cb, void *param);
+//! Start reading the temperature without blocking (needs USE_ALARMS)
+extern inline bool temperatureReadAsync(SensorReadyCallback cb, void *param);
+
 
 // init humidity sensor, do not turn it on
 extern inline void humidityInit(void);
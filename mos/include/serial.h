@@ -43,6 +43,13 @@
 #endif
 
 
+//! Size of the transmit buffer (per serial port); must be a power of 2.
+/// Used only with USE_SERIAL_TX_BUFFER, on the platforms that support it.
+#ifndef SERIAL_TX_BUFFER_SIZE
+#define SERIAL_TX_BUFFER_SIZE 64
+#endif
+
+
 //! Platform-specifig: the number of serial ports available
 #ifndef SERIAL_COUNT
 #define SERIAL_COUNT 0
@@ -83,7 +90,12 @@ void serialDisableRX(uint8_t id);
 //! Send a single byte to a specific serial interface
 void serialSendByte(uint8_t id, uint8_t data);
 
-//! Send binary data to a specific serial interface
+///
+/// Send binary data to a specific serial interface
+///
+/// With USE_SERIAL_TX_BUFFER the data is copied to the transmit buffer
+/// and sent out in background; the function waits only while the buffer is full.
+///
 void serialSendData(uint8_t id, const uint8_t *data, uint16_t len);
 
 ///
@@ -93,6 +105,9 @@ void serialSendData(uint8_t id, const uint8_t *data, uint16_t len);
 ///
 void serialSendString(uint8_t id, const char *string);
 
+//! Wait until all data (including buffered) is sent out of a specific serial interface
+void serialFlush(uint8_t id);
+
 ///
 /// Set callback function for per-byte data receive.
 ///
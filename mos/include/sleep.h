@@ -36,6 +36,12 @@
 ///
 void msleep(uint16_t milliseconds);
 
+///
+/// Make the ongoing (or the next) msleep() of the user context return early.
+/// Can be called from alarm callbacks and interrupt handlers.
+///
+void msleepCancel(void);
+
 #ifdef PLATFORM_PC
 // sleep already defined on PC platform
 # include <unistd.h>
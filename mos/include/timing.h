@@ -138,19 +138,36 @@ static inline uint16_t convertMsToSleepTimer(uint16_t ms)
 //
 #if !USE_ROLE_BASE_STATION && USE_NET
 
-//! Time difference with network root node's clock in milliseconds
+//! Time difference with network root node's clock in milliseconds,
+/// exact at local time rootClockAnchorMs
 extern int64_t rootClockDeltaMs;
+//! The local time (milliseconds, low 32 bits) the delta refers to
+extern uint32_t rootClockAnchorMs;
+//! Root clock's rate relative to the local one minus 1, in 2^-CLOCK_SKEW_SHIFT units
+extern int32_t rootClockSkew;
+
+#define CLOCK_SKEW_SHIFT 24
+
+//! Drift accumulated since rootClockAnchorMs at local time 'localMs'
+static inline int32_t rootClockSkewMs(uint32_t localMs) {
+    if (!rootClockSkew) return 0;
+    return ((int64_t) rootClockSkew * (int32_t) (localMs - rootClockAnchorMs))
+            >> CLOCK_SKEW_SHIFT;
+}
 //! Get the network-wide synchronized time in milliseconds as 32-bit value
 static inline uint32_t getSyncTimeMs(void) {
-    return (uint32_t) (getTimeMs() + rootClockDeltaMs);
+    uint32_t now = getTimeMs();
+    return (uint32_t) (now + rootClockDeltaMs + rootClockSkewMs(now));
 }
 //! Get the network-wide synchronized time in milliseconds as 64-bit value
 static inline uint64_t getSyncTimeMs64(void) {
-    return getTimeMs64() + rootClockDeltaMs;
+    uint64_t now = getTimeMs64();
+    return now + rootClockDeltaMs + rootClockSkewMs((uint32_t) now);
 }
 //! Get the network-wide synchronized time in seconds as 32-bit value
 static inline uint32_t getSyncTimeSec(void) {
-    return (uint32_t) (getTimeSec() + rootClockDeltaMs / 1000);
+    return (uint32_t) (getTimeSec()
+            + (rootClockDeltaMs + rootClockSkewMs(getTimeMs())) / 1000);
 }
 
 #else
@@ -66,6 +66,9 @@
 #if USE_FATFS
 #include <fatfs/fatfs.h>
 #endif
+#if USE_PROFILE
+#include <lib/profile.h>
+#endif
 
 #if (defined DEBUG) && !DPRINT_TO_RADIO
 #define INIT_PRINTF(...) PRINTF(__VA_ARGS__)
@@ -235,6 +238,11 @@ static inline void initSystem(void)
     sealNetInit();
 #endif
 
+#if USE_PROFILE
+    INIT_PRINTF("start profiling...\n");
+    profileInit();
+#endif
+
     INIT_PRINTF("starting the application...\n");
 }
 
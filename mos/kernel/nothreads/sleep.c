@@ -27,6 +27,13 @@
 
 #include <print.h>
 
+static volatile bool msleepCancelled;
+
+void msleepCancel(void)
+{
+    msleepCancelled = true;
+}
+
 //
 // Put the system to sleep for a specific time;
 // version for event-based kernel.
@@ -41,8 +48,8 @@ void msleep(uint16_t ms)
         // how much to sleep?
         uint32_t now = (uint32_t) getJiffies();
         int16_t msToSleep = sleepEnd - now;
-        // if time has passed, quit now
-        if (msToSleep <= 0) break;
+        // if time has passed (or an alarm asked to), quit now
+        if (msToSleep <= 0 || msleepCancelled) break;
 
         // calculate time to sleep: minumum of 'ms' and time to next alarm
         Handle_t handle;
@@ -76,11 +83,12 @@ void msleep(uint16_t ms)
         ATOMIC_END(handle);
 #if 1
         // check for exit conditions
-        if (allTimeSpent) break;
+        if (allTimeSpent || msleepCancelled) break;
 #else
         // use to achieve "wake-on-interrupt" like behavior,
         // given that the there is LPM_EXIT in interrupt handlers
         break;
 #endif
     }
+    msleepCancelled = false;
 }
@@ -80,8 +80,9 @@
 static struct RadioPacketBufferReal_s {
     uint8_t bufferLength;     // length of the buffer
     int8_t receivedLength;    // length of data stored in the packet, or error code if negative
+    uint32_t timestamp;       // local time in milliseconds when the packet was received
     uint8_t buffer[RADIO_BUFFER_SIZE]; // a buffer where the packet is stored
-} realBuf = {RADIO_BUFFER_SIZE, 0, {0}};
+} realBuf = {RADIO_BUFFER_SIZE, 0, 0, {0}};
 
 RadioPacketBuffer_t *radioPacketBuffer = (RadioPacketBuffer_t *) &realBuf;
 // !!!
@@ -113,7 +114,7 @@ PROCESS_THREAD(radio_process, ev, data)
     RPRINTF("%lu, %s received poll\n", getJiffies(), radio_process.name);
 
     radioBufferReset();
-    // packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, last_packet_timestamp);
+    radioPacketBuffer->timestamp = getTimeMs();
     static int len;
     len = radioRecv(radioPacketBuffer->buffer, radioPacketBuffer->bufferLength);
     radioPacketBuffer->receivedLength = len;
@@ -51,6 +51,7 @@ void radioProcess(void)
         return;
     }
 
+    radioPacketBuffer->timestamp = getTimeMs();
     radioPacketBuffer->receivedLength = radioRecv(
             radioPacketBuffer->buffer, radioPacketBuffer->bufferLength);
 }
@@ -306,16 +306,33 @@ NO_EPILOGUE void schedule(void)
     ASM_VOLATILE("ret");
 }
 
+// set when the sleep of the (first) user thread should end early
+static volatile bool msleepCancelled;
+
+void msleepCancel(void)
+{
+    msleepCancelled = true;
+    threadWakeup(0, THREAD_READY);
+}
+
 //
 // Put current thread to sleep for a specific time
 //
 void msleep(uint16_t ms)
 {
-    while (ms > PLATFORM_MAX_SLEEP_MS) {
-        jiffiesToSleep = PLATFORM_MAX_SLEEP_MS;
-        ms -= PLATFORM_MAX_SLEEP_MS;
-        schedule();
+    // only the first user thread can be woken up by msleepCancel()
+    const bool cancellable = (currentThread->index == 0);
+
+    while (!(cancellable && msleepCancelled)) {
+        if (ms > PLATFORM_MAX_SLEEP_MS) {
+            jiffiesToSleep = PLATFORM_MAX_SLEEP_MS;
+            ms -= PLATFORM_MAX_SLEEP_MS;
+            schedule();
+        } else {
+            jiffiesToSleep = ms;
+            schedule();
+            break;
+        }
     }
-    jiffiesToSleep = ms;
-    schedule();
+    if (cancellable) msleepCancelled = false;
 }
@@ -55,6 +55,31 @@
 
 
 
+//! Count the number of bits set in a 32-bit value
+static inline uint_t bitCount32(uint32_t x)
+{
+#ifdef __GNUC__
+    return __builtin_popcountl(x);
+#else
+    uint_t count = 0;
+    for (; x; x &= x - 1) count++;
+    return count;
+#endif
+}
+
+//! Get the index of the lowest bit set in a 32-bit value (x must not be zero)
+static inline uint_t lowestBit32(uint32_t x)
+{
+#ifdef __GNUC__
+    return __builtin_ctzl(x);
+#else
+    uint_t index = 0;
+    while (!(x & 1)) { x >>= 1; index++; }
+    return index;
+#endif
+}
+
+
 //! Calculate square root without using floating point operations, rounded down.
 uint16_t intSqrt(uint32_t);
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "binlog.h"
+#include <serial.h>
+#include <timing.h>
+#include <string.h>
+
+const char binlogAnchor[] = "binlog";
+
+void binlogWrite(const char *format, bool timed, const void *args, uint8_t argsLength)
+{
+    // the whole record is sent at once, so that output from interrupts
+    // or other threads cannot get between the header and the arguments
+    uint8_t record[1 + 1 + 2 + 4 + BINLOG_MAX_ARGS_SIZE];
+    uint8_t *p = record;
+    uint16_t offset = (uint16_t) (format - binlogAnchor);
+
+    if (argsLength > BINLOG_MAX_ARGS_SIZE) argsLength = BINLOG_MAX_ARGS_SIZE;
+
+    *p++ = BINLOG_MAGIC;
+    *p++ = argsLength | (timed ? BINLOG_FLAG_TIMED : 0);
+    *p++ = offset & 0xff;
+    *p++ = offset >> 8;
+    if (timed) {
+        uint32_t now = getTimeMs();
+        memcpy(p, &now, sizeof(now));
+        p += sizeof(now);
+    }
+    memcpy(p, args, argsLength);
+    p += argsLength;
+
+    // with USE_SERIAL_TX_BUFFER this just copies the record in the buffer
+    serialSendData(PRINTF_SERIAL_ID, record, p - record);
+}
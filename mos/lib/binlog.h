@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_BINLOG_H
+#define MANSOS_BINLOG_H
+
+/// \file
+/// Deferred-formatting binary log.
+///
+/// Instead of formatting the text on the mote, a compact binary record
+/// is sent to the serial port: the location of the format string in
+/// the program image, an optional timestamp, and the raw values of
+/// the arguments. The text is reconstructed on the host by
+/// tools/serial/binlog.py, using the ELF file of the application.
+///
+/// Record format (little-endian):
+/// +-------+-------+----------------+------------------+-----------+
+/// | magic | flags | format (16bit) | time ms (32 bit) | arguments |
+/// +-------+-------+----------------+------------------+-----------+
+/// flags: bit 7 - timestamp present; bits 0..6 - length of the arguments.
+/// format: address of the format string, relative to 'binlogAnchor'.
+/// Arguments are stored with the C default argument promotions applied.
+/// String arguments (%s) are stored as pointers and can be decoded only
+/// when they point to constant strings.
+///
+
+#include <defines.h>
+#include <stdtypes.h>
+
+//! The first byte of each binary log record (ASCII "record separator")
+#define BINLOG_MAGIC        0x1e
+#define BINLOG_FLAG_TIMED   0x80
+#define BINLOG_MAX_ARGS_LEN 0x7f
+//! Arguments of a record: at most 9, each at most 8 bytes
+#define BINLOG_MAX_ARGS_SIZE (9 * 8)
+
+//! The format string offsets are relative to this symbol
+extern const char binlogAnchor[];
+
+//! Send a binary log record
+void binlogWrite(const char *format, bool timed, const void *args, uint8_t argsLength);
+
+// never called, used only for compile-time format checking
+static inline void binlogCheckFormat(const char *format, ...) PRINTF_LIKE;
+static inline void binlogCheckFormat(const char *format, ...) { }
+
+// internal: pack the arguments (without the format) in a structure
+#define BINLOG_CAT(a, b) BINLOG_CAT2(a, b)
+#define BINLOG_CAT2(a, b) a ## b
+#define BINLOG_FORMAT(f, ...) f
+#define BINLOG_ARGS(f, ...) __VA_ARGS__
+// the type of an argument after the default argument promotions:
+// "+ 0" promotes the integer types, float is promoted to double explicitly
+#define BINLOG_PROMOTED(a)                                                 \
+    typeof(__builtin_choose_expr(                                          \
+            __builtin_types_compatible_p(typeof((a) + 0), float), 0.0, (a) + 0))
+#define BINLOG_FIELDS(...) \
+    BINLOG_CAT(BINLOG_FIELDS_, COUNT_PARMS(__VA_ARGS__))(__VA_ARGS__)
+#define BINLOG_FIELDS_1(f)
+#define BINLOG_FIELDS_2(f, a) BINLOG_PROMOTED(a) a1;
+#define BINLOG_FIELDS_3(f, a, b) \
+    BINLOG_FIELDS_2(f, a) BINLOG_PROMOTED(b) a2;
+#define BINLOG_FIELDS_4(f, a, b, c) \
+    BINLOG_FIELDS_3(f, a, b) BINLOG_PROMOTED(c) a3;
+#define BINLOG_FIELDS_5(f, a, b, c, d) \
+    BINLOG_FIELDS_4(f, a, b, c) BINLOG_PROMOTED(d) a4;
+#define BINLOG_FIELDS_6(f, a, b, c, d, e) \
+    BINLOG_FIELDS_5(f, a, b, c, d) BINLOG_PROMOTED(e) a5;
+#define BINLOG_FIELDS_7(f, a, b, c, d, e, g) \
+    BINLOG_FIELDS_6(f, a, b, c, d, e) BINLOG_PROMOTED(g) a6;
+#define BINLOG_FIELDS_8(f, a, b, c, d, e, g, h) \
+    BINLOG_FIELDS_7(f, a, b, c, d, e, g) BINLOG_PROMOTED(h) a7;
+#define BINLOG_FIELDS_9(f, a, b, c, d, e, g, h, i) \
+    BINLOG_FIELDS_8(f, a, b, c, d, e, g, h) BINLOG_PROMOTED(i) a8;
+#define BINLOG_FIELDS_10(f, a, b, c, d, e, g, h, i, j) \
+    BINLOG_FIELDS_9(f, a, b, c, d, e, g, h, i) BINLOG_PROMOTED(j) a9;
+
+///
+/// Log a printf-style message (at most 9 arguments).
+/// If the format is not a string constant, it is printed as text.
+///
+#define BINLOG(timed, ...) do {                                         \
+        if (__builtin_constant_p(BINLOG_FORMAT(__VA_ARGS__))) {         \
+            struct PACKED { BINLOG_FIELDS(__VA_ARGS__) } _binlogArgs =  \
+                    { BINLOG_ARGS(__VA_ARGS__) };                       \
+            if (0) binlogCheckFormat(__VA_ARGS__);                      \
+            binlogWrite(BINLOG_FORMAT(__VA_ARGS__), timed,              \
+                    &_binlogArgs, sizeof(_binlogArgs));                 \
+        } else {                                                        \
+            serialSendString(PRINTF_SERIAL_ID,                          \
+                    BINLOG_FORMAT(__VA_ARGS__));                        \
+        }                                                               \
+    } while (0)
+
+#endif
@@ -26,10 +26,40 @@
 
 #include <stdtypes.h>
 
+//
+// Lookup table size used by the block CRC functions:
+//   0   - no tables, bit-by-bit calculation (smallest code);
+//   16  - one lookup per nibble (48 bytes of flash for both tables);
+//   256 - one lookup per byte (768 bytes of flash for both tables).
+// On PC, 256-entry tables are extended to process 8 bytes at a time
+// ("slicing-by-8"), unless CRC_SLICE_BY_8 is defined to 0.
+//
+#ifndef CRC_TABLE_SIZE
+#if PLATFORM_PC
+#define CRC_TABLE_SIZE 256
+#else
+#define CRC_TABLE_SIZE 0
+#endif
+#endif
+
+#ifndef CRC_SLICE_BY_8
+#if PLATFORM_PC && CRC_TABLE_SIZE == 256
+#define CRC_SLICE_BY_8 1
+#else
+#define CRC_SLICE_BY_8 0
+#endif
+#endif
+
 uint16_t crc16(const uint8_t *data, uint16_t len);
 
 uint8_t crc8(const uint8_t *data, uint16_t len);
 
+//! Continue CRC16 calculation; crc16(d, l) == crc16Update(0, d, l)
+uint16_t crc16Update(uint16_t crc, const void *data, uint16_t len);
+
+//! Continue CRC8 calculation; crc8(d, l) == crc8Update(0, d, l)
+uint8_t crc8Update(uint8_t crc, const void *data, uint16_t len);
+
 /* CITT CRC16 polynomial ^16 + ^12 + ^5 + 1 */
 /*-----------------------------------------------------------*/
 static inline uint16_t crc16Add(uint16_t acc, uint8_t byte) {
@@ -30,6 +30,34 @@
 
 
 #include "framer.h"
+#include "crc.h"
+#include <defines.h>
+#include <lib/byteorder.h>
+#include <string.h>
+
+static inline uint8_t *frameEncodeData(int length, const uint8_t *bufIn,
+                                       uint8_t *bufOut)
+{
+    int i;
+    uint8_t byteIn;
+
+    for (i = 0; i < length; i++) {
+        byteIn = *(bufIn++);
+        switch (byteIn) {
+        case FRAME_FLAG_BYTE:
+        case FRAME_ESCAPE_BYTE:
+#ifdef FRAME_ENABLE_ABORT
+        case FRAME_ABORT_BYTE:
+#endif
+            *(bufOut++) = FRAME_ESCAPE_BYTE;
+            *(bufOut++) = byteIn ^ FRAME_XOR_BYTE;
+            break;
+        default:
+            *(bufOut++) = byteIn;
+        }
+    }
+    return bufOut;
+}
 
 //-------------------------------------------------------------------
 //	Encode a stream of bytes bufIn to a HDLC frame bufOut.
@@ -37,28 +65,22 @@
 //-------------------------------------------------------------------
 uint8_t *frameEncode(int length, uint8_t* bufIn, uint8_t* bufOut)
 {
-  int i;
-  uint8_t byteIn;
+    *(bufOut++) = FRAME_FLAG_BYTE;  // Write frame start flag
+    bufOut = frameEncodeData(length, bufIn, bufOut);
+    *(bufOut++) = FRAME_FLAG_BYTE;  // Write frame end flag
+    return bufOut;
+}
 
-  *(bufOut++) = FRAME_FLAG_BYTE:  // Write frame start flag
+uint8_t *frameEncodeCrc(int length, uint8_t* bufIn, uint8_t* bufOut)
+{
+    uint8_t crc[2];
+    le16Write(crc, crc16(bufIn, length));
 
-  for(i=0; i<length; i++){
-    byteIn = *(bufIn++);
-    switch(byteIn){
-      case FRAME_FLAG_BYTE:
-      case FRAME_ESCAPE_BYTE:
-#ifdef FRAME_ENABLE_ABORT
-      case FRAME_ABORT_BYTE:
-#endif
-        *(bufOut++) = FRAME_ESCAPE_BYTE;
-        *(bufOut++) = byteIn ^ FRAME_XOR_BYTE;
-        break;
-      default:
-        *(bufOut++) = byteIn;
-    }
-  } 
-  *(bufOut++) = FRAME_FLAG_BYTE:  // Write frame end flag
-  return (bufOut);
+    *(bufOut++) = FRAME_FLAG_BYTE;
+    bufOut = frameEncodeData(length, bufIn, bufOut);
+    bufOut = frameEncodeData(sizeof(crc), crc, bufOut);
+    *(bufOut++) = FRAME_FLAG_BYTE;
+    return bufOut;
 }
 
 //-------------------------------------------------------------------
@@ -70,32 +92,301 @@ uint8_t *frameEncode(int length, uint8_t* bufIn, uint8_t* bufOut)
 //-------------------------------------------------------------------
 uint8_t *frameDecode(int length, uint8_t* bufIn, uint8_t* bufOut)
 {
-  int i;
-  uint8_t byteIn;
-  uint8_t lastByte;
+    int i;
+    uint8_t byteIn;
+    bool escaped = false;
 
-  lastByte = 0;
-  for(i=0; i<length; i++){
-    byteIn = *(bufIn++);
-    if( lastByte==FRAME_ESCAPE_BYTE ){
-      lastByte = byteIn;
-      *(bufOut++) = byteIn ^ FRAME_XOR_BYTE;
-    }
-    else {
-      lastByte = byteIn;
-      switch(byteIn){
+    for (i = 0; i < length; i++) {
+        byteIn = *(bufIn++);
+        if (escaped) {
+            escaped = false;
+            *(bufOut++) = byteIn ^ FRAME_XOR_BYTE;
+            continue;
+        }
+        switch (byteIn) {
 #ifdef FRAME_ENABLE_ABORT
         case FRAME_ABORT_BYTE:
-          return NULL;  // Frame aborted
+            return NULL;  // Frame aborted
 #endif
         case FRAME_FLAG_BYTE:
-          if( i>0 ) return (buf);  // End of frame. Bail out.
+            if (i > 0) return bufOut;  // End of frame. Bail out.
+            break;
         case FRAME_ESCAPE_BYTE:
-          break;
+            escaped = true;
+            break;
         default:
-          *(bufOut++) = byteIn;
-      }
+            *(bufOut++) = byteIn;
+        }
+    }
+    return bufOut;
+}
+
+//-------------------------------------------------------------------
+// Streaming frame receiver
+//-------------------------------------------------------------------
+
+enum {
+    FRAMER_WAIT_START, // looking for the start of a frame
+    FRAMER_HEADER,     // FRAMER_LENGTH: reading the header
+    FRAMER_DATA,       // reading the frame contents
+    FRAMER_ESCAPE,     // FRAMER_HDLC: the previous byte was an escape
+    FRAMER_SKIP,       // FRAMER_HDLC: frame too long, skip to the next flag
+};
+
+void framerInitHdlc(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                    FramerCallback_t callback)
+{
+    memset(f, 0, sizeof(*f));
+    f->type = FRAMER_HDLC;
+    f->buffer = buffer;
+    f->bufferSize = bufferSize;
+    f->callback = callback;
+}
+
+void framerInitLength(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                      uint8_t startByte, uint8_t lengthOffset,
+                      uint8_t lengthBytes, uint8_t trailerLength,
+                      FramerCallback_t callback)
+{
+    memset(f, 0, sizeof(*f));
+    f->type = FRAMER_LENGTH;
+    f->buffer = buffer;
+    f->bufferSize = bufferSize;
+    f->delimiter = startByte;
+    f->lengthOffset = lengthOffset;
+    f->lengthBytes = lengthBytes;
+    f->trailerLength = trailerLength;
+    f->callback = callback;
+}
+
+void framerInitLine(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                    const char *prefix, uint8_t endByte,
+                    FramerCallback_t callback)
+{
+    memset(f, 0, sizeof(*f));
+    f->type = FRAMER_LINE;
+    f->buffer = buffer;
+    f->bufferSize = bufferSize;
+    f->prefix = prefix;
+    f->delimiter = endByte;
+    f->callback = callback;
+}
+
+void framerReset(Framer_t *f)
+{
+    f->state = FRAMER_WAIT_START;
+    f->length = 0;
+}
+
+static void hdlcFrameEnd(Framer_t *f)
+{
+    uint16_t dataLength;
+
+    if (f->state != FRAMER_DATA || f->length < 2) return;
+    dataLength = f->length - 2;
+    if (le16Read(f->buffer + dataLength) == crc16(f->buffer, dataLength)) {
+        f->callback(f->buffer, dataLength);
+    }
+}
+
+static void hdlcFeedByte(Framer_t *f, uint8_t b)
+{
+    if (b == FRAME_FLAG_BYTE) {
+        // the end of the previous frame and the start of the next one
+        hdlcFrameEnd(f);
+        f->state = FRAMER_DATA;
+        f->length = 0;
+        return;
+    }
+#ifdef FRAME_ENABLE_ABORT
+    if (b == FRAME_ABORT_BYTE) {
+        framerReset(f);
+        return;
+    }
+#endif
+
+    switch (f->state) {
+    case FRAMER_DATA:
+        if (b == FRAME_ESCAPE_BYTE) {
+            f->state = FRAMER_ESCAPE;
+            return;
+        }
+        break;
+    case FRAMER_ESCAPE:
+        b ^= FRAME_XOR_BYTE;
+        f->state = FRAMER_DATA;
+        break;
+    default:
+        return;
+    }
+
+    if (f->length < f->bufferSize) {
+        f->buffer[f->length++] = b;
+    } else {
+        f->state = FRAMER_SKIP;
+    }
+}
+
+static void lengthFrameHeaderEnd(Framer_t *f)
+{
+    uint16_t dataLength;
+    if (f->lengthBytes == 2) {
+        dataLength = be16Read(f->buffer + f->lengthOffset);
+    } else {
+        dataLength = f->buffer[f->lengthOffset];
+    }
+    f->expected = f->length + dataLength + f->trailerLength;
+    f->state = f->expected <= f->bufferSize ? FRAMER_DATA : FRAMER_WAIT_START;
+}
+
+static void lengthFrameEnd(Framer_t *f)
+{
+    f->state = FRAMER_WAIT_START;
+    f->callback(f->buffer, f->length);
+}
+
+static void lengthFeedByte(Framer_t *f, uint8_t b)
+{
+    switch (f->state) {
+    case FRAMER_WAIT_START:
+        if (b == f->delimiter) {
+            f->state = FRAMER_HEADER;
+            f->length = 0;
+        }
+        return;
+    case FRAMER_HEADER:
+        f->buffer[f->length++] = b;
+        if (f->length == f->lengthOffset + f->lengthBytes) {
+            lengthFrameHeaderEnd(f);
+            if (f->state == FRAMER_DATA && f->length == f->expected) {
+                lengthFrameEnd(f);
+            }
+        }
+        return;
+    case FRAMER_DATA:
+        f->buffer[f->length++] = b;
+        if (f->length == f->expected) lengthFrameEnd(f);
+        return;
+    }
+}
+
+static void lineFrameEnd(Framer_t *f)
+{
+    uint16_t length = f->length;
+    f->buffer[length] = '\0';
+    framerReset(f);
+    f->callback(f->buffer, length);
+}
+
+static void lineFeedByte(Framer_t *f, uint8_t b)
+{
+    if (f->state == FRAMER_DATA) {
+        if (b == f->delimiter) {
+            lineFrameEnd(f);
+        } else if (f->length < f->bufferSize - 1) {
+            f->buffer[f->length++] = b;
+        }
+        return;
+    }
+
+    // match the prefix; f->length is the number of characters matched
+    if (b == (uint8_t) f->prefix[f->length]) {
+        if (f->prefix[++f->length] == '\0') {
+            f->state = FRAMER_DATA;
+            f->length = 0;
+        }
+    } else {
+        f->length = (b == (uint8_t) f->prefix[0]);
+    }
+}
+
+void framerFeedByte(Framer_t *f, uint8_t b)
+{
+    switch (f->type) {
+    case FRAMER_HDLC:
+        hdlcFeedByte(f, b);
+        break;
+    case FRAMER_LENGTH:
+        lengthFeedByte(f, b);
+        break;
+    case FRAMER_LINE:
+        lineFeedByte(f, b);
+        break;
+    }
+}
+
+// find the first byte in data that is either 'c1' or 'c2'
+static uint16_t findEither(const uint8_t *data, uint16_t length,
+                           uint8_t c1, uint8_t c2)
+{
+#if PLATFORM_PC
+    const uint8_t *p;
+    p = memchr(data, c1, length);
+    if (p) length = p - data;
+    p = memchr(data, c2, length);
+    return p ? p - data : length;
+#else
+    uint16_t i;
+    for (i = 0; i < length; i++) {
+        if (data[i] == c1 || data[i] == c2) break;
+    }
+    return i;
+#endif
+}
+
+//
+// Copy as many bytes as possible directly to the frame buffer,
+// without looking at them one by one. Returns the number of bytes consumed.
+//
+static uint16_t framerCopyRun(Framer_t *f, const uint8_t *data, uint16_t length)
+{
+    uint16_t run;
+
+    switch (f->type) {
+    case FRAMER_HDLC:
+        if (f->state != FRAMER_DATA) return 0;
+        run = findEither(data, length, FRAME_FLAG_BYTE, FRAME_ESCAPE_BYTE);
+#ifdef FRAME_ENABLE_ABORT
+        {
+            const uint8_t *abort = memchr(data, FRAME_ABORT_BYTE, run);
+            if (abort) run = abort - data;
+        }
+#endif
+        run = MIN(run, f->bufferSize - f->length);
+        break;
+    case FRAMER_LENGTH:
+        if (f->state != FRAMER_DATA) return 0;
+        // leave the last byte for framerFeedByte() to complete the frame
+        run = MIN(length, f->expected - f->length - 1);
+        break;
+    case FRAMER_LINE:
+        if (f->state != FRAMER_DATA) return 0;
+        run = findEither(data, length, f->delimiter, f->delimiter);
+        if (run > f->bufferSize - 1 - f->length) {
+            // the rest does not fit; drop it, as framerFeedByte() would
+            memcpy(f->buffer + f->length, data, f->bufferSize - 1 - f->length);
+            f->length = f->bufferSize - 1;
+            return run;
+        }
+        break;
+    default:
+        return 0;
+    }
+
+    memcpy(f->buffer + f->length, data, run);
+    f->length += run;
+    return run;
+}
+
+void framerFeed(Framer_t *f, const uint8_t *data, uint16_t length)
+{
+    while (length) {
+        uint16_t run = framerCopyRun(f, data, length);
+        if (run == 0) {
+            framerFeedByte(f, *data);
+            run = 1;
+        }
+        data += run;
+        length -= run;
     }
-  } 
-  return (bufOut);
 }
@@ -26,11 +26,20 @@
 // Used to frame packets, e.g for transmission over a serial port
 // Based on HDLC protocol (High-level Data Link Control)
 //      The ABORT flag is optional due to faster and smaller code. 
+//
+// Also contains a streaming frame receiver (Framer_t): bytes are fed
+// one at a time (e.g. from the UART RX interrupt) or in blocks, and a
+// callback is called for each complete frame. The frame is assembled
+// directly in the buffer given by the user, no intermediate copies
+// are made. Besides HDLC, the receiver supports the framing formats
+// of the existing serial protocols (WMP, SMP, NMEA).
 //-------------------------------------------------------------------
 
 #ifndef MANSOS_FRAMER_H
 #define MANSOS_FRAMER_H
 
+#include <stdtypes.h>
+
 //#define FRAME_ENABLE_ABORT    // Uncomment or define this to enable the abort 
 
 #define FRAME_FLAG_BYTE  0x7e   // Frame start and stop
@@ -45,6 +54,13 @@
 //-------------------------------------------------------------------
 uint8_t *frameEncode(int length, uint8_t* bufIn, uint8_t* bufOut);
 
+//-------------------------------------------------------------------
+// Same as frameEncode(), but also appends CRC16 of the data
+// (little-endian) before the end flag, as expected by the HDLC
+// frame receiver. bufOut must have space for 2 * (length + 2) + 2 bytes.
+//-------------------------------------------------------------------
+uint8_t *frameEncodeCrc(int length, uint8_t* bufIn, uint8_t* bufOut);
+
 //-------------------------------------------------------------------
 // Decode a HDLC frame bufIn to a stream of bytes bufOut.
 //      At most 'length' bytes are decoded.
@@ -55,4 +71,73 @@ uint8_t *frameEncode(int length, uint8_t* bufIn, uint8_t* bufOut);
 //-------------------------------------------------------------------
 uint8_t *frameDecode(int length, uint8_t* bufIn, uint8_t* bufOut);
 
+//-------------------------------------------------------------------
+// Streaming frame receiver
+//-------------------------------------------------------------------
+
+//! Called for each complete frame (from the context the bytes are fed in)
+typedef void (*FramerCallback_t)(uint8_t *frame, uint16_t length);
+
+enum FramerType_e {
+    //! Flag-delimited, byte-stuffed frames with CRC16 at the end
+    FRAMER_HDLC,
+    //! A start byte, then a header with a 1 or 2 byte (big-endian) length field
+    FRAMER_LENGTH,
+    //! A start string, then text up to an end character
+    FRAMER_LINE,
+};
+
+typedef struct Framer_s {
+    uint8_t type;           // FRAMER_HDLC, FRAMER_LENGTH or FRAMER_LINE
+    uint8_t state;
+    uint8_t delimiter;      // start byte (FRAMER_LENGTH) or end byte (FRAMER_LINE)
+    uint8_t lengthOffset;   // position of the length field in the frame
+    uint8_t lengthBytes;    // size of the length field
+    uint8_t trailerLength;  // bytes after the data, not counted in the length field
+    uint16_t length;        // bytes in the buffer
+    uint16_t expected;      // frame length, once known
+    uint16_t bufferSize;
+    uint8_t *buffer;
+    const char *prefix;     // start string (FRAMER_LINE)
+    FramerCallback_t callback;
+} Framer_t;
+
+///
+/// Initialize a HDLC frame receiver.
+/// The callback gets the unescaped frame without the CRC;
+/// frames with wrong CRC are silently dropped.
+///
+void framerInitHdlc(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                    FramerCallback_t callback);
+
+///
+/// Initialize a receiver for frames that start with 'startByte', followed
+/// by a header that contains the length of the data at 'lengthOffset'.
+/// The callback gets the frame without the start byte:
+/// header (lengthOffset + lengthBytes bytes), data, trailer.
+/// Frames that do not fit in the buffer are dropped.
+///
+void framerInitLength(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                      uint8_t startByte, uint8_t lengthOffset,
+                      uint8_t lengthBytes, uint8_t trailerLength,
+                      FramerCallback_t callback);
+
+///
+/// Initialize a receiver for text lines that start with 'prefix' and end
+/// with 'endByte'. The callback gets the zero-terminated text between them,
+/// truncated to fit in the buffer.
+///
+void framerInitLine(Framer_t *f, uint8_t *buffer, uint16_t bufferSize,
+                    const char *prefix, uint8_t endByte,
+                    FramerCallback_t callback);
+
+//! Drop the frame that is being received and wait for the next one
+void framerReset(Framer_t *f);
+
+//! Process a received byte (can be used as the UART RX handler body)
+void framerFeedByte(Framer_t *f, uint8_t b);
+
+//! Process a block of received bytes
+void framerFeed(Framer_t *f, const uint8_t *data, uint16_t length);
+
 #endif
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_VARINT_H
+#define MANSOS_VARINT_H
+
+//
+// Variable-length integer encoding (LEB128): 7 bits per byte,
+// least significant group first, high bit set on all but the last byte.
+// Signed values are zigzag-mapped first, so small negative numbers stay short.
+//
+
+#include <stdtypes.h>
+
+//! The max length of an encoded 32-bit value
+#define VARINT_MAX_SIZE 5
+
+//! Map a signed value to unsigned: 0, -1, 1, -2, ... -> 0, 1, 2, 3, ...
+static inline uint32_t zigzagEncode(int32_t value)
+{
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t value)
+{
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+//! The number of bytes needed to encode 'value'
+static inline uint8_t varintSize(uint32_t value)
+{
+    uint8_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+///
+/// Encode 'value' to 'out'
+///   @return a pointer to the next byte after the encoded value
+///
+static inline uint8_t *varintEncode(uint8_t *out, uint32_t value)
+{
+    while (value >= 0x80) {
+        *out++ = (uint8_t) value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (uint8_t) value;
+    return out;
+}
+
+///
+/// Decode a value from 'in', reading no further than 'end'
+///   @return a pointer to the next byte after the decoded value,
+///           or NULL if the input is truncated or malformed
+///
+static inline const uint8_t *varintDecode(const uint8_t *in, const uint8_t *end,
+                                          uint32_t *value /* out */)
+{
+    uint32_t result = 0;
+    uint8_t shift = 0;
+    while (in < end && shift < 7 * VARINT_MAX_SIZE) {
+        uint8_t b = *in++;
+        result |= (uint32_t) (b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *value = result;
+            return in;
+        }
+        shift += 7;
+    }
+    return NULL;
+}
+
+#endif
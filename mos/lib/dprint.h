@@ -73,12 +73,20 @@
      serialEnableTX(PRINTF_SERIAL_ID);                          \
      serial[PRINTF_SERIAL_ID].function = SERIAL_FUNCTION_PRINT
 #  define PRINT_FUNCTION serialPrint
+#  if USE_BINARY_LOG
+//
+// Send binary records, format on host (see lib/binlog.h)
+//
+#  include <lib/binlog.h>
+#  define PRINTF(...) BINLOG(false, __VA_ARGS__)
+#  else
 #  define PRINTF(...)  {                          \
     if (COUNT_PARMS(__VA_ARGS__) == 1) {          \
         serialPrintV(__VA_ARGS__);                \
     } else {                                      \
         debugPrintf(serialPrint, __VA_ARGS__);    \
     } }
+#  endif // USE_BINARY_LOG
 
 # endif // DPRINT_TO_RADIO
 
@@ -104,7 +112,11 @@ extern char *_print_buf;
 //
 // TPRINTF: print text with timestamp
 //
+#if USE_PRINT && USE_BINARY_LOG && !DPRINT_TO_RADIO
+#define TPRINTF(...) BINLOG(true, __VA_ARGS__)
+#else
 #define TPRINTF(...) do { PRINTF("[%lu] ", getTimeMs()); PRINTF(__VA_ARGS__); } while (0)
+#endif
 
 //
 // DEBUG_PRINTF: print only when DEBUG=y
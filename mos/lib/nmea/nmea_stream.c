@@ -26,21 +26,9 @@
 // callback for UART RX
 //-----------------------------------------------------------------------------
 
-//#include "mansos.h"
-//#include "dprint.h"
-//#include "usart.h"
-//#include "udelay.h"
-//#include "leds.h"
 #include "nmea_stream.h"
-#include <stdint.h>
-
-
-enum ParseState {
-    RS_WAIT_HEADER = 1,
-    RS_PARSE_CMD,
-    RS_READ_CMD,
-    RS_DONE
-};
+#include <lib/codec/framer.h>
+#include <string.h>
 
 enum {
     CMD_LEN = 3,
@@ -54,17 +42,38 @@ uint_t nmeaBufState[NMEA_CMD_COUNT] = { BS_EMPTY, BS_EMPTY };
 const char NMEAHEAD[] = "$GP";
 const char NMEACMD[NMEA_CMD_COUNT][CMD_LEN] = { "GGA", "GSA" };
 
+static void nmeaLineReceived(uint8_t *line, uint16_t length);
 
-static uint_t seemsValid[NMEA_CMD_COUNT];
+// the text between the header and the end character, starting with the cmd
+static uint8_t lineBuf[CMD_LEN + MAX_NMEA_CMD_SIZE];
 
-static uint8_t bufPos = 0;
-
-static uint_t readState = RS_WAIT_HEADER;
-static uint_t i;
+static Framer_t nmeaFramer = {
+    .type = FRAMER_LINE,
+    .delimiter = NMEAEND,
+    .bufferSize = sizeof(lineBuf),
+    .buffer = lineBuf,
+    .prefix = NMEAHEAD,
+    .callback = nmeaLineReceived,
+};
 
-//void printBuf(void *userData);
-void nmeaCharRecv(uint8_t b);
+// copy a received command in its buffer, unless the buffer still
+// has data which is not yet processed
+static void nmeaLineReceived(uint8_t *line, uint16_t length)
+{
+    uint_t i;
 
+    if (length < CMD_LEN) return;
+    for (i = 0; i < NMEA_CMD_COUNT; ++i) {
+        if (memcmp(line, NMEACMD[i], CMD_LEN) == 0) {
+            if (nmeaBufState[i] == BS_EMPTY) {
+                // copy the zero-terminated rest of the line
+                memcpy(nmeaBuf[i], line + CMD_LEN, length - CMD_LEN + 1);
+                nmeaBufState[i] = BS_READY;
+            }
+            break;
+        }
+    }
+}
 
 // store bytes received from UART in a buffer
 // each command type has its own buffer
@@ -72,89 +81,5 @@ void nmeaCharRecv(uint8_t b);
 // do not use buffers which have already data, which is not yet processed
 void nmeaCharRecv(uint8_t b)
 {
-    static uint_t goodChars = 0;
-    static uint_t atLeastOneValid = 0;
-    static uint_t actualCmd = -1u;
-    switch (readState) {
-    case RS_WAIT_HEADER:
-        // waiting for header of NMEA cmd
-        if (b == NMEAHEAD[goodChars]) {
-            // good char received
-            if (++goodChars == sizeof(NMEAHEAD) - 1) {
-                // whole header ok
-                readState = RS_PARSE_CMD;
-                goodChars = 0;
-                for (i = 0; i < NMEA_CMD_COUNT; ++i) {
-                    seemsValid[i] = 1;
-                }
-            } else {
-                // still waiting for some header chars
-            }
-        } else {
-            // bad char received, reset parsing
-            goodChars = 0;
-        }
-        break;
-    case RS_PARSE_CMD:
-        // look, which commands seem to be valid, scan the remaining chars
-        atLeastOneValid = 0;
-        for (i = 0; i < NMEA_CMD_COUNT; ++i) {
-            if (seemsValid[i]) {
-                if (b == NMEACMD[i][goodChars]) {
-                    atLeastOneValid = 1;
-                } else {
-                    // first invalid char for this cmd
-                    seemsValid[i] = 0;
-                }
-            }
-        }
-
-        if (atLeastOneValid) {
-            ++goodChars;
-            if (goodChars == 3) {
-                // cmd found, check if buffer is ready (could be, that old
-                // cmd is still in it waiting for parsing)
-                goodChars = 0;
-                for (i = 0; i < NMEA_CMD_COUNT; ++i) {
-                    if (seemsValid[i]) {
-                        if (nmeaBufState[i] == BS_EMPTY) {
-                            // buffer for this cmd ready
-                            readState = RS_READ_CMD;
-                            actualCmd = i;
-                            bufPos = 0;
-                        } else {
-                            // this cmd is already in the buffer, skip it
-                            readState = RS_WAIT_HEADER;
-                        }
-                        break;
-                    }
-                }
-            }
-        } else {
-            // another cmd, skip it
-            readState = RS_WAIT_HEADER;
-            goodChars = 0;
-        }
-        break;
-    case RS_READ_CMD:
-        // already got good header, parsing remaining data until the end of cmd
-        if (b == NMEAEND) {
-            // end of command
-            readState = RS_DONE;
-            nmeaBufState[actualCmd] = BS_READY;
-            readState = RS_WAIT_HEADER;
-            goodChars = 0;
-        } else {
-            // store char in buffer
-            if (bufPos < MAX_NMEA_CMD_SIZE - 1) {
-                nmeaBuf[actualCmd][bufPos] = b;
-            } else if (bufPos < MAX_NMEA_CMD_SIZE) {
-                nmeaBuf[actualCmd][bufPos] = 0;
-            }
-            ++bufPos;
-        }
-        break;
-    default:
-        break; // parseState == PS_DONE - cmd received
-    }
+    framerFeedByte(&nmeaFramer, b);
 }
@@ -29,12 +29,14 @@
 // no "program memory" on the PC
 #define PROGMEM
 #define pgm_read_byte(b) (*(b))
+#define pgm_read_word(w) (*(w))
 
 #elif MCU_MSP430
 
 #define PROGMEM __attribute__ ((section (".text.constants")))
 // msp430 is Von-Neuman architecture, can simply read flash memory
 #define pgm_read_byte(b) (*(b))
+#define pgm_read_word(w) (*(w))
 
 #elif MCU_AVR
 
@@ -22,64 +22,55 @@
  */
 
 #include "average.h"
+#include <string.h>
 
 // Initialize Average_t
-Average_t avgInit(uint8_t window) {
-    Average_t result;
-    uint8_t temp;
-    result.sum = result.count = result.bufSum = result.bufCount = 0;
-    result.window = window;
-    result.haveCoefficients = false;
+void avgInit(Average_t *avg, uint16_t *history, uint8_t window) {
+    memset(avg, 0, sizeof(*avg));
+    avg->window = window;
+    avg->history = history;
     if (window) {
-        // FIXME: malloc!
-        result.history = malloc(sizeof(uint16_t) * window);
-        // Why implicit declaration?
-        //memset(result.history, 0, sizeof(uint16_t) * window);
-        for (temp = 0; temp < window; temp++) {
-            result.history[temp] = 0;
-        }
-        result.oldestValue = 0;
+        memset(history, 0, sizeof(uint16_t) * window);
     }
-    return (result);
 }
 
 // Initialize Average_t with coefficients, window = len(coefs)
-Average_t avgInitWithCoeffs(uint8_t window, uint8_t *coefs) {
-    Average_t result = avgInit(window);
+void avgInitWithCoeffs(Average_t *avg, uint16_t *history, uint8_t window,
+                       const uint8_t *coefs) {
     uint8_t temp;
+    avgInit(avg, history, window);
     if (window) {
-        // FIXME: malloc
-        result.coefficients = (uint8_t*)malloc(sizeof(uint8_t) * window);
-        // Why implicit declaration?
-        //memcpy(result.coefficients, coefs, sizeof(uint8_t) * window);
-        for (temp = 0; temp < window; temp++){
-               result.coefficients[temp] = coefs[temp];
-               result.count += coefs[temp];
-           }
-        result.haveCoefficients = true;
+        avg->coefficients = coefs;
+        for (temp = 0; temp < window; temp++) {
+            avg->count += coefs[temp];
+        }
+        avg->haveCoefficients = true;
     }
-    return (result);
 }
 
-void addAverage(Average_t *avg, uint16_t *val) {
-    // Continuous average
-    if (avg->window == 0) {
-        // Check for overflowing
-        if (avg->sum >= BUFFERING_START_TRESHOLD && avg->bufSum == 0) {
-            avg->bufSum = avg->sum;
-            avg->bufCount = avg->count;
+// Continuous average: check the sum for overflowing
+static inline void avgCheckOverflow(Average_t *avg) {
+    if (avg->sum >= BUFFERING_START_TRESHOLD && avg->bufSum == 0) {
+        avg->bufSum = avg->sum;
+        avg->bufCount = avg->count;
 #ifdef DEBUG
-            PRINTF("Starting average buffer\n");
+        PRINTF("Starting average buffer\n");
 #endif //DEBUG
-        }
-        else if (avg->sum >= BUFFERING_STOP_TRESHOLD) {
-            avg->sum -= avg->bufSum;
-            avg->count -= avg->bufCount;
-            avg->bufSum = avg->bufCount = 0;
+    }
+    else if (avg->sum >= BUFFERING_STOP_TRESHOLD) {
+        avg->sum -= avg->bufSum;
+        avg->count -= avg->bufCount;
+        avg->bufSum = avg->bufCount = 0;
 #ifdef DEBUG
-            PRINTF("Flushing from average buffer\n");
+        PRINTF("Flushing from average buffer\n");
 #endif //DEBUG
-        }
+    }
+}
+
+void addAverage(Average_t *avg, uint16_t *val) {
+    // Continuous average
+    if (avg->window == 0) {
+        avgCheckOverflow(avg);
         // Add next value
         avg->sum += *val;
         avg->count++;
@@ -90,16 +81,8 @@ void addAverage(Average_t *avg, uint16_t *val) {
         if (avg->oldestValue == avg->window) {
             avg->oldestValue = 0;
         }
-        // Moving average with coefficients
-        if (avg->haveCoefficients) {
-            avg->sum = 0;
-            // history[oldest]*coeff[0] + history[oldest + 1]*coeff[1] + ...
-            for (temp = 0; temp < avg->window; temp++) {
-                avg->sum += (uint32_t)avg->history[(avg->oldestValue + temp)
-                                 % avg->window] * avg->coefficients[temp];
-            }
-        // Moving average
-        } else {
+        // Moving average with coefficients: the sum is calculated on demand
+        if (!avg->haveCoefficients) {
             // Change sum, cant use *val - temp, because it yields incorrect
             // result if temp > *val
             avg->sum += *val;
@@ -110,7 +93,105 @@ void addAverage(Average_t *avg, uint16_t *val) {
     }
 }
 
+// Add values to the history, without wrapping around; update the sum
+static uint16_t avgAddSegment(Average_t *avg, const uint16_t *values,
+                              uint16_t count) {
+    uint16_t *history = avg->history + avg->oldestValue;
+    uint32_t added = 0, removed = 0;
+    uint16_t i;
+
+    if (count > avg->window - avg->oldestValue) {
+        count = avg->window - avg->oldestValue;
+    }
+    // separate loops without dependencies between iterations,
+    // so that the compiler can vectorize them
+    for (i = 0; i < count; i++) {
+        removed += history[i];
+    }
+    for (i = 0; i < count; i++) {
+        added += values[i];
+    }
+    memcpy(history, values, count * sizeof(uint16_t));
+
+    avg->sum += added;
+    avg->sum -= removed;
+    avg->oldestValue += count;
+    if (avg->oldestValue == avg->window) {
+        avg->oldestValue = 0;
+    }
+    return count;
+}
+
+void avgAddBatch(Average_t *avg, const uint16_t *values, uint16_t count) {
+    if (avg->window == 0) {
+        while (count) {
+            // add in chunks small enough for the sum not to cross
+            // BUFFERING_STOP_TRESHOLD between the overflow checks
+            uint32_t chunk;
+            uint32_t added = 0;
+            uint16_t i;
+            avgCheckOverflow(avg);
+            chunk = (BUFFERING_STOP_TRESHOLD - avg->sum) / 0xffff;
+            if (chunk == 0) chunk = 1;
+            if (chunk > count) chunk = count;
+            for (i = 0; i < chunk; i++) {
+                added += values[i];
+            }
+            avg->sum += added;
+            avg->count += chunk;
+            values += chunk;
+            count -= chunk;
+        }
+        return;
+    }
+
+    // only the last 'window' values matter
+    if (count > avg->window) {
+        uint16_t skip = count - avg->window;
+        values += skip;
+        count = avg->window;
+        // keep the position in history as if all values were added
+        avg->oldestValue += skip % avg->window;
+        if (avg->oldestValue >= avg->window) {
+            avg->oldestValue -= avg->window;
+        }
+    }
+
+    while (count) {
+        uint16_t added = avgAddSegment(avg, values, count);
+        if (!avg->haveCoefficients) {
+            avg->count += added;
+            if (avg->count > avg->window) avg->count = avg->window;
+        }
+        values += added;
+        count -= added;
+    }
+}
+
+// Weighted sum of the history: two contiguous segments, no modulo
+static uint32_t avgWeightedSum(const Average_t *avg) {
+    // history[oldest]*coeff[0] + history[oldest + 1]*coeff[1] + ...
+    const uint16_t *history = avg->history + avg->oldestValue;
+    const uint8_t *coeffs = avg->coefficients;
+    uint8_t first = avg->window - avg->oldestValue;
+    uint32_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < first; i++) {
+        sum += (uint32_t) history[i] * coeffs[i];
+    }
+    coeffs += first;
+    for (i = 0; i < avg->oldestValue; i++) {
+        sum += (uint32_t) avg->history[i] * coeffs[i];
+    }
+    return sum;
+}
+
 uint16_t getAverageValue(Average_t *avg) {
     // If getter() is used we can calculate this only on demand
+    if (avg->haveCoefficients) {
+        avg->sum = avgWeightedSum(avg);
+    }
+    if (avg->count == 0) return (avg->value = 0);
     return (avg->value = avg->sum / avg->count);
 }
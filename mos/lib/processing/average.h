@@ -26,6 +26,15 @@
 
 #include <defines.h>
 
+//
+// Average of the last 'window' values, or of all values if window is 0.
+// The history of the last values is kept in a caller-provided array
+// of 'window' elements (e.g. a static one), nothing is allocated.
+//
+// Adding a value takes constant time. For weighted average,
+// the weighted sum is calculated only when the value is requested.
+//
+
 // For 2^32
 #define BUFFERING_START_TRESHOLD 2147483648U // 2^31
 #define BUFFERING_STOP_TRESHOLD 4294901760U // 2^32 - 2^16
@@ -38,19 +47,29 @@ struct Average_s {
     uint32_t bufCount;
     uint8_t window;
     uint16_t *history;
-    uint8_t *coefficients;
+    const uint8_t *coefficients;
     uint8_t oldestValue;
     bool haveCoefficients;
 };
 
 typedef struct Average_s Average_t;
 
-Average_t avgInit(uint8_t);
+//! Initialize average calculation over 'window' values stored in 'history'
+void avgInit(Average_t *avg, uint16_t *history, uint8_t window);
 
-Average_t avgInitWithCoeffs(uint8_t, uint8_t *);
+///
+/// Initialize weighted average calculation, window = len(coeffs).
+/// coeffs[0] is the weight of the oldest value. The coefficients
+/// are not copied, they must remain valid while the average is used.
+///
+void avgInitWithCoeffs(Average_t *avg, uint16_t *history, uint8_t window,
+                       const uint8_t *coeffs);
 
 void addAverage(Average_t*, uint16_t*);
 
+//! Add 'count' values at once
+void avgAddBatch(Average_t *avg, const uint16_t *values, uint16_t count);
+
 uint16_t getAverageValue(Average_t *avg);
 
 #endif
@@ -23,6 +23,18 @@
 
 #include "cache.h"
 #include <timing.h>
+#include <alarms.h>
+#include <sleep.h>
+#include <string.h>
+
+enum {
+    CACHE_VALID   = 0x1, // the value has been read at least once
+    CACHE_READING = 0x2, // a conversion is in progress
+    CACHE_USED    = 0x4, // the value has been read from the cache since the last conversion
+    CACHE_FILTERED_OUT = 0x8,
+    CACHE_ACTIVE  = 0x10, // refreshed ahead of expiry
+    CACHE_REFRESH_DUE = 0x20, // waiting for cacheRefreshPoll()
+};
 
 typedef struct SensorCache_s {
     union {
@@ -34,7 +46,14 @@ typedef struct SensorCache_s {
         uint32_t u32;
     } value;
     ticks_t expireTime; // in jiffies
-//    uint16_t code;
+    void *func;         // the last used read function
+    uint16_t lifetime;  // ms
+    uint8_t width;      // value size in bits
+    uint8_t flags;
+#ifdef USE_THREADS
+    Thread_t *reader;
+#endif
+    CacheStats_t stats;
 } SensorCache_t;
 
 #ifndef TOTAL_CACHEABLE_SENSORS
@@ -42,56 +61,281 @@ typedef struct SensorCache_s {
 #endif
 static SensorCache_t sensorCache[TOTAL_CACHEABLE_SENSORS];
 
-int8_t cacheReadSensor8(uint16_t code, ReadFunction8 func,
-                        uint16_t expireTime, bool *isFilteredOut)
+#if CACHE_REFRESH_AHEAD
+static void refreshAlarmCallback(void *);
+static void scheduleRefresh(void);
+static Alarm_t refreshAlarm = { .callback = refreshAlarmCallback };
+#endif
+
+static int32_t callReadFunction(void *func, uint8_t width, bool *isFilteredOut)
 {
+    switch (width) {
+    case 8:
+        return ((ReadFunction8) func)(isFilteredOut);
+    case 16:
+        return ((ReadFunction16) func)(isFilteredOut);
+    default:
+        return ((ReadFunction32) func)(isFilteredOut);
+    }
+}
+
+static int32_t cachedValue(SensorCache_t *c)
+{
+    switch (c->width) {
+    case 8:
+        return c->value.i8;
+    case 16:
+        return c->value.i16;
+    default:
+        return c->value.i32;
+    }
+}
+
+static inline void reportFilteredOut(SensorCache_t *c, bool *isFilteredOut)
+{
+    if (isFilteredOut && (c->flags & CACHE_FILTERED_OUT)) *isFilteredOut = true;
+}
+
+// do the conversion and store the result; CACHE_READING must be already set
+static int32_t convert(SensorCache_t *c, bool *isFilteredOut)
+{
+    bool filteredOut = false;
+    ticks_t start = getJiffies();
+    int32_t result = callReadFunction(c->func, c->width, &filteredOut);
     ticks_t now = getJiffies();
-    SensorCache_t *cacheValue = &sensorCache[code];
-    if (cacheValue->expireTime && !timeAfter(now, cacheValue->expireTime)) {
-        // take from cache
-        return cacheValue->value.i8;
+    uint16_t duration = now - start;
+
+    // exponential moving average with weight 1/4 for the new sample
+    if (c->stats.conversionTime) {
+        c->stats.conversionTime = (3u * c->stats.conversionTime + duration + 2) / 4;
+    } else {
+        c->stats.conversionTime = duration ? duration : 1;
+    }
+
+    switch (c->width) {
+    case 8:
+        c->value.i8 = result;
+        break;
+    case 16:
+        c->value.i16 = result;
+        break;
+    default:
+        c->value.i32 = result;
+        break;
     }
-    int8_t result = func(isFilteredOut);
-    if (expireTime) {
-        // add to cache
-        cacheValue->value.i8 = result;
-        cacheValue->expireTime = now + expireTime;
+    c->flags |= CACHE_VALID;
+    c->flags &= ~(CACHE_USED | CACHE_FILTERED_OUT | CACHE_REFRESH_DUE);
+    if (filteredOut) {
+        c->flags |= CACHE_FILTERED_OUT;
+        if (isFilteredOut) *isFilteredOut = true;
     }
+    c->expireTime = now + c->lifetime;
     return result;
 }
 
-int16_t cacheReadSensor16(uint16_t code, ReadFunction16 func,
-                          uint16_t expireTime, bool *isFilteredOut)
+static int32_t cacheRead(uint16_t code, void *func, uint8_t width,
+                         uint16_t expireTime, bool *isFilteredOut)
 {
-    ticks_t now = getJiffies();
-    SensorCache_t *cacheValue = &sensorCache[code];
-    if (cacheValue->expireTime && !timeAfter(now, cacheValue->expireTime)) {
+    SensorCache_t *c = &sensorCache[code];
+    Handle_t h;
+    int32_t result;
+
+    ATOMIC_START(h);
+    if (c->flags & CACHE_READING) {
+#ifdef USE_THREADS
+        if (c->reader != currentThread) {
+            // someone else is converting: wait for their result
+            ATOMIC_END(h);
+            while (c->flags & CACHE_READING) yield();
+            c->stats.coalesced++;
+            reportFilteredOut(c, isFilteredOut);
+            return cachedValue(c);
+        }
+#endif
+        if (c->flags & CACHE_VALID) {
+            // nested in an ongoing conversion: the last value is the best we can do
+            ATOMIC_END(h);
+            c->stats.coalesced++;
+            reportFilteredOut(c, isFilteredOut);
+            return cachedValue(c);
+        }
+        ATOMIC_END(h);
+        // no value at all yet; read without touching the cache
+        return callReadFunction(func, width, isFilteredOut);
+    }
+
+    if ((c->flags & CACHE_VALID) && c->width == width
+            && !timeAfter(getJiffies(), c->expireTime)) {
         // take from cache
-        return cacheValue->value.i16;
+        c->flags |= CACHE_USED;
+        ATOMIC_END(h);
+        c->stats.hits++;
+        reportFilteredOut(c, isFilteredOut);
+        return cachedValue(c);
     }
-    int16_t result = func(isFilteredOut);
-    if (expireTime) {
-        // add to cache
-        cacheValue->value.i16 = result;
-        cacheValue->expireTime = now + expireTime;
+
+    if (!expireTime) {
+        ATOMIC_END(h);
+        return callReadFunction(func, width, isFilteredOut);
     }
+
+    c->flags |= CACHE_READING | CACHE_ACTIVE;
+#ifdef USE_THREADS
+    c->reader = currentThread;
+#endif
+    ATOMIC_END(h);
+
+    c->stats.misses++;
+    if (c->width != width) c->flags &= ~CACHE_VALID;
+    c->func = func;
+    c->width = width;
+    c->lifetime = expireTime;
+    result = convert(c, isFilteredOut);
+    c->flags &= ~CACHE_READING;
+
+#if CACHE_REFRESH_AHEAD
+    scheduleRefresh();
+#endif
     return result;
 }
 
+int8_t cacheReadSensor8(uint16_t code, ReadFunction8 func,
+                        uint16_t expireTime, bool *isFilteredOut)
+{
+    return cacheRead(code, func, 8, expireTime, isFilteredOut);
+}
+
+int16_t cacheReadSensor16(uint16_t code, ReadFunction16 func,
+                          uint16_t expireTime, bool *isFilteredOut)
+{
+    return cacheRead(code, func, 16, expireTime, isFilteredOut);
+}
+
 int32_t cacheReadSensor32(uint16_t code, ReadFunction32 func,
                           uint16_t expireTime, bool *isFilteredOut)
+{
+    return cacheRead(code, func, 32, expireTime, isFilteredOut);
+}
+
+#if CACHE_REFRESH_AHEAD
+
+// the time when the value should be refreshed, so that it is ready before expiry
+static inline ticks_t refreshTime(SensorCache_t *c)
+{
+    uint16_t lead = c->stats.conversionTime + c->stats.conversionTime / 4 + 1;
+    if (lead >= c->lifetime) lead = c->lifetime / 2;
+    return c->expireTime - lead;
+}
+
+static inline bool needsRefresh(SensorCache_t *c)
+{
+    // only values that are actually used are kept fresh
+    return (c->flags & (CACHE_VALID | CACHE_USED | CACHE_READING))
+            == (CACHE_VALID | CACHE_USED);
+}
+
+static void scheduleRefresh(void)
 {
     ticks_t now = getJiffies();
-    SensorCache_t *cacheValue = &sensorCache[code];
-    if (cacheValue->expireTime && !timeAfter(now, cacheValue->expireTime)) {
-        // take from cache
-        return cacheValue->value.i32;
+    ticks_t first = 0;
+    bool found = false;
+    uint16_t i;
+
+    for (i = 0; i < TOTAL_CACHEABLE_SENSORS; i++) {
+        SensorCache_t *c = &sensorCache[i];
+        ticks_t t;
+        // (entries being read or waiting for the poll are rescheduled
+        // when their conversion completes)
+        if ((c->flags & (CACHE_ACTIVE | CACHE_READING | CACHE_REFRESH_DUE))
+                != CACHE_ACTIVE) continue;
+        t = refreshTime(c);
+        if (!found || timeAfter(first, t)) {
+            first = t;
+            found = true;
+        }
+    }
+    if (!found) return;
+    alarmSchedule(&refreshAlarm, timeAfter(first, now) ? first - now : 0);
+}
+
+// runs in interrupt context (or in the kernel thread): only marks the entries,
+// the sensors are read by cacheRefreshPoll()
+static void refreshAlarmCallback(void *param)
+{
+    ticks_t now = getJiffies();
+    uint16_t i;
+
+    for (i = 0; i < TOTAL_CACHEABLE_SENSORS; i++) {
+        SensorCache_t *c = &sensorCache[i];
+        Handle_t h;
+
+        if (!(c->flags & CACHE_ACTIVE)) continue;
+        if (timeAfter(refreshTime(c), now)) continue;
+
+        ATOMIC_START(h);
+        if (needsRefresh(c)) {
+            c->flags |= CACHE_REFRESH_DUE;
+        } else if (!(c->flags & CACHE_READING)) {
+            // unused: let it expire, it will be read again on demand
+            c->flags &= ~CACHE_ACTIVE;
+        }
+        ATOMIC_END(h);
     }
-    int32_t result = func(isFilteredOut);
-    if (expireTime) {
-        // add to cache
-        cacheValue->value.i32 = result;
-        cacheValue->expireTime = now + expireTime;
+    scheduleRefresh();
+}
+
+void cacheRefreshPoll(void)
+{
+    bool marked = false;
+    uint16_t i;
+
+    for (i = 0; i < TOTAL_CACHEABLE_SENSORS; i++) {
+        SensorCache_t *c = &sensorCache[i];
+        Handle_t h;
+        bool refresh;
+
+        if (!(c->flags & CACHE_REFRESH_DUE)) continue;
+        marked = true;
+
+        ATOMIC_START(h);
+        refresh = needsRefresh(c);
+        if (refresh) {
+            c->flags |= CACHE_READING;
+#ifdef USE_THREADS
+            c->reader = currentThread;
+#endif
+        }
+        c->flags &= ~CACHE_REFRESH_DUE;
+        ATOMIC_END(h);
+
+        if (refresh) {
+            c->stats.refreshes++;
+            convert(c, NULL);
+            c->flags &= ~CACHE_READING;
+        }
     }
-    return result;
+    if (marked) scheduleRefresh();
+}
+
+#endif // CACHE_REFRESH_AHEAD
+
+void cacheGetStats(uint16_t code, CacheStats_t *result)
+{
+    *result = sensorCache[code].stats;
+}
+
+void cacheResetStats(void)
+{
+    uint16_t i;
+    for (i = 0; i < TOTAL_CACHEABLE_SENSORS; i++) {
+        uint16_t conversionTime = sensorCache[i].stats.conversionTime;
+        memset(&sensorCache[i].stats, 0, sizeof(CacheStats_t));
+        sensorCache[i].stats.conversionTime = conversionTime;
+    }
+}
+
+void cacheInvalidate(uint16_t code)
+{
+    sensorCache[code].flags &= ~(CACHE_VALID | CACHE_USED | CACHE_ACTIVE
+            | CACHE_REFRESH_DUE);
 }
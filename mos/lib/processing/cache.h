@@ -30,6 +30,25 @@
 // Sensor cache module.
 // Config file should define CONST_TOTAL_CACHEABLE_SENSORS before useing this.
 //
+// A value read from a sensor is reused until 'expireTime' milliseconds pass.
+// Concurrent reads of the same sensor are coalesced: a reader that finds
+// a conversion already in progress waits for its result when it runs
+// in another thread, and otherwise (a read nested in the first one, e.g.
+// from an alarm processed while the sensor driver sleeps) takes the last
+// known value, however old, instead of starting a second conversion.
+//
+// With CACHE_REFRESH_AHEAD (off by default; needs alarms), values that
+// have been used since the last conversion are marked for refresh by an
+// alarm shortly before they expire, taking into account how long the
+// conversion takes. The alarm never reads a sensor itself: the marked
+// values are converted when the application calls cacheRefreshPoll()
+// from its own context, so the other readers do not block on the sensor.
+// Values nobody reads are left to expire.
+//
+
+#ifndef CACHE_REFRESH_AHEAD
+#define CACHE_REFRESH_AHEAD 0
+#endif
 
 typedef int8_t (*ReadFunction8)(bool *isFilteredOut);
 typedef int16_t (*ReadFunction16)(bool *isFilteredOut);
@@ -44,4 +63,30 @@ int16_t cacheReadSensor16(uint16_t code, ReadFunction16 func,
 int32_t cacheReadSensor32(uint16_t code, ReadFunction32 func,
                           uint16_t expireTime, bool *isFilteredOut);
 
+struct CacheStats_s {
+    uint16_t hits;           // served from the cache
+    uint16_t misses;         // had to wait for a conversion
+    uint16_t coalesced;      // served by a conversion started by another reader
+    uint16_t refreshes;      // conversions done ahead of expiry
+    uint16_t conversionTime; // average duration of a conversion, ms
+};
+
+typedef struct CacheStats_s CacheStats_t;
+
+//! Get the statistics of a cached sensor
+void cacheGetStats(uint16_t code, CacheStats_t *result);
+
+//! Clear the statistics counters of all cached sensors
+void cacheResetStats(void);
+
+//! Forget the cached value of a sensor
+void cacheInvalidate(uint16_t code);
+
+#if CACHE_REFRESH_AHEAD
+//! Convert the values due for refresh. Call from user context, not from alarms
+void cacheRefreshPoll(void);
+#else
+static inline void cacheRefreshPoll(void) {}
+#endif
+
 #endif
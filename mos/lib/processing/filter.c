@@ -58,6 +58,44 @@ bool addFilter(Filter_t *filter, uint16_t *val) {
     return false;
 }
 
+// Store the values for which 'cond' is true; 'cond' is a constant,
+// so each loop in the switch below is compiled without branching on it
+#define FILTER_LOOP(cond)                       \
+    for (i = 0; i < count; i++) {               \
+        uint16_t v = values[i];                 \
+        out[passed] = v;                        \
+        passed += (cond);                       \
+    }
+
+uint16_t filterBatch(Filter_t *filter, const uint16_t *values, uint16_t count,
+                     uint16_t *out) {
+    const uint16_t treshold = filter->treshold;
+    uint16_t i, passed = 0;
+
+    switch (filter->comparator) {
+    case NOT_EQUAL:
+        FILTER_LOOP(v != treshold);
+        break;
+    case EQUAL:
+        FILTER_LOOP(v == treshold);
+        break;
+    case LESS:
+        FILTER_LOOP(v < treshold);
+        break;
+    case LESS_OR_EQUAL:
+        FILTER_LOOP(v <= treshold);
+        break;
+    case MORE:
+        FILTER_LOOP(v > treshold);
+        break;
+    case MORE_OR_EQUAL:
+        FILTER_LOOP(v >= treshold);
+        break;
+    }
+    if (passed) filter->value = out[passed - 1];
+    return passed;
+}
+
 uint16_t getFilterValue(Filter_t *filter) {
     return filter->value;
 }
@@ -47,6 +47,14 @@ Filter_t filterInit(enum Comparators, uint16_t);
 
 bool addFilter(Filter_t*, uint16_t*);
 
+///
+/// Filter 'count' values at once. The values that pass are stored in 'out'
+/// (which may be the same array as 'values').
+/// @return the number of values that passed
+///
+uint16_t filterBatch(Filter_t *filter, const uint16_t *values, uint16_t count,
+                     uint16_t *out);
+
 uint16_t getFilterValue(Filter_t*);
 
 #endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "minmax.h"
+
+void minMaxInit(MinMax_t *mm, MinMaxEntry_t *storage, uint8_t window) {
+    mm->min.entries = storage;
+    mm->min.head = mm->min.length = 0;
+    mm->max.entries = storage + window;
+    mm->max.head = mm->max.length = 0;
+    mm->index = 0;
+    mm->window = window;
+}
+
+// position of the i-th entry from the head, without modulo
+static inline uint8_t queuePos(const MinMaxQueue_t *q, uint8_t i, uint8_t window) {
+    uint16_t pos = q->head + i;
+    return pos >= window ? pos - window : pos;
+}
+
+static inline void queueAdd(MinMaxQueue_t *q, uint8_t window,
+                            uint16_t value, uint16_t index, bool isMin) {
+    // drop the values that cannot become the min / max anymore
+    while (q->length) {
+        uint16_t last = q->entries[queuePos(q, q->length - 1, window)].value;
+        if (isMin ? last < value : last > value) break;
+        q->length--;
+    }
+    // drop the value that left the window
+    if (q->length && (uint16_t) (index - q->entries[q->head].index) >= window) {
+        if (++q->head == window) q->head = 0;
+        q->length--;
+    }
+    q->entries[queuePos(q, q->length, window)].value = value;
+    q->entries[queuePos(q, q->length, window)].index = index;
+    q->length++;
+}
+
+void addMinMax(MinMax_t *mm, uint16_t value) {
+    queueAdd(&mm->min, mm->window, value, mm->index, true);
+    queueAdd(&mm->max, mm->window, value, mm->index, false);
+    mm->index++;
+}
+
+void minMaxAddBatch(MinMax_t *mm, const uint16_t *values, uint16_t count) {
+    uint16_t i;
+    // only the last 'window' values can be in the result
+    if (count > mm->window) {
+        // all the old values will be out of the window
+        mm->min.length = mm->max.length = 0;
+        mm->index += count - mm->window;
+        values += count - mm->window;
+        count = mm->window;
+    }
+    for (i = 0; i < count; i++) {
+        queueAdd(&mm->min, mm->window, values[i], mm->index, true);
+        queueAdd(&mm->max, mm->window, values[i], mm->index, false);
+        mm->index++;
+    }
+}
+
+uint16_t getMinValue(MinMax_t *mm) {
+    return mm->min.length ? mm->min.entries[mm->min.head].value : 0;
+}
+
+uint16_t getMaxValue(MinMax_t *mm) {
+    return mm->max.length ? mm->max.entries[mm->max.head].value : 0;
+}
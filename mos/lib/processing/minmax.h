@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_MINMAX_H
+#define MANSOS_MINMAX_H
+
+#include <defines.h>
+
+//
+// Minimum and maximum of the last 'window' values.
+//
+// Two monotonic queues are kept: candidates for the minimum (in increasing
+// order) and for the maximum (in decreasing order). A value that can no
+// longer become the minimum or maximum is dropped when it is added, so
+// adding a value takes constant amortized time and reading is O(1).
+// The queues are kept in caller-provided storage of 2 * window entries.
+//
+
+struct MinMaxEntry_s {
+    uint16_t value;
+    uint16_t index;     // sequence number of the value
+};
+
+typedef struct MinMaxEntry_s MinMaxEntry_t;
+
+// a double-ended queue in a ring buffer
+struct MinMaxQueue_s {
+    MinMaxEntry_t *entries;
+    uint8_t head;       // the oldest entry (the current min or max)
+    uint8_t length;
+};
+
+typedef struct MinMaxQueue_s MinMaxQueue_t;
+
+struct MinMax_s {
+    MinMaxQueue_t min;
+    MinMaxQueue_t max;
+    uint16_t index;     // sequence number of the next value
+    uint8_t window;
+};
+
+typedef struct MinMax_s MinMax_t;
+
+//! Initialize; 'storage' must have space for 2 * window entries
+void minMaxInit(MinMax_t *mm, MinMaxEntry_t *storage, uint8_t window);
+
+void addMinMax(MinMax_t *mm, uint16_t value);
+
+//! Add 'count' values at once
+void minMaxAddBatch(MinMax_t *mm, const uint16_t *values, uint16_t count);
+
+//! Get the minimum of the last values (0 if no values added)
+uint16_t getMinValue(MinMax_t *mm);
+
+//! Get the maximum of the last values (0 if no values added)
+uint16_t getMaxValue(MinMax_t *mm);
+
+#endif
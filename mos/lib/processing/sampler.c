@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sampler.h"
+#include <adc.h>
+
+static void samplerAlarmCallback(void *param)
+{
+    Sampler_t *s = (Sampler_t *) param;
+    // reschedule first, so that the period does not drift by the sampling time
+    alarmSchedule(&s->alarm, s->period);
+    samplerPoll(s);
+}
+
+void samplerInit(Sampler_t *s, const uint8_t *channels, uint8_t channelCount,
+                 uint16_t *buffer, uint16_t samplesPerBlock,
+                 SamplerCallback callback)
+{
+    s->channels = channels;
+    s->channelCount = channelCount;
+    s->buffer = buffer;
+    s->samplesPerBlock = samplesPerBlock;
+    s->callback = callback;
+    s->stages = NULL;
+    s->filled = 0;
+    s->period = 0;
+    s->burstLength = 1;
+    alarmInit(&s->alarm, samplerAlarmCallback, s);
+}
+
+void samplerStart(Sampler_t *s, uint32_t period, uint8_t burstLength)
+{
+    s->period = period;
+    s->burstLength = burstLength ? burstLength : 1;
+    s->filled = 0;
+    alarmSchedule(&s->alarm, period);
+}
+
+void samplerStop(Sampler_t *s)
+{
+    alarmRemove(&s->alarm);
+    s->filled = 0;
+}
+
+void samplerAddStage(Sampler_t *s, SamplerStage_t *stage, uint8_t channelIndex,
+                     SamplerProcessFn process, void *state)
+{
+    SamplerStage_t **p = &s->stages;
+
+    stage->next = NULL;
+    stage->process = process;
+    stage->state = state;
+    stage->channelIndex = channelIndex;
+    while (*p) p = &(*p)->next;
+    *p = stage;
+}
+
+static void samplerProcessBlock(Sampler_t *s)
+{
+    uint16_t counts[s->channelCount];
+    SamplerStage_t *stage;
+    uint8_t c;
+
+    if (s->callback) s->callback(s);
+
+    for (c = 0; c < s->channelCount; c++) {
+        counts[c] = s->samplesPerBlock;
+    }
+    for (stage = s->stages; stage; stage = stage->next) {
+        c = stage->channelIndex;
+        if (c >= s->channelCount || !counts[c]) continue;
+        counts[c] = stage->process(stage->state, samplerChannelData(s, c), counts[c]);
+    }
+}
+
+void samplerPoll(Sampler_t *s)
+{
+    uint8_t i;
+
+    adcOn();
+    for (i = 0; i < s->burstLength; i++) {
+        // one ADC sequence per sample, the results go to the channel rows
+        adcReadSequence(s->channels, s->channelCount,
+                        s->buffer + s->filled, s->samplesPerBlock);
+        if (++s->filled == s->samplesPerBlock) {
+            samplerProcessBlock(s);
+            s->filled = 0;
+        }
+    }
+    adcOff();
+}
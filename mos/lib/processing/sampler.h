@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_SAMPLER_H
+#define MANSOS_SAMPLER_H
+
+#include <alarms.h>
+#include "average.h"
+#include "stdev.h"
+#include "minmax.h"
+#include "filter.h"
+
+//
+// Batch sensor sampler.
+//
+// Every 'period' milliseconds a burst of 'burstLength' samples is read
+// from each of the channels (the channels of one sample are converted
+// as one ADC sequence). The samples are collected in a caller-provided
+// block buffer; when the block is full, the callback is called with the
+// raw block, then the whole block is passed through the processing stages
+// attached to the channels.
+//
+// The buffer is channel-major: samples of the channel with index 'c'
+// are at buffer[c * samplesPerBlock ... (c + 1) * samplesPerBlock - 1].
+//
+
+//! Processing function; may compact the values in place, returns the new count
+typedef uint16_t (*SamplerProcessFn)(void *state, uint16_t *values, uint16_t count);
+
+struct SamplerStage_s {
+    struct SamplerStage_s *next;
+    SamplerProcessFn process;
+    void *state;
+    uint8_t channelIndex;
+};
+
+typedef struct SamplerStage_s SamplerStage_t;
+
+struct Sampler_s;
+
+//! Called with the full block, before the processing stages are run
+typedef void (*SamplerCallback)(struct Sampler_s *sampler);
+
+struct Sampler_s {
+    Alarm_t alarm;
+    const uint8_t *channels;
+    uint16_t *buffer;
+    SamplerStage_t *stages;
+    SamplerCallback callback;
+    uint32_t period;
+    uint16_t samplesPerBlock;
+    uint16_t filled;
+    uint8_t channelCount;
+    uint8_t burstLength;
+};
+
+typedef struct Sampler_s Sampler_t;
+
+///
+/// Initialize the sampler.
+/// 'buffer' must have space for channelCount * samplesPerBlock values.
+///
+void samplerInit(Sampler_t *s, const uint8_t *channels, uint8_t channelCount,
+                 uint16_t *buffer, uint16_t samplesPerBlock,
+                 SamplerCallback callback);
+
+//! Start sampling: 'burstLength' samples every 'period' milliseconds
+void samplerStart(Sampler_t *s, uint32_t period, uint8_t burstLength);
+
+//! Stop sampling; the partially filled block is discarded
+void samplerStop(Sampler_t *s);
+
+//! Read one burst now (called by the sampler's alarm)
+void samplerPoll(Sampler_t *s);
+
+//! Attach a processing stage to a channel. Stages run in the order added.
+void samplerAddStage(Sampler_t *s, SamplerStage_t *stage, uint8_t channelIndex,
+                     SamplerProcessFn process, void *state);
+
+//! Get the samples of a channel in the current block
+static inline uint16_t *samplerChannelData(Sampler_t *s, uint8_t channelIndex)
+{
+    return s->buffer + (uint16_t) channelIndex * s->samplesPerBlock;
+}
+
+// -- adapters for the data processing library
+
+// (inline, so that only the modules actually used need to be linked in)
+
+static inline uint16_t samplerAverageStage(void *state, uint16_t *values, uint16_t count)
+{
+    avgAddBatch((Average_t *) state, values, count);
+    return count;
+}
+
+static inline uint16_t samplerStdevStage(void *state, uint16_t *values, uint16_t count)
+{
+    stdevAddBatch((Stdev_t *) state, values, count);
+    return count;
+}
+
+static inline uint16_t samplerMinMaxStage(void *state, uint16_t *values, uint16_t count)
+{
+    minMaxAddBatch((MinMax_t *) state, values, count);
+    return count;
+}
+
+static inline uint16_t samplerFilterStage(void *state, uint16_t *values, uint16_t count)
+{
+    return filterBatch((Filter_t *) state, values, count, values);
+}
+
+static inline void samplerAddAverage(Sampler_t *s, SamplerStage_t *stage,
+                                     uint8_t channelIndex, Average_t *avg)
+{
+    samplerAddStage(s, stage, channelIndex, samplerAverageStage, avg);
+}
+
+static inline void samplerAddStdev(Sampler_t *s, SamplerStage_t *stage,
+                                   uint8_t channelIndex, Stdev_t *stdev)
+{
+    samplerAddStage(s, stage, channelIndex, samplerStdevStage, stdev);
+}
+
+static inline void samplerAddMinMax(Sampler_t *s, SamplerStage_t *stage,
+                                    uint8_t channelIndex, MinMax_t *mm)
+{
+    samplerAddStage(s, stage, channelIndex, samplerMinMaxStage, mm);
+}
+
+//! Drop the values that do not pass the filter (the following stages see only those that do)
+static inline void samplerAddFilter(Sampler_t *s, SamplerStage_t *stage,
+                                    uint8_t channelIndex, Filter_t *filter)
+{
+    samplerAddStage(s, stage, channelIndex, samplerFilterStage, filter);
+}
+
+#endif
@@ -22,41 +22,59 @@
  */
 
 #include "stdev.h"
+#include <assert.h>
 
 // Initialize Stdev_t
-Stdev_t stdevInit(uint8_t window) {
-    Stdev_t result;
+void stdevInit(Stdev_t *stdev, uint16_t *history, uint8_t window) {
     // Disallowed, because can't hold all values in memory.
-    if (window == 0) {
-        result.average = avgInit(DEFAULT_SIZE);
-    } else {
-        result.average = avgInit(window);
-    }
-    return result;
+    ASSERT(window != 0);
+    avgInit(&stdev->average, history, window);
+    stdev->sumOfSquares = 0;
+    stdev->value = 0;
 }
 
 void addStdev(Stdev_t *stdev, uint16_t *val) {
+    uint16_t oldest = stdev->average.history[stdev->average.oldestValue];
+    stdev->sumOfSquares -= (uint32_t) oldest * oldest;
+    stdev->sumOfSquares += (uint32_t) *val * *val;
     addAverage(&stdev->average, val);
 }
 
+static uint64_t sumOfSquares(const uint16_t *values, uint16_t count) {
+    uint64_t sum = 0;
+    uint16_t i;
+    for (i = 0; i < count; i++) {
+        sum += (uint32_t) values[i] * values[i];
+    }
+    return sum;
+}
+
+void stdevAddBatch(Stdev_t *stdev, const uint16_t *values, uint16_t count) {
+    Average_t *avg = &stdev->average;
+
+    if (count >= avg->window) {
+        // the whole window is replaced
+        avgAddBatch(avg, values, count);
+        stdev->sumOfSquares = sumOfSquares(avg->history, avg->window);
+    } else {
+        // remove the values that are about to be replaced
+        uint16_t first = MIN(count, avg->window - avg->oldestValue);
+        stdev->sumOfSquares -= sumOfSquares(avg->history + avg->oldestValue, first);
+        stdev->sumOfSquares -= sumOfSquares(avg->history, count - first);
+        stdev->sumOfSquares += sumOfSquares(values, count);
+        avgAddBatch(avg, values, count);
+    }
+}
+
+uint32_t getVarianceValue(Stdev_t *stdev) {
+    uint32_t n = stdev->average.count;
+    uint64_t sum = stdev->average.sum;
+    if (n == 0) return 0;
+    // n^2 * variance = n * sum(x^2) - sum(x)^2
+    return (uint32_t) ((n * stdev->sumOfSquares - sum * sum) / (n * n));
+}
+
 uint16_t getStdevValue(Stdev_t *stdev) {
     // If getter() is used we can calculate this only on demand
-    uint16_t average = getAverageValue(&stdev->average);
-    uint8_t temp;
-    uint32_t sum = 0;
-    for (temp = 0; temp < stdev->average.count; temp++) {
-        int32_t dif;
-        if (stdev->average.history[temp] > average) {
-            dif = (int32_t)(stdev->average.history[temp] - average);
-        } else {
-            dif = (int32_t)(average - stdev->average.history[temp]);
-        }
-        // Dividing here helps against overflow if dif > 2^16, because
-        // 2^16^2 = 2^32 - too large
-        sum += (dif / stdev->average.count) * dif;
-#ifdef DEBUG
-        PRINTF("Adding %lu to stdev sum\n", dif * dif);
-#endif //DEBUG
-    }
-    return (stdev->value = intSqrt(sum));
+    return (stdev->value = intSqrt(getVarianceValue(stdev)));
 }
@@ -28,19 +28,32 @@
 #include "average.h"
 #include "algo.h"
 
-#define DEFAULT_SIZE 10
+//
+// Standard deviation of the last 'window' values (window must not be 0).
+// Running sums of the values and of their squares are updated
+// in constant time; with integer samples they are exact, so unlike
+// floating-point calculations, no numerical error accumulates.
+//
 
 struct Stdev_s {
     Average_t average;
+    uint64_t sumOfSquares;
     uint16_t value;
 };
 
 typedef struct Stdev_s Stdev_t;
 
-Stdev_t stdevInit(uint8_t);
+//! Initialize; 'history' must have space for 'window' values
+void stdevInit(Stdev_t *stdev, uint16_t *history, uint8_t window);
 
 void addStdev(Stdev_t*, uint16_t*);
 
+//! Add 'count' values at once
+void stdevAddBatch(Stdev_t *stdev, const uint16_t *values, uint16_t count);
+
+//! Get the variance (the square of the standard deviation)
+uint32_t getVarianceValue(Stdev_t*);
+
 uint16_t getStdevValue(Stdev_t*);
 
 #endif
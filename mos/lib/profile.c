@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "profile.h"
+#include <serial.h>
+#include <timing.h>
+#include <print.h>
+
+#if PLATFORM_PC
+#include <time.h>
+#include <pthread.h>
+#endif
+
+//
+// Everything here must be NO_INSTRUMENT, and must not call instrumented
+// functions while recording, or the hooks would be called recursively.
+//
+
+#if PLATFORM_PC
+
+#define PROFILE_CLOCK_SPEED 1000000000ul
+
+static pthread_t profileThread;
+
+static inline ProfileTime_t NO_INSTRUMENT profileTime(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ProfileTime_t) ts.tv_sec * PROFILE_CLOCK_SPEED + ts.tv_nsec;
+}
+
+#elif MCU_MSP430
+
+#if PLATFORM_HAS_TIMERB && !USE_SOFT_SERIAL
+
+#define PROFILE_CLOCK_SPEED CPU_HZ
+
+// high word of the time, counted by the timer overflow interrupt
+static volatile uint16_t profileTimeHigh;
+
+NO_INSTRUMENT ISR(TIMERB1, profileTimerInterrupt)
+{
+    if (TBIV == TBIV_TBIFG) profileTimeHigh++;
+}
+
+// called with interrupts disabled
+static inline ProfileTime_t NO_INSTRUMENT profileTime(void)
+{
+    // see TIMER_READ() in defines.h
+    uint16_t t1, t2, high;
+    do {
+        t1 = TBR;
+        t2 = TBR;
+    } while (t1 != t2);
+    high = profileTimeHigh;
+    // the overflow interrupt may be pending
+    if ((TBCTL & TBIFG) && t2 < 0x8000) high++;
+    return ((uint32_t) high << 16) | t2;
+}
+
+#else
+
+#define PROFILE_CLOCK_SPEED ACLK_SPEED
+
+// Timer A is shared with the alarms: extended to 32 bits in software
+static uint16_t profileTimeHigh;
+static uint16_t profileTimeLow;
+
+static inline ProfileTime_t NO_INSTRUMENT profileTime(void)
+{
+    // see TIMER_READ() in defines.h
+    uint16_t t1, t2;
+    do {
+        t1 = TAR;
+        t2 = TAR;
+    } while (t1 != t2);
+    if (t2 < profileTimeLow) profileTimeHigh++;
+    profileTimeLow = t2;
+    return ((uint32_t) profileTimeHigh << 16) | t2;
+}
+
+#endif
+
+#else
+
+#define PROFILE_CLOCK_SPEED (1000ul / JIFFY_TIMER_MS)
+
+static inline ProfileTime_t NO_INSTRUMENT profileTime(void)
+{
+    return (ProfileTime_t) jiffies;
+}
+
+#endif
+
+static ProfileRecord_t profileBuffer[PROFILE_BUFFER_SIZE];
+static uint16_t profileHead;  // where the next record goes
+static uint16_t profileCount;
+static uint16_t profileLost;
+static volatile bool profileOn;
+
+static inline void NO_INSTRUMENT profileRecord(void *function, ProfileTime_t flag)
+{
+    ProfileRecord_t *r;
+    Handle_t h;
+
+    if (!profileOn) return;
+#if PLATFORM_PC
+    if (!pthread_equal(pthread_self(), profileThread)) return;
+#endif
+
+    ATOMIC_START(h);
+    r = &profileBuffer[profileHead];
+    r->function = function;
+    r->time = (profileTime() & ~PROFILE_EXIT_FLAG) | flag;
+    if (++profileHead == PROFILE_BUFFER_SIZE) profileHead = 0;
+    if (profileCount < PROFILE_BUFFER_SIZE) {
+        profileCount++;
+    } else if (profileLost != 0xffff) {
+        profileLost++;
+    }
+    ATOMIC_END(h);
+}
+
+void NO_INSTRUMENT __cyg_profile_func_enter(void *function, void *callSite)
+{
+    profileRecord(function, 0);
+}
+
+void NO_INSTRUMENT __cyg_profile_func_exit(void *function, void *callSite)
+{
+    profileRecord(function, PROFILE_EXIT_FLAG);
+}
+
+void NO_INSTRUMENT profileInit(void)
+{
+#if PLATFORM_PC
+    profileThread = pthread_self();
+#elif MCU_MSP430 && PLATFORM_HAS_TIMERB && !USE_SOFT_SERIAL
+    // count SMCLK cycles, continuous mode, with the overflow interrupt
+    TBCTL = TBCLR;
+    TBCTL = TBSSEL_SMCLK | MC_CONT | TBIE;
+#endif
+    profileOn = true;
+}
+
+void NO_INSTRUMENT profileDump(void)
+{
+    ProfileDumpHeader_t header;
+    uint16_t frameLength;
+    uint16_t first;
+    bool wasOn;
+    Handle_t h;
+
+    // the serial functions are instrumented too: stop recording while sending
+    profileRecord(NULL, 0);
+    ATOMIC_START(h);
+    wasOn = profileOn;
+    profileOn = false;
+    ATOMIC_END(h);
+    if (!wasOn) return; // not started, or already dumping
+
+    header.pointerSize = sizeof(void *);
+    header.timeSize = sizeof(ProfileTime_t);
+    header.lost = profileLost;
+    header.clockSpeed = PROFILE_CLOCK_SPEED;
+    header.anchor = (void *) profileDump;
+    frameLength = sizeof(header) + profileCount * sizeof(ProfileRecord_t);
+    first = profileHead >= profileCount ? profileHead - profileCount
+            : profileHead + PROFILE_BUFFER_SIZE - profileCount;
+
+    serialSendByte(PRINTF_SERIAL_ID, '$');
+    serialSendByte(PRINTF_SERIAL_ID, PROFILE_SERIAL_PROTOCOL);
+    serialSendByte(PRINTF_SERIAL_ID, frameLength >> 8);
+    serialSendByte(PRINTF_SERIAL_ID, frameLength & 0xff);
+    serialSendData(PRINTF_SERIAL_ID, (const uint8_t *) &header, sizeof(header));
+    if (first + profileCount > PROFILE_BUFFER_SIZE) {
+        serialSendData(PRINTF_SERIAL_ID, (const uint8_t *) &profileBuffer[first],
+                (PROFILE_BUFFER_SIZE - first) * sizeof(ProfileRecord_t));
+        serialSendData(PRINTF_SERIAL_ID, (const uint8_t *) profileBuffer,
+                profileHead * sizeof(ProfileRecord_t));
+    } else {
+        serialSendData(PRINTF_SERIAL_ID, (const uint8_t *) &profileBuffer[first],
+                profileCount * sizeof(ProfileRecord_t));
+    }
+
+    ATOMIC_START(h);
+    profileCount = 0;
+    profileLost = 0;
+    profileOn = true;
+    ATOMIC_END(h);
+    profileRecord(NULL, PROFILE_EXIT_FLAG);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_PROFILE_H
+#define MANSOS_PROFILE_H
+
+/// \file
+/// Per-function timing for the profiling build ("make <platform> profile").
+///
+/// All code is compiled with -finstrument-functions. The entry and exit
+/// hooks store a record with the function address and a timestamp in
+/// a RAM ring buffer; when it is full, the oldest records are overwritten.
+/// profileDump() sends the buffer to the serial port, and
+/// tools/serial/profview.py turns the records in a flat profile
+/// and a call graph, using the ELF file of the application.
+///
+/// Timestamps:
+///   MSP430 - SMCLK cycles counted by Timer B, extended to 32 bits by
+///            its overflow interrupt. If Timer B is not available or is used
+///            by the soft serial port, ACLK ticks of Timer A, extended in
+///            software: then gaps longer than a timer period (2 s) between
+///            two records are not measured correctly
+///   PC     - nanoseconds (CLOCK_MONOTONIC); only the main thread is profiled
+///   others - milliseconds (jiffies)
+/// With USE_THREADS the records of the threads are mixed and the call
+/// graph is not reliable.
+///
+/// Dump format: '$' 'p' length (16 bit, big endian), followed by
+/// a ProfileDumpHeader_t and the records, oldest first (little endian).
+/// The time of the dump itself is recorded as a call of function NULL.
+///
+
+#include <defines.h>
+#include <stdtypes.h>
+
+#ifndef PROFILE_BUFFER_SIZE
+//! Number of records in the ring buffer (CONST_PROFILE_BUFFER_SIZE)
+#define PROFILE_BUFFER_SIZE 128
+#endif
+
+//! Protocol of the dump frames on the serial port
+#define PROFILE_SERIAL_PROTOCOL 'p'
+
+#if PLATFORM_PC
+typedef uint64_t ProfileTime_t;
+#else
+typedef uint32_t ProfileTime_t;
+#endif
+
+//! Set in the timestamp of the records made on function exit
+#define PROFILE_EXIT_FLAG ((ProfileTime_t) 1 << (sizeof(ProfileTime_t) * 8 - 1))
+
+typedef struct ProfileRecord_s {
+    void *function;
+    ProfileTime_t time;
+} PACKED ProfileRecord_t;
+
+typedef struct ProfileDumpHeader_s {
+    uint8_t pointerSize;   // sizeof(void *)
+    uint8_t timeSize;      // sizeof(ProfileTime_t)
+    uint16_t lost;         // records overwritten since the last dump
+    uint32_t clockSpeed;   // timestamp ticks per second
+    void *anchor;          // address of profileDump(), to relocate the symbols
+} PACKED ProfileDumpHeader_t;
+
+//! Start recording; called by the kernel after system initialization
+void profileInit(void);
+
+//! Send the recorded data to the serial port and empty the buffer
+void profileDump(void);
+
+#endif
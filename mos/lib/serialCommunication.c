@@ -7,9 +7,7 @@ void addCrc(SerialPacket *sp) {
 	sp->crc = crc8Add(sp->crc, sp->nr);
 	sp->crc = crc8Add(sp->crc, sp->cmd);
 
-	for (counter = 0; counter < sp->len; counter++) {
-		sp->crc = crc8Add(sp->crc, sp->data[counter]);
-	}
+	sp->crc = crc8Update(sp->crc, sp->data, sp->len);
 }
 
 void sendResponse(uint8_t cmd, uint8_t nr) {
@@ -22,7 +22,7 @@
 # OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
 # ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-import sys, subprocess, string, re
+import sys, os, subprocess, string, re
 
 if len(sys.argv) != 6:
     print('Usage: ' + sys.argv[0] + ' <arch> <target> <app_objects> <mos_objects> <flags>')
@@ -103,6 +103,33 @@ def get_symbols(file):
     return [exported, unresolved]
 
 
+# The symbols of system objects are saved next to them (in "<object>.sym"),
+# as the same objects are linked again and again (see OBJECT_CACHE)
+def get_system_symbols(file):
+    symfile = file + ".sym"
+    try:
+        if os.path.getmtime(symfile) >= os.path.getmtime(file):
+            with open(symfile) as f:
+                lines = f.read().split("\n")
+            return [lines[0].split(), lines[1].split()]
+    except (OSError, IOError, IndexError):
+        pass
+
+    [exported, unresolved] = get_symbols(file)
+    try:
+        # write to a temporary file first: other builds may read it
+        tmpfile = symfile + "." + str(os.getpid())
+        with open(tmpfile, "w") as f:
+            f.write(" ".join(exported) + "\n" + " ".join(unresolved) + "\n")
+        os.rename(tmpfile, symfile)
+    except (OSError, IOError):
+        try:
+            os.remove(tmpfile)
+        except OSError:
+            pass
+    return [exported, unresolved]
+
+
 def check_objdump_present():
     try:
         output = subprocess.Popen([objdump], stdout=subprocess.PIPE, stderr=subprocess.PIPE).communicate()[0]
@@ -134,7 +161,7 @@ def find_needed_objects(app_o, system_o):
     exported_in_file_dict = dict()
     unres_in_file_dict = dict()
     for o in system_o:
-        [exported_in_obj, unres_in_obj] = get_symbols(o)
+        [exported_in_obj, unres_in_obj] = get_system_symbols(o)
         exported_in_file_dict[o] = set(exported_in_obj)
         unres_in_file_dict[o] = set(unres_in_obj)
 
@@ -75,10 +75,14 @@
 #define FCF_EXT_SRC_PORT        0x04
 #define FCF_EXT_DST_PORT        0x08
 #define FCF_EXT_HOPLIMIT        0x10
-// there are more data
-//#define FCF_EXT_MORE            0x20
+// source and destination ports are equal, only one of them is present
+#define FCF_EXT_SAME_PORT       0x20
 // this packet is an acknowledgement
 #define FCF_EXT_IS_ACK          0x40
+// compressed header: an original address, if absent, is equal
+// to the respective immediate address. If both destination addresses
+// are absent, the packet is a broadcast.
+#define FCF_EXT_COMPRESSED      0x80
 
 enum {
     MOS_ADDR_TYPE_SHORT,
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2008-2013 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Drift-compensated time synchronization: linear regression over
+// the recent (local time, root time) pairs, as in FTSP.
+//
+
+#include "clocksync.h"
+#include <timing.h>
+#include <print.h>
+#include <lib/algo.h>
+#include <stdlib.h>
+
+#if !USE_ROLE_BASE_STATION
+
+typedef struct ClockSyncPoint_s {
+    uint32_t localMs;   // local time, low 32 bits
+    int32_t offsetMs;   // root time minus local time, relative to 'baseOffset'
+} ClockSyncPoint_t;
+
+// a ring buffer of the pairs; the newest one is at 'newest'
+static ClockSyncPoint_t points[CLOCKSYNC_TABLE_SIZE];
+static uint8_t numPoints;
+static uint8_t newest;
+
+// keeps the stored offsets small
+static int64_t baseOffset;
+// the max deviation of the pairs from the regression line
+static uint16_t maxResidual;
+
+static inline int32_t skewPpm(int32_t skew)
+{
+    return ((int64_t) skew * 1000000) >> CLOCK_SKEW_SHIFT;
+}
+
+static inline ClockSyncPoint_t *point(uint8_t age)
+{
+    return &points[(newest + CLOCKSYNC_TABLE_SIZE - age) % CLOCKSYNC_TABLE_SIZE];
+}
+
+static void estimate(void)
+{
+    const ClockSyncPoint_t *last = point(0);
+    int64_t sumLocal = 0, sumOffset = 0;
+    int32_t meanLocal, meanOffset;
+    int64_t num = 0, den = 0;
+    int32_t skew = 0;
+    uint16_t residual = 0;
+    uint8_t i;
+    Handle_t h;
+
+    // local times are taken relative to the newest point
+    for (i = 0; i < numPoints; ++i) {
+        sumLocal += (int32_t) (point(i)->localMs - last->localMs);
+        sumOffset += point(i)->offsetMs;
+    }
+    meanLocal = sumLocal / numPoints;
+    meanOffset = sumOffset / numPoints;
+
+    if (numPoints >= CLOCKSYNC_MIN_POINTS) {
+        for (i = 0; i < numPoints; ++i) {
+            int32_t dl = (int32_t) (point(i)->localMs - last->localMs) - meanLocal;
+            int32_t dOffset = point(i)->offsetMs - meanOffset;
+            num += (int64_t) dl * dOffset;
+            den += (int64_t) dl * dl;
+        }
+        if (num < (1ll << 38) && num > -(1ll << 38)) {
+            if (den) skew = (num << CLOCK_SKEW_SHIFT) / den;
+        } else {
+            // avoid the overflow; the span of the points is large in this case
+            if (den >> CLOCK_SKEW_SHIFT) skew = num / (den >> CLOCK_SKEW_SHIFT);
+        }
+        if (labs(skewPpm(skew)) > CLOCKSYNC_MAX_SKEW_PPM) {
+            skew = 0;
+        }
+        for (i = 0; i < numPoints; ++i) {
+            int32_t dl = (int32_t) (point(i)->localMs - last->localMs) - meanLocal;
+            int32_t predicted = meanOffset
+                    + (int32_t) (((int64_t) skew * dl) >> CLOCK_SKEW_SHIFT);
+            int32_t error = labs(point(i)->offsetMs - predicted);
+            if (error > residual) residual = min(error, 0xffff);
+        }
+    } else {
+        // too few points: use the newest offset only
+        meanLocal = 0;
+        meanOffset = last->offsetMs;
+    }
+
+    ATOMIC_START(h);
+    rootClockAnchorMs = last->localMs + meanLocal;
+    rootClockDeltaMs = baseOffset + meanOffset;
+    rootClockSkew = skew;
+    ATOMIC_END(h);
+    maxResidual = residual;
+}
+
+int32_t clocksyncAddPoint(uint64_t localMs, uint64_t rootMs)
+{
+    int64_t offset = (int64_t) (rootMs - localMs);
+    uint32_t local = (uint32_t) localMs;
+    int32_t error = 0;
+
+    if (numPoints) {
+        int64_t diff = offset - (rootClockDeltaMs + rootClockSkewMs(local));
+        error = diff > 0x7fffffff ? 0x7fffffff : (diff < -0x7fffffff ? -0x7fffffff : diff);
+        if (labs(error) > CLOCKSYNC_MAX_ERROR) {
+            // the root or the local clock was reset
+            PRINTF("clocksync: error %ld ms, restarting\n", error);
+            numPoints = 0;
+        }
+    }
+    if (numPoints == 0) {
+        baseOffset = offset;
+    }
+
+    // drop the points that are too old
+    while (numPoints
+            && local - point(numPoints - 1)->localMs > CLOCKSYNC_MAX_AGE) {
+        numPoints--;
+    }
+
+    newest = (newest + 1) % CLOCKSYNC_TABLE_SIZE;
+    point(0)->localMs = local;
+    point(0)->offsetMs = offset - baseOffset;
+    if (numPoints < CLOCKSYNC_TABLE_SIZE) numPoints++;
+
+    estimate();
+    return error;
+}
+
+uint32_t clocksyncErrorBound(uint32_t afterMs)
+{
+    uint32_t age;
+    if (numPoints < CLOCKSYNC_MIN_POINTS) return CLOCKSYNC_UNKNOWN_ERROR;
+    age = (uint32_t) getTimeMs() - point(0)->localMs + afterMs;
+    return CLOCKSYNC_JITTER + maxResidual
+            + (age / 1000) * CLOCKSYNC_SKEW_ERROR_PPM / 1000;
+}
+
+int16_t clocksyncSkewPpm(void)
+{
+    return skewPpm(rootClockSkew);
+}
+
+void clocksyncReset(void)
+{
+    Handle_t h;
+    numPoints = 0;
+    ATOMIC_START(h);
+    rootClockSkew = 0;
+    ATOMIC_END(h);
+}
+
+#endif // !USE_ROLE_BASE_STATION
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2008-2013 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_CLOCKSYNC_H
+#define MANSOS_CLOCKSYNC_H
+
+/// \file
+/// Drift-compensated synchronization with the network root's clock
+///
+/// The routing protocol feeds in (local time, root time) pairs taken
+/// from received routing information packets. The last few pairs are
+/// kept in a table; linear regression over them gives the clock offset
+/// and the skew (drift rate) relative to the root. getSyncTimeMs() and
+/// the other functions in timing.h apply both.
+///
+
+#include <defines.h>
+
+//! The number of (local, root) time pairs used in the regression
+#ifndef CLOCKSYNC_TABLE_SIZE
+#define CLOCKSYNC_TABLE_SIZE       8
+#endif
+
+//! The skew is estimated only when at least this many pairs are present
+#ifndef CLOCKSYNC_MIN_POINTS
+#define CLOCKSYNC_MIN_POINTS       3
+#endif
+
+//! Pairs older than this (milliseconds) are not used
+#ifndef CLOCKSYNC_MAX_AGE
+#define CLOCKSYNC_MAX_AGE          (2 * 3600 * 1000ul)
+#endif
+
+//! A pair this far (milliseconds) from the estimate clears the table (root reset etc.)
+#ifndef CLOCKSYNC_MAX_ERROR
+#define CLOCKSYNC_MAX_ERROR        500
+#endif
+
+//! Assumed max error of the skew estimate, parts per million
+#ifndef CLOCKSYNC_SKEW_ERROR_PPM
+#define CLOCKSYNC_SKEW_ERROR_PPM   20
+#endif
+
+//! Timestamping jitter (milliseconds) always included in the error bound
+#ifndef CLOCKSYNC_JITTER
+#define CLOCKSYNC_JITTER           10
+#endif
+
+//! Max absolute skew accepted, parts per million
+#define CLOCKSYNC_MAX_SKEW_PPM     1000
+
+//! Returned by clocksyncErrorBound() when there is too little data
+#define CLOCKSYNC_UNKNOWN_ERROR    0xffffffffu
+
+///
+/// Add a synchronization point: at local time 'localMs' (64-bit milliseconds),
+/// the root's clock was 'rootMs'.
+///   @return the difference (milliseconds) between 'rootMs' and the time
+///           estimated before adding the point
+///
+int32_t clocksyncAddPoint(uint64_t localMs, uint64_t rootMs);
+
+///
+/// The max expected difference from the root's clock 'afterMs' milliseconds from now
+///   @return the bound in milliseconds, or CLOCKSYNC_UNKNOWN_ERROR
+///
+uint32_t clocksyncErrorBound(uint32_t afterMs);
+
+//! The estimated skew of the root's clock relative to the local clock, ppm
+int16_t clocksyncSkewPpm(void);
+
+//! Forget all synchronization points
+void clocksyncReset(void);
+
+#endif
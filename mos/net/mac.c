@@ -66,12 +66,35 @@ int8_t macSendEx(MacInfo_t *mi, const uint8_t *data, uint16_t length) {
     return ret;
 }
 
+#if MAC_COMPRESS_HEADER
+// original src is left out when equal to immediate src
+static inline bool canElideSrc(MacInfo_t *mi) {
+#if SUPPORT_LONG_ADDR
+    if (mi->originalSrc.type != MOS_ADDR_TYPE_SHORT) return false;
+#endif
+    return mi->originalSrc.shortAddr == mi->immedSrc.shortAddr;
+}
+
+// original dst is left out when equal to immediate dst,
+// or when it's broadcast and there is no immediate dst
+static inline bool canElideDst(MacInfo_t *mi) {
+#if SUPPORT_LONG_ADDR
+    if (mi->originalDst.type != MOS_ADDR_TYPE_SHORT) return false;
+#endif
+    if (mi->immedDst.shortAddr) {
+        return mi->originalDst.shortAddr == mi->immedDst.shortAddr;
+    }
+    return mi->originalDst.shortAddr == MOS_ADDR_BROADCAST;
+}
+#endif
+
 bool defaultBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
                         uint16_t *headerLength /* out */) {
     uint8_t *p = headerBuffer;
 //    uint8_t fcf1 = 0, fcf2 = 0; // FCF flags: byte 1 and 2
     uint8_t *fcf1 = headerBuffer;
     uint8_t *fcf2 = headerBuffer + 1; // FCF flags: byte 1 and 2
+    bool elideSrc = false, elideDst = false;
     
     *fcf1 = 0;
     ++p;
@@ -87,8 +110,17 @@ bool defaultBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
     if (mi->hoplimit) *fcf2 |= FCF_EXT_HOPLIMIT;
     if (mi->flags & MI_FLAG_IS_ACK) *fcf2 |= FCF_EXT_IS_ACK;
 
+#if MAC_COMPRESS_HEADER
+    *fcf2 |= FCF_EXT_COMPRESSED;
+    elideSrc = canElideSrc(mi);
+    elideDst = canElideDst(mi);
+    if (mi->srcPort && mi->srcPort == mi->dstPort) *fcf2 |= FCF_EXT_SAME_PORT;
+#endif
+
 #if SUPPORT_LONG_ADDR
-    if (mi->originalSrc.type == MOS_ADDR_TYPE_SHORT) {
+    if (elideSrc) {
+        // FCF_SRC_ADDR_NONE
+    } else if (mi->originalSrc.type == MOS_ADDR_TYPE_SHORT) {
         *fcf1 += FCF_SRC_ADDR_SHORT;
         be16Write(p, mi->originalSrc.shortAddr);
         p += MOS_SHORT_ADDR_SIZE;
@@ -97,7 +129,9 @@ bool defaultBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
         memcpy(p, mi->originalSrc.longAddr, MOS_LONG_ADDR_SIZE);
         p += MOS_LONG_ADDR_SIZE;
     }
-    if (mi->originalDst.type == MOS_ADDR_TYPE_SHORT) {
+    if (elideDst) {
+        // FCF_DST_ADDR_NONE
+    } else if (mi->originalDst.type == MOS_ADDR_TYPE_SHORT) {
         *fcf1 += FCF_DST_ADDR_SHORT;
         be16Write(p, mi->originalDst.shortAddr);
         p += MOS_SHORT_ADDR_SIZE;
@@ -111,13 +145,17 @@ bool defaultBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
             || mi->immedSrc.type != MOS_ADDR_TYPE_SHORT) return false;
 #else
     // src
-    *fcf1 += FCF_SRC_ADDR_SHORT;
-    be16Write(p, mi->originalSrc.shortAddr);
-    p += MOS_SHORT_ADDR_SIZE;
+    if (!elideSrc) {
+        *fcf1 += FCF_SRC_ADDR_SHORT;
+        be16Write(p, mi->originalSrc.shortAddr);
+        p += MOS_SHORT_ADDR_SIZE;
+    }
     // dst
-    *fcf1 += FCF_DST_ADDR_SHORT;
-    be16Write(p, mi->originalDst.shortAddr);
-    p += MOS_SHORT_ADDR_SIZE;
+    if (!elideDst) {
+        *fcf1 += FCF_DST_ADDR_SHORT;
+        be16Write(p, mi->originalDst.shortAddr);
+        p += MOS_SHORT_ADDR_SIZE;
+    }
 #endif // !SUPPORT_LONG_ADDR
     if (mi->immedSrc.shortAddr) {
         *fcf1 |= FCF_IMMED_SRC;
@@ -140,7 +178,7 @@ bool defaultBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
     if (mi->srcPort) {
         *p++ = mi->srcPort;
     }
-    if (mi->dstPort) {
+    if (mi->dstPort && !(*fcf2 & FCF_EXT_SAME_PORT)) {
         *p++ = mi->dstPort;
     }
     if (mi->hoplimit) {
@@ -186,7 +224,7 @@ static uint8_t calcMacHeaderLen(uint8_t fcf1, uint8_t fcf2) {
     if (fcf1 & FCF_EXTENDED) {
         ++result;
         if (fcf2 & FCF_EXT_SRC_PORT) ++result;
-        if (fcf2 & FCF_EXT_DST_PORT) ++result;
+        if ((fcf2 & FCF_EXT_DST_PORT) && !(fcf2 & FCF_EXT_SAME_PORT)) ++result;
         if (fcf2 & FCF_EXT_HOPLIMIT) ++result;
     }
 
@@ -200,7 +238,7 @@ uint8_t *defaultParseHeader(uint8_t *data, uint16_t length, MacInfo_t *mi /* out
 
     // XXX: recv len can be 1, but then it's invalid anyway...
     fcf1 = data[0];
-    fcf2 = data[1];
+    fcf2 = (fcf1 & FCF_EXTENDED) ? data[1] : 0;
     macHeaderLen = calcMacHeaderLen(fcf1, fcf2);
 
     if (macHeaderLen > length) {
@@ -266,11 +304,24 @@ uint8_t *defaultParseHeader(uint8_t *data, uint16_t length, MacInfo_t *mi /* out
     }
     if (fcf1 & FCF_EXTENDED) {
         if (fcf2 & FCF_EXT_SRC_PORT) mi->srcPort = *p++;
-        if (fcf2 & FCF_EXT_DST_PORT) mi->dstPort = *p++;
+        if (fcf2 & FCF_EXT_DST_PORT) {
+            mi->dstPort = (fcf2 & FCF_EXT_SAME_PORT) ? mi->srcPort : *p++;
+        }
         if (fcf2 & FCF_EXT_HOPLIMIT) mi->hoplimit = *p++;
         if (fcf2 & FCF_EXT_IS_ACK) mi->flags |= MI_FLAG_IS_ACK;
     }
 
+    if (fcf2 & FCF_EXT_COMPRESSED) {
+        // restore the left out original addresses
+        if ((fcf1 & 0x7) % 3 == FCF_SRC_ADDR_NONE) {
+            mi->originalSrc.shortAddr = mi->immedSrc.shortAddr;
+        }
+        if ((fcf1 & 0x7) / 3 * 3 == FCF_DST_ADDR_NONE) {
+            mi->originalDst.shortAddr = (fcf1 & FCF_IMMED_DST) ?
+                    mi->immedDst.shortAddr : MOS_ADDR_BROADCAST;
+        }
+    }
+
     mi->macHeader = data;
     mi->macHeaderLen = p - data;
 
@@ -55,6 +55,9 @@
 ///
 /// Expectes software-generated ACKs from the receiber and resends packets on failure.
 /// Uses packet queue to store unsent packets.
+/// If MAC_PROTOCOL_ACK_WINDOW is above 1, several packets per neighbor
+/// can be in flight at once; the ACKs are selective, and ACK timeouts
+/// are adapted to the measured round-trip time of each neighbor.
 #define MAC_PROTOCOL_CSMA_ACK 3
 
 /// The MAC protocol used in SAD project.
@@ -64,6 +67,15 @@
 /// Uses internal buffer to store one unsent packet.
 #define MAC_PROTOCOL_SAD 4
 
+/// Low-power listening (LPL) MAC protocol.
+///
+/// The radio is duty-cycled: it is turned on for MAC_LPL_LISTEN_TIME
+/// every MAC_LPL_CYCLE_TIME milliseconds. Senders repeat the packet until
+/// it is acknowledged, and learn the wake-up phase of each neighbor from
+/// the ACKs, so subsequent packets are sent just before the neighbor wakes up.
+/// Uses packet queue to store unsent packets.
+#define MAC_PROTOCOL_LPL 5
+
 #define MI_FLAG_LOCALLY_ORIGINATED  0x1
 #define MI_FLAG_MORE_DATA           0x2
 #define MI_FLAG_ACK_REQUESTED       0x4
@@ -182,6 +194,22 @@ bool isLocalAddress(MosAddr *addr);
 #define MAC_PROTOCOL_ACK_TIME 200 // milliseconds
 #endif
 
+//! The minimal ACK wait time (milliseconds) when adaptive ACK timeouts are used
+#ifndef MAC_PROTOCOL_ACK_TIME_MIN
+#define MAC_PROTOCOL_ACK_TIME_MIN 10 // milliseconds
+#endif
+
+//! The max number of unacknowledged packets in flight to a single neighbor.
+/// Values above 1 enable sliding-window mode in CSMA-ACK MAC protocol
+#ifndef MAC_PROTOCOL_ACK_WINDOW
+#define MAC_PROTOCOL_ACK_WINDOW 1
+#endif
+
+//! The number of neighbors for which RTT estimates and receive windows are kept
+#ifndef MAC_PROTOCOL_ACK_NEIGHBORS
+#define MAC_PROTOCOL_ACK_NEIGHBORS 4
+#endif
+
 //! The number of attemps a single packet is send to a unicast destination
 #ifndef MAC_PROTOCOL_MAX_ATTEMPTS
 #define MAC_PROTOCOL_MAX_ATTEMPTS 3
@@ -199,7 +227,28 @@ bool isLocalAddress(MosAddr *addr);
 
 //! The size of the unsent packet queue
 #ifndef MAC_PROTOCOL_QUEUE_SIZE
-#define MAC_PROTOCOL_QUEUE_SIZE  1
+#define MAC_PROTOCOL_QUEUE_SIZE  MAC_PROTOCOL_ACK_WINDOW
+#endif
+
+//! LPL: the period (milliseconds) of receiver wake-ups
+#ifndef MAC_LPL_CYCLE_TIME
+#define MAC_LPL_CYCLE_TIME 250
+#endif
+
+//! LPL: the time (milliseconds) the receiver listens after each wake-up
+#ifndef MAC_LPL_LISTEN_TIME
+#define MAC_LPL_LISTEN_TIME 10
+#endif
+
+//! LPL: the interval (milliseconds) between repeated transmissions of a packet.
+/// Must be shorter than MAC_LPL_LISTEN_TIME
+#ifndef MAC_LPL_STROBE_INTERVAL
+#define MAC_LPL_STROBE_INTERVAL 4
+#endif
+
+//! LPL: the time (milliseconds) to start sending before the expected wake-up of a neighbor
+#ifndef MAC_LPL_GUARD_TIME
+#define MAC_LPL_GUARD_TIME 5
 #endif
 
 //! The delay (in milliseconds) for MAC-layer packet forwarding
@@ -207,4 +256,11 @@ bool isLocalAddress(MosAddr *addr);
 #define MAC_FORWARDING_DELAY 1
 #endif
 
+//! Build compressed MAC headers (redundant addresses and ports left out).
+/// Compressed headers are always understood on receive; enable this
+/// only when all motes in the network run code that supports them.
+#ifndef MAC_COMPRESS_HEADER
+#define MAC_COMPRESS_HEADER 0
+#endif
+
 #endif
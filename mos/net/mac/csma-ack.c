@@ -32,6 +32,7 @@
 #include <net/radio_packet_buffer.h>
 #include <net/net_stats.h>
 #include <timing.h>
+#include <string.h>
 
 #define TEST_FILTERS 1
 
@@ -53,12 +54,218 @@ MacProtocol_t macProtocol = {
     .isKnownDstAddress = defaultIsKnownDstAddress,
 };
 
+//
+// Per-neighbor state. Used both on the sender side (RTT estimation)
+// and on the receiver side (the window of recently received seqnums).
+//
+typedef struct AckNeighbor_s {
+    bool isUsed;
+    MosShortAddr addr;
+    uint32_t lastActive; // for LRU replacement
+    uint16_t srtt;       // smoothed RTT, scaled by 8; 0 if no samples yet
+    uint16_t rttvar;     // RTT mean deviation, scaled by 4
+    uint16_t rto;        // the current ACK timeout, in milliseconds
+    uint32_t lastRecv;   // when lastSeqnum was received
+    uint8_t lastSeqnum;  // the most recent seqnum received; 0 if none yet
+    uint8_t recvMask;    // bit i set: seqnum (lastSeqnum - 1 - i) also received
+} AckNeighbor_t;
+
+static AckNeighbor_t neighbors[MAC_PROTOCOL_ACK_NEIGHBORS];
+
+// ACK payload: the most recent seqnum received from the sender + recvMask.
+// Older versions send ACKs without payload; these acknowledge a single packet.
+#define ACK_PAYLOAD_LENGTH 2
+
+// the max value of a single RTT sample; keeps the scaled srtt from overflowing
+#define MAX_RTT_SAMPLE 4095
+
+// max exponential backoff shift for retransmissions
+#define MAX_BACKOFF_SHIFT 3
+
+// all retransmissions of a packet arrive within this time (milliseconds);
+// after a longer silence the neighbor's receive window is forgotten
+#define RECV_WINDOW_LIFETIME \
+    ((uint32_t) MAC_PROTOCOL_MAX_ATTEMPTS * (2 * MAC_PROTOCOL_ACK_TIME << MAX_BACKOFF_SHIFT))
+
+typedef struct AckInfo_s {
+    MosShortAddr from;
+    uint8_t seqnum;
+    uint8_t lastSeqnum;
+    uint8_t recvMask;
+} AckInfo_t;
+
 static Alarm_t sendTimer;
-static bool sendTimerRunning;
 static uint8_t mySeqnum;
 
 // -----------------------------------------------
 
+static AckNeighbor_t *findNeighbor(MosShortAddr addr, bool create)
+{
+    AckNeighbor_t *n, *victim = NULL;
+    for (n = neighbors; n < neighbors + MAC_PROTOCOL_ACK_NEIGHBORS; ++n) {
+        if (!n->isUsed) {
+            if (!victim || victim->isUsed) victim = n;
+            continue;
+        }
+        if (n->addr == addr) return n;
+        if (!victim || (victim->isUsed
+                        && timeAfter32(victim->lastActive, n->lastActive))) {
+            victim = n;
+        }
+    }
+    if (!create) return NULL;
+
+    memset(victim, 0, sizeof(*victim));
+    victim->isUsed = true;
+    victim->addr = addr;
+    victim->rto = MAC_PROTOCOL_ACK_TIME;
+    return victim;
+}
+
+static inline uint16_t getAckTimeout(MosShortAddr addr)
+{
+    AckNeighbor_t *n = findNeighbor(addr, false);
+    return n ? n->rto : MAC_PROTOCOL_ACK_TIME;
+}
+
+//
+// Jacobson/Karels RTT estimator: srtt += (sample - srtt) / 8,
+// rttvar += (|sample - srtt| - rttvar) / 4, rto = srtt + 4 * rttvar
+//
+static void updateRtt(AckNeighbor_t *n, uint32_t sample)
+{
+    if (sample > MAX_RTT_SAMPLE) sample = MAX_RTT_SAMPLE;
+    if (sample == 0) sample = 1;
+
+    if (n->srtt == 0) {
+        n->srtt = sample << 3;
+        n->rttvar = sample << 1;
+    } else {
+        int16_t delta = (int16_t) sample - (n->srtt >> 3);
+        n->srtt += delta;
+        if (delta < 0) delta = -delta;
+        n->rttvar += delta - (n->rttvar >> 2);
+    }
+
+    n->rto = (n->srtt >> 3) + n->rttvar;
+    if (n->rto < MAC_PROTOCOL_ACK_TIME_MIN) n->rto = MAC_PROTOCOL_ACK_TIME_MIN;
+    if (n->rto > 2 * MAC_PROTOCOL_ACK_TIME) n->rto = 2 * MAC_PROTOCOL_ACK_TIME;
+}
+
+//
+// Record a received seqnum in the neighbor's receive window.
+// Returns true if the packet is a duplicate (i.e. our ACK was lost).
+//
+static bool recvWindowUpdate(AckNeighbor_t *n, uint8_t seqnum, uint32_t now)
+{
+    int16_t diff = (int8_t) (seqnum - n->lastSeqnum);
+    bool expired = timeAfter32(now, n->lastRecv + RECV_WINDOW_LIFETIME);
+
+    n->lastRecv = now;
+    // Seqnums start from 1 after a reboot (0 is never used), so 1 that is
+    // not after the last seqnum means that the neighbor has restarted.
+    // Treating it as a new packet can at worst pass up a duplicate,
+    // while treating it as a duplicate would drop it silently
+    if (n->lastSeqnum == 0 || expired || diff < -8 || (seqnum == 1 && diff < 0)) {
+        // first packet from this neighbor, or the neighbor has rebooted
+        n->lastSeqnum = seqnum;
+        n->recvMask = 0;
+        return false;
+    }
+#if MAC_PROTOCOL_ACK_WINDOW > 1
+    if (diff > 0) {
+        n->recvMask = diff > 8 ? 0 :
+                (uint8_t) ((n->recvMask << diff) | (1 << (diff - 1)));
+        n->lastSeqnum = seqnum;
+        return false;
+    }
+    if (diff == 0) return true;
+
+    diff = -diff - 1;
+    if (n->recvMask & (1 << diff)) return true;
+    n->recvMask |= 1 << diff;
+    return false;
+#else
+    // one packet in flight at a time: only a retransmission
+    // of the last packet can be a duplicate
+    if (diff == 0) return true;
+    n->lastSeqnum = seqnum;
+    return false;
+#endif
+}
+
+static inline bool isInRecvMask(uint8_t seqnum, uint8_t lastSeqnum, uint8_t recvMask)
+{
+    uint8_t bit = (uint8_t) (lastSeqnum - seqnum) - 1;
+    return bit < 8 && (recvMask & (1 << bit));
+}
+
+static uint8_t inFlightCount(MosShortAddr nexthop)
+{
+    QueuedPacket_t *p;
+    uint8_t count = 0;
+    STAILQ_FOREACH(p, &packetQueue, chain) {
+        if (p->inFlight && p->nexthop == nexthop) count++;
+    }
+    return count;
+}
+
+static QueuedPacket_t *allocPacket(void)
+{
+    QueuedPacket_t *p;
+    for (p = queuedPackets; p < queuedPackets + MAC_PROTOCOL_QUEUE_SIZE; ++p) {
+        if (!p->isUsed) return p;
+    }
+    return NULL;
+}
+
+static void transmitPacket(QueuedPacket_t *p, uint32_t now)
+{
+    radioSend(p->data, p->dataLength);
+    INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
+    if (!p->inFlight) {
+        p->inFlight = true;
+        p->sendTime = now;
+    }
+    p->ackTime = now + ((uint32_t) getAckTimeout(p->nexthop)
+            << MIN(p->sendTries, MAX_BACKOFF_SHIFT));
+}
+
+// send queued packets for which there is space in the neighbor's window
+static void sendHeldPackets(uint32_t now)
+{
+    QueuedPacket_t *p;
+    STAILQ_FOREACH(p, &packetQueue, chain) {
+        if (!p->inFlight && inFlightCount(p->nexthop) < MAC_PROTOCOL_ACK_WINDOW) {
+            transmitPacket(p, now);
+        }
+    }
+}
+
+static void scheduleSendTimer(uint32_t now)
+{
+    QueuedPacket_t *p;
+    bool found = false;
+    uint32_t earliest = 0;
+
+    STAILQ_FOREACH(p, &packetQueue, chain) {
+        if (!p->inFlight) continue;
+        if (!found || timeAfter32(earliest, p->ackTime)) {
+            earliest = p->ackTime;
+            found = true;
+        }
+    }
+
+    if (!found) {
+        alarmRemove(&sendTimer);
+        return;
+    }
+    alarmSchedule(&sendTimer,
+            timeAfter32(earliest, now) ? earliest - now : 0);
+}
+
+// -----------------------------------------------
+
 static void initCsmaMac(RecvFunction recvCb) {
     netQueueInit();
 
@@ -76,72 +283,73 @@ static int8_t sendCsmaMac(MacInfo_t *mi, const uint8_t *data, uint16_t length) {
     // TODO...
 #endif
 
-    INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
     if (!(mi->flags & MI_FLAG_ACK_REQUESTED)) {
         // PRINTF("send a packet\n");
         // this is a broadcast message or ACK
+        INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
         ret = radioSendHeader(mi->macHeader, mi->macHeaderLen, data, length);
         if (ret == 0) ret = length;
         return ret;
     }
     // PRINTF("send a packet with ACK expected\n");
-    radioSendHeader(mi->macHeader, mi->macHeaderLen, data, length);
-    QueuedPacket_t *p = &queuedPackets[0];
+    QueuedPacket_t *p = allocPacket();
     ret = netQueueAddPacket(mi, data, length, p);
-    if (ret) return ret;
+    if (ret) {
+        // no space for retransmissions: still try to send it once
+        INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
+        radioSendHeader(mi->macHeader, mi->macHeaderLen, data, length);
+        return ret;
+    }
 
     //PRINTF("%lu: packet added!\n", getTimeMs());
 
+    uint32_t now = (uint32_t) getJiffies();
     p->sendTries = 0;
-    p->ackTime = getJiffies() + MAC_PROTOCOL_ACK_TIME;
-
-    if (!sendTimerRunning) {
-        sendTimerRunning = true;
-        alarmSchedule(&sendTimer, MAC_PROTOCOL_ACK_TIME);
+    p->inFlight = false;
+    if (inFlightCount(p->nexthop) < MAC_PROTOCOL_ACK_WINDOW) {
+        transmitPacket(p, now);
     }
+    // else the packet is sent when ACKs open the window
+
+    scheduleSendTimer(now);
     return length;
 }
 
-static void sendTimerCb(void *x) {
-    sendTimerRunning = false;
+static bool matchExpiredPacket(QueuedPacket_t *p, void *userData)
+{
+    uint32_t now = *(uint32_t *) userData;
+    return p->inFlight
+            && p->sendTries >= MAC_PROTOCOL_MAX_ATTEMPTS
+            && !timeAfter32(p->ackTime, now);
+}
 
+static void sendTimerCb(void *x) {
     //PRINTF("sendTimerCb\n");
 
     QueuedPacket_t *p;
+    uint32_t now = (uint32_t) getJiffies();
 
     // remove expired packets
-    p = queueHead();
-    while (p && p->sendTries == MAC_PROTOCOL_MAX_ATTEMPTS) {
-        netQueuePop();
-        p = queueHead();
+    while (netQueueRemovePacket(matchExpiredPacket, &now)) {
         INC_NETSTAT(NETSTAT_PACKETS_DROPPED_TX, EMPTY_ADDR);
     }
 
-    if (STAILQ_EMPTY(&packetQueue)) return;
-
-    uint32_t now = (uint32_t) getJiffies();
-    uint16_t nextTimerTime = MAC_PROTOCOL_ACK_TIME;
     STAILQ_FOREACH(p, &packetQueue, chain) {
         // for this packet ack time has not yet come
-        if (timeAfter32(p->ackTime, now)) {
-            // adjust nextTimerTime
-            uint16_t diff = p->ackTime - now;
-            if (diff < nextTimerTime) nextTimerTime = diff;
-            break;
-        }
+        if (!p->inFlight || timeAfter32(p->ackTime, now)) continue;
 
         p->sendTries++;
         PRINTF("%lu: ************** retry to send (try %u)\n", now, p->sendTries);
-        radioSend(p->data, p->dataLength);
-        INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
+        transmitPacket(p, now);
         // XXX: not the best way, need to get address more simply
         MacInfo_t mi;
         defaultParseHeader(p->data, p->dataLength, &mi);
         INC_NETSTAT(NETSTAT_PACKETS_RTX, mi.originalSrc.shortAddr);
     }
 
-    sendTimerRunning = true;
-    alarmSchedule(&sendTimer, nextTimerTime);
+    // dropped packets may have opened the window
+    sendHeldPackets(now);
+    scheduleSendTimer(now);
 }
 
 #if TEST_FILTERS
@@ -178,21 +386,60 @@ static bool filterPass(MacInfo_t *mi)
 
 #endif
 
-static void sendAck(MacInfo_t *mi)
+static void sendAck(MacInfo_t *mi, AckNeighbor_t *n)
 {
+    uint8_t payload[ACK_PAYLOAD_LENGTH];
+    payload[0] = n->lastSeqnum;
+    payload[1] = n->recvMask;
+
     //PRINTF("send ack to seqnum %u\n", mi->seqnum);
     invertDirection(mi);
     mi->flags = MI_FLAG_IS_ACK; // only this flag and nothing more
     mi->macHeader[1] |= FCF_EXT_IS_ACK;
-    sendCsmaMac(mi, NULL, 0);
+    sendCsmaMac(mi, payload, sizeof(payload));
     INC_NETSTAT(NETSTAT_PACKETS_ACK_TX, mi->originalDst.shortAddr);
 }
 
-static bool matchPacketBySeqnum(QueuedPacket_t *p, void *userData)
+static bool matchAckedPacket(QueuedPacket_t *p, void *userData)
 {
-    uint8_t seqnum = (uint8_t) (uint16_t) userData;
-    uint8_t packetSeqnum = getMacHeaderSeqnum(p->data);
-    return seqnum == packetSeqnum;
+    AckInfo_t *ack = (AckInfo_t *) userData;
+    uint8_t seqnum;
+
+    if (!p->inFlight || p->nexthop != ack->from) return false;
+    seqnum = getMacHeaderSeqnum(p->data);
+    return seqnum == ack->seqnum
+            || seqnum == ack->lastSeqnum
+            || isInRecvMask(seqnum, ack->lastSeqnum, ack->recvMask);
+}
+
+static void ackReceived(MacInfo_t *mi, uint8_t *data, uint16_t length)
+{
+    QueuedPacket_t *p;
+    AckInfo_t ack;
+    uint32_t now = (uint32_t) getJiffies();
+
+    // the ACK reuses the header of the acknowledged packet
+    ack.from = getNexthop(mi);
+    ack.seqnum = mi->seqnum;
+    if (length >= ACK_PAYLOAD_LENGTH) {
+        ack.lastSeqnum = data[0];
+        ack.recvMask = data[1];
+    } else {
+        ack.lastSeqnum = mi->seqnum;
+        ack.recvMask = 0;
+    }
+
+    while ((p = netQueueRemovePacket(matchAckedPacket, &ack)) != NULL) {
+        // Karn's rule: take RTT samples only from packets sent exactly once
+        if (p->sendTries == 0 && getMacHeaderSeqnum(p->data) == ack.seqnum) {
+            AckNeighbor_t *n = findNeighbor(ack.from, true);
+            n->lastActive = now;
+            updateRtt(n, now - p->sendTime);
+        }
+    }
+
+    sendHeldPackets(now);
+    scheduleSendTimer(now);
 }
 
 static void pollCsmaMac(void)
@@ -207,22 +454,28 @@ static void pollCsmaMac(void)
         uint8_t *data = defaultParseHeader(radioPacketBuffer->buffer,
                 radioPacketBuffer->receivedLength, &mi);
         if (data) {
+            uint16_t dataLength = radioPacketBuffer->receivedLength - mi.macHeaderLen;
             if (mi.flags & MI_FLAG_IS_ACK) {
                 //PRINTF("got ack to a packet with seqnum %u\n", mi.seqnum);
                 INC_NETSTAT(NETSTAT_PACKETS_ACK_RX, mi.originalSrc.shortAddr);
-                netQueueRemovePacket(
-                        matchPacketBySeqnum, (void *) (uint16_t) mi.seqnum);
+                ackReceived(&mi, data, dataLength);
             }
             else if (macProtocol.recvCb && filterPass(&mi)) {
-                //INC_NETSTAT(NETSTAT_PACKETS_RECV, mi.originalSrc.shortAddr);  // done @dv.c
-                // call user callback
-                macProtocol.recvCb(&mi, data,
-                        radioPacketBuffer->receivedLength - mi.macHeaderLen);
                 // Send MAC-layer ACK. How do we know whether the packet needs one?
                 // Simple: it is not ACK itself and has nonzero sequence number.
+                AckNeighbor_t *n = NULL;
+                bool isDuplicate = false;
                 if (mi.seqnum != 0) {
-                    sendAck(&mi);
+                    n = findNeighbor(mi.immedSrc.shortAddr ? : mi.originalSrc.shortAddr, true);
+                    n->lastActive = (uint32_t) getJiffies();
+                    isDuplicate = recvWindowUpdate(n, mi.seqnum, n->lastActive);
+                }
+                if (!isDuplicate) {
+                    //INC_NETSTAT(NETSTAT_PACKETS_RECV, mi.originalSrc.shortAddr);  // done @dv.c
+                    // call user callback
+                    macProtocol.recvCb(&mi, data, dataLength);
                 }
+                if (n) sendAck(&mi, n);
             } else{
                 INC_NETSTAT(NETSTAT_PACKETS_DROPPED_RX, EMPTY_ADDR);
             }
@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2008-2012 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Low-power listening (LPL) MAC protocol with phase locking.
+//
+// Receivers wake up every MAC_LPL_CYCLE_TIME milliseconds and listen
+// for MAC_LPL_LISTEN_TIME milliseconds. A sender repeats ("strobes")
+// the data frame until the receiver wakes up and acknowledges it.
+// The time of the ACK reveals the wake-up phase of the neighbor,
+// so the next time the sender starts strobing just before the expected
+// wake-up instead of strobing for a full cycle.
+// Broadcast frames are strobed for a full cycle and are not acknowledged.
+//
+
+#include "../mac.h"
+#include "../net_queue.h"
+#include <radio.h>
+#include <errors.h>
+#include <alarms.h>
+#include <print.h>
+#include <timing.h>
+#include <string.h>
+#include <lib/energy.h>
+#include <net/radio_packet_buffer.h>
+#include <net/net_stats.h>
+
+static void initLplMac(RecvFunction cb);
+static int8_t sendLplMac(MacInfo_t *, const uint8_t *data, uint16_t length);
+static void pollLplMac(void);
+static bool lplBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
+                           uint16_t *headerLength /* out */);
+
+MacProtocol_t macProtocol = {
+    .name = MAC_PROTOCOL_LPL,
+    .init = initLplMac,
+    .send = sendLplMac,
+    .poll = pollLplMac,
+    .buildHeader = lplBuildHeader,
+    .isKnownDstAddress = defaultIsKnownDstAddress,
+};
+
+typedef struct LplNeighbor_s {
+    bool isUsed;
+    bool phaseKnown;
+    MosShortAddr addr;
+    uint32_t lastActive;  // for LRU replacement
+    uint32_t lastWakeup;  // time when the neighbor was last seen awake
+    uint8_t lastSeqnum;   // for duplicate detection of strobed frames
+} LplNeighbor_t;
+
+static LplNeighbor_t neighbors[MAC_PROTOCOL_ACK_NEIGHBORS];
+
+static QueuedPacket_t queuedPackets[MAC_PROTOCOL_QUEUE_SIZE];
+
+static Alarm_t wakeupTimer;
+static Alarm_t listenTimer;
+static Alarm_t strobeTimer;
+
+static bool listening;
+static bool strobing;
+static bool radioIsOn;
+// true if the current strobe relies on a known phase of the neighbor
+static bool strobeLocked;
+static uint32_t strobeEnd;
+// when the last strobe was sent
+static uint32_t strobeTime;
+static uint8_t mySeqnum;
+
+// -----------------------------------------------
+
+static LplNeighbor_t *findNeighbor(MosShortAddr addr, bool create)
+{
+    LplNeighbor_t *n, *victim = NULL;
+    for (n = neighbors; n < neighbors + MAC_PROTOCOL_ACK_NEIGHBORS; ++n) {
+        if (!n->isUsed) {
+            if (!victim || victim->isUsed) victim = n;
+            continue;
+        }
+        if (n->addr == addr) return n;
+        if (!victim || (victim->isUsed
+                        && timeAfter32(victim->lastActive, n->lastActive))) {
+            victim = n;
+        }
+    }
+    if (!create) return NULL;
+
+    memset(victim, 0, sizeof(*victim));
+    victim->isUsed = true;
+    victim->addr = addr;
+    return victim;
+}
+
+// frames to a single neighbor are acknowledged, others are not
+static inline bool isUnicastNexthop(MosShortAddr nexthop)
+{
+    return nexthop != 0 && !(nexthop & 0x8000);
+}
+
+static void radioUpdate(void)
+{
+    bool on = listening || strobing;
+    if (on == radioIsOn) return;
+    radioIsOn = on;
+    if (on) {
+        radioOn();
+        energyConsumerOn(ENERGY_CONSUMER_RADIO_RX);
+    } else {
+        energyConsumerOff(ENERGY_CONSUMER_RADIO_RX);
+        radioOff();
+    }
+}
+
+static void listenFor(uint16_t milliseconds)
+{
+    listening = true;
+    radioUpdate();
+    alarmSchedule(&listenTimer, milliseconds);
+}
+
+static void wakeupTimerCb(void *x)
+{
+    alarmSchedule(&wakeupTimer, MAC_LPL_CYCLE_TIME);
+    listenFor(MAC_LPL_LISTEN_TIME);
+}
+
+static void listenTimerCb(void *x)
+{
+    listening = false;
+    radioUpdate();
+}
+
+// -----------------------------------------------
+
+static void startStrobe(uint32_t now)
+{
+    QueuedPacket_t *p = queueHead();
+    LplNeighbor_t *n;
+    if (!p) return;
+
+    n = isUnicastNexthop(p->nexthop) ? findNeighbor(p->nexthop, false) : NULL;
+    if (n && n->phaseKnown) {
+        // the guard time grows with the time since the last sync to cover clock drift
+        uint32_t elapsed = now - n->lastWakeup;
+        uint32_t guard = MAC_LPL_GUARD_TIME + (elapsed >> 14);
+        if (guard < MAC_LPL_CYCLE_TIME / 2) {
+            uint32_t cycles = (elapsed + guard) / MAC_LPL_CYCLE_TIME + 1;
+            uint32_t wakeup = n->lastWakeup + cycles * MAC_LPL_CYCLE_TIME;
+            strobeLocked = true;
+            strobeEnd = wakeup + guard + MAC_LPL_LISTEN_TIME;
+            alarmSchedule(&strobeTimer, wakeup - guard - now);
+            return;
+        }
+        // too much time has passed; the phase is not reliable anymore
+        n->phaseKnown = false;
+    }
+
+    strobeLocked = false;
+    strobeEnd = now + MAC_LPL_CYCLE_TIME + MAC_LPL_LISTEN_TIME;
+    alarmSchedule(&strobeTimer, 0);
+}
+
+static void strobeDone(bool acked)
+{
+    QueuedPacket_t *p = queueHead();
+    uint32_t now = (uint32_t) getJiffies();
+
+    alarmRemove(&strobeTimer);
+    if (!acked && isUnicastNexthop(p->nexthop)) {
+        if (strobeLocked) {
+            // the neighbor was not awake when expected; fall back to a full strobe
+            LplNeighbor_t *n = findNeighbor(p->nexthop, false);
+            if (n) n->phaseKnown = false;
+            startStrobe(now);
+            return;
+        }
+        PRINTF("LPL mac send failed: no ACK in a full cycle\n");
+        INC_NETSTAT(NETSTAT_PACKETS_DROPPED_TX, EMPTY_ADDR);
+    }
+
+    netQueuePop();
+    strobing = false;
+    radioUpdate();
+    startStrobe(now);
+}
+
+static void strobeTimerCb(void *x)
+{
+    QueuedPacket_t *p = queueHead();
+    uint32_t now = (uint32_t) getJiffies();
+
+    if (!p) return;
+    if (timeAfter32(now, strobeEnd)) {
+        strobeDone(false);
+        return;
+    }
+
+    if (!strobing) {
+        strobing = true;
+        radioUpdate();
+    }
+
+    strobeTime = now;
+    energyConsumerOn(ENERGY_CONSUMER_RADIO_TX);
+    radioSend(p->data, p->dataLength);
+    energyConsumerOff(ENERGY_CONSUMER_RADIO_TX);
+    INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
+
+    alarmSchedule(&strobeTimer, MAC_LPL_STROBE_INTERVAL);
+}
+
+// -----------------------------------------------
+
+static void initLplMac(RecvFunction recvCb)
+{
+    netQueueInit();
+
+    macProtocol.recvCb = recvCb;
+
+    alarmInit(&wakeupTimer, wakeupTimerCb, NULL);
+    alarmInit(&listenTimer, listenTimerCb, NULL);
+    alarmInit(&strobeTimer, strobeTimerCb, NULL);
+
+    // start the duty cycle; the radio is off most of the time
+    radioOff();
+    wakeupTimerCb(NULL);
+}
+
+static int8_t sendLplMac(MacInfo_t *mi, const uint8_t *data, uint16_t length)
+{
+    QueuedPacket_t *p, *free = NULL;
+    int8_t ret;
+
+    if (mi->flags & MI_FLAG_IS_ACK) {
+        // ACKs are sent immediately: the receiver is awake
+        INC_NETSTAT(NETSTAT_RADIO_TX, EMPTY_ADDR);
+        energyConsumerOn(ENERGY_CONSUMER_RADIO_TX);
+        ret = radioSendHeader(mi->macHeader, mi->macHeaderLen, data, length);
+        energyConsumerOff(ENERGY_CONSUMER_RADIO_TX);
+        if (ret == 0) ret = length;
+        return ret;
+    }
+
+    for (p = queuedPackets; p < queuedPackets + MAC_PROTOCOL_QUEUE_SIZE; ++p) {
+        if (!p->isUsed) {
+            free = p;
+            break;
+        }
+    }
+    ret = netQueueAddPacket(mi, data, length, free);
+    if (ret) return ret;
+
+    // start strobing if this is the only packet in the queue
+    if (queueHead() == free) {
+        startStrobe((uint32_t) getJiffies());
+    }
+    return length;
+}
+
+static void sendAck(MacInfo_t *mi)
+{
+    invertDirection(mi);
+    mi->flags = MI_FLAG_IS_ACK; // only this flag and nothing more
+    mi->macHeader[1] |= FCF_EXT_IS_ACK;
+    sendLplMac(mi, NULL, 0);
+    INC_NETSTAT(NETSTAT_PACKETS_ACK_TX, mi->originalDst.shortAddr);
+}
+
+static void ackReceived(MacInfo_t *mi)
+{
+    QueuedPacket_t *p = queueHead();
+    LplNeighbor_t *n;
+    uint32_t now;
+
+    // the ACK reuses the header of the acknowledged packet
+    if (!strobing || !p
+            || getNexthop(mi) != p->nexthop
+            || getMacHeaderSeqnum(p->data) != mi->seqnum) {
+        return;
+    }
+
+    // remember the phase of the neighbor. The ACK may come late in its
+    // listen window, so use the time of the acknowledged strobe: the
+    // neighbor woke up less than a strobe interval before it (or less
+    // than a listen time, if the first strobe was acknowledged)
+    now = (uint32_t) getJiffies();
+    n = findNeighbor(p->nexthop, true);
+    n->lastActive = now;
+    n->lastWakeup = strobeTime;
+    n->phaseKnown = true;
+
+    strobeDone(true);
+}
+
+static void pollLplMac(void)
+{
+    INC_NETSTAT(NETSTAT_RADIO_RX, EMPTY_ADDR);
+    if (isRadioPacketReceived()) {
+        MacInfo_t mi;
+        MosShortAddr nexthop = 0;
+        uint8_t *data = defaultParseHeader(radioPacketBuffer->buffer,
+                radioPacketBuffer->receivedLength, &mi);
+        if (data) nexthop = getNexthop((&mi));
+
+        if (!data) {
+            INC_NETSTAT(NETSTAT_PACKETS_DROPPED_RX, EMPTY_ADDR);
+        }
+        else if (mi.flags & MI_FLAG_IS_ACK) {
+            INC_NETSTAT(NETSTAT_PACKETS_ACK_RX, mi.originalSrc.shortAddr);
+            ackReceived(&mi);
+        }
+        else if (isUnicastNexthop(nexthop) && nexthop != localAddress) {
+            // overheard a frame for someone else; go back to sleep early
+            INC_NETSTAT(NETSTAT_PACKETS_DROPPED_RX, EMPTY_ADDR);
+            alarmRemove(&listenTimer);
+            listenTimerCb(NULL);
+        }
+        else if (macProtocol.recvCb) {
+            bool isDuplicate = false;
+            if (mi.seqnum) {
+                LplNeighbor_t *n = findNeighbor(
+                        mi.immedSrc.shortAddr ? : mi.originalSrc.shortAddr, true);
+                n->lastActive = (uint32_t) getJiffies();
+                isDuplicate = (n->lastSeqnum == mi.seqnum);
+                n->lastSeqnum = mi.seqnum;
+            }
+            // the sender may have more data; stay awake a bit longer
+            listenFor(MAC_LPL_LISTEN_TIME);
+            if (!isDuplicate) {
+                macProtocol.recvCb(&mi, data,
+                        radioPacketBuffer->receivedLength - mi.macHeaderLen);
+            }
+            if (nexthop == localAddress && mi.seqnum) {
+                sendAck(&mi);
+            }
+        }
+        else {
+            INC_NETSTAT(NETSTAT_PACKETS_DROPPED_RX, EMPTY_ADDR);
+        }
+    }
+    else if (isRadioPacketError()) {
+        INC_NETSTAT(NETSTAT_PACKETS_DROPPED_RX, EMPTY_ADDR);
+        PRINTF("got an error from radio: %s\n",
+                strerror(-radioPacketBuffer->receivedLength));
+    }
+    radioBufferReset();
+}
+
+static bool lplBuildHeader(MacInfo_t *mi, uint8_t **header /* out */,
+                           uint16_t *headerLength /* out */)
+{
+    // all frames carry a sequence number, used to filter out repeated strobes;
+    // only unicast frames are acknowledged
+    if (mySeqnum == 0) mySeqnum++;
+    mi->seqnum = mySeqnum++;
+
+    return defaultBuildHeader(mi, header, headerLength);
+}
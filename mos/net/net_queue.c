@@ -46,9 +46,14 @@ int8_t netQueueAddPacket(MacInfo_t *mi, const uint8_t *data, uint16_t length,
         PRINTF("netQueueAddPacket: queue is full!\n");
         return -ENOMEM;
     }
+    if (mi->macHeaderLen + length > MAC_PROTOCOL_BUFFER_SIZE) {
+        return -EMSGSIZE;
+    }
     result->isUsed = true;
+    result->nexthop = getNexthop(mi);
     memcpy(result->data, mi->macHeader, mi->macHeaderLen);
     memcpy(result->data + mi->macHeaderLen, data, length);
+    result->dataLength = mi->macHeaderLen + length;
 
     lock();
     STAILQ_INSERT_TAIL(&packetQueue, result, chain);
@@ -32,6 +32,9 @@ typedef struct QueuedPacket_s {
     bool isUsed;
     uint8_t sendTries; // how many times already tried to send
     uint32_t ackTime;  // await ACK until this time
+    uint32_t sendTime; // time of the first transmission (for RTT measurement)
+    bool inFlight;     // already transmitted, but not yet acknowledged
+    MosShortAddr nexthop;
     uint8_t data[MAC_PROTOCOL_BUFFER_SIZE];
     uint16_t dataLength;
 } QueuedPacket_t;
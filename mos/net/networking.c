@@ -27,6 +27,7 @@
 #include "net_queue.h"
 #include "net_stats.h"
 #include "radio_packet_buffer.h"
+#include "seal_networking.h"
 #include <serial_number.h>
 #include <print.h>
 
@@ -41,6 +42,8 @@ MosShortAddr localAddress;
 #ifndef USE_ROLE_BASE_STATION
 MosShortAddr rootAddress;
 int64_t rootClockDeltaMs;
+uint32_t rootClockAnchorMs;
+int32_t rootClockSkew;
 #endif
 
 #ifdef DEBUG
@@ -50,8 +53,9 @@ uint32_t netstats[TOTAL_NETSTAT];
 static struct RadioPacketBufferReal_s {
     uint8_t bufferLength;     // length of the buffer
     int8_t receivedLength;    // length of data stored in the packet, or error code if negative
+    uint32_t timestamp;       // local time in milliseconds when the packet was received
     uint8_t buffer[RADIO_BUFFER_SIZE]; // a buffer where the packet is stored
-} realBuf = {RADIO_BUFFER_SIZE, 0, {0}};
+} realBuf = {RADIO_BUFFER_SIZE, 0, 0, {0}};
 
 RadioPacketBuffer_t *radioPacketBuffer = (RadioPacketBuffer_t *) &realBuf;
 
@@ -165,6 +169,13 @@ void networkingForwardData(MacInfo_t *macInfo, uint8_t *data, uint16_t len) {
             PRINTF("not forwarding, duplicate...\n");
             break;
         }
+#endif
+#if USE_SEAL_NET && SEAL_AGGREGATION_DELAY
+        // coalesce SEAL packets of children with our own ones
+        if (!IS_LOCAL(macInfo) && macInfo->dstPort == SEAL_DATA_PORT
+                && sealNetAggregateForward(macInfo->originalSrc.shortAddr, data, len)) {
+            break;
+        }
 #endif
         if (IS_LOCAL(macInfo)) {
             INC_NETSTAT(NETSTAT_PACKETS_SENT, macInfo->originalDst.shortAddr);
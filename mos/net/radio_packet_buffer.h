@@ -25,10 +25,12 @@
 #define MANSOS_RADIO_PACKET_BUFFER_H
 
 #include <radio.h>
+#include <timing.h>
 
 typedef struct RadioPacketBuffer_s {
     uint8_t bufferLength;     // length of the buffer
     int8_t receivedLength;    // length of data stored in the packet, or error code if negative
+    uint32_t timestamp;       // local time in milliseconds when the packet was received
     uint8_t buffer[0];        // pointer to a buffer where the packet is stored
 } RadioPacketBuffer_t;
 
@@ -52,4 +54,11 @@ extern RadioPacketBuffer_t *radioPacketBuffer;
 #define radioBufferReset()         \
     radioPacketBuffer->receivedLength = 0;
 
+//! The local time (64-bit milliseconds) when the packet in the buffer was received
+static inline uint64_t radioPacketRxTimeMs64(void)
+{
+    uint32_t age = (uint32_t) getTimeMs() - radioPacketBuffer->timestamp;
+    return getTimeMs64() - age;
+}
+
 #endif
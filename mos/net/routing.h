@@ -127,7 +127,8 @@ typedef struct RoutingRequestPacket_s {
 
 #define MOTE_INFO_VALID_TIME          (5 * SAD_SUPERFRAME_LENGTH)
 
-// timeslots one mote are adjusted (to both ends) by this number
+// timeslots one mote are adjusted (to both ends) by this number at most;
+// the clock error bound from clocksync.h is used when it is smaller
 #define TIMESLOT_IMPRECISION          1000
 
 #define ROUTING_REPLY_WAIT_TIMEOUT    2000
@@ -27,6 +27,8 @@
 
 #include "../mac.h"
 #include "../routing.h"
+#include "../clocksync.h"
+#include "../radio_packet_buffer.h"
 #include "../socket.h"
 #include <alarms.h>
 #include <timing.h>
@@ -322,13 +324,9 @@ static void routingReceive(Socket_t *s, uint8_t *data, uint16_t len)
         lastSeenSeqnum = ri.seqnum;
         hopCountToRoot = ri.hopCount;
         lastRootMessageTime = (uint32_t) getJiffies();
-        int32_t oldRootClockDeltaMs = rootClockDeltaMs;
-        rootClockDeltaMs = ri.rootClockMs - getTimeMs64();
+        // the time of reception is taken when the radio delivered the packet
+        clocksyncAddPoint(radioPacketRxTimeMs64(), ri.rootClockMs);
         //TPRINTF("process packet, rx time=%lu\n", (uint32_t) ri.rootClockMs);
-        if (abs((int32_t)oldRootClockDeltaMs - (int32_t)rootClockDeltaMs) > 500) {
-            PRINTF("large delta change=%ld, time sync off?!\n", (int32_t)rootClockDeltaMs - (int32_t)oldRootClockDeltaMs);
-            PRINTF("delta: old=%ld, new=%ld\n", (int32_t)oldRootClockDeltaMs, (int32_t)rootClockDeltaMs);
-        }
         // TPRINTF("OK!%s\n", isListening ? "" : " (not listening)");
 
         // reschedule next listen start after this timesync
@@ -27,6 +27,8 @@
 
 #include "../mac.h"
 #include "../routing.h"
+#include "../clocksync.h"
+#include "../radio_packet_buffer.h"
 #include "../socket.h"
 #include <alarms.h>
 #include <timing.h>
@@ -36,6 +38,7 @@
 #include <net/net_stats.h>
 
 #include <leds.h>
+#include <lib/algo.h>
 
 static Socket_t roSocket;
 static Alarm_t roCheckTimer;
@@ -65,6 +68,9 @@ static bool routingSearching;
 
 static bool seenRoutingInThisFrame;
 
+// listening starts this much (ms) before the expected start of the timeslot
+static uint32_t listenGuardTime = TIMESLOT_IMPRECISION;
+
 static void roStartListeningTimerCb(void *);
 static void roStopListeningTimerCb(void *);
 
@@ -116,8 +122,10 @@ static uint32_t calcListenStartTime(void)
 {
     uint32_t result = timeToNextFrame() + 4000ul + MOTE_TIME_FULL * moteNumber;
     if (IS_ODD_COLLECTOR) result += MOTE_TIME_FULL * MAX_MOTES;
-    if (result < TIMESLOT_IMPRECISION) result = 0;
-    else result -= TIMESLOT_IMPRECISION;
+    // with drift compensation, the expected clock error is usually much smaller
+    listenGuardTime = min(clocksyncErrorBound(result), (uint32_t) TIMESLOT_IMPRECISION);
+    if (result < listenGuardTime) result = 0;
+    else result -= listenGuardTime;
     return result;
 }
 
@@ -152,6 +160,7 @@ void routingInit(void)
 
 static void roStartListeningTimerCb(void *x)
 {
+    uint32_t guardTime = listenGuardTime;
     alarmSchedule(&roStartListeningTimer, calcListenStartTime());
 
     // listen to info only when routing info is already valid (?)
@@ -159,7 +168,7 @@ static void roStartListeningTimerCb(void *x)
         TPRINTF("+++ mote #%u start\n", moteNumber);
         isListening = true;
         radioOn();
-        alarmSchedule(&roStopListeningTimer, TIMESLOT_IMPRECISION * 2 + MOTE_TIME * 2);
+        alarmSchedule(&roStopListeningTimer, guardTime * 2 + MOTE_TIME * 2);
     }
 }
 
@@ -335,15 +344,11 @@ static void routingReceive(Socket_t *s, uint8_t *data, uint16_t len)
         lastSeenSeqnum = ri.seqnum;
         hopCountToRoot = ri.hopCount;
         lastRootMessageTime = (uint32_t)getJiffies();
-        int64_t oldRootClockDeltaMs = rootClockDeltaMs;
-        rootClockDeltaMs = ri.rootClockMs - getTimeMs64();
+        // the time of reception is taken when the radio delivered the packet
+        clocksyncAddPoint(radioPacketRxTimeMs64(), ri.rootClockMs);
         bool numberChanged = moteNumber != ri.moteNumber;
         moteNumber = ri.moteNumber;
         // PRINTF("%lu: ++++++++++++ fixed local time\n", getSyncTimeMs());
-        if (abs((int32_t)oldRootClockDeltaMs - (int32_t)rootClockDeltaMs) > 500) {
-            PRINTF("large delta change=%ld, time sync off?!\n", (int32_t)rootClockDeltaMs - (int32_t)oldRootClockDeltaMs);
-            PRINTF("delta: old=%ld, new=%ld\n", (int32_t)oldRootClockDeltaMs, (int32_t)rootClockDeltaMs);
-        }
         // TPRINTF("OK!%s\n", isListening ? "" : " (not listening)");
 
         if (numberChanged) {
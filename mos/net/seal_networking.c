@@ -25,9 +25,17 @@
 #include "address.h"
 #include "socket.h"
 #include <lib/codec/crc.h>
+#include <lib/codec/varint.h>
+#include <lib/algo.h>
 #include <assert.h>
 #include <timing.h>
 #include <print.h>
+#include <alarms.h>
+#include <mutex.h>
+#include <sleep.h>
+#if SEAL_FORWARD_TO_SERIAL
+#include <serial.h>
+#endif
 
 #if DEBUG
 #define SEAL_DEBUG 1
@@ -44,16 +52,44 @@
 static SealNetListener_t listeners[MAX_SEAL_LISTENERS];
 static SealNetListener_t *listenerBeingProcessed;
 
+// bitmask of listener slots in use
+static uint32_t usedListeners;
+// dispatch index: for each field code, the listeners whose lowest code it is
+static uint32_t listenersByCode[SEAL_MAX_FIELD_CODES];
+
 static SealPacket_t *packetInProgress;
 uint8_t packetInProgressNumFields;
+static uint8_t packetInProgressNumMasks;
+
+// meta info of the record being processed
+static uint16_t recordSource;
+static uint32_t recordTimestamp;
 
 #if USE_NET
 static Socket_t socket;
 #endif
 
+#if SEAL_AGGREGATION_DELAY
+// Records forwarded from other motes are added from the kernel thread
+// (or an interrupt), so the buffer is only changed with interrupts disabled.
+// It is sent from a copy by the user context, which holds aggregateMutex.
+static uint8_t aggregateBuffer[SEAL_AGGREGATE_MAX_SIZE];
+static uint8_t aggregateSendBuffer[SEAL_AGGREGATE_MAX_SIZE];
+static uint16_t aggregateLength; // zero if there is no packet in progress
+static uint32_t aggregateLastTime;
+static Alarm_t aggregateTimer;
+static Mutex_t aggregateMutex;
+// set by the timer, which also wakes up the user context;
+// the packet is then sent by sealNetAggregatePoll()
+static volatile bool aggregateTimeout;
+
+static void aggregateTimerCb(void *);
+#endif
+
 // local functions
 
 static void sealRecv(uint8_t *data, uint16_t length);
+static void sealSend(const void *data, uint16_t length);
 
 #define for_all_listeners(op)                                           \
     do {                                                                \
@@ -62,9 +98,19 @@ static void sealRecv(uint8_t *data, uint16_t length);
         for (; l != end; ++l) { op; }                                   \
     } while (0)
 
+#if MAX_SEAL_LISTENERS == 32
+#define ALL_LISTENERS_MASK 0xfffffffful
+#else
+#define ALL_LISTENERS_MASK ((1ul << MAX_SEAL_LISTENERS) - 1)
+#endif
+
+//! Mask of bits below the given one
+#define LOWER_BITS(bit) ((1ul << (bit)) - 1)
+
 #if USE_NET
 static void sealRecvData(Socket_t *socket, uint8_t *data, uint16_t length)
 {
+    recordSource = socket->recvMacInfo->originalSrc.shortAddr;
     sealRecv(data, length);
 }
 #else
@@ -72,6 +118,8 @@ static void sealRecvRaw(void)
 {
     static uint8_t buffer[RADIO_MAX_PACKET];
     int16_t length = radioRecv(buffer, sizeof(buffer));
+    if (length <= 0) return;
+    recordSource = 0;
     sealRecv(buffer, length);
 }
 #endif
@@ -88,53 +136,148 @@ void sealNetInit(void)
     radioSetReceiveHandle(sealRecvRaw);
     radioOn();
 #endif
+#if SEAL_AGGREGATION_DELAY
+    alarmInit(&aggregateTimer, aggregateTimerCb, NULL);
+#endif
 }
 
 static inline bool isSingleValued(SealNetListener_t *l)
 {
-    uint32_t bit;
-    uint_t cnt = 0;
-    for (bit = 1; bit; bit <<= 1) {
-        if (l->typeMask & bit) {
-            if (cnt) return false;
-            else cnt = 1;
-        }
-    }
-    return true;
+    return !(l->typeMask & (l->typeMask - 1));
 }
 
-static void receivePacketData(SealNetListener_t *l, uint32_t typeMask, const uint8_t *data)
+static inline uint16_t listenerLowestCode(SealNetListener_t *l)
+{
+    return l->maskIndex * SEAL_TYPEMASK_CODES + lowestBit32(l->typeMask);
+}
+
+static void receivePacketData(SealNetListener_t *l, const uint32_t *typeMasks,
+                              const uint8_t *valueBase, const uint8_t *data)
 {
 //    PRINTF("receivePacketData for %p\n", l);
 
-    uint16_t code = ffs(l->typeMask) - 1; // XXX: warning on msp430
-    bool isSingleValued = !(l->typeMask & ~(1ul << code));
+    const uint32_t typeMask = typeMasks[l->maskIndex];
+    const uint8_t base = valueBase[l->maskIndex];
+    bool singleValued = isSingleValued(l);
 
     int32_t *write;
-    if (isSingleValued) write = &l->u.lastValue;
+    if (singleValued) write = &l->u.lastValue;
     else write = l->u.buffer;
 
-    uint32_t bit;
-    for (bit = 1; ; bit <<= 1) {
-        if (typeMask & bit) {
-            if (l->typeMask & bit) {
-                // read memory can be unaligned!
-                memcpy(write, data, 4);
-                write++;
-            }
-            data += 4;
-        }
-        if (bit == (1ul << 31)) break;
+    uint32_t bits = l->typeMask;
+    while (bits) {
+        uint_t bit = lowestBit32(bits);
+        uint_t index = base + bitCount32(typeMask & LOWER_BITS(bit));
+        // read memory can be unaligned!
+        memcpy(write, data + index * sizeof(int32_t), sizeof(int32_t));
+        write++;
+        bits &= bits - 1;
     }
     listenerBeingProcessed = l;
-    if (isSingleValued) {
-        l->callback.sv(code, l->u.lastValue);
+    if (singleValued) {
+        l->callback.sv(listenerLowestCode(l), l->u.lastValue);
     } else {
         l->callback.mv(l->u.buffer);
     }
     listenerBeingProcessed = NULL;
 }
 
+// process a single record: typemask(s) followed by field values
+static void sealRecvRecord(const uint8_t *data, uint16_t length)
+{
+    uint32_t typeMasks[SEAL_MAX_TYPEMASKS];
+    uint8_t valueBase[SEAL_MAX_TYPEMASKS]; // number of values before those of each typemask
+    uint_t numMasks = 0;
+    uint_t numValues = 0;
+    uint16_t valueOffset = 0;
+    uint32_t typeMask;
+    uint32_t candidates = 0;
+
+    do {
+        if (valueOffset + sizeof(typeMask) > length) {
+            DPRINTF("sealRecv: too short record!\n");
+            return;
+        }
+        memcpy(&typeMask, data + valueOffset, sizeof(typeMask));
+        valueOffset += sizeof(typeMask);
+        // typemasks for codes higher than supported are skipped;
+        // their values follow ours, so offsets are not affected
+        if (numMasks < SEAL_MAX_TYPEMASKS) {
+            uint32_t bits = typeMask & ~SEAL_TYPEMASK_EXTENSION;
+            uint32_t *byCode = listenersByCode + numMasks * SEAL_TYPEMASK_CODES;
+            typeMasks[numMasks] = bits;
+            valueBase[numMasks] = numValues;
+            numMasks++;
+            // collect the listeners whose lowest code is present
+            for (; bits; bits &= bits - 1) {
+                candidates |= byCode[lowestBit32(bits)];
+            }
+        }
+        numValues += bitCount32(typeMask & ~SEAL_TYPEMASK_EXTENSION);
+    } while (typeMask & SEAL_TYPEMASK_EXTENSION);
+
+    if (valueOffset + numValues * sizeof(int32_t) > length) {
+        DPRINTF("sealRecv: too short record!\n");
+        return;
+    }
+    data += valueOffset;
+
+    PRINTF("^\n"); // XXX TODO: this is SAD specific
+    while (candidates) {
+        SealNetListener_t *l = listeners + lowestBit32(candidates);
+        if (l->maskIndex < numMasks
+                && (typeMasks[l->maskIndex] & l->typeMask) == l->typeMask) {
+            receivePacketData(l, typeMasks, valueBase, data);
+        }
+        candidates &= candidates - 1;
+    }
+    PRINTF("$\n");
+}
+
+static void sealRecvAggregate(const uint8_t *data, uint16_t length)
+{
+    SealAggregateHeader_t h;
+    const uint8_t *p = data + sizeof(h);
+    const uint8_t *end = data + length;
+    uint32_t time;
+
+    memcpy(&h, data, sizeof(h));
+    time = h.baseTime;
+
+    while (p + sizeof(recordSource) < end) {
+        uint32_t delta;
+        uint8_t recordLength;
+
+        memcpy(&recordSource, p, sizeof(recordSource));
+        p += sizeof(recordSource);
+        p = varintDecode(p, end, &delta);
+        if (!p || p >= end) break;
+        recordLength = *p++;
+        if (p + recordLength > end) break;
+
+        time += delta;
+        recordTimestamp = time;
+        sealRecvRecord(p, recordLength);
+        p += recordLength;
+    }
+    if (p != end) {
+        DPRINTF("sealRecv: malformed aggregated packet!\n");
+    }
+}
+
+#if SEAL_FORWARD_TO_SERIAL
+static void sealForward(const uint8_t *data, uint16_t length)
+{
+    uint16_t frameLength = sizeof(recordSource) + length;
+    serialSendByte(PRINTF_SERIAL_ID, '$');
+    serialSendByte(PRINTF_SERIAL_ID, 'S');
+    serialSendByte(PRINTF_SERIAL_ID, frameLength >> 8);
+    serialSendByte(PRINTF_SERIAL_ID, frameLength & 0xff);
+    serialSendData(PRINTF_SERIAL_ID, (const uint8_t *) &recordSource, sizeof(recordSource));
+    serialSendData(PRINTF_SERIAL_ID, data, length);
+}
+#endif
+
 static void sealRecv(uint8_t *data, uint16_t length)
 {
     DPRINTF("%lu: seal rx\n", (uint32_t) getTimeMs());
@@ -145,7 +288,7 @@ static void sealRecv(uint8_t *data, uint16_t length)
     }
     SealHeader_t h;
     memcpy(&h, data, sizeof(h));
-    if (h.magic != SEAL_MAGIC) {
+    if (h.magic != SEAL_MAGIC && h.magic != SEAL_AGGREGATE_MAGIC) {
         DPRINTF("sealRecv: wrong magic (%#04x vs %#04x expected)!\n", h.magic, SEAL_MAGIC);
         return;
     }
@@ -154,59 +297,81 @@ static void sealRecv(uint8_t *data, uint16_t length)
         DPRINTF("sealRecv: wrong crc (%#04x vs %#04x expected)!\n", h.crc, calcCrc);
         return;
     }
-    uint32_t typeMask = h.typeMask;
-    uint8_t valueOffset = sizeof(SealHeader_t);
-    while (typeMask & (1ul << 31)) {
-        // TODO: support multiple typemask extension!
-        // TODO: check len
-        memcpy(&typeMask, data + valueOffset, sizeof(typeMask));
-        valueOffset += sizeof(typeMask);
+
+#if SEAL_FORWARD_TO_SERIAL
+    sealForward(data, length);
+#endif
+
+    if (h.magic == SEAL_AGGREGATE_MAGIC) {
+        sealRecvAggregate(data, length);
+    } else {
+        recordTimestamp = getSyncTimeMs();
+        sealRecvRecord(data + 4, length - 4);
     }
-    typeMask = h.typeMask;
+}
 
-    PRINTF("^\n"); // XXX TODO: this is SAD specific
-    for_all_listeners(
-            if (l->typeMask && (l->typeMask & typeMask) == l->typeMask) {
-                receivePacketData(l, typeMask, data + valueOffset);
-            });
-    PRINTF("$\n");
+static SealNetListener_t *listenerAdd(uint8_t maskIndex, uint32_t typeMask)
+{
+    uint32_t free = ~usedListeners & ALL_LISTENERS_MASK;
+    uint_t i;
+    SealNetListener_t *l;
+
+    if (!free) {
+        DPRINTF("sealNetRegisterInterest: all full!\n");
+        return NULL;
+    }
+    i = lowestBit32(free);
+    l = listeners + i;
+    l->maskIndex = maskIndex;
+    l->typeMask = typeMask;
+    usedListeners |= 1ul << i;
+    if (typeMask) {
+        listenersByCode[listenerLowestCode(l)] |= 1ul << i;
+    }
+    return l;
+}
+
+static void listenerRemove(SealNetListener_t *l)
+{
+    uint_t i = l - listeners;
+    l->callback.sv = NULL;
+    usedListeners &= ~(1ul << i);
+    if (l->typeMask) {
+        listenersByCode[listenerLowestCode(l)] &= ~(1ul << i);
+    }
 }
 
 bool sealNetPacketRegisterInterest(uint32_t typeMask,
                                     MultiValueCallbackFunction callback,
                                     int32_t *buffer)
 {
-    for_all_listeners(
-            if (l->callback.mv == NULL) {
-                l->callback.mv = callback;
-                l->typeMask = typeMask;
-                l->u.buffer = buffer;
-                return true;
-            });
-    DPRINTF("sealNetRegisterInterest: all full!\n");
-    return false;
+    ASSERT(!(typeMask & SEAL_TYPEMASK_EXTENSION));
+    SealNetListener_t *l = listenerAdd(0, typeMask);
+    if (!l) return false;
+    l->callback.mv = callback;
+    l->u.buffer = buffer;
+    return true;
 }
 
 bool sealNetRegisterInterest(uint16_t code,
                              SingleValueCallbackFunction callback)
 {
-    for_all_listeners(
-            if (l->callback.sv == NULL) {
-                l->callback.sv = callback;
-                l->typeMask = 1ul << code;
-                l->u.buffer = NULL;
-                return true;
-            });
-    DPRINTF("sealNetRegisterInterest: all full!\n");
-    return false;
+    ASSERT(code < SEAL_MAX_FIELD_CODES);
+    SealNetListener_t *l = listenerAdd(code / SEAL_TYPEMASK_CODES,
+            1ul << (code % SEAL_TYPEMASK_CODES));
+    if (!l) return false;
+    l->callback.sv = callback;
+    l->u.buffer = NULL;
+    return true;
 }
 
 bool sealNetPacketUnregisterInterest(uint32_t typeMask,
                                       MultiValueCallbackFunction callback)
 {
     for_all_listeners(
-            if (l->typeMask == typeMask && l->callback.mv == callback) {
-                l->callback.sv = NULL;
+            if (l->maskIndex == 0 && l->typeMask == typeMask
+                    && l->callback.mv == callback) {
+                listenerRemove(l);
                 return true;
             });
     DPRINTF("sealNetUnregisterInterest: not found!\n");
@@ -216,10 +381,12 @@ bool sealNetPacketUnregisterInterest(uint32_t typeMask,
 bool sealNetUnregisterInterest(uint16_t code,
                                 SingleValueCallbackFunction callback)
 {
-    uint32_t typeMask = 1ul << code;
+    uint8_t maskIndex = code / SEAL_TYPEMASK_CODES;
+    uint32_t typeMask = 1ul << (code % SEAL_TYPEMASK_CODES);
     for_all_listeners(
-            if (l->typeMask == typeMask && l->callback.sv == callback) {
-                l->callback.sv = NULL;
+            if (l->maskIndex == maskIndex && l->typeMask == typeMask
+                    && l->callback.sv == callback) {
+                listenerRemove(l);
                 return true;
             });
     DPRINTF("sealNetUnregisterInterest: not found!\n");
@@ -232,30 +399,254 @@ void sealNetPacketStart(SealPacket_t *buffer)
     packetInProgress->header.magic = SEAL_MAGIC;
     packetInProgress->header.typeMask = 0;
     packetInProgressNumFields = 0;
+    packetInProgressNumMasks = 1;
 }
 
 void sealNetPacketAddField(uint16_t code, int32_t value)
 {
     ASSERT(packetInProgress);
-    ASSERT(code < 31); // XXX TODO: add support for larger codes
+    ASSERT(code < SEAL_MAX_FIELD_CODES);
+
+    uint8_t *masks = (uint8_t *) &packetInProgress->header.typeMask;
+    uint8_t maskIndex = code / SEAL_TYPEMASK_CODES;
+    uint32_t typeMask;
+
+    if (maskIndex >= packetInProgressNumMasks) {
+        // chain more typemasks: move the values to make room for them
+        uint8_t added = maskIndex + 1 - packetInProgressNumMasks;
+        uint8_t *values = masks + packetInProgressNumMasks * sizeof(typeMask);
+        memmove(values + added * sizeof(typeMask), values,
+                packetInProgressNumFields * sizeof(value));
+        while (packetInProgressNumMasks <= maskIndex) {
+            memcpy(&typeMask, masks + (packetInProgressNumMasks - 1) * sizeof(typeMask),
+                    sizeof(typeMask));
+            typeMask |= SEAL_TYPEMASK_EXTENSION;
+            memcpy(masks + (packetInProgressNumMasks - 1) * sizeof(typeMask),
+                    &typeMask, sizeof(typeMask));
+            memset(masks + packetInProgressNumMasks * sizeof(typeMask), 0, sizeof(typeMask));
+            packetInProgressNumMasks++;
+        }
+    }
 
-    packetInProgress->header.typeMask |= (1ul << code);
-    memcpy(packetInProgress->fields + packetInProgressNumFields, &value, sizeof(value));
+    memcpy(&typeMask, masks + maskIndex * sizeof(typeMask), sizeof(typeMask));
+    typeMask |= 1ul << (code % SEAL_TYPEMASK_CODES);
+    memcpy(masks + maskIndex * sizeof(typeMask), &typeMask, sizeof(typeMask));
+
+    memcpy(masks + packetInProgressNumMasks * sizeof(typeMask)
+            + packetInProgressNumFields * sizeof(value), &value, sizeof(value));
     packetInProgressNumFields++;
 }
 
+static void sealSend(const void *data, uint16_t length)
+{
+#if USE_NET
+    socketSend(&socket, data, length);
+#else
+    radioSend(data, length);
+#endif
+}
+
+#if SEAL_AGGREGATION_DELAY
+
+// the worst-case size of a record in the aggregated packet
+#define AGGREGATE_RECORD_SIZE(bodyLength) \
+    (sizeof(uint16_t) + VARINT_MAX_SIZE + 1 + (bodyLength))
+
+// the caller must hold aggregateMutex
+static void aggregateFlushLocked(void)
+{
+    uint16_t length;
+    uint16_t crc;
+    Handle_t h;
+
+    ATOMIC_START(h);
+    length = aggregateLength;
+    memcpy(aggregateSendBuffer, aggregateBuffer, length);
+    if (length) alarmRemove(&aggregateTimer);
+    aggregateLength = 0;
+    aggregateTimeout = false;
+    ATOMIC_END(h);
+
+    if (!length) return;
+    crc = crc16(aggregateSendBuffer + 4, length - 4);
+    memcpy(aggregateSendBuffer + 2, &crc, sizeof(crc));
+    sealSend(aggregateSendBuffer, length);
+}
+
+// append a record (typemask(s) + values) if there is room for it;
+// call with interrupts disabled
+static bool aggregateAppend(uint16_t source, uint32_t time,
+                            const uint8_t *body, uint16_t bodyLength)
+{
+    uint32_t delta;
+    uint8_t *p;
+
+    if (aggregateLength && aggregateLength + AGGREGATE_RECORD_SIZE(bodyLength)
+            > SEAL_AGGREGATE_MAX_SIZE) {
+        return false;
+    }
+
+    if (!aggregateLength) {
+        SealAggregateHeader_t h;
+        h.magic = SEAL_AGGREGATE_MAGIC;
+        h.crc = 0;
+        h.baseTime = time;
+        memcpy(aggregateBuffer, &h, sizeof(h));
+        aggregateLength = sizeof(h);
+        aggregateLastTime = time;
+        // bound the latency of the first (and so all) records
+        alarmSchedule(&aggregateTimer, SEAL_AGGREGATION_DELAY);
+    }
+
+    // records forwarded from other motes may come slightly out of order
+    delta = timeAfter32(time, aggregateLastTime) ? time - aggregateLastTime : 0;
+    aggregateLastTime += delta;
+
+    p = aggregateBuffer + aggregateLength;
+    memcpy(p, &source, sizeof(source));
+    p += sizeof(source);
+    p = varintEncode(p, delta);
+    *p++ = (uint8_t) bodyLength;
+    memcpy(p, body, bodyLength);
+    p += bodyLength;
+    aggregateLength = p - aggregateBuffer;
+    return true;
+}
+
+// add a record from the user context, sending the packet out first
+// if the record does not fit in it; returns false if it can never fit
+static bool aggregateAdd(uint16_t source, uint32_t time,
+                         const uint8_t *body, uint16_t bodyLength)
+{
+    Handle_t h;
+    bool added;
+
+    if (sizeof(SealAggregateHeader_t) + AGGREGATE_RECORD_SIZE(bodyLength)
+            > SEAL_AGGREGATE_MAX_SIZE) {
+        return false;
+    }
+
+    mutexLock(&aggregateMutex);
+    for (;;) {
+        ATOMIC_START(h);
+        added = aggregateAppend(source, time, body, bodyLength);
+        ATOMIC_END(h);
+        if (added) break;
+        aggregateFlushLocked();
+    }
+    mutexUnlock(&aggregateMutex);
+    return true;
+}
+
+static void aggregateTimerCb(void *x)
+{
+    // alarm context: do not lock or send here
+    aggregateTimeout = true;
+    msleepCancel();
+}
+
+void sealNetAggregatePoll(void)
+{
+    if (aggregateTimeout) sealNetAggregateFlush();
+}
+
+void sealNetAggregateFlush(void)
+{
+    mutexLock(&aggregateMutex);
+    aggregateFlushLocked();
+    mutexUnlock(&aggregateMutex);
+}
+
+// walk the records of an aggregated packet; appends them if 'append' is set,
+// returns their worst-case size in the buffer
+static uint16_t forwardRecords(const uint8_t *data, uint16_t length, bool append)
+{
+    SealAggregateHeader_t ah;
+    const uint8_t *p = data + sizeof(ah);
+    const uint8_t *end = data + length;
+    uint16_t size = 0;
+    uint32_t time;
+
+    memcpy(&ah, data, sizeof(ah));
+    time = ah.baseTime;
+    while (p + sizeof(uint16_t) < end) {
+        uint32_t delta;
+        uint8_t recordLength;
+        uint16_t recordSrc;
+        memcpy(&recordSrc, p, sizeof(recordSrc));
+        p = varintDecode(p + sizeof(recordSrc), end, &delta);
+        if (!p || p >= end) break;
+        recordLength = *p++;
+        if (p + recordLength > end) break;
+        time += delta;
+        size += AGGREGATE_RECORD_SIZE(recordLength);
+        if (append) aggregateAppend(recordSrc, time, p, recordLength);
+        p += recordLength;
+    }
+    return size;
+}
+
+//
+// Called from the routing code in the kernel thread (or an interrupt):
+// the records are only queued here, without locking or sending.
+// If they do not fit, the packet is forwarded as it is, and the
+// aggregated one is sent out by the next sealNetAggregatePoll().
+//
+bool sealNetAggregateForward(uint16_t source, const uint8_t *data, uint16_t length)
+{
+    SealHeader_t h;
+    uint16_t size;
+    bool added = false;
+    Handle_t handle;
+
+    if (length < sizeof(h)) return false;
+    memcpy(&h, data, sizeof(h));
+    if (h.crc != crc16(data + 4, length - 4)) return false;
+
+    if (h.magic == SEAL_MAGIC) {
+        size = AGGREGATE_RECORD_SIZE(length - 4);
+    } else if (h.magic == SEAL_AGGREGATE_MAGIC && length >= sizeof(SealAggregateHeader_t)) {
+        // re-aggregate the records one by one
+        size = forwardRecords(data, length, false);
+    } else {
+        return false;
+    }
+
+    ATOMIC_START(handle);
+    if ((aggregateLength ? aggregateLength : sizeof(SealAggregateHeader_t))
+            + size <= SEAL_AGGREGATE_MAX_SIZE) {
+        if (h.magic == SEAL_MAGIC) {
+            aggregateAppend(source, getSyncTimeMs(), data + 4, length - 4);
+        } else {
+            forwardRecords(data, length, true);
+        }
+        added = true;
+    } else if (aggregateLength) {
+        // make room for the next ones
+        aggregateTimeout = true;
+        msleepCancel();
+    }
+    ATOMIC_END(handle);
+    return added;
+}
+
+#endif // SEAL_AGGREGATION_DELAY
+
 void sealNetPacketFinish(void)
 {
     ASSERT(packetInProgress);
-    uint16_t length = 8 + packetInProgressNumFields * 4;
-    packetInProgress->header.crc = 
-            crc16((const uint8_t *) packetInProgress + 4, length - 4);
+    uint16_t length = 4 + packetInProgressNumMasks * 4 + packetInProgressNumFields * 4;
 
-#if USE_NET
-    socketSend(&socket, packetInProgress, length);
-#else
-    radioSend(packetInProgress, length);
+#if SEAL_AGGREGATION_DELAY
+    if (aggregateAdd(localAddress, getSyncTimeMs(),
+                    (const uint8_t *) packetInProgress + 4, length - 4)) {
+        return;
+    }
 #endif
+
+    packetInProgress->header.crc = 
+            crc16((const uint8_t *) packetInProgress + 4, length - 4);
+    sealSend(packetInProgress, length);
 }
 
 void sealNetSendValue(uint16_t code, int32_t value)
@@ -269,23 +660,24 @@ void sealNetSendValue(uint16_t code, int32_t value)
 int32_t sealNetReadValue(uint16_t code) 
 {
     ASSERT(listenerBeingProcessed);
-    ASSERT(listenerBeingProcessed->typeMask & (1ul << code));
+    ASSERT(listenerBeingProcessed->maskIndex == code / SEAL_TYPEMASK_CODES);
+
+    uint_t bit = code % SEAL_TYPEMASK_CODES;
+    ASSERT(listenerBeingProcessed->typeMask & (1ul << bit));
 
-    int32_t *read;
     if (isSingleValued(listenerBeingProcessed)) {
-        read = &listenerBeingProcessed->u.lastValue;
-    } else {
-        read = listenerBeingProcessed->u.buffer;
+        return listenerBeingProcessed->u.lastValue;
     }
-    uint32_t bit;
-    for (bit = 1; bit; bit <<= 1) {
-        if (bit == 1ul << code) {
-            return *read;
-        }
-        if (listenerBeingProcessed->typeMask & bit) {
-            read++;
-        }
-    }
-    ASSERT(false);
-    return 0;
+    return listenerBeingProcessed->u.buffer[
+            bitCount32(listenerBeingProcessed->typeMask & LOWER_BITS(bit))];
+}
+
+uint16_t sealNetReadSource(void)
+{
+    return recordSource;
+}
+
+uint32_t sealNetReadTimestamp(void)
+{
+    return recordTimestamp;
 }
@@ -40,6 +40,24 @@
 #define SEAL_DATA_PORT 123
 #endif
 
+//! The max time (milliseconds) a record is kept in the aggregation buffer
+/// (see sealNetAggregatePoll()).
+/// Zero disables aggregation: each SEAL packet is sent separately
+#ifndef SEAL_AGGREGATION_DELAY
+#define SEAL_AGGREGATION_DELAY 0
+#endif
+
+//! The max size of an aggregated SEAL packet (must fit in a radio frame with MAC header)
+#ifndef SEAL_AGGREGATE_MAX_SIZE
+#define SEAL_AGGREGATE_MAX_SIZE 96
+#endif
+
+//! Forward received SEAL packets to the serial port, framed for the base
+/// station gateway (tools/gateway): '$' 'S' length(2, big endian) source(2) packet
+#ifndef SEAL_FORWARD_TO_SERIAL
+#define SEAL_FORWARD_TO_SERIAL 0
+#endif
+
 //
 // Some default field codes (also defined in file seal/components.py).
 // All codes belong pseudo sensors. Real sensor codes follow,
@@ -59,6 +77,22 @@
 #define ADDRESS_TYPE_MASK   (1 << PACKET_FIELD_ID_ADDRESS)
 #define ISSENT_TYPE_MASK    (1 << PACKET_FIELD_ID_IS_SENT)
 
+//
+// A typemask holds 31 field codes; bit 31 is set when another typemask
+// (for the next 31 codes) follows. Field values follow the last typemask,
+// in ascending order of their codes.
+//
+#define SEAL_TYPEMASK_CODES     31
+#define SEAL_TYPEMASK_EXTENSION (1ul << 31)
+
+//! The max number of chained typemasks processed (higher field codes are ignored)
+#ifndef SEAL_MAX_TYPEMASKS
+#define SEAL_MAX_TYPEMASKS 2
+#endif
+
+//! The number of different field codes supported
+#define SEAL_MAX_FIELD_CODES (SEAL_TYPEMASK_CODES * SEAL_MAX_TYPEMASKS)
+
 //! Each SEAL packet must have this header; data fields (if any) follow it.
 struct SealHeader_s {
     uint16_t magic;
@@ -67,6 +101,31 @@ struct SealHeader_s {
 } PACKED;
 typedef struct SealHeader_s SealHeader_t;
 
+//! The magic code at start of aggregated SEAL packets (several records in one frame)
+#ifndef SEAL_AGGREGATE_MAGIC
+#define SEAL_AGGREGATE_MAGIC 0x5EA2
+#endif
+
+//
+// Aggregated packet format:
+// +--------+--------+-----------+--------+-----+--------+
+// | magic  | crc    | base time | record | ... | record |
+// +--------+--------+-----------+--------+-----+--------+
+// Each record:
+// +---------+---------------------+--------+-----------------------------+
+// | source  | time delta (varint) | length | typemask(s) + field values  |
+// +---------+---------------------+--------+-----------------------------+
+// The time delta is in milliseconds, relative to the previous record
+// (or to the base time for the first record). The record body is
+// the same as in a plain SEAL packet, without magic and crc.
+//
+struct SealAggregateHeader_s {
+    uint16_t magic;
+    uint16_t crc;
+    uint32_t baseTime;
+} PACKED;
+typedef struct SealAggregateHeader_s SealAggregateHeader_t;
+
 //! SEAL data packet
 struct SealPacket_s {
     SealHeader_t header;
@@ -110,7 +169,9 @@ bool sealNetUnregisterInterest(uint16_t code,
 void sealNetPacketStart(SealPacket_t *buffer);
 
 //
-// Add a value to SEAL packet
+// Add a value to SEAL packet. The values must be added in ascending order
+// of their codes. For codes above 30 an extra typemask is inserted
+// in the packet, so the buffer must have room for it.
 //
 void sealNetPacketAddField(uint16_t code, int32_t value);
 
@@ -137,6 +198,43 @@ static inline void sealNetSendCommand(uint16_t command)
 //
 int32_t sealNetReadValue(uint16_t code);
 
+//
+// Read the originator address of the record being processed.
+// Valid in listener callbacks only.
+//
+uint16_t sealNetReadSource(void);
+
+//
+// Read the time (sync time, in milliseconds) of the record being processed.
+// For aggregated records this is the time when the record was created,
+// otherwise the time of reception. Valid in listener callbacks only.
+//
+uint32_t sealNetReadTimestamp(void);
+
+#if SEAL_AGGREGATION_DELAY
+//
+// Add a SEAL packet received from another mote to the aggregation buffer
+// (instead of forwarding it as is). Returns false if the packet cannot be
+// aggregated; the caller should then forward it as usual.
+// Safe to call from the kernel thread: it never locks or sends.
+//
+bool sealNetAggregateForward(uint16_t source, const uint8_t *data, uint16_t length);
+
+//
+// Send out the aggregated packet immediately, if there is one
+//
+void sealNetAggregateFlush(void);
+
+//
+// Send out the aggregated packet if its delay has expired.
+// The delay is tracked by an alarm, but the packet is sent from here,
+// so call this from the application (user) context after each msleep():
+// the alarm cuts the sleep short with msleepCancel().
+// Seal-generated applications do this in their main loop.
+//
+void sealNetAggregatePoll(void);
+#endif
+
 // ----------------------------------
 // System & private API
 
@@ -145,6 +243,7 @@ void sealNetInit(void);
 //! SEAL networking packet subscriber
 typedef struct SealNetListener_s {
     uint32_t typeMask;
+    uint8_t maskIndex; // the number of the typemask in the packet this mask refers to
     union {
         SingleValueCallbackFunction sv;
         MultiValueCallbackFunction mv;
@@ -161,5 +260,8 @@ typedef struct SealNetListener_s {
 #ifndef MAX_SEAL_LISTENERS
 #define MAX_SEAL_LISTENERS 32
 #endif
+#if MAX_SEAL_LISTENERS > 32
+#error MAX_SEAL_LISTENERS must not be larger than 32
+#endif
 
 #endif
@@ -58,6 +58,8 @@ void initPlatform(void);
 #define SERIAL_COUNT 1
 // use the only "USART" for PRINTF
 #define PRINTF_SERIAL_ID 0
+// serialSendData() and serialSendString() are implemented in usart_hal.c
+#define SERIAL_HAS_BULK_SEND 1
 
 // SD card ID
 #define SDCARD_SPI_ID 0
@@ -80,7 +80,7 @@ bool processLedCommand(bool set, uint8_t oidLen, SmpOid_t oid,
         }
     }
     response->type = ST_OCTET;
-    arg->u.uint8 = ledsGet() & (1 << led);
+    response->u.uint8 = (ledsGet() & (1 << led)) ? 1 : 0;
     return true;
 }
 
@@ -204,3 +204,29 @@ bool processCommand(bool set, uint8_t command, uint8_t oidLen, SmpOid_t oid,
 
     return false;
 }
+
+// leaf OIDs handled by processCommand(), used for walks
+typedef struct {
+    uint8_t len;
+    uint8_t oid[3];
+} SmpLeafOid_t;
+
+static const SmpLeafOid_t leafOids[] = {
+    {2, {SMP_MOS, SMP_RES_TYPE}},
+    {2, {SMP_MOS, SMP_RES_ADDRESS}},
+    {2, {SMP_MOS, SMP_RES_IEEE_ADDRESS}},
+    {3, {SMP_MOS, SMP_RES_LED, SMP_LED_RED}},
+    {3, {SMP_MOS, SMP_RES_LED, SMP_LED_GREEN}},
+    {3, {SMP_MOS, SMP_RES_LED, SMP_LED_BLUE}},
+    {3, {SMP_MOS, SMP_RES_SENSOR, SMP_SENSOR_TSR}},
+    {3, {SMP_MOS, SMP_RES_SENSOR, SMP_SENSOR_PAR}},
+    {3, {SMP_MOS, SMP_RES_SENSOR, SMP_SENSOR_VOLTAGE}},
+    {3, {SMP_MOS, SMP_RES_SENSOR, SMP_SENSOR_HUMIDITY}},
+    {3, {SMP_MOS, SMP_RES_SENSOR, SMP_SENSOR_TEMPERATURE}},
+};
+
+uint8_t smpGetLeafOid(uint8_t index, uint8_t *oid) {
+    if (index >= sizeof(leafOids) / sizeof(leafOids[0])) return 0;
+    memcpy(oid, leafOids[index].oid, leafOids[index].len);
+    return leafOids[index].len;
+}
@@ -54,6 +54,7 @@
 #include <delay.h>
 #include <random.h>
 #include <lib/codec/crc.h>
+#include <lib/codec/framer.h>
 #include <print.h>
 #include <leds.h>
 #include <stdarg.h>
@@ -194,44 +195,20 @@ void smpProxySendSmp(uint8_t *data, uint16_t length) {
 #endif
 }
 
-void serialReceive(uint8_t x) {
-    static uint8_t recvBuf[400];
-    static uint16_t symbolsRead;
-    static uint16_t expectedLen;
-    static enum {
-        READ_DELIMITER,
-        READ_LEN_BYTE1,
-        READ_LEN_BYTE2,
-        READ_DATA
-    } state = READ_DELIMITER;
-
-    switch (state) {
-    case READ_DELIMITER:
-        if (x == SERIAL_PACKET_DELIMITER) state = READ_LEN_BYTE1;
-        break;
-    case READ_LEN_BYTE1:
-        expectedLen = x << 8;
-        state = READ_LEN_BYTE2;
-        break;
-    case READ_LEN_BYTE2:
-        expectedLen |= x;
-        if (expectedLen == 0 || expectedLen > sizeof(recvBuf)) {
-            PRINTF("invalid packet length on serial port: %d\n", expectedLen);
-            expectedLen = 0;
-            state = READ_DELIMITER;
-        } else {
-            state = READ_DATA;
-        }
-        break;
-    case READ_DATA:
-        recvBuf[symbolsRead++] = x;
-        if (symbolsRead == expectedLen) {
-            smpProxyRecvSerial(recvBuf, symbolsRead);
-            state = READ_DELIMITER;
-            symbolsRead = 0;
-        }
-        break;
+// frame: delimiter, 2 byte length (big-endian), data
+static Framer_t serialFramer;
+static uint8_t recvBuf[2 + 400];
+
+static void serialFrameReceived(uint8_t *frame, uint16_t length) {
+    if (length <= 2) {
+        PRINTF("invalid packet length on serial port: 0\n");
+        return;
     }
+    smpProxyRecvSerial(frame + 2, length - 2);
+}
+
+void serialReceive(uint8_t x) {
+    framerFeedByte(&serialFramer, x);
 }
 
 #if !USE_MAC
@@ -249,7 +226,8 @@ void radioReceive(void) {
     uint8_t *p = buffer + 2;
     length -= 2;
 
-    uint16_t crc = be16Read(buffer);
+    // the same byte order as in radioSendHeader() calls
+    uint16_t crc = le16Read(buffer);
     if (crc != crc16(p, length)) {
         PRINTF("radioRecv: wrong CRC!");
         return;
@@ -280,6 +258,8 @@ void smpInit(void) {
     serialInit(SMP_SERIAL_ID, SMP_BAUDRATE, 0);
     serialEnableTX(SMP_SERIAL_ID);
     serialEnableRX(SMP_SERIAL_ID);
+    framerInitLength(&serialFramer, recvBuf, sizeof(recvBuf),
+            SERIAL_PACKET_DELIMITER, 0, 2, 0, serialFrameReceived);
     serialSetReceiveHandle(SMP_SERIAL_ID, serialReceive);
     serial[SMP_SERIAL_ID].function = SERIAL_FUNCTION_PRINT;
 
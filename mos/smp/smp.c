@@ -25,54 +25,160 @@
 #include <serial.h>
 #include <print.h>
 #include <string.h>
+#include <alarms.h>
 #include <net/address.h>
 
-void smpRecv(uint8_t *data, uint16_t recvLen) {
-    bool set = false;
-    uint8_t oid[MAX_OID_LEN];
-    uint8_t oidLen = 0;
-    uint8_t oidPrefixLen = 0;
+// size of the SMP_META_WALK_CURSOR varbind that ends a truncated response
+#define CURSOR_VARBIND_LEN (1 + 2 + 1 + 2)
 
-    static uint8_t sendBuffer[400];
-    uint8_t *response = sendBuffer + 1; // leave space for length at the beginning
-    uint16_t responseMaxLen = sizeof(sendBuffer) - 1;
+// max size of an encoded value (the type byte and 64-bit integer)
+#define MAX_VALUE_LEN (1 + 8)
 
-    SmpVariant_t arg = { .type = 0xFF };
-    SmpVariant_t resp;
+typedef struct {
+    uint8_t *response;       // current write position
+    uint16_t responseMaxLen; // free space, not counting the cursor varbind
+    uint16_t varbind;        // index of the next varbind
+    uint16_t cursor;         // varbinds already sent in previous responses
+    bool truncated;
+    uint32_t repeatInterval;
+    uint16_t repeatTimes;
+    bool repeatRequested;
+    uint8_t requestIdPos;    // the SMP_META_REQUEST_ID varbind in the request
+    uint8_t requestIdLen;    // (0 if none)
+} SmpContext_t;
 
-    uint8_t *p = data;
+typedef struct {
+    Alarm_t alarm;
+    uint32_t interval;
+    uint16_t timesLeft;      // 0 for unlimited
+    uint8_t length;          // 0 if the slot is free
+    uint8_t requestIdPos;    // see SmpContext_t
+    uint8_t requestIdLen;
+    uint8_t request[SMP_MAX_SUBSCRIPTION_LEN];
+} SmpSubscription_t;
 
-#ifdef DEBUG
-    // PRINTF("SMP recv quelque chose (%d bytes)\n", recvLen);
-    // debugHexdump(data, recvLen);
-#endif
+static SmpSubscription_t subscriptions[SMP_MAX_SUBSCRIPTIONS];
 
-    uint16_t packetLen = *p++;
+// the response buffer is shared, so requests are not processed concurrently
+static volatile bool busy;
 
-    // check packet length
-    // PRINTF("packetLen = %d", packetLen);
-    if (packetLen > recvLen) {
-        PRINTF("packetLen is longer than physical length (%d vs %d)\n",
-                packetLen, recvLen);
-        return;
+static bool variantToUint32(SmpVariant_t *value, uint32_t *result) {
+    switch (value->type) {
+    case ST_OCTET:
+        *result = value->u.uint8;
+        return true;
+    case ST_UINTEGER16:
+        *result = value->u.uint16;
+        return true;
+    case ST_INTEGER:
+    case ST_UINTEGER:
+        *result = value->u.uint32;
+        return true;
     }
+    return false;
+}
 
-    // check packet type
-    switch (*p) {
-    case SMP_PACKET_REQUEST:
+static void processMeta(SmpContext_t *ctx, bool set, uint8_t oidLen, uint8_t *oid,
+                        SmpVariant_t *arg) {
+    uint32_t value;
+    if (!set || oidLen != 2 || arg->type == 0xFF
+            || !variantToUint32(arg, &value)) {
+        PRINTF("ignoring meta command\n");
+        return;
+    }
+    switch (oid[1]) {
+    case SMP_META_REQUEST_ID:
+        // echo it back; not counted as a varbind, so that each part
+        // of a truncated response carries it
+        if (3 + 1 + 5 <= ctx->responseMaxLen) {
+            *ctx->response++ = SMP_ELEM_OID | 2;
+            *ctx->response++ = SMP_META;
+            *ctx->response++ = SMP_META_REQUEST_ID;
+            ctx->responseMaxLen -= 3;
+            encodeVariant(&ctx->response, &ctx->responseMaxLen, arg);
+        }
         break;
-    case SMP_PACKET_RESPONSE:
-        PRINTF("ignoring SMP response packet\n");
+    case SMP_META_REPEAT_INTERVAL:
+        ctx->repeatInterval = value;
+        ctx->repeatRequested = true;
+        break;
+    case SMP_META_REPEAT_TIMES:
+        ctx->repeatTimes = value;
+        break;
+    case SMP_META_WALK_CURSOR:
+        ctx->cursor = value;
+        break;
+    }
+}
+
+// process a single GET or SET command and append the varbind to the response
+static void processVarbind(SmpContext_t *ctx, bool set, uint8_t oidLen, uint8_t *oid,
+                           SmpVariant_t *arg) {
+    SmpVariant_t resp;
+    uint8_t *p = ctx->response;
+
+    if (ctx->truncated) return;
+    // already sent in a previous response?
+    if (ctx->varbind < ctx->cursor) {
+        ctx->varbind++;
         return;
-    default:
-        PRINTF("unrecognized SMP packet type %d\n", *p);
+    }
+    // check before processing, so that nothing is executed twice
+    if (1 + oidLen + MAX_VALUE_LEN > ctx->responseMaxLen) {
+        // continue from this one in the next response
+        ctx->truncated = true;
+        return;
+    }
+    ctx->varbind++;
+
+    if (!processCommand(set, oid[1], oidLen - 2, oid + 2, arg, &resp)) {
         return;
     }
-    ++p;
 
-    // prepare response packet
-    *response++ = SMP_PACKET_RESPONSE;
-    responseMaxLen--;
+    *p++ = SMP_ELEM_OID | oidLen;
+    memcpy(p, oid, oidLen);
+    p += oidLen;
+    ctx->responseMaxLen -= 1 + oidLen;
+    if (encodeVariant(&p, &ctx->responseMaxLen, &resp)) {
+        return;
+    }
+    ctx->response = p;
+}
+
+// GET all known leaf OIDs that start with the given one
+static void processWalk(SmpContext_t *ctx, uint8_t oidLen, uint8_t *oid) {
+    uint8_t leaf[MAX_OID_LEN];
+    uint8_t leafLen;
+    uint8_t i;
+
+    for (i = 0; (leafLen = smpGetLeafOid(i, leaf)) != 0; ++i) {
+        if (leafLen < oidLen || memcmp(leaf, oid, oidLen)) continue;
+        processVarbind(ctx, false, leafLen, leaf, NULL);
+        if (ctx->truncated) break;
+    }
+}
+
+static void subscribe(SmpContext_t *ctx, uint8_t *data, uint16_t packetLen);
+
+static void processPacket(uint8_t *data, uint16_t packetLen, bool repeated) {
+    bool set = false;
+    bool walk = (data[1] == SMP_PACKET_WALK);
+    uint8_t oid[MAX_OID_LEN];
+    uint8_t oidLen = 0;
+    uint8_t oidPrefixLen = 0;
+    uint8_t *oidElement = NULL;
+
+    static uint8_t sendBuffer[SMP_MAX_RESPONSE_LEN];
+    SmpContext_t ctx;
+
+    SmpVariant_t arg = { .type = 0xFF };
+
+    uint8_t *p = data + 2;
+
+    memset(&ctx, 0, sizeof(ctx));
+    // leave space for length and type at the beginning
+    ctx.response = sendBuffer + 2;
+    ctx.responseMaxLen = sizeof(sendBuffer) - 2 - CURSOR_VARBIND_LEN;
 
     // parse the received packet
     for (; p < data + packetLen; ++p) {
@@ -99,23 +205,20 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
         case SMP_ELEM_OID_PREFIX:
             // PRINTF("SMP_ELEM_OID\n");
             len = *p & 0x3F;
-            if (packetLen < len + 1) {
+            if (p + len >= data + packetLen) {
                 PRINTF("element length too large %d, packetLen=%d\n", len, packetLen);
                 return;
             }
-            // include same field in response
-            memcpy(response, p, len + 1);
-            response += len + 1;
-            responseMaxLen -= len + 1;
 
             if ((*p & 0xc0) == SMP_ELEM_OID) {
                 // whole OID
-                if (oidPrefixLen + oidLen > MAX_OID_LEN) {
+                if (oidPrefixLen + len > MAX_OID_LEN) {
                     PRINTF("OID too long\n");
                     return;
                 }
                 memcpy(oid + oidPrefixLen, p + 1, len);
                 oidLen = len + oidPrefixLen;
+                oidElement = p;
 
                 if (!set) doProcess = true;
             } else {
@@ -129,9 +232,13 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
 
         case SMP_ELEM_VALUE:
             // PRINTF("SMP_ELEM_VALUE\n");
-            if (decodeVariant(&p, (uint16_t *) &packetLen, &arg)) {
-                return;
+            {
+                uint16_t maxLen = data + packetLen - p;
+                if (decodeVariant(&p, &maxLen, &arg)) {
+                    return;
+                }
             }
+            --p; // the loop moves to the next element
             doProcess = true;
             break;
         }
@@ -140,32 +247,172 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
 
         // PRINTF("process a command\n");
 
-        // process the command and write reply
-        do {
-            if (oidLen < 2) {
-                PRINTF("ignoring command, oid too short\n");
-                break;
-            }
-            if (oid[0] != SMP_MOS) {
-                PRINTF("ignoring command for unknown oid[0]=0x%x\n", oid[0]);
-                break;
-            }
-            if (!processCommand(set, oid[1], oidLen - 2, oid + 2, &arg, &resp)) {
-                break;
-            }
-            if (encodeVariant(&response, &responseMaxLen, &resp)) {
-                return;
+        if (oidLen >= 2 && oid[0] == SMP_META) {
+            if (oidLen == 2 && oid[1] == SMP_META_REQUEST_ID && oidElement) {
+                // remember where it is, to compare subscription requests without it
+                ctx.requestIdPos = oidElement - data;
+                ctx.requestIdLen = p + 1 - oidElement;
             }
-        } while (false);
+            processMeta(&ctx, set, oidLen, oid, &arg);
+        } else if (oidLen < 1 || oid[0] != SMP_MOS) {
+            PRINTF("ignoring command for unknown oid\n");
+        } else if (walk && !set) {
+            processWalk(&ctx, oidLen, oid);
+        } else if (oidLen < 2) {
+            PRINTF("ignoring command, oid too short\n");
+        } else {
+            processVarbind(&ctx, set, oidLen, oid, arg.type == 0xFF ? NULL : &arg);
+        }
 
         arg.type = 0xFF;
     }
 
+    if (ctx.truncated) {
+        // tell where to continue
+        SmpVariant_t cursor;
+        uint16_t maxLen = CURSOR_VARBIND_LEN;
+        cursor.type = ST_UINTEGER16;
+        cursor.u.uint16 = ctx.varbind;
+        *ctx.response++ = SMP_ELEM_OID | 2;
+        *ctx.response++ = SMP_META;
+        *ctx.response++ = SMP_META_WALK_CURSOR;
+        maxLen -= 3;
+        encodeVariant(&ctx.response, &maxLen, &cursor);
+    }
+
+    if (ctx.repeatRequested && !repeated) {
+        subscribe(&ctx, data, packetLen);
+    }
+
     {
-        // encode response length in send buffer (255 byte length supported!)
-        uint8_t responseLen = response - sendBuffer;
+        uint8_t responseLen = ctx.response - sendBuffer;
         sendBuffer[0] = responseLen;
+        sendBuffer[1] = SMP_PACKET_RESPONSE;
         // send response packet
         smpProxySendSmp(sendBuffer, responseLen);
     }
 }
+
+static void repeatAlarmCallback(void *param) {
+    SmpSubscription_t *s = (SmpSubscription_t *) param;
+
+    if (busy) {
+        // try again a bit later
+        alarmSchedule(&s->alarm, 10);
+        return;
+    }
+    busy = true;
+    processPacket(s->request, s->length, true);
+    busy = false;
+
+    if (s->timesLeft && --s->timesLeft == 0) {
+        s->length = 0;
+        return;
+    }
+    alarmSchedule(&s->alarm, s->interval);
+}
+
+// is it the same request, apart from the request IDs (and the length byte)?
+static bool isSameRequest(SmpSubscription_t *s, SmpContext_t *ctx,
+                          uint8_t *data, uint16_t packetLen) {
+    uint8_t idEnd, newIdEnd;
+    if (!s->length || s->length - s->requestIdLen != packetLen - ctx->requestIdLen) {
+        return false;
+    }
+    if (!s->requestIdLen || !ctx->requestIdLen) {
+        return s->requestIdLen == ctx->requestIdLen
+                && !memcmp(s->request + 1, data + 1, packetLen - 1);
+    }
+    if (s->requestIdPos != ctx->requestIdPos) return false;
+    idEnd = s->requestIdPos + s->requestIdLen;
+    newIdEnd = ctx->requestIdPos + ctx->requestIdLen;
+    return !memcmp(s->request + 1, data + 1, s->requestIdPos - 1)
+            && !memcmp(s->request + idEnd, data + newIdEnd, s->length - idEnd);
+}
+
+static void subscribe(SmpContext_t *ctx, uint8_t *data, uint16_t packetLen) {
+    uint8_t i;
+    SmpSubscription_t *s = NULL;
+
+    if (ctx->repeatInterval == 0) {
+        PRINTF("cancel all subscriptions\n");
+        for (i = 0; i < SMP_MAX_SUBSCRIPTIONS; ++i) {
+            alarmRemove(&subscriptions[i].alarm);
+            subscriptions[i].length = 0;
+        }
+        return;
+    }
+    if (ctx->repeatTimes == 1) {
+        // already sent once
+        return;
+    }
+    if (packetLen > SMP_MAX_SUBSCRIPTION_LEN) {
+        PRINTF("request too long for subscription\n");
+        return;
+    }
+
+    for (i = 0; i < SMP_MAX_SUBSCRIPTIONS; ++i) {
+        // the same request replaces the old subscription
+        if (isSameRequest(&subscriptions[i], ctx, data, packetLen)) {
+            s = &subscriptions[i];
+            break;
+        }
+        if (!s && !subscriptions[i].length) s = &subscriptions[i];
+    }
+    if (!s) {
+        PRINTF("too many subscriptions\n");
+        return;
+    }
+
+    alarmRemove(&s->alarm);
+    memcpy(s->request, data, packetLen);
+    s->length = packetLen;
+    s->requestIdPos = ctx->requestIdPos;
+    s->requestIdLen = ctx->requestIdLen;
+    s->timesLeft = ctx->repeatTimes ? ctx->repeatTimes - 1 : 0;
+    alarmInit(&s->alarm, repeatAlarmCallback, s);
+    s->interval = ctx->repeatInterval;
+    alarmSchedule(&s->alarm, ctx->repeatInterval);
+}
+
+void smpRecv(uint8_t *data, uint16_t recvLen) {
+#ifdef DEBUG
+    // PRINTF("SMP recv quelque chose (%d bytes)\n", recvLen);
+    // debugHexdump(data, recvLen);
+#endif
+
+    uint16_t packetLen = data[0];
+
+    // check packet length
+    // PRINTF("packetLen = %d", packetLen);
+    if (packetLen > recvLen) {
+        PRINTF("packetLen is longer than physical length (%d vs %d)\n",
+                packetLen, recvLen);
+        return;
+    }
+    if (packetLen < 2) {
+        PRINTF("packet too short\n");
+        return;
+    }
+
+    // check packet type
+    switch (data[1]) {
+    case SMP_PACKET_REQUEST:
+    case SMP_PACKET_WALK:
+        break;
+    case SMP_PACKET_RESPONSE:
+        PRINTF("ignoring SMP response packet\n");
+        return;
+    default:
+        PRINTF("unrecognized SMP packet type %d\n", data[1]);
+        return;
+    }
+
+    if (busy) {
+        PRINTF("SMP busy, packet dropped\n");
+        return;
+    }
+    busy = true;
+    processPacket(data, packetLen, false);
+    busy = false;
+}
@@ -26,6 +26,31 @@
 
 #include <defines.h>
 
+//
+// Packet types.
+//
+// A request is a sequence of elements: commands, OIDs (optionally relative to
+// an OID prefix), and values. Each GET of an OID, and each SET of an OID
+// followed by a value, yields one OID + value pair ("varbind") in the response.
+//
+// A walk has the same format, but a GET of an OID returns all leaf OIDs under
+// it (as enumerated by smpGetLeafOid()), so a single packet can read
+// the whole status of a mote, e.g. "GET 1" for all MansOS resources.
+//
+// Responses are limited to SMP_MAX_RESPONSE_LEN bytes. When the varbinds do not
+// fit, the response ends with SMP_META_WALK_CURSOR set to the number of
+// varbinds already sent. To continue, repeat the packet with a SET of
+// SMP_META_WALK_CURSOR to that value in front of the first OID.
+//
+// Setting SMP_META_REPEAT_INTERVAL (in milliseconds) in a request subscribes
+// to it: the mote repeats the request with that period and pushes
+// the responses, SMP_META_REPEAT_TIMES times (if set) or until
+// a request with zero repeat interval cancels all subscriptions.
+//
+// A value set to SMP_META_REQUEST_ID is echoed back in the response (and in
+// pushed responses of the subscription), so that a client can match responses
+// to its outstanding requests.
+//
 typedef enum {
     SMP_PACKET_REQUEST,
     SMP_PACKET_RESPONSE,
@@ -44,6 +69,8 @@ typedef enum {
     SMP_META_TIMESTAMP,
     SMP_META_REPEAT_INTERVAL,
     SMP_META_REPEAT_TIMES,
+    SMP_META_WALK_CURSOR,
+    SMP_META_REQUEST_ID,
 
     TOTAL_SMP_META_OIDS,
 } SmpMetaId_e;
@@ -102,7 +129,23 @@ typedef enum {
     SMP_SENSOR_TEMPERATURE,
 } SmpSensorType_e;
 
-#define MAX_OID_LEN 64
+// the length of an OID element is a 6-bit field
+#define MAX_OID_LEN 63
+
+// max size of a response packet; small enough for a single radio packet
+#ifndef SMP_MAX_RESPONSE_LEN
+#define SMP_MAX_RESPONSE_LEN 120
+#endif
+
+// max number of concurrent repeat subscriptions
+#ifndef SMP_MAX_SUBSCRIPTIONS
+#define SMP_MAX_SUBSCRIPTIONS 2
+#endif
+
+// max size of a request that can be repeated
+#ifndef SMP_MAX_SUBSCRIPTION_LEN
+#define SMP_MAX_SUBSCRIPTION_LEN 48
+#endif
 
 typedef uint8_t *SmpOid_t;
 
@@ -145,6 +188,11 @@ void smpDebugPrint(const char *format, ...);
 bool processCommand(bool doSet, uint8_t command, uint8_t oidLen, SmpOid_t oid,
                     SmpVariant_t *arg, SmpVariant_t *response);
 
+// this function must be defined by application as well: copy the leaf OID
+// with the given index to 'oid' and return its length, or 0 when there are
+// no more leaves. Leaves must be returned in lexicographic order.
+uint8_t smpGetLeafOid(uint8_t index, uint8_t *oid);
+
 uint8_t encodeOctet(uint8_t **data, uint16_t *maxLen, uint8_t value);
 uint8_t encodeUint16(uint8_t **data, uint16_t *maxLen, uint16_t value);
 uint8_t encodeInt32(uint8_t **data, uint16_t *maxLen, int32_t value);
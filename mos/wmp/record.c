@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2013 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "record.h"
+#include <lib/byteorder.h>
+#include <string.h>
+
+static void writeIndex(RecordWriter_t *w, uint32_t now);
+static void reserve(RecordWriter_t *w, uint16_t length, uint32_t now);
+
+// the staging buffer is filled up to the end of the current file block
+static inline void resetBlock(RecordWriter_t *w)
+{
+    w->used = 0;
+    w->capacity = RECORD_BLOCK_SIZE - w->blockPosition % RECORD_BLOCK_SIZE;
+}
+
+void recordWriterOpen(RecordWriter_t *w, FILE *file, bool binary, uint32_t now)
+{
+    w->file = file;
+    w->binary = binary;
+    w->blockPosition = file->fileSize; // appending
+    w->schemaPosition = RECORD_NO_SCHEMA;
+    w->indexTime = now;
+    w->flushTime = now;
+    w->columnCount = 0;
+    resetBlock(w);
+    if (binary && w->capacity < RECORD_BLOCK_SIZE) {
+        // continuing a block of an earlier session: start a new time base
+        reserve(w, 9, now);
+        if (!w->used) writeIndex(w, now);
+    }
+}
+
+void recordFlush(RecordWriter_t *w)
+{
+    if (!w->used) return;
+    // a partial block is continued by the next write
+    fwrite(w->buffer, 1, w->used, w->file);
+    w->blockPosition += w->used;
+    resetBlock(w);
+}
+
+void recordWriterClose(RecordWriter_t *w)
+{
+    if (!w->file) return;
+    recordFlush(w);
+    fflush(w->file);
+    w->file = NULL;
+}
+
+static void writeIndex(RecordWriter_t *w, uint32_t now)
+{
+    uint8_t *p = w->buffer + w->used;
+    p[0] = RECORD_INDEX;
+    le32Write(p + 1, now);
+    le32Write(p + 5, w->schemaPosition);
+    w->used += 9;
+    w->indexTime = now;
+}
+
+// make space for a record of 'length' bytes
+static void reserve(RecordWriter_t *w, uint16_t length, uint32_t now)
+{
+    if (w->used + length > w->capacity) {
+        if (w->binary) {
+            // pad up to the block end; the record goes to the next block
+            memset(w->buffer + w->used, RECORD_PAD, w->capacity - w->used);
+            w->used = w->capacity;
+        }
+        recordFlush(w);
+    }
+    if (w->binary && (w->blockPosition + w->used) % RECORD_BLOCK_SIZE == 0) {
+        writeIndex(w, now);
+    }
+}
+
+static void afterWrite(RecordWriter_t *w, uint32_t now)
+{
+    if (w->used == w->capacity) {
+        recordFlush(w);
+    } else if (now - w->flushTime >= RECORD_FLUSH_PERIOD) {
+        recordFlush(w);
+        fflush(w->file);
+        w->flushTime = now;
+    }
+}
+
+void recordWriteSchema(RecordWriter_t *w, const RecordColumn_t *columns,
+                       uint8_t count, uint32_t now)
+{
+    uint16_t length = 3;
+    uint8_t *p;
+    uint8_t i;
+
+    if (count > RECORD_MAX_COLUMNS) count = RECORD_MAX_COLUMNS;
+    for (i = 0; i < count; i++) {
+        length += 3 + strlen(columns[i].name);
+    }
+    reserve(w, length, now);
+
+    w->schemaPosition = w->blockPosition + w->used;
+    p = w->buffer + w->used;
+    *p++ = RECORD_SCHEMA;
+    *p++ = RECORD_FORMAT_VERSION;
+    *p++ = count;
+    for (i = 0; i < count; i++) {
+        uint8_t nameLength = strlen(columns[i].name);
+        *p++ = columns[i].code;
+        *p++ = columns[i].type;
+        *p++ = nameLength;
+        memcpy(p, columns[i].name, nameLength);
+        p += nameLength;
+        w->columnTypes[i] = columns[i].type;
+    }
+    w->columnCount = count;
+    w->used += length;
+    afterWrite(w, now);
+}
+
+void recordWriteData(RecordWriter_t *w, const int32_t *values, uint32_t now)
+{
+    uint16_t length = 3;
+    uint8_t *p;
+    uint8_t i;
+
+    for (i = 0; i < w->columnCount; i++) {
+        length += w->columnTypes[i] & ~RECORD_TYPE_SIGNED;
+    }
+    // a new time base is needed if the time delta would not fit
+    // (reserving space may already start a new block with a new index)
+    reserve(w, now - w->indexTime > 0xffff ? length + 9 : length, now);
+    if (now - w->indexTime > 0xffff) writeIndex(w, now);
+
+    p = w->buffer + w->used;
+    *p++ = RECORD_DATA;
+    le16Write(p, now - w->indexTime);
+    p += 2;
+    for (i = 0; i < w->columnCount; i++) {
+        switch (w->columnTypes[i] & ~RECORD_TYPE_SIGNED) {
+        case 1:
+            *p = values[i];
+            break;
+        case 2:
+            le16Write(p, values[i]);
+            break;
+        default:
+            le32Write(p, values[i]);
+            break;
+        }
+        p += w->columnTypes[i] & ~RECORD_TYPE_SIGNED;
+    }
+    w->used += length;
+    afterWrite(w, now);
+}
+
+void recordWriteText(RecordWriter_t *w, const char *text, uint16_t length,
+                     uint32_t now)
+{
+    while (length) {
+        uint16_t chunk = MIN(length, w->capacity - w->used);
+        memcpy(w->buffer + w->used, text, chunk);
+        w->used += chunk;
+        text += chunk;
+        length -= chunk;
+        if (w->used == w->capacity) recordFlush(w);
+    }
+    // a complete line goes to the file right away, as it always did
+    if (w->used && w->buffer[w->used - 1] == '\n') recordFlush(w);
+    afterWrite(w, now);
+}
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MANSOS_WMP_RECORD_H
+#define MANSOS_WMP_RECORD_H
+
+/// \file
+/// Staged file writer with a compact binary record format
+///
+/// All output goes through a block-sized staging buffer, aligned to the
+/// block boundaries of the file, so the file system sees whole-sector
+/// writes instead of a small write per field. In text mode each line
+/// is passed to the file as soon as it is complete.
+///
+/// Binary files consist of RECORD_BLOCK_SIZE byte blocks (counted from
+/// the start of the file). Records never cross block boundaries. All
+/// numbers are little-endian. Staged data is also written out every
+/// RECORD_FLUSH_PERIOD seconds; a partially written block is continued
+/// by the next write. Record types:
+///
+///   'T' time index:  u32 time (s), u32 file offset of the schema in effect
+///                    (0xffffffff if none); starts every block
+///   'S' schema:      u8 version, u8 column count, then for each column:
+///                    u8 sensor code, u8 type, u8 name length, name
+///   'D' data:        u16 seconds since the last index, then one value
+///                    per column, as described by the column type
+///   0x00 padding:    the rest of the block is unused
+///
+/// Column type: size of the value in bytes, ORed with RECORD_TYPE_SIGNED.
+///
+/// tools/web/wmprecord.py converts the files to CSV.
+///
+
+#include <defines.h>
+#include <fatfs/posix-stdio.h>
+
+#define RECORD_FORMAT_VERSION 1
+
+#ifndef RECORD_BLOCK_SIZE
+#define RECORD_BLOCK_SIZE     512
+#endif
+
+#ifndef RECORD_MAX_COLUMNS
+#define RECORD_MAX_COLUMNS    16
+#endif
+
+//! Staged data is written out at least this often, seconds
+#ifndef RECORD_FLUSH_PERIOD
+#define RECORD_FLUSH_PERIOD   60
+#endif
+
+enum {
+    RECORD_PAD    = 0x00,
+    RECORD_INDEX  = 'T',
+    RECORD_SCHEMA = 'S',
+    RECORD_DATA   = 'D',
+};
+
+#define RECORD_TYPE_SIGNED  0x80
+#define RECORD_TYPE_U16     2
+#define RECORD_TYPE_I32     (4 | RECORD_TYPE_SIGNED)
+
+#define RECORD_NO_SCHEMA    0xffffffffu
+
+struct RecordColumn_s {
+    uint8_t code;
+    uint8_t type;
+    const char *name;
+};
+
+typedef struct RecordColumn_s RecordColumn_t;
+
+struct RecordWriter_s {
+    FILE *file;
+    uint32_t blockPosition;   // file offset of the staging buffer
+    uint32_t schemaPosition;  // file offset of the current schema record
+    uint32_t indexTime;       // time in the last index record
+    uint32_t flushTime;       // time of the last flush
+    uint16_t used;            // bytes in the staging buffer
+    uint16_t capacity;        // bytes up to the end of the block
+    bool binary;
+    uint8_t columnCount;
+    uint8_t columnTypes[RECORD_MAX_COLUMNS];
+    uint8_t buffer[RECORD_BLOCK_SIZE];
+};
+
+typedef struct RecordWriter_s RecordWriter_t;
+
+//! Start writing to an (opened for appending) file
+void recordWriterOpen(RecordWriter_t *w, FILE *file, bool binary, uint32_t now);
+
+//! Write out the staged data and detach from the file
+void recordWriterClose(RecordWriter_t *w);
+
+//! Write out the staged data
+void recordFlush(RecordWriter_t *w);
+
+//! Binary mode: start a new schema; the following data records use it
+void recordWriteSchema(RecordWriter_t *w, const RecordColumn_t *columns,
+                       uint8_t count, uint32_t now);
+
+//! Binary mode: write a data record with one value per schema column
+void recordWriteData(RecordWriter_t *w, const int32_t *values, uint32_t now);
+
+//! Text mode: write a string
+void recordWriteText(RecordWriter_t *w, const char *text, uint16_t length,
+                     uint32_t now);
+
+#endif
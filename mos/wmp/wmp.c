@@ -22,13 +22,16 @@
  */
 
 #include "wmp.h"
+#include "record.h"
 #include "stdmansos.h"
 #include <lib/byteorder.h>
 #include <lib/algo.h>
+#include <lib/codec/varint.h>
 #include <codec.h>
 #include <assert.h>
 #include <fatfs/fatfs.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <sdstream.h>
 #include <eeprom.h>
 #include <timing.h>
@@ -49,25 +52,30 @@ static FILE wmpFileBuffer;
 
 // -------------------------------------------------------
 
+//
+// Commands are received directly in this structure: the fields up to 'crc'
+// are laid out as on the wire. The crc byte is received right after
+// the arguments and is moved to 'crc' afterwards.
+//
 struct SerialPacket_s {
     uint8_t command;    // WMP command
-    uint8_t argLen;     // promised argument length
-    uint8_t argLenRead; // actual argument length read so far
+    uint8_t argLen;     // argument length
     uint8_t arguments[99];
-    uint8_t zero;
+    uint8_t zero;       // space for the received crc or a string terminator
     uint8_t crc;        // XOR of packet fields
 } PACKED;
 
 typedef struct SerialPacket_s SerialPacket_t;
 SerialPacket_t sp;
 
-static bool commandMode;
+static Framer_t wmpFramer;
 
 static bool wmpSerialOutputEnabled = true;
 static bool wmpSdCardOutputEnabled;
 static bool wmpFileOutputEnabled;
 static char wmpOutputFileName[13];
 static FILE *outputFile;
+static RecordWriter_t fileWriter;
 
 // the generic function type for reading sensors
 typedef int32_t (*WmpSensorReadFunction)(void);
@@ -76,6 +84,7 @@ typedef int32_t (*WmpSensorReadFunction)(void);
 typedef struct {
     WmpSensorType_t code;        // numerical code (NOT SEAL-compatible!)
     bool isRead;                 // whether is read in the last period
+    uint8_t recordType;          // column type in binary files (0: RECORD_TYPE_I32)
     const char *name;            // ASCII name of the sensor (SEAL-compatible)
     uint32_t period;             // set to 0 to disable reading
     int32_t lastReadValue;       // last reading value
@@ -139,12 +148,14 @@ int32_t wmpReadBattery(void) {
 static WmpSensor_t availableSensors[] = {
     {
         .code = WMP_SENSOR_LIGHT,
+        .recordType = RECORD_TYPE_U16,
         .name = "Light",
         .func = wmpReadLight,
     },
 #if USE_HUMIDITY
     {
         .code = WMP_SENSOR_HUMIDITY,
+        .recordType = RECORD_TYPE_U16,
         .name = "Humidity",
         .func = wmpReadHumidity,
     },
@@ -153,46 +164,55 @@ static WmpSensor_t availableSensors[] = {
     // support up to 8 ADC channels
     {
         .code = WMP_SENSOR_ADC0,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC0",
         .func = wmpReadADC0,
     },
     {
         .code = WMP_SENSOR_ADC1,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC0",
         .func = wmpReadADC1,
     },
     {
         .code = WMP_SENSOR_ADC2,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC2",
         .func = wmpReadADC2,
     },
     {
         .code = WMP_SENSOR_ADC3,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC3",
         .func = wmpReadADC3,
     },
     {
         .code = WMP_SENSOR_ADC4,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC4",
         .func = wmpReadADC4,
     },
     {
         .code = WMP_SENSOR_ADC5,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC5",
         .func = wmpReadADC5,
     },
     {
         .code = WMP_SENSOR_ADC6,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC6",
         .func = wmpReadADC6,
     },
     {
         .code = WMP_SENSOR_ADC7,
+        .recordType = RECORD_TYPE_U16,
         .name = "ADC7",
         .func = wmpReadADC7,
     },
     {
         .code = WMP_SENSOR_BATTERY,
+        .recordType = RECORD_TYPE_U16,
         .name = "Battery",
         .func = wmpReadBattery,
     }
@@ -201,39 +221,123 @@ static WmpSensor_t availableSensors[] = {
 
 // -------------------------------------------------------
 
-static void writeCsvFileRecord(void)
+// format a decimal number, return the length
+static uint8_t formatInt32(char *buffer, int32_t value)
 {
+    char digits[10];
+    uint32_t v = value < 0 ? -(uint32_t) value : (uint32_t) value;
+    uint8_t n = 0, length = 0;
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) buffer[length++] = '-';
+    while (n) buffer[length++] = digits[--n];
+    return length;
+}
+
+// file names with .bin extension select the binary record format
+static bool isBinaryFileName(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    return dot && (dot[1] | 0x20) == 'b' && (dot[2] | 0x20) == 'i'
+            && (dot[3] | 0x20) == 'n' && dot[4] == '\0';
+}
+
+static void openOutputFile(void)
+{
+    outputFile = fopenEx(wmpOutputFileName, "a", &wmpFileBuffer);
+    if (outputFile) {
+        recordWriterOpen(&fileWriter, outputFile,
+                isBinaryFileName(wmpOutputFileName), getSyncTimeSec());
+        csvFileFirstLinePending = true;
+    }
+}
+
+static void closeOutputFile(void)
+{
+    if (outputFile) {
+        recordWriterClose(&fileWriter);
+        fclose(outputFile);
+        outputFile = NULL;
+    }
+}
+
+static void writeBinaryFileRecord(uint32_t now)
+{
+    int32_t values[ARRAYLEN(availableSensors)];
+    uint8_t i, n = 0;
+
+    if (csvFileFirstLinePending) {
+        RecordColumn_t columns[ARRAYLEN(availableSensors)];
+        for (i = 0; i < ARRAYLEN(availableSensors); ++i) {
+            if (availableSensors[i].period != 0) {
+                columns[n].code = availableSensors[i].code;
+                columns[n].type = availableSensors[i].recordType ?
+                        availableSensors[i].recordType : RECORD_TYPE_I32;
+                columns[n].name = availableSensors[i].name;
+                n++;
+            }
+        }
+        recordWriteSchema(&fileWriter, columns, n, now);
+        csvFileFirstLinePending = false;
+        n = 0;
+    }
+
+    for (i = 0; i < ARRAYLEN(availableSensors); ++i) {
+        if (availableSensors[i].period != 0) {
+            values[n++] = availableSensors[i].lastReadValue;
+            availableSensors[i].isRead = false;
+        }
+    }
+    recordWriteData(&fileWriter, values, now);
+}
+
+static void writeCsvFileRecord(uint32_t now)
+{
+    char line[12 * (ARRAYLEN(availableSensors) + 1) + 1];
+    uint16_t length;
     uint8_t i;
-    char str[12];
 
     if (csvFileFirstLinePending) {
         // write first (header) line with sensor names
-        fputs("\ntimestamp,", outputFile);
+        recordWriteText(&fileWriter, "\ntimestamp,", 11, now);
         for (i = 0; i < ARRAYLEN(availableSensors); ++i) {
             if (availableSensors[i].period != 0) {
-                fputs(availableSensors[i].name, outputFile);
-                fputc(',', outputFile);
+                const char *name = availableSensors[i].name;
+                recordWriteText(&fileWriter, name, strlen(name), now);
+                recordWriteText(&fileWriter, ",", 1, now);
             }
         }
-        fputc('\n', outputFile);
+        recordWriteText(&fileWriter, "\n", 1, now);
         csvFileFirstLinePending = false;
     }
 
     // write timestamp first
-    sprintf(str, "%ld", getSyncTimeSec());
-    fputs(str, outputFile);
-    fputc(',', outputFile);
+    length = formatInt32(line, now);
+    line[length++] = ',';
     // write all active sensors
     for (i = 0; i < ARRAYLEN(availableSensors); ++i) {
         if (availableSensors[i].isRead) {
-            sprintf(str, "%ld", availableSensors[i].lastReadValue);
-            fputs(str, outputFile);
-            fputc(',', outputFile);
+            length += formatInt32(line + length, availableSensors[i].lastReadValue);
+            line[length++] = ',';
             availableSensors[i].isRead = false;
         }
     }
     // end with a newline
-    fputc('\n', outputFile);
+    line[length++] = '\n';
+    recordWriteText(&fileWriter, line, length, now);
+}
+
+static void writeFileRecord(void)
+{
+    uint32_t now = getSyncTimeSec();
+    if (fileWriter.binary) {
+        writeBinaryFileRecord(now);
+    } else {
+        writeCsvFileRecord(now);
+    }
     numReadSensors = 0;
 }
 
@@ -244,16 +348,20 @@ void wmpReadSensor(void *sensor_)
     uint16_t stringLength;
 
     sensor->lastReadValue = sensor->func();
-    stringLength = snprintf(buffer, sizeof(buffer), "%s=%ld,xx",
-            sensor->name, sensor->lastReadValue);
-    if (sizeof(buffer) <= stringLength) {
-        stringLength = sizeof(buffer) - 1;
-    }
-    // replace x'es with crc
-    uint8_t crc = crc8((uint8_t *) buffer, stringLength - 3);
-    buffer[stringLength - 2] = toHex(crc >> 4);
-    buffer[stringLength - 1] = toHex(crc & 0xf);
-    
+
+    // the text form is needed only for serial and SD card output
+    if (wmpSerialOutputEnabled || wmpSdCardOutputEnabled) {
+        stringLength = snprintf(buffer, sizeof(buffer), "%s=%ld,xx",
+                sensor->name, sensor->lastReadValue);
+        if (sizeof(buffer) <= stringLength) {
+            stringLength = sizeof(buffer) - 1;
+        }
+        // replace x'es with crc
+        uint8_t crc = crc8((uint8_t *) buffer, stringLength - 3);
+        buffer[stringLength - 2] = toHex(crc >> 4);
+        buffer[stringLength - 1] = toHex(crc & 0xf);
+    }
+
     DPRINTF("File enabled=%s, output=%p\n", wmpFileOutputEnabled ? "yes" : "no", outputFile);
 
     // handle serial output
@@ -277,7 +385,7 @@ void wmpReadSensor(void *sensor_)
         }
         DPRINTF("numReadSensors=%u, total=%u\n", numReadSensors, numTotalActiveSensors);
         if (numReadSensors >= numTotalActiveSensors) {
-            writeCsvFileRecord();
+            writeFileRecord();
         }
     }
     alarmSchedule(&sensor->alarm, sensor->period);
@@ -522,13 +630,10 @@ static void processFilenameSet(void)
     memcpy(wmpOutputFileName, sp.arguments, len);
     wmpOutputFileName[len] = '\0';
 
-    if (outputFile) {
-        fclose(outputFile);
-        outputFile = NULL;
-    }
+    closeOutputFile();
 
     if (wmpOutputFileName[0]) {
-        outputFile = fopenEx(wmpOutputFileName, "a", &wmpFileBuffer);
+        openOutputFile();
         if (!outputFile) goto error;
     }
 
@@ -578,6 +683,250 @@ static void processFileGet(void)
     wmpSendReply();
 }
 
+// -------------------------------------------------------
+// Bulk file transfer (the protocol is described in wmp.h)
+//
+// The command handlers run in the serial receive interrupt, so they only
+// record the requests; the file is read and the frames are sent in the
+// alarm callback. With threads, it runs in the kernel thread and fills the
+// whole window; otherwise it runs in the timer interrupt and sends a single
+// frame each time (the alarm is processed again on the next timer tick).
+//
+
+static Alarm_t bulkAlarm;
+static FILE bulkFileBuffer;
+static FILE *bulkFile;
+static uint32_t bulkFileSize;
+static uint32_t bulkSendOffset;     // offset of the next frame to send
+static uint32_t bulkAckOffset;      // everything before this is received
+static uint8_t bulkWindow;          // max unacknowledged frames
+static uint8_t bulkChunk;           // raw data in a frame
+static uint8_t bulkFlags;
+static uint8_t bulkRetries;
+static bool bulkEofSent;
+static bool bulkContinue;           // the window was not filled in the last callback
+
+// requests from the command handlers
+static volatile bool bulkStartPending;
+static volatile bool bulkAckPending;
+static uint32_t bulkRequestOffset;
+static uint8_t bulkRequestWindow;
+static uint8_t bulkRequestFlags;
+static char bulkRequestName[13];
+static uint32_t bulkRequestAckOffset;
+static uint8_t bulkRequestAckFlags;
+
+// start character, command, argLen, arguments, crc
+static uint8_t bulkFrame[3 + 6 + WMP_BULK_CHUNK + 2 + 1];
+#if WMP_BULK_COMPRESSION
+static uint8_t bulkRaw[WMP_BULK_COMPRESSED_CHUNK];
+
+// Encode the deltas of 16-bit words as zigzag varints; returns the encoded length
+static uint16_t deltaEncode(const uint8_t *src, uint16_t length, uint8_t *dst)
+{
+    uint8_t *out = dst;
+    uint16_t i;
+    uint16_t previous = 0;
+    for (i = 0; i + 1 < length; i += 2) {
+        uint16_t word = le16Read(src + i);
+        out = varintEncode(out, zigzagEncode((int16_t) (word - previous)));
+        previous = word;
+    }
+    if (length & 1) {
+        *out++ = src[length - 1];
+    }
+    return out - dst;
+}
+#endif
+
+static void bulkSendFrame(uint8_t command, uint8_t argLen)
+{
+    uint16_t i;
+    uint8_t crc = 0;
+    bulkFrame[0] = WMP_START_CHARACTER;
+    bulkFrame[1] = command | WMP_CMD_REPLY_FLAG;
+    bulkFrame[2] = argLen;
+    for (i = 0; i < argLen + 3u; ++i) {
+        crc ^= bulkFrame[i];
+    }
+    bulkFrame[argLen + 3] = crc;
+    serialSendData(PRINTF_SERIAL_ID, bulkFrame, argLen + 4);
+}
+
+static void bulkStop(void)
+{
+    if (bulkFile) {
+        fclose(bulkFile);
+        bulkFile = NULL;
+    }
+}
+
+static void bulkStart(void)
+{
+    uint8_t *args = bulkFrame + 3;
+
+    bulkStop();
+    bulkFileSize = 0;
+    args[0] = WMP_ERROR;
+    bulkFile = fopenEx(bulkRequestName, "r", &bulkFileBuffer);
+    if (bulkFile) {
+        bulkFileSize = bulkFile->fileSize;
+        bulkSendOffset = bulkAckOffset = min(bulkRequestOffset, bulkFileSize);
+        bulkWindow = bulkRequestWindow;
+        if (bulkWindow == 0) bulkWindow = 1;
+        if (bulkWindow > WMP_BULK_MAX_WINDOW) bulkWindow = WMP_BULK_MAX_WINDOW;
+        bulkFlags = bulkRequestFlags;
+#if WMP_BULK_COMPRESSION
+        bulkChunk = (bulkFlags & WMP_BULK_COMPRESS) ?
+                WMP_BULK_COMPRESSED_CHUNK : WMP_BULK_CHUNK;
+#else
+        bulkFlags &= ~WMP_BULK_COMPRESS;
+        bulkChunk = WMP_BULK_CHUNK;
+#endif
+        bulkRetries = 0;
+        bulkEofSent = false;
+        args[0] = WMP_SUCCESS;
+    }
+    le32Write(args + 1, bulkFileSize);
+    bulkSendFrame(WMP_CMD_GET_FILE_BULK, 5);
+}
+
+// Send the frame at 'bulkSendOffset'; returns false on read errors
+static bool bulkSendData(void)
+{
+    uint8_t *args = bulkFrame + 3;
+    uint8_t *payload = args + 6;
+    uint8_t encoding = WMP_ENCODING_RAW;
+    uint16_t rawLength, length;
+
+    rawLength = min(bulkFileSize - bulkSendOffset, (uint32_t) bulkChunk);
+    if (rawLength) {
+        if (bulkFile->position != bulkSendOffset) {
+            fseek(bulkFile, bulkSendOffset, SEEK_SET);
+        }
+#if WMP_BULK_COMPRESSION
+        if (bulkFlags & WMP_BULK_COMPRESS) {
+            if (fread(bulkRaw, 1, rawLength, bulkFile) != rawLength) return false;
+            length = deltaEncode(bulkRaw, rawLength, payload);
+            if (length < rawLength) {
+                encoding = WMP_ENCODING_DELTA;
+            } else {
+                memcpy(payload, bulkRaw, rawLength);
+                length = rawLength;
+            }
+        } else
+#endif
+        {
+            // read straight into the frame
+            if (fread(payload, 1, rawLength, bulkFile) != rawLength) return false;
+            length = rawLength;
+        }
+    } else {
+        // end of file
+        length = 0;
+        bulkEofSent = true;
+    }
+
+    le32Write(args, bulkSendOffset);
+    args[4] = encoding;
+    args[5] = rawLength;
+    le16Write(payload + length, crc16(args, 6 + length));
+    bulkSendFrame(WMP_CMD_FILE_DATA, 6 + length + 2);
+
+    bulkSendOffset += rawLength;
+    return true;
+}
+
+static void bulkAlarmCallback(void *unused)
+{
+    Handle_t h;
+    bool start, acked, resume;
+    uint32_t ackOffset;
+    uint8_t ackFlags;
+
+    ATOMIC_START(h);
+    start = bulkStartPending;
+    bulkStartPending = false;
+    acked = bulkAckPending;
+    bulkAckPending = false;
+    ackOffset = bulkRequestAckOffset;
+    ackFlags = bulkRequestAckFlags;
+    bulkRequestAckFlags = 0;
+    ATOMIC_END(h);
+    resume = bulkContinue;
+    bulkContinue = false;
+
+    if (start) {
+        bulkStart();
+    }
+    if (!bulkFile) return;
+
+    if (acked) {
+        if (ackFlags & WMP_ACK_ABORT) goto stop;
+        if (ackOffset > bulkAckOffset && ackOffset <= bulkSendOffset) {
+            bulkAckOffset = ackOffset;
+            bulkRetries = 0;
+        }
+        if (bulkAckOffset == bulkFileSize) goto stop;
+        if (ackFlags & WMP_ACK_NAK) {
+            // go back to the first byte not received
+            bulkSendOffset = bulkAckOffset;
+            bulkEofSent = false;
+        }
+    } else if (!start && !resume) {
+        // timeout: resend everything not acknowledged
+        if (++bulkRetries > WMP_BULK_MAX_RETRIES) {
+            DPRINTF("bulk transfer: timeout\n");
+            goto stop;
+        }
+        bulkSendOffset = bulkAckOffset;
+        bulkEofSent = false;
+    }
+
+    while (!bulkEofSent
+            && bulkSendOffset - bulkAckOffset < (uint32_t) bulkWindow * bulkChunk) {
+        if (!bulkSendData()) goto stop;
+#if !USE_THREADS
+        // without threads this runs in the timer interrupt: send one frame
+        // and continue in the next callback, so that the serial receive
+        // interrupt is not blocked while the whole window is sent
+        bulkContinue = !bulkEofSent && bulkSendOffset - bulkAckOffset
+                < (uint32_t) bulkWindow * bulkChunk;
+        break;
+#endif
+    }
+
+    // acknowledgements received while sending must not wait for the timeout
+    ATOMIC_START(h);
+    alarmSchedule(&bulkAlarm, bulkAckPending || bulkContinue ? 0 : WMP_BULK_TIMEOUT);
+    ATOMIC_END(h);
+    return;
+
+  stop:
+    bulkStop();
+}
+
+static void processFileBulkGet(void)
+{
+    uint8_t len = min(sizeof(bulkRequestName) - 1, sp.argLen - 6);
+    bulkRequestOffset = le32Read(sp.arguments);
+    bulkRequestWindow = sp.arguments[4];
+    bulkRequestFlags = sp.arguments[5];
+    memcpy(bulkRequestName, sp.arguments + 6, len);
+    bulkRequestName[len] = '\0';
+    bulkStartPending = true;
+    // the reply is sent from the alarm callback, after the file is opened
+    alarmSchedule(&bulkAlarm, 0);
+}
+
+static void processFileAck(void)
+{
+    bulkRequestAckOffset = le32Read(sp.arguments);
+    bulkRequestAckFlags |= sp.arguments[4];
+    bulkAckPending = true;
+    alarmSchedule(&bulkAlarm, 0);
+}
+
 static void wmpProcessCommand(void)
 {
     DPRINTF("got command %u\n", (uint16_t) sp.command);
@@ -631,6 +980,14 @@ static void wmpProcessCommand(void)
         if (!checkArgLen(1)) return;
         processFileGet();
         break;
+    case WMP_CMD_GET_FILE_BULK:
+        if (!checkArgLen(7)) return;
+        processFileBulkGet();
+        break;
+    case WMP_CMD_FILE_ACK:
+        if (!checkArgLen(5)) return;
+        processFileAck();
+        break;
     case WMP_CMD_SET_DAC:
         if (!checkArgLen(4)) return;
         // TODO
@@ -642,64 +999,29 @@ static void wmpProcessCommand(void)
     }
 }
 
-static void wmpSerialReceive(uint8_t x)
+static void wmpFrameReceived(uint8_t *frame, uint16_t length)
 {
-//    DPRINTF("got %x\n", (uint16_t) x);
-    enum State {
-        READ_START_CHARACTER,
-        READ_COMMAND,
-        READ_ARG_LEN,
-        READ_ARGS,
-        READ_CRC,
-    };
-    static enum State state = READ_START_CHARACTER;
-    switch (state) {
-    case READ_START_CHARACTER:
-        if (x == WMP_START_CHARACTER) {
-            commandMode = true;
-            state = READ_COMMAND;
-        }
-        break;
-    case READ_COMMAND:
-        sp.command = x;
-        state = READ_ARG_LEN;
-        break;
-    case READ_ARG_LEN:
-        sp.argLen = x;
-        if (sp.argLen > sizeof(sp.arguments)) {
-            PRINTF("Command too long: %u byte arguments!\n", (uint16_t) sp.argLen);
-            state = READ_START_CHARACTER;
-            break;
-        }
-        sp.argLenRead = 0;
-        if (sp.argLen) {
-            state = READ_ARGS;
-        } else {
-            state = READ_CRC;
-        }
-        break;
-    case READ_ARGS:
-        sp.arguments[sp.argLenRead++] = x;
-        if (sp.argLenRead == sp.argLen) {
-            state = READ_CRC;
-        }
-        break;
-    case READ_CRC:
-        sp.crc = x;
-        if (wmpCrc() == sp.crc) {
-            wmpProcessCommand();
-        } else {
-            DPRINTF("bad crc %u\n", (uint16_t) sp.crc);
-        }
-        state = READ_START_CHARACTER;
-        commandMode = false;
-        break;
+    sp.crc = sp.arguments[sp.argLen];
+    if (wmpCrc() == sp.crc) {
+        wmpProcessCommand();
+    } else {
+        DPRINTF("bad crc %u\n", (uint16_t) sp.crc);
     }
 }
 
+static void wmpSerialReceive(uint8_t x)
+{
+    framerFeedByte(&wmpFramer, x);
+}
+
 void wmpInit(void)
 {
+    // frame: start character, command, argLen, arguments, crc
+    framerInitLength(&wmpFramer, (uint8_t *) &sp, offsetof(SerialPacket_t, crc),
+            WMP_START_CHARACTER, offsetof(SerialPacket_t, argLen), 1, 1,
+            wmpFrameReceived);
     serialSetReceiveHandle(PRINTF_SERIAL_ID, wmpSerialReceive);
+    alarmInit(&bulkAlarm, bulkAlarmCallback, NULL);
 
     // read config values from flash
     uint32_t key;
@@ -732,7 +1054,7 @@ void wmpInit(void)
         }
         eepromRead(WMP_EEPROM_FILE_BASE, &wmpOutputFileName, 12);
         if (wmpOutputFileName[0]) {
-            outputFile = fopenEx(wmpOutputFileName, "a", &wmpFileBuffer);
+            openOutputFile();
         }
     } else {
         eepromWrite(WMP_EEPROM_OUTPUT_BASE + WMP_OUTPUT_SERIAL, &wmpSerialOutputEnabled, 1);
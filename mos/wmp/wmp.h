@@ -85,6 +85,12 @@ enum WmpCommandType_e {
     WMP_CMD_SET_DAC,
     //! get DAC channel value
     WMP_CMD_GET_DAC,
+    //! start bulk transfer of a file (see below)
+    WMP_CMD_GET_FILE_BULK,
+    //! acknowledge received bulk transfer data
+    WMP_CMD_FILE_ACK,
+    //! a frame of bulk transfer data (sent by the mote only)
+    WMP_CMD_FILE_DATA,
 } PACKED;
 typedef enum WmpCommandType_e WmpCommandType_t;
 
@@ -99,6 +105,60 @@ typedef enum WmpCommandType_e WmpCommandType_t;
 //! Start character of all WMP binary packets
 #define WMP_START_CHARACTER   '$'
 
+//
+// Bulk file transfer.
+//
+// WMP_CMD_GET_FILE_BULK arguments: u32 start offset, u8 window (frames),
+// u8 flags, file name. The reply carries the status and u32 file size;
+// then the mote sends WMP_CMD_FILE_DATA frames (with the reply flag set):
+// u32 offset, u8 encoding, u8 raw data length, payload, u16 CRC16 of all
+// the preceding arguments. A frame without data marks the end of file.
+//
+// The host acknowledges data with WMP_CMD_FILE_ACK: u32 offset of the first
+// byte not yet received, u8 flags. The mote keeps at most 'window' frames
+// unacknowledged and goes back to the acknowledged offset on a NAK
+// or when no acknowledgement arrives in time.
+//
+
+//! Bulk transfer flag: compress the data if possible
+#define WMP_BULK_COMPRESS      0x1
+
+//! Acknowledgement flag: data after the offset was lost, resend it
+#define WMP_ACK_NAK            0x1
+//! Acknowledgement flag: stop the transfer
+#define WMP_ACK_ABORT          0x2
+
+//! Data frame encoding: raw bytes
+#define WMP_ENCODING_RAW       0
+//! Data frame encoding: zigzag varints of 16-bit little-endian word deltas;
+/// the last byte of odd-length data is stored as is
+#define WMP_ENCODING_DELTA     1
+
+//! Raw data in a bulk transfer frame, bytes
+#define WMP_BULK_CHUNK             240
+//! Raw data in a compressed frame, bytes (varints may need 1.5 times more space)
+#define WMP_BULK_COMPRESSED_CHUNK  160
+
+//! Set to 0 to save RAM and code if compression is never needed
+#ifndef WMP_BULK_COMPRESSION
+#define WMP_BULK_COMPRESSION   1
+#endif
+
+//! Max unacknowledged frames
+#ifndef WMP_BULK_MAX_WINDOW
+#define WMP_BULK_MAX_WINDOW    8
+#endif
+
+//! Time without progress after which unacknowledged data is resent, ms
+#ifndef WMP_BULK_TIMEOUT
+#define WMP_BULK_TIMEOUT       500
+#endif
+
+//! Resends without progress before the transfer is aborted
+#ifndef WMP_BULK_MAX_RETRIES
+#define WMP_BULK_MAX_RETRIES   5
+#endif
+
 // initialization (setups serial receiver)
 void wmpInit(void);
 
@@ -0,0 +1,258 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Decoding of Seal output: text lines (as printed by the serial output
+// of Seal programs) and binary SEAL packets forwarded by base stations.
+//
+
+#include "gateway.h"
+#include <stdlib.h>
+#include <ctype.h>
+#include <lib/codec/crc.h>
+#include <lib/codec/varint.h>
+
+SampleHandler sampleHandler;
+
+// names of binary packet fields; the common ones are the same
+// for all programs (see PACKET_FIELD_ID_* in mos/net/seal_networking.h)
+static map<unsigned, string> fieldNames;
+
+static void initFieldNames(void)
+{
+    if (!fieldNames.empty()) return;
+    fieldNames[0] = "command";
+    fieldNames[1] = "sequencenumber";
+    fieldNames[2] = "timestamp";
+    fieldNames[3] = "address";
+    fieldNames[4] = "issent";
+}
+
+bool loadFieldNames(const char *fileName)
+{
+    initFieldNames();
+    FILE *f = fopen(fileName, "r");
+    if (!f) {
+        perror(fileName);
+        return false;
+    }
+    char line[256];
+    char name[128];
+    unsigned code;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%u %127s", &code, name) == 2) {
+            for (char *p = name; *p; ++p) *p = tolower(*p);
+            fieldNames[code] = name;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static string fieldName(unsigned code)
+{
+    initFieldNames();
+    map<unsigned, string>::iterator it = fieldNames.find(code);
+    if (it != fieldNames.end()) return it->second;
+    char name[32];
+    snprintf(name, sizeof(name), "field%u", code);
+    return name;
+}
+
+static void addSample(const string &mote, const string &name, double value)
+{
+    Sample s;
+    s.timeMs = timeMs();
+    s.mote = mote;
+    s.name = name;
+    s.value = value;
+    stats.samples++;
+    if (sampleHandler) sampleHandler(s);
+}
+
+static string strip(const char *begin, const char *end)
+{
+    while (begin < end && isspace((unsigned char) *begin)) begin++;
+    while (end > begin && isspace((unsigned char) end[-1])) end--;
+    return string(begin, end);
+}
+
+// -----------------------------------------------
+// text lines: [address:]name=value[,crc8]
+
+void decodeLine(const string &portMote, const char *line)
+{
+    string mote = portMote;
+    const char *eq = strchr(line, '=');
+    const char *colon = strchr(line, ':');
+    // the data of another mote, forwarded by this one
+    if (colon && eq && colon < eq && colon != line) {
+        mote.assign(line, colon - line);
+        line = colon + 1;
+    }
+
+    size_t length = strlen(line);
+    const char *comma = strchr(line, ',');
+    if (length > 3 && comma == line + length - 3) {
+        char *end;
+        unsigned long receivedCrc = strtoul(comma + 1, &end, 16);
+        uint8_t crc = crc8((const uint8_t *) line, length - 3);
+        if (*end || receivedCrc != crc) {
+            stats.badChecksums++;
+            return;
+        }
+        length -= 3;
+    }
+    const char *lineEnd = line + length;
+
+    eq = (const char *) memchr(line, '=', length);
+    // no value, or packet separator
+    if (!eq || eq == line) return;
+
+    string name = strip(line, eq);
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] < 0x20 || name[i] > 0x7e) return;
+        name[i] = tolower(name[i]);
+    }
+    if (name.empty()) return;
+
+    string valueString = strip(eq + 1, lineEnd);
+    char *end;
+    double value = strtoll(valueString.c_str(), &end, 0);
+    if (*end || valueString.empty()) {
+        value = strtod(valueString.c_str(), &end);
+        if (*end || valueString.empty()) {
+            fprintf(stderr, "gateway: sensor %s value is in unknown format: %s\n",
+                    name.c_str(), valueString.c_str());
+            value = 0;
+        }
+    }
+    addSample(mote, name, value);
+}
+
+// -----------------------------------------------
+// binary packets (little-endian, as sent by the motes)
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static string addressName(uint16_t address)
+{
+    char name[8];
+    snprintf(name, sizeof(name), "%04x", address);
+    return name;
+}
+
+// typemask(s) followed by field values; see sealRecvRecord() in mos/net/seal_networking.c
+static bool decodeRecord(string mote, uint16_t source,
+                         const uint8_t *data, unsigned length)
+{
+    vector<uint32_t> typeMasks;
+    unsigned offset = 0;
+    unsigned numValues = 0;
+    uint32_t typeMask;
+    do {
+        if (offset + 4 > length) return false;
+        typeMask = get32(data + offset);
+        offset += 4;
+        typeMasks.push_back(typeMask & ~SEAL_TYPEMASK_EXTENSION);
+        numValues += __builtin_popcount(typeMask & ~SEAL_TYPEMASK_EXTENSION);
+    } while (typeMask & SEAL_TYPEMASK_EXTENSION);
+    if (offset + numValues * 4 > length) return false;
+
+    vector<pair<unsigned, int32_t> > fields;
+    const uint8_t *value = data + offset;
+    for (unsigned i = 0; i < typeMasks.size(); ++i) {
+        for (uint32_t bits = typeMasks[i]; bits; bits &= bits - 1) {
+            unsigned code = i * SEAL_TYPEMASK_CODES + __builtin_ctz(bits);
+            fields.push_back(make_pair(code, (int32_t) get32(value)));
+            value += 4;
+        }
+    }
+
+    if (source) {
+        mote = addressName(source);
+    } else {
+        for (unsigned i = 0; i < fields.size(); ++i) {
+            if (fields[i].first == 3) mote = addressName(fields[i].second);
+        }
+    }
+    for (unsigned i = 0; i < fields.size(); ++i) {
+        addSample(mote, fieldName(fields[i].first), fields[i].second);
+    }
+    return true;
+}
+
+static bool decodeAggregate(const string &mote, const uint8_t *data, unsigned length)
+{
+    const uint8_t *p = data + 8; // magic, crc, base time
+    const uint8_t *end = data + length;
+    while (p + 2 < end) {
+        uint16_t source = get16(p);
+        uint32_t delta;
+        p = varintDecode(p + 2, end, &delta);
+        if (!p || p >= end) return false;
+        uint8_t recordLength = *p++;
+        if (p + recordLength > end) return false;
+        if (!decodeRecord(mote, source, p, recordLength)) return false;
+        p += recordLength;
+    }
+    return p == end;
+}
+
+void decodePacket(const string &mote, const uint8_t *data, unsigned length)
+{
+    stats.frames++;
+    if (length < 2 + 8) {
+        stats.badPackets++;
+        return;
+    }
+    uint16_t source = get16(data);
+    data += 2;
+    length -= 2;
+
+    uint16_t magic = get16(data);
+    if (magic != SEAL_MAGIC && magic != SEAL_AGGREGATE_MAGIC) {
+        stats.badPackets++;
+        return;
+    }
+    if (get16(data + 2) != crc16(data + 4, length - 4)) {
+        stats.badChecksums++;
+        return;
+    }
+    bool ok;
+    if (magic == SEAL_AGGREGATE_MAGIC) {
+        ok = decodeAggregate(mote, data, length);
+    } else {
+        ok = decodeRecord(mote, source, data + 4, length - 4);
+    }
+    if (!ok) stats.badPackets++;
+}
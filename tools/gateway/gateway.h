@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Base station gateway: reads Seal output of the motes attached to serial
+// ports, stores the data and forwards it to the subscribers (the web server).
+//
+
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+// see mos/net/seal_networking.h
+#define SEAL_MAGIC           0x5EA1
+#define SEAL_AGGREGATE_MAGIC 0x5EA2
+#define SEAL_TYPEMASK_CODES     31
+#define SEAL_TYPEMASK_EXTENSION (1ul << 31)
+#define SEAL_SERIAL_PROTOCOL 'S'
+
+// see mos/smp/smp.h
+#define SERIAL_PACKET_DELIMITER '$'
+#define PROTOCOL_DEBUG 'd'
+#define PROTOCOL_SMP   's'
+
+// the longest text line or binary frame accepted
+#define MAX_LINE_LENGTH  1024
+
+struct Sample {
+    uint64_t timeMs;   // server time, milliseconds since 1970
+    string mote;       // port basename or mote address
+    string name;       // sensor name, lower case
+    double value;
+};
+
+struct Statistics {
+    unsigned long lines;
+    unsigned long frames;
+    unsigned long samples;
+    unsigned long badChecksums;
+    unsigned long badPackets;
+};
+
+extern Statistics stats;
+
+uint64_t timeMs(void);
+
+// -----------------------------------------------
+// decoder.cpp: text and binary Seal output
+
+// called for each decoded sample
+typedef void (*SampleHandler)(const Sample &s);
+
+extern SampleHandler sampleHandler;
+
+// read "code name" pairs of binary packet fields (Seal sensor codes)
+bool loadFieldNames(const char *fileName);
+
+// decode a text line, e.g. "light=123" or "0102:light=123,5a"
+void decodeLine(const string &mote, const char *line);
+
+// decode a SEAL packet forwarded by a base station (source address first)
+void decodePacket(const string &mote, const uint8_t *data, unsigned length);
+
+// -----------------------------------------------
+// port.cpp: serial ports
+
+class Port {
+public:
+    Port(const string &device) : fd(-1), device(device), state(READ_TEXT),
+                                 protocol(0), expectedLength(0) {
+        size_t slash = device.rfind('/');
+        name = slash == string::npos ? device : device.substr(slash + 1);
+    }
+    ~Port() { closePort(); }
+
+    bool openPort(unsigned baudrate);
+    void closePort();
+
+    // read available data and decode it; return -1 on error or end of file
+    int receive();
+
+    int fd;
+    string device;
+    string name;
+
+private:
+    void parse(const uint8_t *data, unsigned length);
+    void lineDone();
+
+    enum {
+        READ_TEXT,
+        READ_PROTOCOL,
+        READ_LENGTH_BYTE1,
+        READ_LENGTH_BYTE2,
+        READ_FRAME
+    } state;
+    uint8_t protocol;
+    uint16_t expectedLength;
+    vector<uint8_t> buffer;
+};
+
+// -----------------------------------------------
+// store.cpp: batched writes of the data files
+
+// the same layout as the web server uses: <directory>/<mote>/<sensor>.csv
+// (and <sensor>.tsd time series files, if 'timeSeries' is set)
+void storeInit(const char *directory, unsigned maxBufferedBytes, bool timeSeries);
+void storeAdd(const Sample &s);
+// write out all buffered rows
+void storeFlush(void);
+bool storeWantFlush(void);
+
+// -----------------------------------------------
+// subscribers.cpp: local socket the web server connects to
+//
+// One line per event:
+//   L <port> <text>                    - a text line received from a mote
+//   D <time ms> <mote> <sensor> <value> - a sample
+//
+
+// create the socket and add it to the epoll set; return the socket
+int subscribersInit(const char *path, int epollFd);
+void subscribersAccept(void);
+// handle epoll events of a subscriber; return false if 'fd' is not one
+bool subscriberEvent(int fd, uint32_t events);
+void subscribersSendLine(const string &port, const char *line);
+void subscribersSendSample(const Sample &s);
+// write the queued data out (once per event loop iteration)
+void subscribersFlush(void);
+void subscribersClose(void);
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Base station gateway daemon: listens to all serial ports at once,
+// decodes the text and binary Seal output of the motes, stores the data
+// in batches and forwards it to the web server over a local socket.
+//
+
+#include "gateway.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+
+#define DEFAULT_BAUDRATE       38400
+#define DEFAULT_DATA_DIRECTORY "data"
+#define DEFAULT_SOCKET_PATH    "/tmp/mansos-gateway.sock"
+#define DEFAULT_FLUSH_INTERVAL 1000   // milliseconds
+#define MAX_BUFFERED_BYTES     (64 * 1024)
+// how often closed ports are opened again (e.g. a mote plugged back in)
+#define REOPEN_INTERVAL        2000   // milliseconds
+
+Statistics stats;
+
+static vector<Port *> ports;
+static volatile sig_atomic_t quit;
+
+uint64_t timeMs(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void handleSample(const Sample &s)
+{
+    storeAdd(s);
+    subscribersSendSample(s);
+}
+
+static void handleSignal(int)
+{
+    quit = 1;
+}
+
+static void openPorts(int epollFd, unsigned baudrate)
+{
+    for (unsigned i = 0; i < ports.size(); ++i) {
+        if (ports[i]->fd >= 0) continue;
+        if (!ports[i]->openPort(baudrate)) continue;
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        // port descriptors are told apart by the index (negative)
+        ev.data.u64 = ~(uint64_t) i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, ports[i]->fd, &ev);
+    }
+}
+
+static void usage(void)
+{
+    printf("Usage: gateway [options] <serial port> ...\n");
+    printf("Options:\n");
+    printf("  -b <baudrate>   serial port baudrate (default: %d)\n", DEFAULT_BAUDRATE);
+    printf("  -d <directory>  data directory (default: %s)\n", DEFAULT_DATA_DIRECTORY);
+    printf("  -s <path>       subscriber socket (default: %s)\n", DEFAULT_SOCKET_PATH);
+    printf("  -f <ms>         max time the data is buffered before writing (default: %d)\n",
+            DEFAULT_FLUSH_INTERVAL);
+    printf("  -n <file>       names of binary packet fields (\"<code> <name>\" per line)\n");
+    printf("  -t              also store the data in time series files (.tsd)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned baudrate = DEFAULT_BAUDRATE;
+    const char *dataDirectory = DEFAULT_DATA_DIRECTORY;
+    const char *socketPath = DEFAULT_SOCKET_PATH;
+    unsigned flushInterval = DEFAULT_FLUSH_INTERVAL;
+    bool timeSeries = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:d:s:f:n:th")) != -1) {
+        switch (opt) {
+        case 'b':
+            baudrate = atoi(optarg);
+            break;
+        case 'd':
+            dataDirectory = optarg;
+            break;
+        case 's':
+            socketPath = optarg;
+            break;
+        case 'f':
+            flushInterval = atoi(optarg);
+            break;
+        case 'n':
+            if (!loadFieldNames(optarg)) return 1;
+            break;
+        case 't':
+            timeSeries = true;
+            break;
+        default:
+            usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind == argc) {
+        usage();
+        return 1;
+    }
+    for (int i = optind; i < argc; ++i) {
+        ports.push_back(new Port(argv[i]));
+    }
+
+    int epollFd = epoll_create1(0);
+    if (epollFd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+    int listenFd = subscribersInit(socketPath, epollFd);
+    if (listenFd < 0) return 1;
+    storeInit(dataDirectory, MAX_BUFFERED_BYTES, timeSeries);
+    sampleHandler = handleSample;
+
+    signal(SIGINT, handleSignal);
+    signal(SIGTERM, handleSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    openPorts(epollFd, baudrate);
+    uint64_t now = timeMs();
+    uint64_t nextFlush = now + flushInterval;
+    uint64_t nextReopen = now + REOPEN_INTERVAL;
+
+    while (!quit) {
+        struct epoll_event events[64];
+        uint64_t next = min(nextFlush, nextReopen);
+        int timeout = next > now ? (int) (next - now) : 0;
+        int n = epoll_wait(epollFd, events, 64, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            uint64_t data = events[i].data.u64;
+            if ((int64_t) data < 0) {
+                Port *p = ports[~data];
+                if (p->receive() < 0) {
+                    // closing removes it from the epoll set
+                    p->closePort();
+                }
+            } else if ((int) data == listenFd) {
+                subscribersAccept();
+            } else {
+                subscriberEvent((int) data, events[i].events);
+            }
+        }
+        subscribersFlush();
+
+        now = timeMs();
+        if (storeWantFlush() || now >= nextFlush) {
+            storeFlush();
+            nextFlush = now + flushInterval;
+        }
+        if (now >= nextReopen) {
+            openPorts(epollFd, baudrate);
+            nextReopen = now + REOPEN_INTERVAL;
+        }
+    }
+
+    storeFlush();
+    subscribersClose();
+    for (unsigned i = 0; i < ports.size(); ++i) {
+        delete ports[i];
+    }
+    printf("gateway: %lu lines, %lu frames, %lu samples; %lu bad checksums, %lu bad packets\n",
+            stats.lines, stats.frames, stats.samples, stats.badChecksums, stats.badPackets);
+    return 0;
+}
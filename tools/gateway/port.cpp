@@ -0,0 +1,171 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Serial ports. The motes print text lines; base stations may also
+// forward binary SEAL packets, framed the same way as SMP packets:
+// delimiter, protocol, 2 byte length (big-endian), data.
+//
+
+#include "gateway.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <ctype.h>
+#include <algorithm>
+
+static speed_t toSpeed(unsigned baudrate)
+{
+    switch (baudrate) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    default: return B38400;
+    }
+}
+
+bool Port::openPort(unsigned baudrate)
+{
+    fd = open(device.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return false;
+
+    struct termios newtio;
+    memset(&newtio, 0, sizeof(newtio));
+    newtio.c_cflag = CS8 | CLOCAL | CREAD;
+    newtio.c_iflag = IGNPAR | IGNBRK;
+    cfsetispeed(&newtio, toSpeed(baudrate));
+    cfsetospeed(&newtio, toSpeed(baudrate));
+    tcflush(fd, TCIFLUSH);
+    // not fatal: could be a pseudo terminal or a pipe
+    tcsetattr(fd, TCSANOW, &newtio);
+
+    state = READ_TEXT;
+    buffer.clear();
+    printf("gateway: listening to %s\n", device.c_str());
+    return true;
+}
+
+void Port::closePort()
+{
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+int Port::receive()
+{
+    uint8_t data[4096];
+    ssize_t length = read(fd, data, sizeof(data));
+    if (length < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        perror(device.c_str());
+        return -1;
+    }
+    if (length == 0) {
+        fprintf(stderr, "gateway: EOF on %s\n", device.c_str());
+        return -1;
+    }
+    parse(data, length);
+    return length;
+}
+
+void Port::lineDone()
+{
+    // strip whitespace on both ends
+    size_t begin = 0, end = buffer.size();
+    while (begin < end && isspace(buffer[begin])) begin++;
+    while (end > begin && isspace(buffer[end - 1])) end--;
+    if (begin < end) {
+        string line((const char *) &buffer[begin], end - begin);
+        stats.lines++;
+        subscribersSendLine(name, line.c_str());
+        decodeLine(name, line.c_str());
+    }
+    buffer.clear();
+}
+
+void Port::parse(const uint8_t *data, unsigned length)
+{
+    const uint8_t *end = data + length;
+    while (data < end) {
+        switch (state) {
+        case READ_TEXT: {
+            uint8_t c = *data++;
+            if (c == '\n') {
+                lineDone();
+            } else if (c == SERIAL_PACKET_DELIMITER) {
+                state = READ_PROTOCOL;
+            } else if ((c >= 0x20 && c <= 0x7e) || c == '\t' || c == '\r') {
+                // binary garbage is dropped, as by the web server
+                if (buffer.size() < MAX_LINE_LENGTH) buffer.push_back(c);
+            }
+            break;
+        }
+        case READ_PROTOCOL:
+            protocol = *data;
+            if (protocol == SEAL_SERIAL_PROTOCOL || protocol == PROTOCOL_SMP
+                    || protocol == PROTOCOL_DEBUG) {
+                // a frame interrupts the text line
+                lineDone();
+                data++;
+                state = READ_LENGTH_BYTE1;
+            } else {
+                // just a character in the text
+                if (buffer.size() < MAX_LINE_LENGTH) buffer.push_back(SERIAL_PACKET_DELIMITER);
+                state = READ_TEXT;
+            }
+            break;
+        case READ_LENGTH_BYTE1:
+            expectedLength = *data++ << 8;
+            state = READ_LENGTH_BYTE2;
+            break;
+        case READ_LENGTH_BYTE2:
+            expectedLength |= *data++;
+            if (expectedLength == 0 || expectedLength > MAX_LINE_LENGTH) {
+                stats.badPackets++;
+                state = READ_TEXT;
+            } else {
+                state = READ_FRAME;
+            }
+            break;
+        case READ_FRAME: {
+            unsigned n = min<unsigned>(end - data, expectedLength - buffer.size());
+            buffer.insert(buffer.end(), data, data + n);
+            data += n;
+            if (buffer.size() == expectedLength) {
+                // SMP and debug frames are for the shell
+                if (protocol == SEAL_SERIAL_PROTOCOL) {
+                    decodePacket(name, &buffer[0], buffer.size());
+                }
+                buffer.clear();
+                state = READ_TEXT;
+            }
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Data files, in the format of the web server ("saveProcessedData"):
+// one tab-separated file per sensor of each mote, with a header line.
+// Rows are buffered and written out in batches, one write per file.
+// Optionally the samples are also appended to the time series files
+// (tools/tsdb) that the web server uses for graphs of long periods.
+//
+
+#include "gateway.h"
+#include "tsdb.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <strings.h>
+#include <set>
+
+static string dataDirectory;
+static unsigned maxBuffered;
+static unsigned buffered;
+
+// file name -> (sensor name, rows not written yet)
+static map<string, pair<string, string> > pending;
+static set<string> knownDirectories;
+
+static bool useTimeSeries;
+// file name -> open series
+static map<string, Tsdb *> series;
+
+void storeInit(const char *directory, unsigned maxBufferedBytes, bool timeSeries)
+{
+    dataDirectory = directory;
+    maxBuffered = maxBufferedBytes;
+    useTimeSeries = timeSeries;
+    mkdir(directory, 0755);
+}
+
+static bool isSafeName(const string &name)
+{
+    return !name.empty() && name.size() <= 64
+            && name[0] != '.' && name.find('/') == string::npos;
+}
+
+void storeAdd(const Sample &s)
+{
+    if (!isSafeName(s.mote) || !isSafeName(s.name)) return;
+
+    // Windows does not allow to create files named "com0", "com1" etc.
+    string moteDirectory = s.mote;
+    if (strncasecmp(moteDirectory.c_str(), "com", 3) == 0) {
+        moteDirectory = "_" + moteDirectory;
+    }
+    string directory = dataDirectory + "/" + moteDirectory;
+    if (knownDirectories.insert(directory).second) {
+        mkdir(directory.c_str(), 0755);
+    }
+
+    char row[128];
+    time_t t = s.timeMs / 1000;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    int n = snprintf(row, sizeof(row), "%lu\t", (unsigned long) t);
+    n += strftime(row + n, sizeof(row) - n, "%d %b %Y %H:%M:%S", &tm);
+    n += snprintf(row + n, sizeof(row) - n, "\t%.15g\n", s.value);
+
+    pair<string, string> &p = pending[directory + "/" + s.name + ".csv"];
+    p.first = s.name;
+    p.second.append(row, n);
+    buffered += n;
+
+    if (useTimeSeries) {
+        string fileName = directory + "/" + s.name + ".tsd";
+        Tsdb *&db = series[fileName];
+        if (!db) db = tsdbOpen(fileName.c_str(), true);
+        if (!db || tsdbAppend(db, s.timeMs, s.value) < 0) {
+            perror(fileName.c_str());
+        }
+    }
+}
+
+bool storeWantFlush(void)
+{
+    return buffered >= maxBuffered;
+}
+
+void storeFlush(void)
+{
+    map<string, pair<string, string> >::iterator it;
+    for (it = pending.begin(); it != pending.end(); ++it) {
+        string &rows = it->second.second;
+        if (rows.empty()) continue;
+        int fd = open(it->first.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        if (fd < 0) {
+            perror(it->first.c_str());
+            rows.clear();
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size == 0) {
+            rows = "serverTimestampUnix\tserverTimestamp\t" + it->second.first + "\n" + rows;
+        }
+        if (write(fd, rows.data(), rows.size()) != (ssize_t) rows.size()) {
+            perror(it->first.c_str());
+        }
+        close(fd);
+        rows.clear();
+    }
+    buffered = 0;
+
+    map<string, Tsdb *>::iterator st;
+    for (st = series.begin(); st != series.end(); ++st) {
+        if (st->second && tsdbFlush(st->second) < 0) {
+            perror(st->first.c_str());
+        }
+    }
+}
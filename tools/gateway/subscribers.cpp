@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Subscribers: local (Unix domain) socket clients, e.g. the web server.
+// Events are queued per client and written out once per event loop
+// iteration; a client that does not keep up is disconnected.
+//
+
+#include "gateway.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+// the max amount of data queued for a single subscriber
+#define MAX_QUEUED (1024 * 1024)
+
+static int listenFd = -1;
+static int epollFd = -1;
+static string socketPath;
+
+struct Subscriber {
+    string queue;
+    bool waitingForWrite;
+};
+
+static map<int, Subscriber> subscribers;
+
+int subscribersInit(const char *path, int epoll)
+{
+    epollFd = epoll;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "gateway: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        perror("socket");
+        return -1;
+    }
+    // left over from a previous run
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+            || listen(listenFd, 8) < 0) {
+        perror(path);
+        close(listenFd);
+        return listenFd = -1;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    socketPath = path;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    return listenFd;
+}
+
+void subscribersAccept(void)
+{
+    int fd = accept(listenFd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EAGAIN && errno != EINTR) perror("accept");
+        return;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    subscribers[fd].waitingForWrite = false;
+    printf("gateway: subscriber %d connected\n", fd);
+}
+
+static void subscriberClose(int fd)
+{
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+    close(fd);
+    subscribers.erase(fd);
+    printf("gateway: subscriber %d disconnected\n", fd);
+}
+
+static void setWaitingForWrite(int fd, Subscriber &s, bool waiting)
+{
+    if (s.waitingForWrite == waiting) return;
+    struct epoll_event ev;
+    ev.events = waiting ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.u64 = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+    s.waitingForWrite = waiting;
+}
+
+// return false if the subscriber is closed
+static bool subscriberWrite(int fd, Subscriber &s)
+{
+    while (!s.queue.empty()) {
+        ssize_t n = write(fd, s.queue.data(), s.queue.size());
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            return false;
+        }
+        s.queue.erase(0, n);
+    }
+    setWaitingForWrite(fd, s, !s.queue.empty());
+    return true;
+}
+
+bool subscriberEvent(int fd, uint32_t events)
+{
+    map<int, Subscriber>::iterator it = subscribers.find(fd);
+    if (it == subscribers.end()) return false;
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        // nothing is expected from the subscribers, except closing
+        char buffer[256];
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+            subscriberClose(fd);
+            return true;
+        }
+    }
+    if ((events & EPOLLOUT) && !subscriberWrite(fd, it->second)) {
+        subscriberClose(fd);
+    }
+    return true;
+}
+
+static void queueForAll(const char *data, unsigned length)
+{
+    map<int, Subscriber>::iterator it;
+    for (it = subscribers.begin(); it != subscribers.end(); ++it) {
+        // dropped in subscribersFlush()
+        if (it->second.queue.size() > MAX_QUEUED) continue;
+        it->second.queue.append(data, length);
+    }
+}
+
+void subscribersSendLine(const string &port, const char *line)
+{
+    if (subscribers.empty()) return;
+    string event = "L " + port + " " + line + "\n";
+    queueForAll(event.data(), event.size());
+}
+
+void subscribersSendSample(const Sample &s)
+{
+    if (subscribers.empty()) return;
+    char event[256];
+    int n = snprintf(event, sizeof(event), "D %llu %s %s %.15g\n",
+                     (unsigned long long) s.timeMs, s.mote.c_str(),
+                     s.name.c_str(), s.value);
+    if (n >= (int) sizeof(event)) return;
+    queueForAll(event, n);
+}
+
+void subscribersFlush(void)
+{
+    vector<int> toClose;
+    map<int, Subscriber>::iterator it;
+    for (it = subscribers.begin(); it != subscribers.end(); ++it) {
+        if (it->second.queue.size() > MAX_QUEUED) {
+            fprintf(stderr, "gateway: subscriber %d is too slow\n", it->first);
+            toClose.push_back(it->first);
+        } else if (!it->second.waitingForWrite && !subscriberWrite(it->first, it->second)) {
+            toClose.push_back(it->first);
+        }
+    }
+    for (unsigned i = 0; i < toClose.size(); ++i) {
+        subscriberClose(toClose[i]);
+    }
+}
+
+void subscribersClose(void)
+{
+    while (!subscribers.empty()) {
+        subscriberClose(subscribers.begin()->first);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
@@ -0,0 +1,108 @@
+//
+// Encoder side of recordTest.py: writes a WMP binary record file with
+// mos/wmp/record.c, built for the host against an in-memory FILE.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// replaces fatfs/posix-stdio.h
+#define MANSOS_POSIX_STDIO_H
+#define FILE RecordTestFile_t
+
+typedef struct RecordTestFile_s {
+    uint8_t data[1 << 20];
+    uint32_t fileSize;
+} RecordTestFile_t;
+
+#define fwrite recordTestWrite
+#define fflush recordTestFlush
+
+static size_t recordTestWrite(const void *ptr, size_t size, size_t n, FILE *fp)
+{
+    memcpy(fp->data + fp->fileSize, ptr, size * n);
+    fp->fileSize += size * n;
+    return n;
+}
+
+static int recordTestFlush(FILE *fp)
+{
+    return 0;
+}
+
+#include <wmp/record.c>
+
+#undef FILE
+#undef fwrite
+#undef fflush
+
+// keep in sync with recordTest.py
+static const RecordColumn_t columnsA[] = {
+    { 1, RECORD_TYPE_U16, "light" },
+    { 2, RECORD_TYPE_I32, "temperature" },
+    { 3, 1 | RECORD_TYPE_SIGNED, "delta" },
+};
+
+static const RecordColumn_t columnsB[] = {
+    { 2, RECORD_TYPE_I32, "temperature" },
+    { 4, 1, "battery" },
+};
+
+#define COUNT         3000
+#define SCHEMA_CHANGE 1700
+#define REOPEN        1000
+#define BIG_GAP       500
+
+static uint32_t sampleTime(uint32_t i)
+{
+    return 1400000000u + i * 7 + (i >= BIG_GAP ? 100000 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    static RecordTestFile_t file;
+    RecordWriter_t w;
+    uint32_t i;
+    FILE *out;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+        return 1;
+    }
+
+    recordWriterOpen(&w, &file, true, sampleTime(0));
+    recordWriteSchema(&w, columnsA, 3, sampleTime(0));
+    for (i = 0; i < COUNT; i++) {
+        int32_t values[3];
+        if (i == REOPEN) {
+            // a new session continues the partially written block
+            recordWriterClose(&w);
+            recordWriterOpen(&w, &file, true, sampleTime(i));
+            recordWriteSchema(&w, columnsA, 3, sampleTime(i));
+        }
+        if (i == SCHEMA_CHANGE) {
+            recordWriteSchema(&w, columnsB, 2, sampleTime(i));
+        }
+        if (i < SCHEMA_CHANGE) {
+            values[0] = (i * 13) % 65536;
+            values[1] = (int32_t) i * 1000 - 500000;
+            values[2] = (int32_t) (i % 200) - 100;
+        } else {
+            values[0] = (int32_t) i * -3;
+            values[1] = i % 256;
+        }
+        recordWriteData(&w, values, sampleTime(i));
+    }
+    recordWriterClose(&w);
+
+    out = fopen(argv[1], "wb");
+    if (!out || fwrite(file.data, 1, file.fileSize, out) != file.fileSize) {
+        perror(argv[1]);
+        return 1;
+    }
+    fclose(out);
+    return 0;
+}
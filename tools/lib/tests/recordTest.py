@@ -0,0 +1,79 @@
+#!/usr/bin/python
+
+#
+# WMP binary record round trip test: files written by mos/wmp/record.c
+# (built for the host from recordTest.c) decoded by tools/web/wmprecord.py
+#
+
+import os, sys, tempfile, subprocess
+
+sys.path.append(os.path.join("..", "..", "web"))
+
+import wmprecord
+
+MOSROOT = os.path.join("..", "..", "..", "mos")
+
+# keep in sync with recordTest.c
+COUNT = 3000
+SCHEMA_CHANGE = 1700
+BIG_GAP = 500
+
+def sampleTime(i):
+    return 1400000000 + i * 7 + (100000 if i >= BIG_GAP else 0)
+
+def expectedValues(i):
+    if i < SCHEMA_CHANGE:
+        return [(i * 13) % 65536, i * 1000 - 500000, i % 200 - 100]
+    return [i * -3, i % 256]
+
+tmpdir = tempfile.mkdtemp()
+exe = os.path.join(tmpdir, "recordTest")
+path = os.path.join(tmpdir, "DATA.BIN")
+
+cc = os.environ.get("CC", "cc")
+try:
+    r = subprocess.call([cc, "-w", "-o", exe, "recordTest.c", "-DPLATFORM_PC", "-DCPU_MHZ=1",
+                         "-I" + MOSROOT, "-I" + os.path.join(MOSROOT, "include"),
+                         "-I" + os.path.join(MOSROOT, "arch", "pc"),
+                         "-I" + os.path.join(MOSROOT, "platforms", "pc")])
+except OSError:
+    r = -1
+if r != 0:
+    print("failed to build the encoder with '" + cc + "'")
+    sys.exit(1)
+assert subprocess.call([exe, path]) == 0
+
+with open(path, "rb") as f:
+    data = f.read()
+# several blocks, each starting with an index record
+assert len(data) > 4 * wmprecord.RECORD_BLOCK_SIZE
+for blockStart in range(0, len(data), wmprecord.RECORD_BLOCK_SIZE):
+    assert wmprecord.blockTime(data, blockStart) is not None
+
+records = list(wmprecord.decode(data))
+assert len(records) == COUNT
+for i, (columns, timestamp, values) in enumerate(records):
+    assert timestamp == sampleTime(i), (i, timestamp)
+    assert values == expectedValues(i), (i, values)
+    names = [c.name for c in columns]
+    if i < SCHEMA_CHANGE:
+        assert names == ["light", "temperature", "delta"]
+    else:
+        assert names == ["temperature", "battery"]
+
+# decoding from the block index gives the same records
+since = sampleTime(2500)
+start = wmprecord.findStart(data, since)
+assert start > 0
+tail = [(t, v) for (c, t, v) in wmprecord.decode(data, start) if t >= since]
+assert tail == [(sampleTime(i), expectedValues(i)) for i in range(2500, COUNT)]
+
+lines = []
+wmprecord.toCsv(data, lines.append, sampleTime(10), sampleTime(11))
+assert "".join(lines) == "\ntimestamp,light,temperature,delta,\n" \
+    "%d,130,-490000,-90,\n%d,143,-489000,-89,\n" % (sampleTime(10), sampleTime(11))
+
+os.remove(path)
+os.remove(exe)
+os.rmdir(tmpdir)
+print("OK")
@@ -0,0 +1,50 @@
+#!/usr/bin/python
+
+#
+# Time series store test app (build tools/tsdb first)
+#
+
+import os, sys, tempfile
+
+sys.path.append("..")
+
+import tsdb
+
+if not tsdb.available:
+    print("tsdb library not built, run 'make' in tools/tsdb")
+    sys.exit(1)
+
+path = os.path.join(tempfile.mkdtemp(), "light" + tsdb.TSDB_EXTENSION)
+start = 1400000000000
+samples = [(start + i * 60000 + (i % 7) * 3, float(i % 100) / 4) for i in range(20000)]
+
+# append in two sessions: the second one continues the last chunk
+with tsdb.TimeSeries(path, True) as ts:
+    for t, v in samples[:12345]:
+        ts.append(t, v)
+with tsdb.TimeSeries(path, True) as ts:
+    for t, v in samples[12345:]:
+        ts.append(t, v)
+    try:
+        ts.append(start, 0)
+        assert False, "time going backwards accepted"
+    except IOError:
+        pass
+
+with tsdb.TimeSeries(path) as ts:
+    assert ts.info() == (samples[0][0], samples[-1][0], len(samples))
+    assert ts.read() == samples
+    assert ts.read(samples[100][0], samples[199][0]) == samples[100:200]
+
+    buckets = ts.downsample(samples[0][0], samples[-1][0], 10)
+    assert len(buckets) == 10
+    assert sum(b[4] for b in buckets) == len(samples)
+    assert buckets[0][0] == samples[0][0]
+    assert buckets[0][1] == 0 and buckets[0][2] == 24.75
+
+    # more points than samples: the samples themselves
+    raw = ts.downsample(samples[0][0], samples[9][0], 1000)
+    assert [(b[0], b[3]) for b in raw] == samples[:10]
+
+os.remove(path)
+print("OK")
@@ -0,0 +1,123 @@
+#
+# Python binding of the time series store (tools/tsdb).
+#
+# The library is built with "make" in tools/tsdb; set MANSOS_TSDB_LIBRARY
+# to use a library in other location. If it is not available,
+# 'available' is False and the callers should fall back to the CSV files.
+#
+
+import ctypes
+import os
+
+TSDB_EXTENSION = ".tsd"
+
+
+class TsdbInfo(ctypes.Structure):
+    _fields_ = [("firstTime", ctypes.c_int64),
+                ("lastTime", ctypes.c_int64),
+                ("samples", ctypes.c_uint64),
+                ("chunks", ctypes.c_uint64)]
+
+
+class TsdbBucket(ctypes.Structure):
+    _fields_ = [("time", ctypes.c_int64),
+                ("min", ctypes.c_double),
+                ("max", ctypes.c_double),
+                ("avg", ctypes.c_double),
+                ("count", ctypes.c_uint32),
+                ("reserved", ctypes.c_uint32)]
+
+
+def loadLibrary():
+    path = os.environ.get("MANSOS_TSDB_LIBRARY")
+    if not path:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            "..", "tsdb", "libtsdb.so")
+    try:
+        lib = ctypes.CDLL(path, use_errno=True)
+    except OSError:
+        return None
+
+    lib.tsdbOpen.restype = ctypes.c_void_p
+    lib.tsdbOpen.argtypes = [ctypes.c_char_p, ctypes.c_int]
+    lib.tsdbClose.restype = None
+    lib.tsdbClose.argtypes = [ctypes.c_void_p]
+    lib.tsdbAppend.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_double]
+    lib.tsdbFlush.argtypes = [ctypes.c_void_p]
+    lib.tsdbInfo.argtypes = [ctypes.c_void_p, ctypes.POINTER(TsdbInfo)]
+    lib.tsdbRead.restype = ctypes.c_long
+    lib.tsdbRead.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_int64,
+                             ctypes.POINTER(ctypes.c_int64),
+                             ctypes.POINTER(ctypes.c_double), ctypes.c_long]
+    lib.tsdbDownsample.restype = ctypes.c_long
+    lib.tsdbDownsample.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_int64,
+                                   ctypes.c_long, ctypes.POINTER(TsdbBucket)]
+    return lib
+
+lib = loadLibrary()
+available = lib is not None
+
+MIN_TIME = -(1 << 63)
+MAX_TIME = (1 << 63) - 1
+
+
+def checkResult(result, path):
+    if result < 0:
+        errno = ctypes.get_errno()
+        raise IOError(errno, os.strerror(errno), path)
+    return result
+
+
+class TimeSeries(object):
+    """One series: the samples of a sensor of a mote."""
+
+    def __init__(self, path, writable=False):
+        if lib is None:
+            raise IOError("time series library not available")
+        self.path = path
+        self.handle = lib.tsdbOpen(path.encode("utf-8"), 1 if writable else 0)
+        if not self.handle:
+            errno = ctypes.get_errno()
+            raise IOError(errno, os.strerror(errno), path)
+
+    def close(self):
+        if self.handle:
+            lib.tsdbClose(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    # time in milliseconds since 1970; must not go backwards
+    def append(self, timestamp, value):
+        checkResult(lib.tsdbAppend(self.handle, timestamp, value), self.path)
+
+    def flush(self):
+        checkResult(lib.tsdbFlush(self.handle), self.path)
+
+    # return (first time, last time, number of samples)
+    def info(self):
+        info = TsdbInfo()
+        checkResult(lib.tsdbInfo(self.handle, ctypes.byref(info)), self.path)
+        return info.firstTime, info.lastTime, info.samples
+
+    # return [(time, value)] in time range [start, end]
+    def read(self, start=MIN_TIME, end=MAX_TIME, maxCount=100000):
+        times = (ctypes.c_int64 * maxCount)()
+        values = (ctypes.c_double * maxCount)()
+        n = checkResult(lib.tsdbRead(self.handle, start, end,
+                                     times, values, maxCount), self.path)
+        return list(zip(times[:n], values[:n]))
+
+    # return [(time, min, max, avg, count)], at most 'points' entries
+    def downsample(self, start, end, points):
+        buckets = (TsdbBucket * points)()
+        n = checkResult(lib.tsdbDownsample(self.handle, start, end,
+                                           points, buckets), self.path)
+        return [(b.time, b.min, b.max, b.avg, b.count) for b in buckets[:n]]
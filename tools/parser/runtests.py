@@ -22,7 +22,7 @@
 # OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
 # ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
-import main, sys, os
+import main, sys, os, re
 
 testFileDir = 'tests'
 architecture = 'testarch'
@@ -32,6 +32,9 @@ outputDirName = "build"
 doCompile = False
 compileArch = "telosb"
 
+# totals of the optimization report
+report = {}
+
 def runTest(sourceFileName):
     if not os.path.exists(outputDirName):
         os.makedirs(outputDirName)
@@ -57,6 +60,8 @@ def runTest(sourceFileName):
 
     if ret != 0: return
 
+    reportTest(outputFileName)
+
     # prepend output with the test script
     with open(outputFileName, 'r+') as outputFile:
         contents = outputFile.read()
@@ -72,6 +77,24 @@ def runTest(sourceFileName):
     if doCompile:
         os.system("cd build && make clean && make {}".format(compileArch))
 
+# Code size is approximated by the generated source: lines and function definitions.
+# The cost of a sensor read is the number of condition checks it triggers.
+def reportTest(outputFileName):
+    from seal import generator
+    stats = generator.getOptimizationStatistics()
+    with open(outputFileName, 'r') as f:
+        code = f.read().split("\n")
+    stats["lines"] = len(code)
+    stats["functions"] = len([line for line in code if line == "{"])
+    stats["checksPerRead"] = len([line for line in code if re.match(r"\s*condition\d+Callback\(\);", line)])
+    print ("  {lines} lines, {functions} functions, {checksPerRead} condition checks on sensor reads".format(**stats))
+    print ("  conditions: {evaluatedConditions} of {conditions} evaluated at run time"
+           " ({constantConditions} constant, {sharedConditions} shared);"
+           " {deadBranches} dead branches, {foldedFunctions} functions folded".format(**stats))
+    print ("  take() windows: {fusedWindows} fused, {sharedWindows} aggregates sharing a window".format(**stats))
+    for key in stats:
+        report[key] = report.get(key, 0) + stats[key]
+
 def runTests():
     numTests = 0
     files = os.listdir(testFileDir)
@@ -84,6 +107,12 @@ def runTests():
         numTests += 1
         # break ###
     print ("{} tests successfully executed".format(numTests))
+    if report:
+        print ("total: {lines} lines, {functions} functions, {checksPerRead} condition checks on sensor reads".format(**report))
+        print ("total: {evaluatedConditions} of {conditions} conditions evaluated at run time"
+               " ({constantConditions} constant, {sharedConditions} shared);"
+               " {deadBranches} dead branches, {foldedFunctions} functions folded".format(**report))
+        print ("total: {fusedWindows} take() windows fused, {sharedWindows} aggregates sharing a window".format(**report))
 
 if __name__ == '__main__':
     runTests()
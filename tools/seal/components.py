@@ -75,11 +75,66 @@ def mergeParameters(parameters, additionalParametrs):
             result[p[0]] = p[1]
     return result
 
+# integer division and remainder as in C (rounding toward zero)
+def cDivide(a, b):
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+def cModulo(a, b):
+    return a - b * cDivide(a, b)
+
+# functions computed at compile time when all of their arguments are constant
+constantFunctions = {
+    "abs":        lambda args: abs(args[0]),
+    "neg":        lambda args: -args[0],
+    "min":        lambda args: min(args),
+    "max":        lambda args: max(args),
+    "sum":        lambda args: sum(args),
+    "plus":       lambda args: args[0] + args[1],
+    "add":        lambda args: args[0] + args[1],
+    "minus":      lambda args: args[0] - args[1],
+    "subtract":   lambda args: args[0] - args[1],
+    "multiply":   lambda args: args[0] * args[1],
+    "times":      lambda args: args[0] * args[1],
+    "divide":     lambda args: cDivide(args[0], args[1]),
+    "modulo":     lambda args: cModulo(args[0], args[1]),
+    "difference": lambda args: abs(args[0] - args[1]),
+    "square":     lambda args: args[0] * args[0],
+    "power":      lambda args: args[0] ** args[1] if args[1] >= 0 else None,
+}
+
+# Returns the integer value of a function tree if it consists of constants only, None otherwise
+def foldConstantFunction(functionTree):
+    if len(functionTree.arguments) == 0:
+        if not isinstance(functionTree.function, Value): return None
+        value = functionTree.asConstant()
+        # the generated code uses integer arithmetic
+        if isinstance(value, bool) or not (isinstance(value, int) or isinstance(value, long)):
+            return None
+        return value
+    function = constantFunctions.get(functionTree.function)
+    if function is None: return None
+    args = []
+    for a in functionTree.arguments:
+        value = foldConstantFunction(a)
+        if value is None: return None
+        args.append(value)
+    try:
+        value = function(args)
+    except (ZeroDivisionError, IndexError, ValueError):
+        return None
+    # leave overflows to the run time
+    if value is None or value < -0x80000000 or value > 0x7fffffff:
+        return None
+    return value
+
 ######################################################
 class BranchCollection(object):
     def __init__(self):
         self.branches = {0 : []} # default branch (code 0) is always present
         self.conditions = {0 : []}
+        # branches that can never be entered because of a constant condition
+        self.deadBranches = set()
 
     def addBranch(self, n, conditions):
         # if the branch does not exist, it is initialized to empty list
@@ -90,13 +145,52 @@ class BranchCollection(object):
         self.branches.setdefault(branchNumber, [])
         self.branches[branchNumber].append(useCase)
 
+    # Applies the compile-time values of conditions: branches that can never be
+    # entered are dropped along with their use cases, and conditions that are
+    # known to hold are left out from branch evaluation. Shared conditions
+    # are replaced with the condition that is actually evaluated.
+    def optimize(self, conditionList):
+        for n in self.conditions:
+            if n == 0: continue
+            live = []
+            for c in self.conditions[n]:
+                condition = conditionList[abs(c) - 1]
+                if condition.constantValue is not None:
+                    if bool(condition.constantValue) != (c > 0):
+                        self.deadBranches.add(n)
+                    continue
+                if condition.sharedWith:
+                    c = condition.sharedWith.id if c > 0 else -condition.sharedWith.id
+                live.append(c)
+            self.conditions[n] = live
+
+        for n in self.deadBranches:
+            self.conditions[n] = []
+            for uc in self.branches[n]:
+                if not isinstance(uc, UseCase) or isinstance(uc.component, Output):
+                    continue
+                uc.component.useCases.remove(uc)
+                # keep the value variable for conditions and outputs that refer to it
+                if type(uc.component) is Sensor and len(uc.component.useCases) == 0:
+                    uc.component.markAsUsed()
+            self.branches[n] = []
+
+    def isDead(self, n):
+        return n in self.deadBranches
+
+    # true for branches entered unconditionally (all their conditions are constant)
+    def isAlwaysActive(self, n):
+        return n not in self.deadBranches and len(self.conditions[n]) == 0
+
     def generateCode(self, outputFile):
         for b in self.branches.items():
+            if self.isDead(b[0]): continue
             self.generateStartCode(b, outputFile)
             self.generateStopCode(b, outputFile)
 
     def generateLocalFunctions(self, outputFile):
         for n in self.branches:
+            if self.isDead(n): continue
             outputFile.write("static inline void branch{0}Start(void);\n".format(n))
             if n != 0: outputFile.write("static inline void branch{0}Stop(void);\n".format(n))
 
@@ -107,6 +201,8 @@ class BranchCollection(object):
         outputFile.write("{\n")
         for uc in useCases:
             uc.generateBranchEnterCode(outputFile)
+        if number == 0:
+            componentRegister.schedule.generateBranchEnterCode(outputFile)
         outputFile.write("}\n\n")
 
     def generateStopCode(self, b, outputFile):
@@ -138,6 +234,256 @@ class BranchCollection(object):
         return result
 
 
+######################################################
+def gcd(a, b):
+    while b:
+        a, b = b, a % b
+    return a
+
+def lcm(a, b):
+    return a * b // gcd(a, b)
+
+# Coalesces the periodic alarms of the default branch into a single alarm.
+# The schedule is precomputed over the hyperperiod (the LCM of all periods):
+# every distinct instant in it becomes one table entry with a bitmask of
+# the callbacks due then, so each instant costs one wakeup no matter
+# how many sensors are read. Pre-read (warm-up) callbacks of sync sensors
+# are merged in the same table.
+class AlarmSchedule(object):
+    # limits on the size of the generated table
+    MAX_ENTRIES = 32
+    MAX_CALLBACKS = 32
+
+    def __init__(self):
+        self.callbacks = []
+        self.entries = []
+
+    def isEligible(self, uc):
+        if not isinstance(uc, UseCase): return False
+        if not uc.generateAlarm or isinstance(uc.component, Output): return False
+        # started by their parent use case
+        if uc.parentUseCase: return False
+        if uc.sync or uc.times or uc.duration: return False
+        if not isinstance(uc.period, (int, long)) or uc.period <= 0: return False
+        for (s, readTime) in uc.getPreReads():
+            if readTime >= uc.period: return False
+        return True
+
+    # returns None if the table could be too large
+    def computeEntries(self, members):
+        period = 1
+        for uc in members:
+            period = lcm(period, uc.period)
+        # the number of instants is at most the number of events;
+        # check it before enumerating them, the common period can be huge
+        numEvents = 0
+        for uc in members:
+            numEvents += (period // uc.period) * (1 + len(uc.getPreReads()))
+        if numEvents > self.MAX_ENTRIES: return None
+        callbacks = []
+        events = {}
+        for uc in members:
+            callbacks.append("{0}{1}{2}Callback".format(
+                    uc.component.getNameCC(), uc.branchName, uc.numInBranch))
+            bit = 1 << (len(callbacks) - 1)
+            for t in range(0, period, uc.period):
+                events[t] = events.get(t, 0) | bit
+            for (s, readTime) in uc.getPreReads():
+                callbacks.append("{0}PreReadCallback".format(s.getNameCC()))
+                bit = 1 << (len(callbacks) - 1)
+                for t in range(uc.period - readTime, period, uc.period):
+                    events[t] = events.get(t, 0) | bit
+        instants = sorted(events.keys())
+        entries = []
+        for i in range(len(instants)):
+            if i + 1 < len(instants): delay = instants[i + 1] - instants[i]
+            else: delay = period - instants[i]
+            entries.append((delay, events[instants[i]]))
+        return (callbacks, entries)
+
+    def build(self, branchCollection):
+        members = []
+        candidates = filter(self.isEligible, branchCollection.branches[0])
+        # add the shortest periods first; skip use cases that would make the table too large
+        for uc in sorted(candidates, key = lambda uc: uc.period):
+            table = self.computeEntries(members + [uc])
+            # the ones left out keep their own alarms
+            if table is None or len(table[0]) > self.MAX_CALLBACKS:
+                continue
+            members.append(uc)
+        # keep the order of the program at the instants where several callbacks are due
+        members.sort(key = lambda uc: branchCollection.branches[0].index(uc))
+        (callbacks, entries) = self.computeEntries(members)
+        # a single alarm with nothing to merge gains nothing
+        if len(callbacks) < 2: return
+        self.callbacks = callbacks
+        self.entries = entries
+        for uc in members:
+            uc.scheduled = True
+
+    def isUsed(self):
+        return len(self.entries) != 0
+
+    def generateVariables(self, outputFile):
+        if not self.isUsed(): return
+        outputFile.write("Alarm_t scheduleAlarm;\n")
+        outputFile.write("static uint8_t scheduleCursor;\n")
+
+    def generateLocalFunctions(self, outputFile):
+        if not self.isUsed(): return
+        outputFile.write("void scheduleCallback(void *isFromBranchStart);\n")
+
+    def generateCallbacks(self, outputFile):
+        if not self.isUsed(): return
+        if len(self.callbacks) <= 8: maskType = "uint8_t"
+        elif len(self.callbacks) <= 16: maskType = "uint16_t"
+        else: maskType = "uint32_t"
+
+        outputFile.write("typedef struct ScheduleEntry_s {\n")
+        outputFile.write("    uint32_t delay; // until the next entry, ms\n")
+        outputFile.write("    {0} mask;    // bit N set: call scheduleCallbacks[N]\n".format(maskType))
+        outputFile.write("} ScheduleEntry_t;\n\n")
+
+        outputFile.write("static void (* const scheduleCallbacks[])(void *) = {\n")
+        for c in self.callbacks:
+            outputFile.write("    {0},\n".format(c))
+        outputFile.write("};\n\n")
+
+        outputFile.write("static const ScheduleEntry_t schedule[] = {\n")
+        for (delay, mask) in self.entries:
+            outputFile.write("    {{ {0}, {1:#x} }},\n".format(delay, mask))
+        outputFile.write("};\n\n")
+
+        outputFile.write("void scheduleCallback(void *isFromBranchStart)\n")
+        outputFile.write("{\n")
+        outputFile.write("    const ScheduleEntry_t *entry = &schedule[scheduleCursor];\n")
+        outputFile.write("    if (++scheduleCursor == sizeof(schedule) / sizeof(*schedule)) scheduleCursor = 0;\n")
+        outputFile.write("    alarmSchedule(&scheduleAlarm, entry->delay);\n")
+        outputFile.write("    {0} mask = entry->mask;\n".format(maskType))
+        outputFile.write("    uint8_t i;\n")
+        outputFile.write("    for (i = 0; mask; i++, mask >>= 1) {\n")
+        outputFile.write("        if (mask & 1) scheduleCallbacks[i](isFromBranchStart);\n")
+        outputFile.write("    }\n")
+        outputFile.write("}\n\n")
+
+    def generateAppMainCode(self, outputFile):
+        if not self.isUsed(): return
+        outputFile.write("    alarmInit(&scheduleAlarm, scheduleCallback, NULL);\n")
+
+    def generateBranchEnterCode(self, outputFile):
+        if not self.isUsed(): return
+        # the first entry is the instant 0, i.e. the start of the branch
+        outputFile.write("    scheduleCallback(IS_FROM_BRANCH_START);\n")
+
+
+######################################################
+# A take() window of a sensor read chain. All aggregates of the same window
+# (e.g. min(take(X, 10)) and max(take(X, 10))) share one circular buffer:
+# the source is read once per read of the chain, and a single update
+# function maintains a running sum and computes every aggregate in one pass.
+class StreamWindow(object):
+    aggregateFunctions = ["min", "max", "sum", "avg", "stdev"]
+
+    def __init__(self, name, source, dataType, numToTake, lazy):
+        self.name = name
+        self.source = source
+        self.dataType = dataType
+        self.numToTake = numToTake
+        self.lazy = lazy
+        self.aggregates = []
+
+    def getAggregate(self, outputFile, aggregateFunction):
+        variable = self.name + toTitleCase(aggregateFunction)
+        if aggregateFunction not in self.aggregates:
+            self.aggregates.append(aggregateFunction)
+            # declared here, as the users of the value are written out before the update function
+            outputFile.write("static {0} {1};\n\n".format(self.dataType, variable))
+        return variable
+
+    def needsSum(self):
+        return bool(set(self.aggregates) & set(["sum", "avg", "stdev"]))
+
+    def needsLoop(self):
+        return bool(set(self.aggregates) & set(["min", "max", "stdev"]))
+
+    def generateUpdateFunction(self, outputFile):
+        outputFile.write("static inline void {0}Update(void)\n".format(self.name))
+        outputFile.write("{\n")
+        outputFile.write("    static {0} values[{1}];\n".format(self.dataType, self.numToTake))
+        outputFile.write("    static uint16_t valuesCursor;\n")
+        if self.needsSum():
+            outputFile.write("    static int32_t valuesSum;\n")
+        outputFile.write("    bool b = false, *isFilteredOut = &b;\n")
+        outputFile.write("    {0} tmp = {1};\n".format(self.dataType, self.source))
+        outputFile.write("    if (!*isFilteredOut) {\n")
+        if self.needsSum():
+            outputFile.write("        valuesSum += tmp - values[valuesCursor];\n")
+        outputFile.write("        values[valuesCursor] = tmp;\n")
+        outputFile.write("        valuesCursor = (valuesCursor + 1) % {};\n".format(self.numToTake))
+        outputFile.write("    }\n")
+        if self.lazy:
+            outputFile.write("    if (valuesCursor != 0) return;\n")
+        if "sum" in self.aggregates:
+            outputFile.write("    {0}Sum = valuesSum;\n".format(self.name))
+        if "avg" in self.aggregates or "stdev" in self.aggregates:
+            outputFile.write("    int32_t average = valuesSum / {};\n".format(self.numToTake))
+        if "avg" in self.aggregates:
+            outputFile.write("    {0}Avg = average;\n".format(self.name))
+        if not self.needsLoop():
+            outputFile.write("}\n\n")
+            return
+
+        # the rest of aggregates in a single pass over the window
+        if "min" in self.aggregates:
+            outputFile.write("    {0} minimum = values[0];\n".format(self.dataType))
+        if "max" in self.aggregates:
+            outputFile.write("    {0} maximum = values[0];\n".format(self.dataType))
+        if "stdev" in self.aggregates:
+            outputFile.write("    int32_t deviation = 0;\n")
+        outputFile.write("    uint16_t i;\n")
+        outputFile.write("    for (i = 0; i < {}; ++i) {}\n".format(self.numToTake, '{'))
+        if "min" in self.aggregates:
+            outputFile.write("        if (values[i] < minimum) minimum = values[i];\n")
+        if "max" in self.aggregates:
+            outputFile.write("        if (values[i] > maximum) maximum = values[i];\n")
+        if "stdev" in self.aggregates:
+            outputFile.write("        int32_t d = values[i] - average;\n")
+            outputFile.write("        deviation += d < 0 ? -d : d;\n")
+        outputFile.write("    }\n")
+        if "min" in self.aggregates:
+            outputFile.write("    {0}Min = minimum;\n".format(self.name))
+        if "max" in self.aggregates:
+            outputFile.write("    {0}Max = maximum;\n".format(self.name))
+        if "stdev" in self.aggregates:
+            outputFile.write("    {0}Stdev = deviation / {1};\n".format(self.name, self.numToTake))
+        outputFile.write("}\n\n")
+
+# The state of the sensor read chain being generated: its take() windows,
+# in the order their update functions must run (inner windows first).
+class ReadChain(object):
+    def __init__(self):
+        self.windows = {}
+        self.windowList = []
+        # windows inside a branch of if() are read only when the branch is taken
+        self.conditionalDepth = 0
+
+    def canFuse(self):
+        return self.conditionalDepth == 0
+
+    def findWindow(self, key):
+        return self.windows.get(key)
+
+    def addWindow(self, key, window):
+        self.windows[key] = window
+        self.windowList.append(window)
+        componentRegister.numFusedWindows += 1
+
+    def generateUpdateFunctions(self, outputFile):
+        for w in self.windowList:
+            w.generateUpdateFunction(outputFile)
+        return [w.name + "Update()" for w in self.windowList]
+
+
 ######################################################
 class UseCase(object):
     def __init__(self, component):
@@ -186,6 +532,8 @@ class UseCase(object):
             self.parameters[paramName] = p[1]
 
         self.readFunctionSuffix = ""
+        # set when the alarm is coalesced in the common schedule
+        self.scheduled = False
         self.conditions = list(conditions)
         self.branchNumber = branchNumber
         if numInBranch == 0:
@@ -331,14 +679,25 @@ class UseCase(object):
                 "#define {0}_PERIOD{1}    {2}\n".format(
                     ucname, self.numInBranch, self.period))
 
+    # subsensors that must be warmed up before each periodic read: list of (sensor, readTime)
+    def getPreReads(self):
+        if not self.period or type(self.component) is not Sensor \
+                or not self.component.syncOnlySensor:
+            return []
+        result = []
+        for s in self.component.subsensors:
+            if s.getParameterValue("preReadFunction") is None: continue
+            if s.specification._readTime == 0: continue
+            result.append((s, s.specification._readTime))
+        return result
+
     def generateVariables(self, outputFile):
-        if self.generateAlarm:
+        if self.generateAlarm and not self.scheduled:
             outputFile.write(
                 "Alarm_t {0}{1}Alarm{2};\n".format(
                     self.component.getNameCC(), self.branchName, self.numInBranch))
-            if type(self) is Sensor:
-                for s in self.component.subsensors:
-                    outputFile.write("Alarm_t {0}PreAlarm;\n".format(s.getNameCC()))
+            for (s, readTime) in self.getPreReads():
+                outputFile.write("Alarm_t {0}PreAlarm;\n".format(s.getNameCC()))
 
     def generateOutCode(self, outputFile):
         p = self.parameters.get("out")
@@ -518,11 +877,8 @@ class UseCase(object):
                             onFunc = s.getParameterValue("onFunction")
                             if onFunc:
                                 outputFile.write("    {};\n".format(onFunc))
-                    if self.period:
-                        for s in self.component.subsensors:
-                            if s.getParameterValue("preReadFunction") is None: continue
-                            preReadTime = s.specification._readTime
-                            if preReadTime == 0: continue
+                    if not self.scheduled:
+                        for (s, preReadTime) in self.getPreReads():
                             outputFile.write("    alarmSchedule(&{0}PreAlarm, {2}_PERIOD{1} - {3});\n".format(
                                     s.getNameCC(), self.numInBranch, ucname, preReadTime))
                     outputFile.write("    bool isFilteredOut = false;\n")
@@ -593,6 +949,8 @@ class UseCase(object):
 
             if self.component.isRemote() or self.interruptBased:
                 pass
+            elif self.scheduled:
+                pass # rescheduled by the common schedule
             elif self.once:
                 pass
             elif self.period:
@@ -618,10 +976,10 @@ class UseCase(object):
         ccname = self.component.getNameCC()
         ccname += self.branchName
         if self.generateAlarm:
-            outputFile.write("    alarmInit(&{0}Alarm{1}, {0}{1}Callback, NULL);\n".format(
-                   ccname, self.numInBranch))
-            if type(self) is Sensor:
-                for s in self.component.subsensors:
+            if not self.scheduled:
+                outputFile.write("    alarmInit(&{0}Alarm{1}, {0}{1}Callback, NULL);\n".format(
+                       ccname, self.numInBranch))
+                for (s, readTime) in self.getPreReads():
                     outputFile.write("    alarmInit(&{0}PreAlarm, {0}PreReadCallback, NULL);\n".format(s.getNameCC()))
         elif self.component.isRemote():
             if len(self.component.remoteFields) > 1:
@@ -653,6 +1011,8 @@ class UseCase(object):
     def generateBranchEnterCode(self, outputFile):
         # if this UC has parent, the parent will generate first call instead
         if self.parentUseCase: return
+        # started together with the common schedule
+        if self.scheduled: return
 
         if self.generateAlarm:
             if isinstance(self.component, Output):
@@ -1230,11 +1590,11 @@ class Sensor(Component):
 
     def generateMaxFunction(self, outputFile, functionTree, root):
         if len(functionTree.arguments) == 1:
-            return self.generateUnaryMaxFunction(outputFile, functionTree, root)
             if functionTree.arguments[0].function == "take":
                 return self.generateTakeFunction(outputFile, functionTree.arguments[0], "max")
             if functionTree.arguments[0].function == "tuple":
                 return self.generateTupleFunction(outputFile, functionTree.arguments[0], "max")
+            return self.generateUnaryMaxFunction(outputFile, functionTree, root)
         return self.generateNaryMaxFunction(outputFile, functionTree, root)
 
     def generateSquareFunction(self, outputFile, functionTree, root):
@@ -1298,9 +1658,8 @@ class Sensor(Component):
             componentRegister.userError("2nd argument of EWMA() function is expected to be a constant!\n")
             return ""
 
-        # TODO: improve this
-        numerator = int(100 * alpha)
-        denominator = 100
+        # alpha in 8-bit fixed point: a shift instead of divisions
+        numerator = int(round(256 * alpha))
 
         funName = self.getGeneratedFunctionName("EWMA")
         outputFile.write("static inline {0} {1}(bool *__unused)\n".format(self.getDataType(), funName))
@@ -1310,8 +1669,8 @@ class Sensor(Component):
         outputFile.write("    {0} value = {1};\n".format(self.getDataType(), subReadFunction))
         # S_t = Y_t * alpha + S_{t-1} * (1 - alpha)
         outputFile.write("    if (!*isFilteredOut) {\n")
-        outputFile.write("        ewmaValue = value * {} / {} + ewmaValue * {} / {};\n".format(
-                numerator, denominator, denominator - numerator, denominator))
+        outputFile.write("        ewmaValue = ((int32_t) value * {} + (int32_t) ewmaValue * {}) >> 8;\n".format(
+                numerator, 256 - numerator))
         outputFile.write("    }\n")
         outputFile.write("    return ewmaValue;\n")
         outputFile.write("}\n\n")
@@ -1667,10 +2026,13 @@ class Sensor(Component):
     def generateIfFunction(self, outputFile, functionTree, root):
         conditionFunction = self.generateSubReadFunctions(
             outputFile, functionTree.arguments[0], root)
+        chain = componentRegister.readChain
+        if chain: chain.conditionalDepth += 1
         ifFunction = self.generateSubReadFunctions(
             outputFile, functionTree.arguments[1], root)
         elseFunction = self.generateSubReadFunctions(
             outputFile, functionTree.arguments[2], root)
+        if chain: chain.conditionalDepth -= 1
 
         funName = self.getGeneratedFunctionName("If")
         outputFile.write("static inline {0} {1}(bool *isFilteredOut)\n".format(self.getDataType(), funName))
@@ -1695,25 +2057,44 @@ class Sensor(Component):
         return funName + "(isFilteredOut)"
 
     def generateTakeFunction(self, outputFile, functionTree, aggregateFunction):
-        subReadFunction = self.generateSubReadFunctions(
-            outputFile, functionTree.arguments[0], None)
-
         numToTake = functionTree.arguments[1].asConstant()
         if numToTake is None:
             componentRegister.userError("Second argument of take() function is expected to be a constant!\n")
             return ""
 
+        timeToTake = None
         if len(functionTree.arguments) > 2:
             timeToTake = functionTree.arguments[2].asConstant()
-            if timeToTake:
-                # generate takeRecent function;
-                # ignore "lazy" parameter in that case.
-                return self.generateTakeRecentFunction(outputFile,
-                                                       subReadFunction, aggregateFunction,
-                                                       numToTake, timeToTake)
 
         lazy = getUseCaseParameterValue("lazy", self.sensorReadFunctionParams)
 
+        if aggregateFunction == "average": aggregateFunction = "avg"
+        if aggregateFunction == "std": aggregateFunction = "stdev"
+        chain = componentRegister.readChain
+        if not timeToTake and chain and chain.canFuse() \
+                and aggregateFunction in StreamWindow.aggregateFunctions:
+            key = (self.name, functionTree.arguments[0].generateSensorName(), numToTake, bool(lazy))
+            window = chain.findWindow(key)
+            if window is None:
+                source = self.generateSubReadFunctions(
+                    outputFile, functionTree.arguments[0], None)
+                window = StreamWindow(self.getGeneratedFunctionName("window"), source,
+                                      self.getDataType(), numToTake, lazy)
+                chain.addWindow(key, window)
+            else:
+                componentRegister.numSharedWindows += 1
+            return window.getAggregate(outputFile, aggregateFunction)
+
+        subReadFunction = self.generateSubReadFunctions(
+            outputFile, functionTree.arguments[0], None)
+
+        if timeToTake:
+            # generate takeRecent function;
+            # ignore "lazy" parameter in that case.
+            return self.generateTakeRecentFunction(outputFile,
+                                                   subReadFunction, aggregateFunction,
+                                                   numToTake, timeToTake)
+
         staticIfLazy = "static " if lazy else ""
 
         funName = self.getGeneratedFunctionName("take" + toTitleCase(aggregateFunction))
@@ -1988,6 +2369,12 @@ class Sensor(Component):
             componentRegister.userError(errorMessage)
             return "0"
 
+        # no helper function is needed if the result is known already
+        constant = foldConstantFunction(functionTree)
+        if constant is not None:
+            componentRegister.numFoldedFunctions += 1
+            return str(constant)
+
         # run through the tree and generate all needed
         if functionTree.function == "abs":
             return self.generateAbsFunction(outputFile, functionTree, root)
@@ -2075,31 +2462,24 @@ class Sensor(Component):
         if useCase: self.sensorReadFunctionParams = useCase.parameters
         else: self.sensorReadFunctionParams = self.parameters
 
+        componentRegister.readChain = ReadChain()
         subReadFunction = self.generateSubReadFunctions(
             outputFile, self.functionTree, self)
+        windowUpdates = componentRegister.readChain.generateUpdateFunctions(outputFile)
+        componentRegister.readChain = None
 
-        if self.cacheNeeded:
-            outputFile.write("static inline {0} {1}CacheReadProcess{2}(bool *isFilteredOut)\n".format(
-                    self.getDataType(), self.getNameCC(), readFunctionSuffix))
-            outputFile.write("{\n")
-            outputFile.write("    return {};\n".format(subReadFunction))
-            outputFile.write("}\n\n")
-
-        # generate reading and processing function
+        # generate reading and processing function; when the sensor is cached,
+        # only its raw value comes from the cache (see getRawReadFunction()),
+        # the processing and take() windows run on every read
         outputFile.write("static inline {0} {1}ReadProcess{2}(bool *isFilteredOut)\n".format(
                 self.getDataType(), self.getNameCC(), readFunctionSuffix))
         outputFile.write("{\n")
 
         # HERE: turn on/off? use associated componenent?
 
-        if self.cacheNeeded:
-            # TODO: in some cases this will lead to double read from cache (inefficient)
-            dataFormat = str(self.getDataSize() * 8)
-            outputFile.write("    return cacheReadSensor{0}({1}, &{2}CacheReadProcess{3}, {4}, isFilteredOut);\n".format(
-                dataFormat, self.cacheNumber, self.getNameCC(),
-                readFunctionSuffix, self.minUpdatePeriod))
-        else:
-            outputFile.write("    return {};\n".format(subReadFunction))
+        for u in windowUpdates:
+            outputFile.write("    {};\n".format(u))
+        outputFile.write("    return {};\n".format(subReadFunction))
 
         outputFile.write("}\n\n")
 
@@ -2263,7 +2643,7 @@ class OutputUseCase(object):
         headerField = 0
         numField = 1
         for f in self.packetFields:
-            if f.sensorID >= numField * 32:
+            if f.sensorID >= numField * 31:
                 headerField |= 1 << 31
                 outputFile.write("#define {}_TYPE_MASK {:#x}\n".format(self.getNameUC(), headerField))
                 outputFile.write(getIndent(indent + 1) + "uint32_t typeMask{};\n".format(numField))
@@ -2271,7 +2651,7 @@ class OutputUseCase(object):
                 headerField = 0
                 numField += 1
             bit = f.sensorID
-            bit -= 32 * (numField - 1)
+            bit -= 31 * (numField - 1)
             if (f.sensorID >= PACKET_FIELD_ID_FIRST_FREE):
                 headerField |= (1 << bit)
         if headerField:
@@ -2970,9 +3350,14 @@ class ComponentRegister(object):
         self.virtualComponents = {}
         self.patterns = {}
         self.numCachedSensors = 0
+        self.numFoldedFunctions = 0
+        self.numFusedWindows = 0
+        self.numSharedWindows = 0
+        self.readChain = None
         self.additionalConfig = set()
         self.extraSourceFiles = []
         self.branchCollection = BranchCollection()
+        self.schedule = AlarmSchedule()
         self.allSensorNames = dict(commonFields)
         self.isError = False
         self.architecture = architecture
@@ -3405,6 +3790,7 @@ class ComponentRegister(object):
             s.generateVariables(outputFile)
         for p in self.patterns.values():
             p.generateVariables(outputFile)
+        self.schedule.generateVariables(outputFile)
 
     def getAllComponents(self):
         return set(self.actuators.values()).union(set(self.sensors.values())).union(set(self.outputs.values()))
@@ -3414,6 +3800,10 @@ class ComponentRegister(object):
             if s.syncOnlySensor:
                 s.addSubsensors()
 
+    def buildSchedule(self):
+        self.schedule = AlarmSchedule()
+        self.schedule.build(self.branchCollection)
+
     def markCachedSensors(self):
         self.numCachedSensors = 0
         for s in self.sensors.values():
@@ -98,8 +98,11 @@ class Generator(object):
 
     def generateVariables(self):
         self.outputFile.write("int8_t conditionStatus[NUM_CONDITIONS] = {\n")
-        for i in range(components.conditionCollection.totalConditions()):
-            self.outputFile.write("    -1,\n")
+        for c in components.conditionCollection.conditionList:
+            if c.constantValue is None:
+                self.outputFile.write("    -1,\n")
+            else:
+                self.outputFile.write("    {},\n".format(int(bool(c.constantValue))))
         self.outputFile.write("};\n")
         self.outputFile.write("bool branchStatus[NUM_BRANCHES] = {true};\n")
         components.componentRegister.generateVariables(self.outputFile)
@@ -113,6 +116,7 @@ class Generator(object):
             c.generateLocalFunctions(self.outputFile)
         components.componentRegister.branchCollection.generateLocalFunctions(self.outputFile)
         components.conditionCollection.generateLocalFunctions(self.outputFile)
+        components.componentRegister.schedule.generateLocalFunctions(self.outputFile)
 
     def generateOutputCode(self):
         sensorsUsed = []
@@ -135,10 +139,15 @@ class Generator(object):
         for n in self.networkComponents:
             n.generateReadFunctions(self.outputFile)
 
+        components.componentRegister.schedule.generateCallbacks(self.outputFile)
+
     def generateConditions(self):
         # branch evaluation functions
-        for i in range(1, components.componentRegister.branchCollection.getNumBranches()):
-            conditions = components.componentRegister.branchCollection.getConditions(i)
+        branchCollection = components.componentRegister.branchCollection
+        for i in range(1, branchCollection.getNumBranches()):
+            if branchCollection.isDead(i) or branchCollection.isAlwaysActive(i):
+                continue
+            conditions = branchCollection.getConditions(i)
             self.outputFile.write("static inline bool branch{}Evaluate(void) {}\n".format(i, '{'))
             self.outputFile.write("    if ({}) return branchStatus[{}];\n".format(
                     formatConditionsUndefined(conditions), i))
@@ -165,15 +174,25 @@ class Generator(object):
         # generate component initialization code
         for c in self.components:
             c.generateAppMainCode(self.outputFile)
+        components.componentRegister.schedule.generateAppMainCode(self.outputFile)
 
         # evaluate all static conditions
         components.conditionCollection.generateAppMainCode(self.outputFile)
 
         # start all active branches
-        if (components.componentRegister.branchCollection.getNumBranches() > 1):
-            self.outputFile.write("    bool newBranchStatus;\n")
+        branchCollection = components.componentRegister.branchCollection
+        for br in range(1, branchCollection.getNumBranches()):
+            if not branchCollection.isDead(br) and not branchCollection.isAlwaysActive(br):
+                self.outputFile.write("    bool newBranchStatus;\n")
+                break
         self.outputFile.write("    branch0Start();\n")
-        for br in range(1, components.componentRegister.branchCollection.getNumBranches()):
+        for br in range(1, branchCollection.getNumBranches()):
+            if branchCollection.isDead(br):
+                continue
+            if branchCollection.isAlwaysActive(br):
+                self.outputFile.write("    branchStatus[{}] = true;\n".format(br))
+                self.outputFile.write("    branch{}Start();\n".format(br))
+                continue
             self.outputFile.write("    newBranchStatus = branch{}Evaluate();\n".format(br))
             self.outputFile.write("    if (newBranchStatus) {\n")
             self.outputFile.write("        branchStatus[{}] = true;\n".format(br))
@@ -223,20 +242,33 @@ class Generator(object):
 #        self.outputFile.write("        }\n")
 #        self.outputFile.write("    }\n")
 
-        self.outputFile.write("    for (;;) {\n")
-        self.outputFile.write("        msleep(10000);\n")
-        self.outputFile.write("    }\n")
+        self.generateMainLoop(self.outputFile)
         self.outputFile.write("}\n")
 
+    def generateMainLoop(self, outputFile):
+        # aggregated SEAL packets are sent from here, not from the alarm;
+        # the alarm wakes this loop up with msleepCancel()
+        outputFile.write("    for (;;) {\n")
+        outputFile.write("        msleep(10000);\n")
+        outputFile.write("#if SEAL_AGGREGATION_DELAY\n")
+        outputFile.write("        sealNetAggregatePoll();\n")
+        outputFile.write("#endif\n")
+        outputFile.write("    }\n")
+
     def generate(self, outputFile):
         self.outputFile = outputFile
 
         # generate condition code now, for later use
         components.conditionCollection.generateCode(components.componentRegister)
+        # drop branches that can never be entered, simplify the rest
+        components.componentRegister.branchCollection.optimize(
+            components.conditionCollection.conditionList)
         # find out the sensors that should be cached
         components.componentRegister.markCachedSensors()
         # find out the sensors that should synched
         components.componentRegister.markSyncSensors()
+        # coalesce periodic alarms in a single schedule
+        components.componentRegister.buildSchedule()
 
         self.components = components.componentRegister.getAllComponents()
         self.outputs = []
@@ -373,8 +405,10 @@ endif
 
         with open(os.path.join(path, 'main.c'), 'w') as outputFile:
             outputFile.write("#include <stdmansos.h>\n")
+            outputFile.write("#include <net/seal_networking.h>\n")
             outputFile.write("\n")
             outputFile.write("void appMain(void) {\n")
+            self.generateMainLoop(outputFile)
             outputFile.write("}\n")
 
     def generateCollectorCode(self, path, pathToOS):
@@ -395,8 +429,10 @@ endif
 
         with open(os.path.join(path, 'main.c'), 'w') as outputFile:
             outputFile.write("#include <stdmansos.h>\n")
+            outputFile.write("#include <net/seal_networking.h>\n")
             outputFile.write("\n")
             outputFile.write("void appMain(void) {\n")
+            self.generateMainLoop(outputFile)
             outputFile.write("}\n")
 
     def generateRaw2Csv(self, path, templatePath):
@@ -436,3 +472,20 @@ def createGenerator(targetOS):
     if targetOS == "contiki":
         return ContikiGenerator()
     return None
+
+###############################################
+# Results of the compile-time optimizations for the last generated program
+def getOptimizationStatistics():
+    conditionCollection = components.conditionCollection
+    conditions = conditionCollection.conditionList
+    evaluated = [c for c in conditions if getattr(c, "id", None) and conditionCollection.isEvaluated(c)]
+    return {
+        "conditions": len(conditions),
+        "evaluatedConditions": len(evaluated),
+        "constantConditions": len([c for c in conditions if getattr(c, "constantValue", None) is not None]),
+        "sharedConditions": len([c for c in conditions if getattr(c, "sharedWith", None)]),
+        "deadBranches": len(components.componentRegister.branchCollection.deadBranches),
+        "foldedFunctions": components.componentRegister.numFoldedFunctions,
+        "fusedWindows": components.componentRegister.numFusedWindows,
+        "sharedWindows": components.componentRegister.numSharedWindows,
+    }
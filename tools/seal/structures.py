@@ -85,6 +85,27 @@ def typeIsString(s):
         return isinstance(s, unicode)
     return False
 
+# comparison operators allowed in conditions, for constant folding
+comparisonOperators = {
+    '==': lambda a, b: a == b,
+    '!=': lambda a, b: a != b,
+    '<':  lambda a, b: a < b,
+    '>':  lambda a, b: a > b,
+    '<=': lambda a, b: a <= b,
+    '>=': lambda a, b: a >= b,
+}
+
+# the value of a condition operand, if it is known at compile time; None otherwise
+def getConstantValue(operand):
+    if operand is None or not hasattr(operand, "getConstantValue"):
+        return None
+    return operand.getConstantValue()
+
+def formatConstant(value):
+    if isinstance(value, bool):
+        return "true" if value else "false"
+    return str(value)
+
 ######################################################
 class FunctionTree(object):
     def __init__(self, function, arguments):
@@ -198,11 +219,36 @@ class ConditionCollection(object):
         # for optimization, should return as soon as isFilteredOut becomes true.
         condition = self.conditionList[i]
         condition.id = i + 1
+        condition.constantValue = condition.getConstantValue()
+        condition.sharedWith = None
         return "    int8_t result = (bool)" + condition.getEvaluationCode(componentRegister)
 
     def generateCode(self, componentRegister):
         for i in range(len(self.conditionList)):
             self.codeList.append(self.generateCodeForCondition(i, componentRegister))
+        self.shareConditions()
+
+    # A condition that has the same code as an earlier one is not evaluated separately;
+    # branches use the status of the earlier condition instead.
+    # Only conditions on periodic sensors (or on nothing at all) are shared,
+    # as the others are also evaluated from interrupts, states or network callbacks.
+    def shareConditions(self):
+        first = {}
+        for i in range(len(self.conditionList)):
+            condition = self.conditionList[i]
+            if condition.constantValue is not None: continue
+            if condition.dependentOnStates or condition.dependentOnRemoteSensors \
+                    or condition.dependentOnInterrupts or condition.dependentOnPackets:
+                continue
+            code = self.codeList[i]
+            if code in first:
+                condition.sharedWith = first[code]
+            else:
+                first[code] = condition
+
+    # constant and shared conditions need no code of their own
+    def isEvaluated(self, condition):
+        return condition.constantValue is None and condition.sharedWith is None
 
     def writeOutCodeForEventBasedCondition(self, condition, outputFile, branchCollection):
         if condition.dependentOnPeriodicSensors or condition.dependentOnStates:
@@ -253,7 +299,8 @@ class ConditionCollection(object):
 
     def writeOutCode(self, outputFile, branchCollection):
         for c in self.conditionList:
-            self.writeOutCodeForCondition(c, outputFile, branchCollection)
+            if self.isEvaluated(c):
+                self.writeOutCodeForCondition(c, outputFile, branchCollection)
 
     def generateLocalFunctionsForCondition(self, condition, outputFile):
         if condition.dependentOnPeriodicSensors or condition.dependentOnStates:
@@ -269,11 +316,12 @@ class ConditionCollection(object):
 
     def generateLocalFunctions(self, outputFile):
         for c in self.conditionList:
-            self.generateLocalFunctionsForCondition(c, outputFile)
+            if self.isEvaluated(c):
+                self.generateLocalFunctionsForCondition(c, outputFile)
 
     def onSensorRead(self, outputFile, sensorName):
         for c in self.conditionList:
-            if sensorName in c.dependentOnPeriodicSensors:
+            if self.isEvaluated(c) and sensorName in c.dependentOnPeriodicSensors:
                 outputFile.write("        condition{}Callback();\n".format(c.id))
 
     def generateAppMainCodeForCondition(self, condition, outputFile):
@@ -304,7 +352,8 @@ class ConditionCollection(object):
         if len(self.conditionList):
             outputFile.write("\n")
         for c in self.conditionList:
-            self.generateAppMainCodeForCondition(c, outputFile)
+            if self.isEvaluated(c):
+                self.generateAppMainCodeForCondition(c, outputFile)
         if len(self.conditionList):
             outputFile.write("\n")
 
@@ -355,6 +404,16 @@ class Value(object):
             s += self.suffix
         return s
 
+    def getConstantValue(self):
+        if isinstance(self.value, SealValue):
+            return self.value.getConstantValue()
+        if isinstance(self.value, bool):
+            return self.value
+        if isinstance(self.value, int) or isinstance(self.value, long) \
+                or isinstance(self.value, float):
+            return self.getRawValue()
+        return None
+
     def getCodeForGenerator(self, componentRegister, condition, inParameter):
         # print " Value", self.value
         if type(self.value) is SealValue:
@@ -408,6 +467,12 @@ class SealValue(object):
             result += self.secondPart
         return result
 
+    def getConstantValue(self):
+        # constants are resolved already by the parser; anything else is a sensor, state or field
+        if isinstance(self.firstPart, Value):
+            return self.firstPart.getConstantValue()
+        return None
+
     def getCodeForGenerator(self, componentRegister, condition, inParameter):
         if isinstance(self.firstPart, Value):
             return self.firstPart.getCode()
@@ -498,8 +563,42 @@ class Expression(object):
             return self.right.getCode()
         return self.right
 
+    # Returns the value of the expression if it can be computed at compile time, None otherwise.
+    # Logical operators are folded also when only one operand is constant and decides the result.
+    def getConstantValue(self):
+        op = self.op.lower() if self.op else None
+        if self.left is not None and self.right is not None:
+            left = getConstantValue(self.left)
+            right = getConstantValue(self.right)
+            if op == 'and' or op == 'or':
+                decisive = (op == 'or')
+                if left is not None and bool(left) == decisive: return decisive
+                if right is not None and bool(right) == decisive: return decisive
+                if left is not None and right is not None: return not decisive
+                return None
+            if left is None or right is None: return None
+            if op in comparisonOperators:
+                return comparisonOperators[op](left, right)
+            return None
+        if op == 'not':
+            right = getConstantValue(self.right)
+            if right is None: return None
+            return not right
+        if op is not None:
+            return None
+        return getConstantValue(self.right)
+
     def getCodeForGenerator(self, componentRegister, condition, inParameter):
         # print "getCodeForGenerator", self.right, self.op, self.left
+        constant = self.getConstantValue()
+        if constant is not None:
+            return formatConstant(constant)
+        if self.left != None and self.right != None and self.op.lower() in ('and', 'or'):
+            # the constant operand (if any) does not decide the result, so it can be dropped
+            if getConstantValue(self.left) is not None:
+                return self.right.getCodeForGenerator(componentRegister, condition, inParameter)
+            if getConstantValue(self.right) is not None:
+                return self.left.getCodeForGenerator(componentRegister, condition, inParameter)
         if self.left != None and self.right != None:
             result = self.left.getCodeForGenerator(componentRegister, condition, inParameter)
             result += " " + self.op + " "
@@ -0,0 +1,256 @@
+#!/usr/bin/env python
+
+#
+# Binary log decoder: reconstructs PRINTF/TPRINTF text output
+# of applications built with USE_BINARY_LOG=y (see mos/lib/binlog.h).
+#
+# Usage:
+#   binlog.py -e build/telosb/image.elf -s /dev/ttyUSB0
+#   binlog.py -e build/pc/App.exe < captured-output.bin
+#
+
+import re
+import struct
+import sys
+import argparse
+
+BINLOG_MAGIC = 0x1e
+BINLOG_FLAG_TIMED = 0x80
+ANCHOR_SYMBOL = "binlogAnchor"
+
+SHF_ALLOC = 0x2
+SHT_NOBITS = 8
+SHT_SYMTAB = 2
+
+# C type sizes on the supported architectures (by ELF e_machine)
+TYPE_SIZES = {
+    105: {'int': 2, 'long': 4, 'longlong': 8, 'ptr': 2, 'double': 4},  # MSP430
+    83:  {'int': 2, 'long': 4, 'longlong': 8, 'ptr': 2, 'double': 4},  # AVR
+    3:   {'int': 4, 'long': 4, 'longlong': 8, 'ptr': 4, 'double': 8},  # i386
+    62:  {'int': 4, 'long': 8, 'longlong': 8, 'ptr': 8, 'double': 8},  # x86-64
+}
+
+CONVERSION_RE = re.compile(
+    r"%([-+ #0]*)(\d+|\*)?(?:\.(\d+|\*))?(hh|h|ll|l|z|j|t|L)?([diouxXcspfFeEgGaA%])")
+
+
+class ElfImage(object):
+    """Minimal ELF reader: allocated sections and symbol table."""
+
+    def __init__(self, filename):
+        with open(filename, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("not an ELF file: " + filename)
+        self.is64 = self.data[4] == 2 or self.data[4] == b"\x02"
+        if self.is64:
+            (self.machine,) = struct.unpack_from("<H", self.data, 18)
+            shoff, = struct.unpack_from("<Q", self.data, 40)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 58)
+        else:
+            (self.machine,) = struct.unpack_from("<H", self.data, 18)
+            shoff, = struct.unpack_from("<I", self.data, 32)
+            shentsize, shnum = struct.unpack_from("<HH", self.data, 46)
+        self.sections = []
+        for i in range(shnum):
+            off = shoff + i * shentsize
+            if self.is64:
+                (name, stype, flags, addr, offset, size, link, info, align,
+                 entsize) = struct.unpack_from("<IIQQQQIIQQ", self.data, off)
+            else:
+                (name, stype, flags, addr, offset, size, link, info, align,
+                 entsize) = struct.unpack_from("<IIIIIIIIII", self.data, off)
+            self.sections.append((stype, flags, addr, offset, size, link, entsize))
+
+    def symbols(self):
+        """Yield (name, value, size, type) of the symbol table entries."""
+        for (stype, flags, addr, offset, size, link, entsize) in self.sections:
+            if stype != SHT_SYMTAB:
+                continue
+            strtab = self.sections[link]
+            for i in range(size // entsize):
+                off = offset + i * entsize
+                if self.is64:
+                    name, info, other, shndx, value, symsize = \
+                        struct.unpack_from("<IBBHQQ", self.data, off)
+                else:
+                    name, value, symsize, info, other, shndx = \
+                        struct.unpack_from("<IIIBBH", self.data, off)
+                start = strtab[3] + name
+                end = self.data.index(b"\0", start)
+                yield self.data[start:end].decode("latin-1"), value, symsize, info & 0xf
+
+    def findSymbol(self, wanted):
+        for name, value, size, symtype in self.symbols():
+            if name == wanted:
+                return value
+        return None
+
+    def readString(self, address):
+        for (stype, flags, addr, offset, size, link, entsize) in self.sections:
+            if not (flags & SHF_ALLOC) or stype == SHT_NOBITS:
+                continue
+            if addr <= address < addr + size:
+                start = offset + address - addr
+                end = self.data.index(b"\0", start)
+                return self.data[start:end].decode("latin-1")
+        return None
+
+
+class Decoder(object):
+    def __init__(self, elf):
+        self.elf = elf
+        self.sizes = TYPE_SIZES.get(elf.machine)
+        if self.sizes is None:
+            raise ValueError("unsupported architecture (e_machine {})".format(elf.machine))
+        self.anchor = elf.findSymbol(ANCHOR_SYMBOL)
+        if self.anchor is None:
+            raise ValueError("symbol '{}' not found; was the app built with USE_BINARY_LOG=y?"
+                             .format(ANCHOR_SYMBOL))
+        self.addressMask = (1 << (8 * self.sizes['ptr'])) - 1
+        self.formatCache = {}
+
+    def formatAddress(self, offset):
+        # the offset is a 16-bit signed value relative to the anchor
+        if offset >= 0x8000:
+            offset -= 0x10000
+        return (self.anchor + offset) & self.addressMask
+
+    def readArg(self, args, pos, size, signed, isFloat=False):
+        chunk = args[pos:pos + size]
+        if len(chunk) < size:
+            raise IndexError("record too short")
+        if isFloat:
+            return struct.unpack("<f" if size == 4 else "<d", chunk)[0], pos + size
+        code = {1: 'b', 2: 'h', 4: 'i', 8: 'q'}[size]
+        if not signed:
+            code = code.upper()
+        return struct.unpack("<" + code, chunk)[0], pos + size
+
+    def render(self, fmt, args):
+        out = []
+        pos = 0
+        last = 0
+        for m in CONVERSION_RE.finditer(fmt):
+            out.append(fmt[last:m.start()])
+            last = m.end()
+            flags, width, precision, length, conv = m.groups()
+            if conv == '%':
+                out.append('%')
+                continue
+            if width == '*':
+                width, pos = self.readArg(args, pos, self.sizes['int'], True)
+                width = str(width)
+            if precision == '*':
+                precision, pos = self.readArg(args, pos, self.sizes['int'], True)
+                precision = str(precision)
+            spec = "%" + flags + (width or "") + ("." + precision if precision else "")
+
+            if conv in "diouxXc":
+                if length in ('l', 'j'):
+                    size = self.sizes['long']
+                elif length == 'll':
+                    size = self.sizes['longlong']
+                elif length in ('z', 't'):
+                    size = self.sizes['ptr']
+                else:
+                    size = self.sizes['int']
+                value, pos = self.readArg(args, pos, size, conv in "di")
+                if conv == 'c':
+                    out.append((spec + "c") % chr(value & 0xff))
+                else:
+                    out.append((spec + conv.replace('u', 'd')) % value)
+            elif conv in "fFeEgGaA":
+                value, pos = self.readArg(args, pos, self.sizes['double'], True, True)
+                out.append((spec + conv.replace('a', 'e').replace('A', 'E')) % value)
+            elif conv == 'p':
+                value, pos = self.readArg(args, pos, self.sizes['ptr'], False)
+                out.append("0x%x" % value)
+            elif conv == 's':
+                value, pos = self.readArg(args, pos, self.sizes['ptr'], False)
+                s = self.elf.readString(value)
+                if s is None:
+                    s = "<0x%x>" % value
+                out.append((spec + "s") % s)
+        out.append(fmt[last:])
+        return "".join(out)
+
+    def decodeRecord(self, flags, offset, timestamp, args):
+        address = self.formatAddress(offset)
+        fmt = self.formatCache.get(address)
+        if fmt is None:
+            fmt = self.elf.readString(address)
+            if fmt is None:
+                return "<unknown format at 0x%x>\n" % address
+            self.formatCache[address] = fmt
+        try:
+            text = self.render(fmt, args)
+        except (IndexError, ValueError, TypeError, OverflowError) as e:
+            text = "<bad record for format %r: %s>\n" % (fmt, e)
+        if timestamp is not None:
+            text = "[%u] %s" % (timestamp, text)
+        return text
+
+    def decodeStream(self, read, write):
+        """Decode a byte stream; 'read(n)' returns bytes, '' on EOF."""
+        while True:
+            b = read(1)
+            if not b:
+                return
+            if ord(b) != BINLOG_MAGIC:
+                # plain text output
+                write(b.decode("latin-1"))
+                continue
+            header = read(3)
+            if len(header) < 3:
+                return
+            flags, offset = struct.unpack("<BH", header)
+            timestamp = None
+            if flags & BINLOG_FLAG_TIMED:
+                t = read(4)
+                if len(t) < 4:
+                    return
+                timestamp, = struct.unpack("<I", t)
+            argsLength = flags & 0x7f
+            args = read(argsLength) if argsLength else b""
+            if len(args) < argsLength:
+                return
+            write(self.decodeRecord(flags, offset, timestamp, args))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MansOS binary log decoder")
+    parser.add_argument("-e", "--elf", required=True,
+                        help="the ELF image of the application")
+    parser.add_argument("-s", "--serial-port", dest="serialPort",
+                        help="read from this serial port (default: standard input)")
+    parser.add_argument("-b", "--baudrate", dest="baudRate", type=int, default=38400)
+    args = parser.parse_args()
+
+    try:
+        decoder = Decoder(ElfImage(args.elf))
+    except (IOError, ValueError) as e:
+        sys.stderr.write("binlog: {}\n".format(e))
+        return 1
+
+    if args.serialPort:
+        import serial
+        ser = serial.Serial(args.serialPort, args.baudRate, timeout=None)
+        read = ser.read
+    else:
+        stream = getattr(sys.stdin, "buffer", sys.stdin)
+        read = stream.read
+
+    def write(text):
+        sys.stdout.write(text)
+        sys.stdout.flush()
+
+    try:
+        decoder.decodeStream(read, write)
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
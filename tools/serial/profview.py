@@ -0,0 +1,289 @@
+#!/usr/bin/env python
+
+#
+# Profile viewer: flat profile and call graph of applications built
+# with "make <platform> profile" (see mos/lib/profile.h).
+#
+# Usage:
+#   profview.py -e build/telosb/image.elf -s /dev/ttyUSB0 [-n <dumps>]
+#   profview.py -e build/pc/App.exe < captured-output.bin
+#   profview.py -e build/pc/App.exe --folded < captured-output.bin | flamegraph.pl > app.svg
+#
+# The program output other than the profile dumps is copied to stderr.
+# The serial port is read until the given number of dumps or Ctrl+C.
+# With --folded, the output is the stacks in the "folded" format of
+# perf and FlameGraph (stackcollapse-perf.pl), weighted with timer ticks.
+#
+
+import struct
+import sys
+import argparse
+import bisect
+
+from binlog import ElfImage
+
+SERIAL_PACKET_DELIMITER = b"$"
+PROFILE_SERIAL_PROTOCOL = b"p"
+ANCHOR_SYMBOL = "profileDump"
+STT_FUNC = 2
+
+DUMP_NAME = "<profile dump>"
+
+
+class Symbols(object):
+    """Function names by address."""
+
+    def __init__(self, elf):
+        functions = sorted((value, size, name) for name, value, size, symtype
+                           in elf.symbols() if symtype == STT_FUNC and name)
+        self.addresses = [f[0] for f in functions]
+        self.functions = functions
+        self.anchor = elf.findSymbol(ANCHOR_SYMBOL)
+        if self.anchor is None:
+            raise ValueError("symbol '{}' not found; was the app built with 'profile'?"
+                             .format(ANCHOR_SYMBOL))
+        self.cache = {}
+
+    def name(self, address):
+        if address == 0:
+            return DUMP_NAME
+        name = self.cache.get(address)
+        if name is None:
+            i = bisect.bisect_right(self.addresses, address) - 1
+            if i >= 0:
+                value, size, name = self.functions[i]
+                if address != value and address >= value + max(size, 1):
+                    name = None
+            if name is None:
+                name = "0x%x" % address
+            self.cache[address] = name
+        return name
+
+
+class Function(object):
+    def __init__(self):
+        self.calls = 0
+        self.selfTime = 0
+        self.totalTime = 0
+
+
+class Arc(object):
+    def __init__(self):
+        self.calls = 0
+        self.totalTime = 0
+
+
+class Frame(object):
+    def __init__(self, name, start, path):
+        self.name = name
+        self.start = start
+        self.path = path
+
+
+class Profile(object):
+    """Rebuilds the call stack from the records and accumulates the times."""
+
+    def __init__(self, symbols):
+        self.symbols = symbols
+        self.functions = {}
+        self.arcs = {}
+        self.folded = {}
+        self.stack = []
+        self.now = 0
+        self.lastTime = None
+        self.clockSpeed = 0
+        self.dumps = 0
+        self.records = 0
+        self.lost = 0
+
+    def function(self, name):
+        f = self.functions.get(name)
+        if f is None:
+            f = self.functions[name] = Function()
+        return f
+
+    def leave(self, frame):
+        # the caller's time includes the callee's; count recursive calls once
+        elapsed = self.now - frame.start
+        if all(f.name != frame.name for f in self.stack):
+            self.function(frame.name).totalTime += elapsed
+        caller = self.stack[-1].name if self.stack else None
+        arc = self.arcs.get((caller, frame.name))
+        if arc is not None:
+            arc.totalTime += elapsed
+
+    def closeAll(self):
+        while self.stack:
+            self.leave(self.stack.pop())
+
+    def record(self, address, time, exit, timeBits):
+        if self.lastTime is not None:
+            # the timestamps wrap around; the time between records is always less
+            delta = (time - self.lastTime) & ((1 << timeBits) - 1)
+            self.now += delta
+            if self.stack:
+                top = self.stack[-1]
+                self.function(top.name).selfTime += delta
+                self.folded[top.path] = self.folded.get(top.path, 0) + delta
+        self.lastTime = time
+        self.records += 1
+
+        name = self.symbols.name(address)
+        if not exit:
+            caller = self.stack[-1].name if self.stack else None
+            self.function(name).calls += 1
+            arc = self.arcs.get((caller, name))
+            if arc is None:
+                arc = self.arcs[(caller, name)] = Arc()
+            arc.calls += 1
+            path = self.stack[-1].path + ";" + name if self.stack else name
+            self.stack.append(Frame(name, self.now, path))
+            return
+        # an exit: also unwinds the frames that did not record their exit
+        for i in range(len(self.stack) - 1, -1, -1):
+            if self.stack[i].name == name:
+                while len(self.stack) > i:
+                    self.leave(self.stack.pop())
+                return
+        # entered before the recording started: nothing known about it
+
+    def dump(self, data):
+        if len(data) < 8:
+            return
+        pointerSize, timeSize, lost, clockSpeed = struct.unpack_from("<BBHI", data, 0)
+        ptrCode = {2: "H", 4: "I", 8: "Q"}.get(pointerSize)
+        timeCode = {4: "I", 8: "Q"}.get(timeSize)
+        if ptrCode is None or timeCode is None:
+            sys.stderr.write("profile: bad dump header\n")
+            return
+        anchor, = struct.unpack_from("<" + ptrCode, data, 8)
+        # position independent executables are loaded at other addresses
+        bias = anchor - self.symbols.anchor
+        self.clockSpeed = clockSpeed
+        self.dumps += 1
+        if lost:
+            # the trace is not continuous: start over
+            self.closeAll()
+            self.lastTime = None
+            self.lost += lost
+
+        timeBits = timeSize * 8 - 1
+        exitFlag = 1 << timeBits
+        recordFormat = "<" + ptrCode + timeCode
+        recordSize = struct.calcsize(recordFormat)
+        for pos in range(8 + pointerSize, len(data) - recordSize + 1, recordSize):
+            address, time = struct.unpack_from(recordFormat, data, pos)
+            if address:
+                address -= bias
+            self.record(address, time & (exitFlag - 1), time & exitFlag, timeBits)
+
+    def finish(self):
+        # the functions still running: count their time so far
+        for i in range(len(self.stack)):
+            frame = self.stack[i]
+            elapsed = self.now - frame.start
+            if all(f.name != frame.name for f in self.stack[:i]):
+                self.function(frame.name).totalTime += elapsed
+            caller = self.stack[i - 1].name if i else None
+            self.arcs[(caller, frame.name)].totalTime += elapsed
+
+    def us(self, ticks):
+        return ticks * 1000000.0 / self.clockSpeed if self.clockSpeed else 0.0
+
+    def printFlat(self, out):
+        totalSelf = sum(f.selfTime for f in self.functions.values()) or 1
+        out.write("Flat profile: {} records in {} dumps, {} records lost, "
+                  "{} Hz clock\n\n".format(self.records, self.dumps, self.lost,
+                                           self.clockSpeed))
+        out.write("%6s %12s %12s %8s  %s\n" % ("%self", "self us", "total us",
+                                                "calls", "function"))
+        for name, f in sorted(self.functions.items(),
+                              key=lambda item: (-item[1].selfTime, item[0])):
+            out.write("%6.2f %12.1f %12.1f %8u  %s\n" % (
+                100.0 * f.selfTime / totalSelf, self.us(f.selfTime),
+                self.us(f.totalTime), f.calls, name))
+
+    def printCallGraph(self, out):
+        out.write("\nCall graph (calls, total us of the calls):\n")
+        callers = {}
+        for (caller, callee), arc in self.arcs.items():
+            callers.setdefault(caller, []).append((callee, arc))
+        for caller in sorted(callers, key=lambda c: (c is not None, c)):
+            out.write("\n%s\n" % (caller if caller is not None else "<unknown caller>"))
+            for callee, arc in sorted(callers[caller],
+                                      key=lambda item: (-item[1].totalTime, item[0])):
+                out.write("    %-32s %8u %12.1f\n" % (callee, arc.calls,
+                                                      self.us(arc.totalTime)))
+
+    def printFolded(self, out):
+        for path in sorted(self.folded):
+            if self.folded[path]:
+                out.write("%s %u\n" % (path, self.folded[path]))
+
+
+def readStream(read, profile, maxDumps):
+    """Pass the text through to stderr, decode the profile dumps."""
+    while maxDumps is None or profile.dumps < maxDumps:
+        b = read(1)
+        if not b:
+            return
+        if b != SERIAL_PACKET_DELIMITER:
+            sys.stderr.write(b.decode("latin-1"))
+            continue
+        protocol = read(1)
+        if protocol != PROFILE_SERIAL_PROTOCOL:
+            sys.stderr.write((b + protocol).decode("latin-1"))
+            continue
+        header = read(2)
+        if len(header) < 2:
+            return
+        length, = struct.unpack(">H", header)
+        data = read(length)
+        if len(data) < length:
+            return
+        profile.dump(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MansOS profile viewer")
+    parser.add_argument("-e", "--elf", required=True,
+                        help="the ELF image of the application")
+    parser.add_argument("-s", "--serial-port", dest="serialPort",
+                        help="read from this serial port (default: standard input)")
+    parser.add_argument("-b", "--baudrate", dest="baudRate", type=int, default=38400)
+    parser.add_argument("-n", "--dumps", type=int,
+                        help="stop after this many dumps")
+    parser.add_argument("--folded", action="store_true",
+                        help="print folded stacks (for FlameGraph) instead of the report")
+    args = parser.parse_args()
+
+    try:
+        profile = Profile(Symbols(ElfImage(args.elf)))
+    except (IOError, ValueError) as e:
+        sys.stderr.write("profile: {}\n".format(e))
+        return 1
+
+    if args.serialPort:
+        import serial
+        ser = serial.Serial(args.serialPort, args.baudRate, timeout=None)
+        read = ser.read
+    else:
+        stream = getattr(sys.stdin, "buffer", sys.stdin)
+        read = stream.read
+
+    try:
+        readStream(read, profile, args.dumps)
+    except KeyboardInterrupt:
+        pass
+    profile.finish()
+
+    if args.folded:
+        profile.printFolded(sys.stdout)
+    else:
+        profile.printFlat(sys.stdout)
+        profile.printCallGraph(sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,276 @@
+/**
+ * Copyright (c) 2008-2010 Leo Selavo and the contributors. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "connection.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+const tcflag_t BAUDRATE = B38400;
+
+// pc-cloud default port; see mos/platforms/pc/platform_radio.h
+#define CLOUD_DEFAULT_PORT "6293"
+
+PacketHandler packetHandler;
+
+Connection::~Connection() {
+    if (fd >= 0) close(fd);
+}
+
+int Connection::receive() {
+    uint8_t buffer[400];
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 0;
+        perror(name.c_str());
+        return -1;
+    }
+    if (len == 0) {
+        fprintf(stderr, "shell: EOF on %s\n", name.c_str());
+        return -1;
+    }
+    parse(buffer, len);
+    return len;
+}
+
+int Connection::flush() {
+    while (!outQueue.empty()) {
+        ssize_t len = write(fd, &outQueue[0], outQueue.size());
+        if (len < 0) {
+            if (errno == EAGAIN || errno == EINTR) return 0;
+            perror(name.c_str());
+            return -1;
+        }
+        outQueue.erase(outQueue.begin(), outQueue.begin() + len);
+    }
+    return 0;
+}
+
+// -----------------------------------------------
+
+// frame to mote: delimiter, 2 byte length (big-endian), address, data;
+// frame from mote: delimiter, protocol, 2 byte length, data
+class SerialConnection : public Connection {
+public:
+    SerialConnection(int fd, const string &name)
+        : Connection(fd, name), state(READ_DELIMITER),
+          protocol(0), expectedLen(0), symbolsRead(0) {}
+
+    void send(const uint8_t *data, uint16_t len, uint16_t address) {
+        uint16_t frameLen = len + 2; // include destination address as well
+        outQueue.push_back(SERIAL_PACKET_DELIMITER);
+        outQueue.push_back(frameLen >> 8);
+        outQueue.push_back(frameLen & 0xff);
+        outQueue.push_back(address >> 8);
+        outQueue.push_back(address & 0xff);
+        outQueue.insert(outQueue.end(), data, data + len);
+    }
+
+protected:
+    void parse(const uint8_t *input, unsigned len);
+
+private:
+    enum {
+        READ_DELIMITER,
+        READ_PROTOCOL,
+        READ_LEN_BYTE1,
+        READ_LEN_BYTE2,
+        READ_DATA
+    } state;
+    uint8_t protocol;
+    uint16_t expectedLen;
+    uint16_t symbolsRead;
+    uint8_t recvBuf[400];
+};
+
+void SerialConnection::parse(const uint8_t *input, unsigned len) {
+    const uint8_t *end = input + len;
+    while (input < end) {
+        switch (state) {
+        case READ_DELIMITER:
+            if (*input++ == SERIAL_PACKET_DELIMITER) {
+                state = READ_PROTOCOL;
+            }
+            break;
+        case READ_PROTOCOL:
+            protocol = *input++;
+            if (protocol == PROTOCOL_SMP || protocol == PROTOCOL_DEBUG) {
+                state = READ_LEN_BYTE1;
+            } else if (protocol != SERIAL_PACKET_DELIMITER) {
+                state = READ_DELIMITER;
+            }
+            break;
+        case READ_LEN_BYTE1:
+            expectedLen = (*input++) << 8;
+            state = READ_LEN_BYTE2;
+            break;
+        case READ_LEN_BYTE2:
+            expectedLen = expectedLen | (*input++);
+            if (expectedLen == 0 || expectedLen > sizeof(recvBuf) - 1) {
+                fprintf(stderr, "shell: invalid packet length "
+                        "on serial port: %d\n", expectedLen);
+                expectedLen = 0;
+                state = READ_DELIMITER;
+            } else {
+                state = READ_DATA;
+            }
+            break;
+        case READ_DATA: {
+            unsigned n = min<unsigned>(end - input, expectedLen - symbolsRead);
+            memcpy(recvBuf + symbolsRead, input, n);
+            input += n;
+            symbolsRead += n;
+            if (symbolsRead == expectedLen) {
+                recvBuf[symbolsRead] = '\0';
+                packetHandler(this, protocol, recvBuf, symbolsRead);
+                state = READ_DELIMITER;
+                symbolsRead = 0;
+            }
+            break;
+        }
+        }
+    }
+}
+
+Connection *openSerialConnection(const char *device) {
+    int fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        perror(device);
+        return NULL;
+    }
+
+    /* Serial port setting */
+    struct termios newtio;
+    memset(&newtio, 0, sizeof(newtio));
+    newtio.c_cflag = CS8 | CLOCAL | CREAD;
+    newtio.c_iflag = IGNPAR | IGNBRK;
+    cfsetispeed(&newtio, BAUDRATE);
+    cfsetospeed(&newtio, BAUDRATE);
+
+    if (tcflush(fd, TCIFLUSH) < 0) {
+        perror("tcflush");
+        close(fd);
+        return NULL;
+    }
+    if (tcsetattr(fd, TCSANOW, &newtio) < 0) {
+        // not fatal: could be a pseudo terminal or a pipe
+        perror("tcsetattr");
+    }
+    return new SerialConnection(fd, device);
+}
+
+// -----------------------------------------------
+
+// The cloud forwards each packet to all other connected simulated motes.
+// Packet: 2 byte length (host byte order), then the radio packet as sent
+// by the SMP proxy: CRC16 of the rest (little-endian), then
+// to mote: address (big-endian), SMP packet; from mote: SMP packet.
+class CloudConnection : public Connection {
+public:
+    CloudConnection(int fd, const string &name) : Connection(fd, name) {}
+
+    void send(const uint8_t *data, uint16_t len, uint16_t address) {
+        uint8_t header[4];
+        vector<uint8_t> radioPacket;
+        radioPacket.push_back(address >> 8);
+        radioPacket.push_back(address & 0xff);
+        radioPacket.insert(radioPacket.end(), data, data + len);
+        uint16_t crc = crc16(&radioPacket[0], radioPacket.size());
+        uint16_t packetLen = radioPacket.size() + 2;
+        memcpy(header, &packetLen, 2);
+        header[2] = crc & 0xff;
+        header[3] = crc >> 8;
+        outQueue.insert(outQueue.end(), header, header + sizeof(header));
+        outQueue.insert(outQueue.end(), radioPacket.begin(), radioPacket.end());
+    }
+
+protected:
+    void parse(const uint8_t *input, unsigned len);
+
+private:
+    vector<uint8_t> inQueue;
+};
+
+void CloudConnection::parse(const uint8_t *input, unsigned len) {
+    inQueue.insert(inQueue.end(), input, input + len);
+    for (;;) {
+        uint16_t packetLen;
+        if (inQueue.size() < 2) return;
+        memcpy(&packetLen, &inQueue[0], 2);
+        if (inQueue.size() < 2u + packetLen) return;
+
+        uint8_t *p = &inQueue[2];
+        // SMP responses only: requests from other clients start with
+        // an address, not with the SMP length
+        if (packetLen >= 4
+                && (p[0] | (p[1] << 8)) == crc16(p + 2, packetLen - 2)
+                && p[2] == packetLen - 2
+                && p[3] == SMP_PACKET_RESPONSE) {
+            packetHandler(this, PROTOCOL_SMP, p + 2, packetLen - 2);
+        }
+        inQueue.erase(inQueue.begin(), inQueue.begin() + 2 + packetLen);
+    }
+}
+
+Connection *openCloudConnection(const char *hostAndPort) {
+    string host = hostAndPort;
+    string port = CLOUD_DEFAULT_PORT;
+    size_t colon = host.rfind(':');
+    if (colon != string::npos) {
+        port = host.substr(colon + 1);
+        host = host.substr(0, colon);
+    }
+    if (host.empty()) host = "localhost";
+
+    struct addrinfo hints, *result;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", hostAndPort, gai_strerror(err));
+        return NULL;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot connect\n", hostAndPort);
+        return NULL;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return new CloudConnection(fd, host + ":" + port);
+}
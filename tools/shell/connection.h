@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2008-2010 Leo Selavo and the contributors. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Connections to mote networks: a base station on a serial port,
+// or the pc-cloud radio simulator over TCP.
+// All I/O is non-blocking; the caller polls the descriptors.
+//
+
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "common.h"
+#include <string>
+
+class Connection;
+
+// called for each complete packet received; 'protocol' is PROTOCOL_SMP
+// or PROTOCOL_DEBUG
+typedef void (*PacketHandler)(Connection *c, uint8_t protocol,
+                              uint8_t *data, uint16_t len);
+
+extern PacketHandler packetHandler;
+
+class Connection {
+public:
+    Connection(int fd, const string &name) : fd(fd), name(name) {}
+    virtual ~Connection();
+
+    // queue an SMP packet for the mote with the given address
+    virtual void send(const uint8_t *data, uint16_t len, uint16_t address) = 0;
+
+    // read available data and call packetHandler for complete packets;
+    // return -1 on error or end of file
+    int receive();
+
+    // write as much of the queued data as possible; return -1 on error
+    int flush();
+
+    bool wantWrite() const { return !outQueue.empty(); }
+
+    int fd;
+    string name;
+
+protected:
+    virtual void parse(const uint8_t *data, unsigned len) = 0;
+
+    vector<uint8_t> outQueue;
+};
+
+// base station on a serial port
+Connection *openSerialConnection(const char *device);
+
+// pc-cloud at "host[:port]"
+Connection *openCloudConnection(const char *hostAndPort);
+
+#endif
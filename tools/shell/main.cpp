@@ -20,17 +20,16 @@
  * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
-#include "common.h"
+#include "connection.h"
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <termios.h>
 #include <unistd.h>
 #include <memory.h>
 #include <sys/types.h>
-#include <sys/select.h>
-#include <sys/stat.h>
+#include <poll.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <limits.h>
@@ -43,25 +42,28 @@ using namespace std;
 #define PROMPT "$ "
 
 #define VERSION_MAJOR 0
-#define VERSION_MINOR 1
+#define VERSION_MINOR 2
 
-#define ARRAYLEN(x) (sizeof(x) / sizeof(x[0]))
+// serial ports and pc-cloud connections; requests are sent to all of them,
+// unless it is known on which one the destination mote is
+vector<Connection *> connections;
+map<uint16_t, Connection *> moteConnections;
 
-int serialFD = -1;
+uint16_t dstAddress;
 
-bool commandInProgress;
-unsigned commandIssuedTime;
-bool commandReplyReceived;
+#define DEFAULT_TIMEOUT 2000 // milliseconds
+#define DEFAULT_RETRIES 2
 
-uint16_t dstAddress;
+unsigned commandTimeout = DEFAULT_TIMEOUT;
+unsigned commandRetries = DEFAULT_RETRIES;
 
-#define COMMAND_TIMEOUT 2 // seconds
-#define WAIT_TIMEOUT    1 // seconds
+// in batch mode commands are read from a file and all issued at once;
+// values are printed one per line, prefixed with the mote address
+bool batchMode;
 
 #define MAX_CMD_SIZE 32
 
-const char *serialDevice = "/dev/ttyUSB0";
-const tcflag_t BAUDRATE = B38400;
+const char *defaultSerialDevice = "/dev/ttyUSB0";
 
 static void hexdump(uint8_t *data, unsigned len);
 
@@ -172,121 +174,208 @@ void printTemperature(uint32_t value) {
 }
 
 // -----------------------------------------------
+// Outstanding requests. Any number of them can be in progress at once;
+// motes echo the SMP_META_REQUEST_ID value back, which is used to match
+// responses to requests.
+
+enum RequestKind {
+    RK_GET,     // print the response(s)
+    RK_WATCH,   // a subscription: motes push responses periodically
+    RK_PROGRAM, // code upload: send the next chunk on reply
+    RK_REBOOT,  // no reply expected
+};
+
+struct Request {
+    RequestKind kind;
+    uint8_t type;            // SMP packet type
+    uint16_t address;        // destination; 0 or 0xffff for all motes
+    vector<uint8_t> body;    // OIDs and values, without the meta settings
+    bool repeat;             // send the repeat settings (zero to unsubscribe)
+    uint32_t repeatInterval;
+    uint16_t repeatTimes;
+    uint16_t cursor;         // where to continue a truncated response
+    vector<uint8_t> packet;  // as sent
+    uint64_t deadline;       // 0 if none
+    unsigned retriesLeft;
+    unsigned responses;
+};
+
+typedef map<uint16_t, Request> RequestMap;
+RequestMap requests;
+uint16_t lastRequestId;
 
-void writeSerialPort(const void *data, uint16_t len, uint16_t dstAddress) {
-    // fprintf(stderr, "shell: writeSerialPort %d bytes to 0x%04x\n", len, dstAddress);
-    // hexdump((uint8_t *)data, len);
+static const uint8_t typeOid[] = {SMP_MOS, SMP_RES_TYPE};
+static const uint8_t addressOid[] = {SMP_MOS, SMP_RES_ADDRESS};
 
-    len += 2; // include destination address as well
+static uint64_t timeMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-    uint8_t header[5];
-    header[0] = SERIAL_PACKET_DELIMITER; // always start with this symbol
-    header[1] = len >> 8;
-    header[2] = len & 0xff;
-    header[3] = dstAddress >> 8;
-    header[4] = dstAddress & 0xff;
+static bool isBroadcast(uint16_t address) {
+    return address == 0 || address == 0xffff;
+}
 
-    if (write(serialFD, header, sizeof(header)) != sizeof(header)) {
-        // TODO: handle EAGAIN
-        perror("write header serial port");
+static void transmit(const vector<uint8_t> &packet, uint16_t address) {
+    map<uint16_t, Connection *>::iterator it = moteConnections.find(address);
+    if (!isBroadcast(address) && it != moteConnections.end()) {
+        it->second->send(&packet[0], packet.size(), address);
         return;
     }
-    if (write(serialFD, data, len) != len) {
-        // TODO: handle EAGAIN
-        perror("write data serial port");
-    }
-}
-
-/*
- 0                   1                   2                   3
- 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 
-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-|0|  length (7) |G|O|
-+---------------------------------------------------------------+
-
-                          <-- 8 bits -->
-  +---------------------------------------------------------------+
-1 | 0x0 - single byte length (1 bit) |    0x6 - length (7 bits)   |
-  +---------------------------------------------------------------+
-2 |             0x0 - SSMP GET command (8 bits)                   |
-  +---------------------------------------------------------------+
-3 | 0x0 - SSMP GET command (2 bits)  |      unused (6 bits)       |
-  +---------------------------------------------------------------+
-4 | 0x1 - SSMP OID (2 bits)          |  0x2 - OID length (6 bits) |
-  +---------------------------------------------------------------+
-5 |               0x1 - OID 'MANSOS' (8 bits)                     |
-  +---------------------------------------------------------------+
-6 |                0x3 - OID 'LEDs' (8 bits)                      |
-  +---------------------------------------------------------------+
-7 |            0x0 - OID 'LED code RED' (8 bits)                  |
-  +---------------------------------------------------------------+
-
-*/
-void smpSend(SmpCommand_e cmd, Oid_t *oid, unsigned numOid, SmpVariant_t *arg) {
-    uint8_t packetBuffer[400];
-    uint8_t *p = packetBuffer;
+    for (unsigned i = 0; i < connections.size(); ++i) {
+        connections[i]->send(&packet[0], packet.size(), address);
+    }
+}
+
+static void putOid(vector<uint8_t> &packet, uint8_t command,
+                   const uint8_t *oid, unsigned oidLen) {
+    packet.push_back(command);
+    packet.push_back(SMP_ELEM_OID | oidLen);
+    packet.insert(packet.end(), oid, oid + oidLen);
+}
 
-    commandInProgress = true;
-    commandIssuedTime = time(NULL);
-    commandReplyReceived = false;
+static void putValue(vector<uint8_t> &packet, SmpVariant_t *value) {
+    uint8_t buffer[300];
+    uint8_t *p = buffer;
+    uint16_t maxLen = sizeof(buffer);
+    encodeVariant(&p, &maxLen, value);
+    packet.insert(packet.end(), buffer, p);
+}
 
-    p++; // leave place for length
-    *p++ = SMP_PACKET_REQUEST;
+static void putBinary(vector<uint8_t> &packet, void *data, uint8_t len) {
+    uint8_t buffer[300];
+    uint8_t *p = buffer;
+    uint16_t maxLen = sizeof(buffer);
+    encodeBinary(&p, &maxLen, data, len);
+    packet.insert(packet.end(), buffer, p);
+}
 
-    // Mote type (always Tmote Sky)
-    *p++ = SMP_COMMAND_GET;
-    *p++ = SMP_ELEM_OID | 2;
-    *p++ = SMP_MOS;
-    *p++ = SMP_RES_TYPE;
+static void putMeta(vector<uint8_t> &packet, uint8_t meta, uint32_t value) {
+    const uint8_t oid[] = {SMP_META, meta};
+    SmpVariant_t v;
+    if (value <= 0xffff) {
+        v.type = ST_UINTEGER16;
+        v.u.uint16 = value;
+    } else {
+        v.type = ST_UINTEGER;
+        v.u.uint32 = value;
+    }
+    putOid(packet, SMP_COMMAND_SET, oid, sizeof(oid));
+    putValue(packet, &v);
+}
+
+static Request &newRequest(RequestKind kind, uint8_t type, uint16_t address) {
+    do {
+        ++lastRequestId;
+    } while (lastRequestId == 0 || requests.count(lastRequestId));
+
+    Request &r = requests[lastRequestId];
+    r.kind = kind;
+    r.type = type;
+    r.address = address;
+    r.repeat = false;
+    r.repeatInterval = 0;
+    r.repeatTimes = 0;
+    r.cursor = 0;
+    r.deadline = 0;
+    r.retriesLeft = commandRetries;
+    r.responses = 0;
+    return r;
+}
 
+static void submitRequest(uint16_t id) {
+    Request &r = requests[id];
+
+    r.packet.clear();
+    r.packet.push_back(0); // leave place for length
+    r.packet.push_back(r.type);
+    // meta settings first, as they apply to the OIDs that follow
+    putMeta(r.packet, SMP_META_REQUEST_ID, id);
+    if (r.repeat) {
+        putMeta(r.packet, SMP_META_REPEAT_INTERVAL, r.repeatInterval);
+        if (r.repeatTimes) {
+            putMeta(r.packet, SMP_META_REPEAT_TIMES, r.repeatTimes);
+        }
+    }
+    if (r.cursor) {
+        putMeta(r.packet, SMP_META_WALK_CURSOR, r.cursor);
+    }
+    r.packet.insert(r.packet.end(), r.body.begin(), r.body.end());
+    if (r.packet.size() > 0xff) {
+        fprintf(stderr, "shell: request too long\n");
+        requests.erase(id);
+        return;
+    }
+    r.packet[0] = r.packet.size();
+
+    uint64_t now = timeMs();
+    switch (r.kind) {
+    case RK_WATCH:
+        // kept until the last response is expected
+        r.retriesLeft = 0;
+        r.deadline = r.repeatTimes ?
+                now + (uint64_t) r.repeatInterval * r.repeatTimes + commandTimeout : 0;
+        break;
+    case RK_REBOOT:
+        r.deadline = now;
+        r.retriesLeft = 0;
+        break;
+    default:
+        r.deadline = now + commandTimeout;
+        break;
+    }
+
+    transmit(r.packet, r.address);
+}
+
+void smpSend(SmpCommand_e cmd, Oid_t *oid, unsigned numOid, SmpVariant_t *arg) {
+    Request &r = newRequest(RK_GET, SMP_PACKET_REQUEST, dstAddress);
+
+    // Mote type (always Tmote Sky)
+    putOid(r.body, SMP_COMMAND_GET, typeOid, sizeof(typeOid));
     // Mote PAN address
-    *p++ = SMP_COMMAND_GET;
-    *p++ = SMP_ELEM_OID | 2;
-    *p++ = SMP_MOS;
-    *p++ = SMP_RES_ADDRESS;
+    putOid(r.body, SMP_COMMAND_GET, addressOid, sizeof(addressOid));
 
     for (unsigned i = 0; i < numOid; ++i) {
         if (oid->length) {
-            *p++ = cmd;
-            *p++ = SMP_ELEM_OID | oid->length;
-            memcpy(p, oid->oid, oid->length);
-            p += oid->length;
+            putOid(r.body, cmd, oid->oid, oid->length);
         }
         ++oid;
     }
     if (arg && arg->type != 0xFF) {
-        uint16_t maxLen = sizeof(packetBuffer) - (p - packetBuffer);
-        encodeVariant(&p, &maxLen, arg);
+        putValue(r.body, arg);
     }
-
-    packetBuffer[0] = p - packetBuffer;
-
-    writeSerialPort(packetBuffer, p - packetBuffer, dstAddress);
+    submitRequest(lastRequestId);
 }
 
-void smpSend(void *binaryPacket, uint8_t binaryPacketLen) {
-    uint8_t packetBuffer[400];
-    uint8_t *p = packetBuffer;
-
-    commandInProgress = true;
-    commandIssuedTime = time(NULL);
-    commandReplyReceived = false;
-
-    p++; // leave place for length
-    *p++ = SMP_PACKET_REQUEST;
+void smpSend(void *binaryPacket, uint8_t binaryPacketLen, RequestKind kind) {
+    static const uint8_t binaryOid[] = {SMP_MOS, SMP_RES_BINARY_PACKET};
+    Request &r = newRequest(kind, SMP_PACKET_REQUEST, dstAddress);
 
     // Binary packet
-    *p++ = SMP_COMMAND_SET;
-    *p++ = SMP_ELEM_OID | 2;
-    *p++ = SMP_MOS;
-    *p++ = SMP_RES_BINARY_PACKET;
-
-    uint16_t maxLen = sizeof(packetBuffer) - (p - packetBuffer);
-    encodeBinary(&p, &maxLen, binaryPacket, binaryPacketLen);
-
-    packetBuffer[0] = p - packetBuffer;
+    putOid(r.body, SMP_COMMAND_SET, binaryOid, sizeof(binaryOid));
+    putBinary(r.body, binaryPacket, binaryPacketLen);
+    submitRequest(lastRequestId);
+}
 
-    writeSerialPort(packetBuffer, p - packetBuffer, dstAddress);
+// get all values under OID; if 'repeat' is set, subscribe to them
+// (or cancel subscriptions, if the interval is zero)
+void smpSendWalk(Oid_t *oid, bool repeat, uint32_t repeatInterval, uint16_t repeatTimes) {
+    Request &r = newRequest(repeat && repeatInterval ? RK_WATCH : RK_GET,
+            SMP_PACKET_WALK, dstAddress);
+    r.repeat = repeat;
+    r.repeatInterval = repeatInterval;
+    r.repeatTimes = repeatTimes;
+
+    // Mote PAN address, to know where to send continuation requests
+    // (unless it is in the subtree anyway)
+    if (oid->length > sizeof(addressOid)
+            || memcmp(oid->oid, addressOid, oid->length)) {
+        putOid(r.body, SMP_COMMAND_GET, addressOid, sizeof(addressOid));
+    }
+    putOid(r.body, SMP_COMMAND_GET, oid->oid, oid->length);
+    submitRequest(lastRequestId);
 }
 
 void printOid(uint8_t *oid, uint8_t oidLen) {
@@ -348,7 +437,49 @@ void printValue(SmpVariant_t *value, uint8_t *oid, uint8_t oidLen) {
     }
 }
 
-void smpRecv(uint8_t *data, uint16_t recvLen) {
+static void printResponseHeader(void) {
+    if (!batchMode) printf("A mote with:\n");
+}
+
+static void printVarbind(uint16_t address, uint8_t *oid, uint8_t oidLen,
+                         SmpVariant_t *value) {
+    if (batchMode) {
+        printf("0x%04x ", address);
+        for (uint8_t i = 0; i < oidLen; ++i) {
+            printf(i ? ".%d" : "%d", oid[i]);
+        }
+        printf(" ");
+    } else {
+        printOid(oid, oidLen);
+    }
+    printValue(value, oid, oidLen);
+    fputc('\n', stdout);
+}
+
+void programReplyReceived(void) {
+    if (!isCodeFileBeingSent()) return;
+    // TODO FIXME: abort on an error!
+    if (image.blockId >= image.numBlocksToSend) {
+        // file sent.
+        printf("File uploaded.\n");
+        imageId = 0;
+    } else {
+        if (image.blockId == 0) {
+            printf("Uploading started...\n");
+        } else {
+            printf("A chunk uploaded...\n");
+        }
+        sendCodeFileContinue();
+    }
+}
+
+struct Varbind {
+    uint8_t oid[MAX_OID_LEN];
+    uint8_t oidLen;
+    SmpVariant_t value;
+};
+
+void smpRecv(Connection *connection, uint8_t *data, uint16_t recvLen) {
     int32_t packetLen;
     uint8_t oid[MAX_OID_LEN];
     uint8_t oidLen = 0;
@@ -359,8 +490,11 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
 
     uint8_t *p = data;
 
-    // TODO: wait for a specific/multiple responses!
-    commandReplyReceived = true;
+    vector<Varbind> varbinds;
+    uint16_t requestId = 0;
+    uint16_t cursor = 0;
+    uint16_t address = 0;
+    bool haveAddress = false;
 
     packetLen = *p++;
 
@@ -374,6 +508,7 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
     // check packet type
     switch (*p) {
     case SMP_PACKET_REQUEST:
+    case SMP_PACKET_WALK:
         fprintf(stderr, "shell: ignoring SMP request packet\n");
         return;
     case SMP_PACKET_RESPONSE:
@@ -383,26 +518,11 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
         return;
     }
 
-    if (isCodeFileBeingSent()) {
-        // TODO FIXME: abort on an error!
-        if (image.blockId >= image.numBlocksToSend) {
-            // file sent.
-            printf("File uploaded.");
-            imageId = 0;
-        } else if (image.blockId == 0) {
-            printf("Uploading started...");
-        } else {
-            printf("A chunk uploaded...");
-        }
-        return;
-    }
-
     // parse the received packet
-    printf("A mote with:\n");
     ++p;
     for (; p < data + packetLen; ++p) {
         uint8_t len;
-        uint16_t maxLen = packetLen;
+        uint16_t maxLen = data + packetLen - p;
 
         switch (*p & 0xc0) {
         case SMP_ELEM_COMMAND:
@@ -420,14 +540,12 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
             }
             if ((*p & 0xc0) == SMP_ELEM_OID) {
                 // whole OID
-                if (oidPrefixLen + oidLen > MAX_OID_LEN) {
+                if (oidPrefixLen + len > MAX_OID_LEN) {
                     fprintf(stderr, "OID too long");
                     return;
                 }
                 memcpy(oid + oidPrefixLen, p + 1, len);
                 oidLen = len + oidPrefixLen;
-
-                printOid(oid, oidLen);
             } else {
                 // OID prefix
                 oidPrefixLen = len;
@@ -442,12 +560,120 @@ void smpRecv(uint8_t *data, uint16_t recvLen) {
             if (decodeVariant(&p, &maxLen, &arg)) {
                 return;
             }
-            printValue(&arg, oid, oidLen);
-            fputc('\n', stdout);
             --p; // XXX
+
+            if (oidLen == 2 && oid[0] == SMP_META) {
+                uint16_t value = arg.type == ST_UINTEGER16 ? arg.u.uint16 : arg.u.uint32;
+                if (oid[1] == SMP_META_REQUEST_ID) requestId = value;
+                else if (oid[1] == SMP_META_WALK_CURSOR) cursor = value;
+                break;
+            }
+            if (oidLen == 2 && oid[0] == SMP_MOS && oid[1] == SMP_RES_ADDRESS
+                    && arg.type == ST_UINTEGER16) {
+                address = arg.u.uint16;
+                haveAddress = true;
+            }
+            Varbind vb;
+            memcpy(vb.oid, oid, oidLen);
+            vb.oidLen = oidLen;
+            vb.value = arg;
+            varbinds.push_back(vb);
             break;
         }
     }
+
+    if (haveAddress) {
+        moteConnections[address] = connection;
+    }
+
+    RequestMap::iterator it = requests.find(requestId);
+    Request *r = (requestId && it != requests.end()) ? &it->second : NULL;
+
+    if (!haveAddress && r && !isBroadcast(r->address)) {
+        // e.g. a continuation, where the address was in the first part
+        address = r->address;
+        haveAddress = true;
+    }
+
+    if (r && (r->kind == RK_PROGRAM || r->kind == RK_REBOOT)) {
+        // code upload continues on the first reply only
+        if (r->responses++ == 0) {
+            r->retriesLeft = 0;
+            if (r->kind == RK_PROGRAM) programReplyReceived();
+        }
+        return;
+    }
+
+    printResponseHeader();
+    for (unsigned i = 0; i < varbinds.size(); ++i) {
+        printVarbind(address, varbinds[i].oid, varbinds[i].oidLen, &varbinds[i].value);
+    }
+    if (cursor && haveAddress && r) {
+        // truncated; ask the same mote for the rest
+        Request &next = newRequest(RK_GET, r->type, address);
+        next.body = r->body;
+        next.cursor = cursor;
+        submitRequest(lastRequestId);
+    } else if (cursor) {
+        printf(" ...(truncated)\n");
+    }
+
+    if (!r) return;
+    r->responses++;
+    if (r->kind == RK_GET && !isBroadcast(r->address)) {
+        // done
+        requests.erase(requestId);
+    }
+}
+
+// retry or finish the requests that have timed out
+static void checkTimeouts(void) {
+    uint64_t now = timeMs();
+    RequestMap::iterator it = requests.begin();
+    while (it != requests.end()) {
+        Request &r = it->second;
+        if (!r.deadline || r.deadline > now) {
+            ++it;
+            continue;
+        }
+        if (!r.responses && r.retriesLeft) {
+            r.retriesLeft--;
+            r.deadline = now + commandTimeout;
+            transmit(r.packet, r.address);
+            ++it;
+            continue;
+        }
+        if (!r.responses && r.kind != RK_REBOOT) {
+            if (r.kind == RK_PROGRAM) imageId = 0;
+            if (batchMode) {
+                fprintf(stderr, "0x%04x timeout\n", r.address);
+            } else {
+                printf("..timeout.\n");
+            }
+        }
+        requests.erase(it++);
+    }
+}
+
+// time until the next deadline, in milliseconds
+static int nextTimeout(void) {
+    uint64_t now = timeMs();
+    uint64_t result = 1000;
+    for (RequestMap::iterator it = requests.begin(); it != requests.end(); ++it) {
+        uint64_t deadline = it->second.deadline;
+        if (!deadline) continue;
+        if (deadline <= now) return 0;
+        if (deadline - now < result) result = deadline - now;
+    }
+    return result;
+}
+
+// are there requests that are worth waiting for before exit?
+static bool requestsPending(void) {
+    for (RequestMap::iterator it = requests.begin(); it != requests.end(); ++it) {
+        if (it->second.deadline) return true;
+    }
+    return false;
 }
 
 char *parseOid(char *p, Oid_t *oid) {
@@ -492,7 +718,10 @@ void showHelp() {
             "sense                           -- read sensor values\n"
             "get <OID>                       -- get a specific OID value from all motes\n"
             "set <OID> <type> <value>        -- set a specific OID to <value>\n"
+            "walk [<OID>]                    -- get all values under OID (default: all)\n"
+            "watch <sec> [<times>] [<OID>]   -- get values under OID periodically (0 sec to stop)\n"
             "select [<address>]              -- select a specific mote (no args for broadcast)\n"
+            "@<address> <command>            -- run a command on a specific mote\n"
             "load [<file>]                   -- load an ihex file (no args for clear existing)\n"
             "program [<address>]             -- upload code (from ihex file) on a specific mote\n"
             "reboot                          -- reboot mote\n"
@@ -510,6 +739,8 @@ struct Command_t {
 
 void handleSetCommand(char *args);
 void handleGetCommand(char *args);
+void handleWalkCommand(char *args);
+void handleWatchCommand(char *args);
 void handleLsCommand(char *args);
 void handleLedCommand(char *args);
 void handleSenseCommand(char *args);
@@ -592,6 +823,21 @@ static bool parseOnOff(char *args, bool &success) {
 void processCommand(char *cmdWithArgs) {
     if (*cmdWithArgs == '\0') return; // do nothing on empty input
 
+    if (*cmdWithArgs == '@') {
+        // a command for a specific mote
+        char *end;
+        unsigned address = strtoul(cmdWithArgs + 1, &end, 0);
+        if (end == cmdWithArgs + 1) {
+            fprintf(stderr, "an address expected after '@'!\n");
+            return;
+        }
+        uint16_t oldAddress = dstAddress;
+        dstAddress = address;
+        processCommand(trim(end));
+        dstAddress = oldAddress;
+        return;
+    }
+
     char cmd[MAX_CMD_SIZE + 1];
     char *args;
     parseCmdAndArgs(cmdWithArgs, cmd, args);
@@ -652,6 +898,56 @@ void handleGetCommand(char *args) {
     smpSend(SMP_COMMAND_GET, &oid, 1, NULL);
 }
 
+static void parseWalkOid(char *args, Oid_t *oid) {
+    if (args && *args) {
+        parseOid(args, oid);
+    } else {
+        oid->oid[0] = SMP_MOS;
+        oid->length = 1;
+    }
+}
+
+void handleWalkCommand(char *args) {
+    Oid_t oid;
+    parseWalkOid(args, &oid);
+    smpSendWalk(&oid, false, 0, 0);
+}
+
+void handleWatchCommand(char *args) {
+    if (!args) {
+        fprintf(stderr, "SMP watch command: arguments expected!\n");
+        return;
+    }
+    char *end;
+    unsigned seconds = strtoul(args, &end, 10);
+    if (end == args) {
+        fprintf(stderr, "SMP watch command: a number expected!\n");
+        return;
+    }
+    args = end;
+    while (isspace(*args)) ++args;
+    unsigned times = 0;
+    // an optional repeat count before the OID (that contains dots)
+    char *oidStart = args + strcspn(args, " \t");
+    if (*args && !memchr(args, '.', oidStart - args) && *oidStart) {
+        times = strtoul(args, &end, 10);
+        args = end;
+        while (isspace(*args)) ++args;
+    }
+
+    Oid_t oid;
+    parseWalkOid(args, &oid);
+    if (!seconds) {
+        // stop waiting for the pushed responses
+        RequestMap::iterator it = requests.begin();
+        while (it != requests.end()) {
+            if (it->second.kind == RK_WATCH) requests.erase(it++);
+            else ++it;
+        }
+    }
+    smpSendWalk(&oid, true, seconds * 1000, seconds ? times : 0);
+}
+
 void handleLedCommand(char *args) {
     if (!args) {
         fprintf(stderr, "LED command: arguments expected!\n");
@@ -810,10 +1106,8 @@ void handleRebootCommand(char *args) {
         pck.extFlashAddress = 0;
     }
 
-    smpSend(&pck, sizeof(pck));
-
     // this is a special command: do not wait for reply
-    commandInProgress = false;
+    smpSend(&pck, sizeof(pck), RK_REBOOT);
 }
 
 // -------------------------------------------------------
@@ -829,7 +1123,7 @@ void sendCodeFileStart(CodeType ct) {
     // pck.destinationAddress = RA_DST_LOCAL;
 
     // start sending hex file
-    smpSend(&pck, sizeof(pck));
+    smpSend(&pck, sizeof(pck), RK_PROGRAM);
 }
 
 void sendCodeFileContinue(void) {
@@ -850,7 +1144,7 @@ void sendCodeFileContinue(void) {
     pck.crc = crc16((uint8_t *)&pck.address, 2 + REPROGRAMMING_DATA_CHUNK_SIZE);
 
     // send next hex file chunk
-    smpSend(&pck, sizeof(pck));
+    smpSend(&pck, sizeof(pck), RK_PROGRAM);
 
     ++image.currentChunk;
     ++image.blockId;
@@ -858,25 +1152,42 @@ void sendCodeFileContinue(void) {
 
 // -------------------------------------------------------
 
-int readInput() {
-    char buffer[100];
-    ssize_t ret = read(0, buffer, sizeof(buffer) - 1);
+static void printPrompt(void) {
+    if (batchMode) return;
+    fputs(PROMPT, stdout);
+    fflush(stdout);
+}
+
+// read commands; each complete line is executed at once, even if
+// earlier commands are still waiting for replies
+int readInput(int fd) {
+    static string line;
+    char buffer[256];
+    ssize_t ret = read(fd, buffer, sizeof(buffer));
     if (ret < 0) {
+        if (errno == EAGAIN || errno == EINTR) return 1;
         perror("readInput");
         return ret;
     }
 
     if (ret == 0) {
         // fprintf(stderr, "EOF on stdin\n");
-        return 0;
-    }
-    if (commandInProgress) {
-        // ignore user input while commands are in progress
-        return ret;
+        buffer[0] = '\n'; // execute the last line without newline, if any
+        if (line.empty()) return 0;
+        ret = 1;
     }
 
-    buffer[ret] = 0;
-    processCommand(trim(buffer));
+    for (ssize_t i = 0; i < ret; ++i) {
+        if (buffer[i] != '\n') {
+            line += buffer[i];
+            continue;
+        }
+        vector<char> command(line.begin(), line.end());
+        command.push_back('\0');
+        line.clear();
+        processCommand(trim(&command[0]));
+        printPrompt();
+    }
     return ret;
 }
 
@@ -909,111 +1220,65 @@ void handleDebugPacket(uint8_t *data, uint16_t len) {
     fflush(stdout);
 }
 
-void handleSmpPacket(uint8_t *data, uint16_t len) {
-    // printf("read %d bytes from serial port:\n", len);
+
+void handlePacket(Connection *connection, uint8_t protocol,
+                  uint8_t *data, uint16_t len) {
+    // printf("read %d bytes from %s:\n", len, connection->name.c_str());
     // hexdump(data, len);
-    smpRecv(data, len);
-    printf("\n");
-    fflush(stdout);
+    switch (protocol) {
+    case PROTOCOL_DEBUG:
+        if (!batchMode) handleDebugPacket(data, len);
+        break;
+    case PROTOCOL_SMP:
+        smpRecv(connection, data, len);
+        if (!batchMode) printf("\n");
+        fflush(stdout);
+        break;
+    default:
+        fprintf(stderr, "unknown data recvd\n");
+        break;
+    }
 }
 
-int readData() {
-    static uint8_t recvBuf[400];
-    static uint8_t protocol;
-    static uint16_t symbolsRead;
-    static uint16_t expectedLen;
-    static enum {
-        READ_DELIMITER,
-        READ_PROTOCOL,
-        READ_LEN_BYTE1,
-        READ_LEN_BYTE2,
-        READ_DATA
-    } state = READ_DELIMITER;
-
-    uint8_t tmpBuf[400];
-    ssize_t len = read(serialFD, tmpBuf, sizeof(tmpBuf) - 1);
-    uint8_t *input = tmpBuf;
-
-    if (len < 0) {
-        perror("readData");
-        return len;
-    }
-    if (len == 0) {
-        fprintf(stderr, "EOF on serial port\n");
-        return 0;
-    }
-
-    // fprintf(stderr, "readData: read %d bytes\n", len);
-    // hexdump(tmpBuf, len);
-
-    while (input < tmpBuf + len) {
-        switch (state) {
-        case READ_DELIMITER:
-            if (*input++ == SERIAL_PACKET_DELIMITER) {
-                state = READ_PROTOCOL;
-            }
-            break;
-        case READ_PROTOCOL:
-            protocol = *input++;
-            if (protocol == PROTOCOL_SMP || protocol == PROTOCOL_DEBUG) {
-                state = READ_LEN_BYTE1;
-            } else if (protocol != SERIAL_PACKET_DELIMITER) {
-                state = READ_DELIMITER;
-            }
-            break;
-        case READ_LEN_BYTE1:
-            expectedLen = (*input++) << 8;
-            state = READ_LEN_BYTE2;
-            break;
-        case READ_LEN_BYTE2:
-            expectedLen = expectedLen | (*input++);
-            if (expectedLen == 0 || expectedLen > sizeof(recvBuf) - 1) {
-                fprintf(stderr, "shell: invalid packet length "
-                        "on serial port: %d\n", expectedLen);
-                expectedLen = 0;
-                state = READ_DELIMITER;
-            } else {
-                state = READ_DATA;
-            }
-            break;
-        case READ_DATA:
-            // TODO: make more efficient
-            recvBuf[symbolsRead++] = *input++;
-            if (symbolsRead == expectedLen) {
-                switch (protocol) {
-                case PROTOCOL_DEBUG:
-                    recvBuf[symbolsRead] = '\0';
-                    handleDebugPacket(recvBuf, symbolsRead);
-                    break;
-                case PROTOCOL_SMP:
-                    handleSmpPacket(recvBuf, symbolsRead);
-                    break;
-                default:
-                    fprintf(stderr, "unknown data recvd\n");
-                    break;
-                }
-                state = READ_DELIMITER;
-                symbolsRead = 0;
-            }
-            break;
-        }
+static void closeConnection(unsigned i) {
+    map<uint16_t, Connection *>::iterator it = moteConnections.begin();
+    while (it != moteConnections.end()) {
+        if (it->second == connections[i]) moteConnections.erase(it++);
+        else ++it;
     }
-    return len;
+    delete connections[i];
+    connections.erase(connections.begin() + i);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: shell [options] [serial-port]\n"
+            "  -d <serial-port>   connect to a base station (repeatable; default %s)\n"
+            "  -c <host[:port]>   connect to pc-cloud (repeatable)\n"
+            "  -l <file>          load an ihex file\n"
+            "  -s <address>       select a mote\n"
+            "  -b <file>          batch mode: run commands from file ('-' for stdin)\n"
+            "                     in parallel, print one value per line, then exit\n"
+            "  -t <ms>            request timeout (default %d)\n"
+            "  -r <count>         retries of unanswered requests (default %d)\n",
+            defaultSerialDevice, DEFAULT_TIMEOUT, DEFAULT_RETRIES);
 }
 
-// usage: ./shell [serial-port]
 int main(int argc, char *argv[]) {
-    struct termios newtio;
+    int inputFd = 0;
+    vector<const char *> serialDevices;
+    vector<const char *> cloudAddresses;
 
-    printf("MansOS command shell; version %d.%d (built %s)\n\n",
-            VERSION_MAJOR, VERSION_MINOR, __DATE__);
-            
     // Backwards compability
-    if (argc == 2) {
-        serialDevice = *++argv;
+    if (argc == 2 && argv[1][0] != '-') {
+        serialDevices.push_back(argv[1]);
     }
     else {
         while (*++argv != NULL) {
+            if (!argv[1] && argv[0][0] == '-') {
+                printf("Parameter expected after %s\n", *argv);
+                usage();
+                return -1;
+            }
             if  (!strcmp(*argv, "-l")) {
                 handleLoadFileCommand(*++argv);
             }
@@ -1021,34 +1286,54 @@ int main(int argc, char *argv[]) {
                  handleSelectAddressCommand(*++argv);
             }
             else if (!strcmp(*argv, "-d")) {
-                serialDevice = *++argv;
+                serialDevices.push_back(*++argv);
+            }
+            else if (!strcmp(*argv, "-c")) {
+                cloudAddresses.push_back(*++argv);
+            }
+            else if (!strcmp(*argv, "-b")) {
+                batchMode = true;
+                ++argv;
+                if (strcmp(*argv, "-")) {
+                    inputFd = open(*argv, O_RDONLY);
+                    if (inputFd < 0) {
+                        perror(*argv);
+                        return -1;
+                    }
+                }
             }
-            else
+            else if (!strcmp(*argv, "-t")) {
+                commandTimeout = atoi(*++argv);
+            }
+            else if (!strcmp(*argv, "-r")) {
+                commandRetries = atoi(*++argv);
+            }
+            else {
                 printf("Unrecognized parameter: %s\n", *argv);
+                usage();
+                return -1;
+            }
         }
     }
-    // fprintf(stderr, "using serial port %s\n", serialDevice);
-
-    serialFD = open(serialDevice, O_RDWR | O_NOCTTY | O_NONBLOCK);
-    if (serialFD < 0) {
-        perror("serial open");
-        return -1;
+    if (serialDevices.empty() && cloudAddresses.empty()) {
+        serialDevices.push_back(defaultSerialDevice);
     }
 
-    /* Serial port setting */
-    memset(&newtio, 0, sizeof(newtio));
-    newtio.c_cflag = CS8 | CLOCAL | CREAD;
-    newtio.c_iflag = IGNPAR | IGNBRK;
-    cfsetispeed(&newtio, BAUDRATE);
-    cfsetospeed(&newtio, BAUDRATE);
+    if (!batchMode) {
+        printf("MansOS command shell; version %d.%d (built %s)\n\n",
+                VERSION_MAJOR, VERSION_MINOR, __DATE__);
+    }
 
-    if (tcflush(serialFD, TCIFLUSH) < 0) {
-        perror("tcflush");
-        return -1;
+    packetHandler = handlePacket;
+    for (unsigned i = 0; i < serialDevices.size(); ++i) {
+        Connection *c = openSerialConnection(serialDevices[i]);
+        if (!c) return -1;
+        connections.push_back(c);
     }
-    if (tcsetattr(serialFD, TCSANOW, &newtio) < 0) {
-        perror("tcsetattr");
-        return -1;
+    for (unsigned i = 0; i < cloudAddresses.size(); ++i) {
+        Connection *c = openCloudConnection(cloudAddresses[i]);
+        if (!c) return -1;
+        connections.push_back(c);
     }
 
     registerCommand("ls", handleLsCommand);
@@ -1056,6 +1341,8 @@ int main(int argc, char *argv[]) {
     registerCommand("sense", handleSenseCommand);
     registerCommand("set", handleSetCommand);
     registerCommand("get", handleGetCommand);
+    registerCommand("walk", handleWalkCommand);
+    registerCommand("watch", handleWatchCommand);
     registerCommand("quit", handleQuitCommand);
     registerCommand("help", handleHelpCommand);
     registerCommand("?", handleHelpCommand);
@@ -1064,68 +1351,60 @@ int main(int argc, char *argv[]) {
     registerCommand("program", handleProgramCommand);
     registerCommand("reboot", handleRebootCommand);
 
-    fputs(PROMPT, stdout);
-    fflush(stdout);
+    printPrompt();
 
-    bool eofOnStdin = false;
+    bool eofOnInput = false;
     for (;;) {
-        fd_set rfds;
-        struct timeval tv;
-        int ret;
-
-        FD_ZERO(&rfds);
-        if (!eofOnStdin) FD_SET(0, &rfds);
-        FD_SET(serialFD, &rfds);
+        vector<pollfd> fds(connections.size() + 1);
 
-        tv.tv_sec = WAIT_TIMEOUT;
-        tv.tv_usec = 0;
+        // stdin (or batch file) is the last one
+        for (unsigned i = 0; i < connections.size(); ++i) {
+            fds[i].fd = connections[i]->fd;
+            fds[i].events = POLLIN;
+            if (connections[i]->wantWrite()) fds[i].events |= POLLOUT;
+        }
+        fds.back().fd = eofOnInput ? -1 : inputFd;
+        fds.back().events = POLLIN;
 
-        ret = select(serialFD + 1, &rfds, NULL, NULL, &tv);
+        int ret = poll(&fds[0], fds.size(), nextTimeout());
         if (ret == -1) {
-            perror("select");
+            if (errno == EINTR) continue;
+            perror("poll");
             return -1;
         }
 
-        bool printPrompt = false;
-
-        if (FD_ISSET(serialFD, &rfds)) {
-            if (readData() < 0) return -1;
-        }
-        if (FD_ISSET(0, &rfds)) {
-            int ret = readInput();
-            if (ret < 0) return -1;
-            if (ret == 0) eofOnStdin = true;
-            else if (!commandInProgress) {
-                printPrompt = true;
+        for (unsigned i = connections.size(); i-- > 0; ) {
+            bool ok = true;
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ok = connections[i]->receive() >= 0;
             }
-        }
-
-        unsigned now = time(NULL);
-        if (commandInProgress && now >= commandIssuedTime + COMMAND_TIMEOUT) {
-            if (!commandReplyReceived) {
-                printf("..timeout.\n");
-                imageId = 0;
-                commandInProgress = false;
-                printPrompt = true;
-            } else if (!isCodeFileBeingSent()) {
-                commandInProgress = false;
-                printPrompt = true;
+            if (ok && (fds[i].revents & POLLOUT)) {
+                ok = connections[i]->flush() >= 0;
             }
+            if (!ok) closeConnection(i);
+        }
+        if (connections.empty()) {
+            fprintf(stderr, "shell: no connections left\n");
+            return -1;
         }
 
-        if (eofOnStdin && !commandInProgress) {
-            // printf("EOF\n");
-            fputc('\n', stdout);
-            return 0;
+        if (fds.back().revents) {
+            int ret = readInput(inputFd);
+            if (ret < 0) return -1;
+            if (ret == 0) eofOnInput = true;
         }
 
-        if (printPrompt) {
-            fputs(PROMPT, stdout);
-            fflush(stdout);
+        checkTimeouts();
+
+        // send the new requests right away
+        for (unsigned i = 0; i < connections.size(); ++i) {
+            if (connections[i]->wantWrite()) connections[i]->flush();
         }
 
-        if (isCodeFileBeingSent() && commandReplyReceived) {
-            sendCodeFileContinue();
+        if (eofOnInput && !requestsPending()) {
+            // printf("EOF\n");
+            if (!batchMode) fputc('\n', stdout);
+            return 0;
         }
     }
 }
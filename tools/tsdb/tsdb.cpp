@@ -0,0 +1,475 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tsdb.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// a time delta-of-delta (max 10 bytes) and a value (max 9 bytes)
+#define MAX_SAMPLE_SIZE  19u
+#define MAX_CHUNK_COUNT  0xffff
+
+struct Chunk {
+    TsdbChunkHeader header;
+    uint8_t payload[TSDB_PAYLOAD_SIZE];
+};
+
+typedef char chunkSizeCheck[sizeof(Chunk) == TSDB_CHUNK_SIZE ? 1 : -1];
+
+struct Tsdb {
+    int fd;
+    bool writable;
+
+    // read-only mapping of the whole chunks of the file
+    const uint8_t *map;
+    size_t mapSize;
+
+    // the last chunk (writable series only)
+    Chunk chunk;
+    uint64_t chunkIndex;
+    bool dirty;
+    bool hasPrev;
+    int64_t prevTime;
+    int64_t prevDelta;
+    uint64_t prevBits;
+};
+
+static inline uint64_t doubleBits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline double bitsDouble(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// -----------------------------------------------
+// Encoding
+
+static inline unsigned putVarint(uint8_t *p, uint64_t x)
+{
+    unsigned n = 0;
+    while (x >= 0x80) {
+        p[n++] = (uint8_t) x | 0x80;
+        x >>= 7;
+    }
+    p[n++] = (uint8_t) x;
+    return n;
+}
+
+static inline unsigned putValue(uint8_t *p, uint64_t x)
+{
+    if (x == 0) {
+        p[0] = 0;
+        return 1;
+    }
+    unsigned trailing = __builtin_ctzll(x) / 8;
+    unsigned leading = __builtin_clzll(x) / 8;
+    unsigned n = 8 - trailing - leading;
+    p[0] = (trailing << 4) | n;
+    x >>= trailing * 8;
+    for (unsigned i = 1; i <= n; i++) {
+        p[i] = (uint8_t) x;
+        x >>= 8;
+    }
+    return n + 1;
+}
+
+class ChunkDecoder {
+public:
+    ChunkDecoder(const Chunk *chunk)
+        : p(chunk->payload), end(chunk->payload + chunk->header.used),
+          left(chunk->header.count), time(chunk->header.firstTime),
+          delta(0), bits(0) {
+        if (end > chunk->payload + TSDB_PAYLOAD_SIZE) {
+            end = chunk->payload + TSDB_PAYLOAD_SIZE;
+        }
+    }
+
+    // decode the next sample; false at the end of chunk or on bad data
+    bool next(int64_t &t, double &v) {
+        if (!left) return false;
+        left--;
+
+        uint64_t zigzag = 0;
+        unsigned shift = 0;
+        do {
+            if (p >= end || shift > 63) return fail();
+            zigzag |= (uint64_t) (*p & 0x7f) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+        delta += (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+        time += delta;
+
+        if (p >= end) return fail();
+        uint8_t control = *p++;
+        if (control) {
+            unsigned n = control & 0xf;
+            unsigned trailing = control >> 4;
+            if (n > 8 || trailing + n > 8 || p + n > end) return fail();
+            uint64_t x = 0;
+            for (unsigned i = 0; i < n; i++) {
+                x |= (uint64_t) p[i] << (8 * i);
+            }
+            p += n;
+            bits ^= x << (trailing * 8);
+        }
+        t = time;
+        v = bitsDouble(bits);
+        return true;
+    }
+
+    int64_t lastDelta() const { return delta; }
+    uint64_t lastBits() const { return bits; }
+
+private:
+    bool fail() { left = 0; return false; }
+
+    const uint8_t *p;
+    const uint8_t *end;
+    unsigned left;
+    int64_t time;
+    int64_t delta;
+    uint64_t bits;
+};
+
+// -----------------------------------------------
+// Writing
+
+static void resetChunk(Tsdb *db)
+{
+    memset(&db->chunk.header, 0, sizeof(db->chunk.header));
+    db->chunk.header.magic = TSDB_CHUNK_MAGIC;
+}
+
+static bool validHeader(const TsdbChunkHeader *h)
+{
+    return h->magic == TSDB_CHUNK_MAGIC && h->count != 0
+            && h->used <= TSDB_PAYLOAD_SIZE;
+}
+
+// load the last chunk of the file to continue appending to it
+static int loadLastChunk(Tsdb *db)
+{
+    struct stat st;
+    if (fstat(db->fd, &st) < 0) return -1;
+    // drop a partially written chunk at the end
+    off_t size = st.st_size - st.st_size % TSDB_CHUNK_SIZE;
+    if (size != st.st_size && ftruncate(db->fd, size) < 0) return -1;
+
+    resetChunk(db);
+    db->chunkIndex = 0;
+    if (size == 0) return 0;
+
+    db->chunkIndex = size / TSDB_CHUNK_SIZE - 1;
+    Chunk chunk;
+    if (pread(db->fd, &chunk, sizeof(chunk), size - TSDB_CHUNK_SIZE) != sizeof(chunk)) {
+        return -1;
+    }
+    if (!validHeader(&chunk.header)) {
+        // overwrite a broken last chunk
+        return 0;
+    }
+    ChunkDecoder decoder(&chunk);
+    int64_t t = 0;
+    double v;
+    unsigned count = 0;
+    while (decoder.next(t, v)) count++;
+    if (count != chunk.header.count) return 0;
+
+    db->chunk = chunk;
+    db->hasPrev = true;
+    db->prevTime = t;
+    db->prevDelta = decoder.lastDelta();
+    db->prevBits = decoder.lastBits();
+    return 0;
+}
+
+int tsdbFlush(Tsdb *db)
+{
+    if (!db->dirty) return 0;
+    if (pwrite(db->fd, &db->chunk, sizeof(db->chunk),
+               (off_t) db->chunkIndex * TSDB_CHUNK_SIZE) != sizeof(db->chunk)) {
+        return -1;
+    }
+    db->dirty = false;
+    return 0;
+}
+
+int tsdbAppend(Tsdb *db, int64_t timeMs, double value)
+{
+    if (!db->writable) {
+        errno = EBADF;
+        return -1;
+    }
+    TsdbChunkHeader *h = &db->chunk.header;
+    if (db->hasPrev && timeMs < db->prevTime) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (h->used + MAX_SAMPLE_SIZE > TSDB_PAYLOAD_SIZE || h->count == MAX_CHUNK_COUNT) {
+        if (tsdbFlush(db) < 0) return -1;
+        db->chunkIndex++;
+        resetChunk(db);
+    }
+    if (h->count == 0) {
+        h->firstTime = timeMs;
+        h->min = h->max = value;
+        db->prevTime = timeMs;
+        db->prevDelta = 0;
+        db->prevBits = 0;
+    }
+
+    int64_t delta = timeMs - db->prevTime;
+    int64_t deltaOfDelta = delta - db->prevDelta;
+    uint64_t zigzag = ((uint64_t) deltaOfDelta << 1) ^ (uint64_t) (deltaOfDelta >> 63);
+    uint64_t bits = doubleBits(value);
+
+    uint8_t *p = db->chunk.payload + h->used;
+    unsigned n = putVarint(p, zigzag);
+    n += putValue(p + n, bits ^ db->prevBits);
+
+    h->used += n;
+    h->count++;
+    h->lastTime = timeMs;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+    h->sum += value;
+
+    db->hasPrev = true;
+    db->prevTime = timeMs;
+    db->prevDelta = delta;
+    db->prevBits = bits;
+    db->dirty = true;
+    return 0;
+}
+
+// -----------------------------------------------
+// Reading
+
+// map the whole chunks of the file (again, if it has grown)
+static int mapFile(Tsdb *db)
+{
+    if (db->writable && tsdbFlush(db) < 0) return -1;
+
+    struct stat st;
+    if (fstat(db->fd, &st) < 0) return -1;
+    size_t size = st.st_size - st.st_size % TSDB_CHUNK_SIZE;
+    if (size == db->mapSize) return 0;
+
+    if (db->map) munmap((void *) db->map, db->mapSize);
+    db->map = NULL;
+    db->mapSize = 0;
+    if (size == 0) return 0;
+
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, db->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    db->map = (const uint8_t *) map;
+    db->mapSize = size;
+    return 0;
+}
+
+static inline size_t numChunks(const Tsdb *db)
+{
+    return db->mapSize / TSDB_CHUNK_SIZE;
+}
+
+static inline const Chunk *getChunk(const Tsdb *db, size_t i)
+{
+    return (const Chunk *) (db->map + i * TSDB_CHUNK_SIZE);
+}
+
+// the first chunk that may contain samples at or after 'from'
+static size_t findChunk(const Tsdb *db, int64_t from)
+{
+    size_t lo = 0, hi = numChunks(db);
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const TsdbChunkHeader *h = &getChunk(db, mid)->header;
+        if (validHeader(h) && h->lastTime < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int tsdbInfo(Tsdb *db, TsdbInfo *info)
+{
+    if (mapFile(db) < 0) return -1;
+    memset(info, 0, sizeof(*info));
+    for (size_t i = 0; i < numChunks(db); i++) {
+        const TsdbChunkHeader *h = &getChunk(db, i)->header;
+        if (!validHeader(h)) continue;
+        if (!info->samples) info->firstTime = h->firstTime;
+        info->lastTime = h->lastTime;
+        info->samples += h->count;
+        info->chunks++;
+    }
+    return 0;
+}
+
+long tsdbRead(Tsdb *db, int64_t from, int64_t to,
+              int64_t *times, double *values, long max)
+{
+    if (mapFile(db) < 0) return -1;
+    long count = 0;
+    for (size_t i = findChunk(db, from); i < numChunks(db) && count < max; i++) {
+        const Chunk *chunk = getChunk(db, i);
+        if (!validHeader(&chunk->header)) continue;
+        if (chunk->header.firstTime > to) break;
+
+        ChunkDecoder decoder(chunk);
+        int64_t t;
+        double v;
+        while (count < max && decoder.next(t, v)) {
+            if (t < from) continue;
+            if (t > to) break;
+            times[count] = t;
+            values[count] = v;
+            count++;
+        }
+    }
+    return count;
+}
+
+static inline void bucketAdd(TsdbBucket *b, int64_t time,
+                             double min, double max, double sum, uint32_t count)
+{
+    if (b->count == 0) {
+        b->time = time;
+        b->min = min;
+        b->max = max;
+    } else {
+        if (min < b->min) b->min = min;
+        if (max > b->max) b->max = max;
+    }
+    b->avg += sum; // the sum until the buckets are finished
+    b->count += count;
+}
+
+long tsdbDownsample(Tsdb *db, int64_t from, int64_t to,
+                    long buckets, TsdbBucket *out)
+{
+    if (buckets <= 0 || to < from) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (mapFile(db) < 0) return -1;
+
+    // clamp the range to the stored data
+    size_t first = 0, last = numChunks(db);
+    while (first < last && !validHeader(&getChunk(db, first)->header)) first++;
+    while (last > first && !validHeader(&getChunk(db, last - 1)->header)) last--;
+    if (first == last) return 0;
+    if (from < getChunk(db, first)->header.firstTime) {
+        from = getChunk(db, first)->header.firstTime;
+    }
+    if (to > getChunk(db, last - 1)->header.lastTime) {
+        to = getChunk(db, last - 1)->header.lastTime;
+    }
+    if (to < from) return 0;
+
+    memset(out, 0, buckets * sizeof(*out));
+    // the last bucket ends exactly at 'to'
+    uint64_t width = ((uint64_t) to - (uint64_t) from) / buckets + 1;
+
+    for (size_t i = findChunk(db, from); i < numChunks(db); i++) {
+        const Chunk *chunk = getChunk(db, i);
+        const TsdbChunkHeader *h = &chunk->header;
+        if (!validHeader(h)) continue;
+        if (h->firstTime > to) break;
+
+        if (h->firstTime >= from && h->lastTime <= to) {
+            uint64_t first = ((uint64_t) h->firstTime - (uint64_t) from) / width;
+            uint64_t last = ((uint64_t) h->lastTime - (uint64_t) from) / width;
+            if (first == last) {
+                // the whole chunk falls in one bucket: use the index only
+                bucketAdd(&out[first], h->firstTime, h->min, h->max, h->sum, h->count);
+                continue;
+            }
+        }
+
+        ChunkDecoder decoder(chunk);
+        int64_t t;
+        double v;
+        while (decoder.next(t, v)) {
+            if (t < from) continue;
+            if (t > to) break;
+            bucketAdd(&out[((uint64_t) t - (uint64_t) from) / width], t, v, v, v, 1);
+        }
+    }
+
+    long n = 0;
+    for (long i = 0; i < buckets; i++) {
+        if (!out[i].count) continue;
+        out[n] = out[i];
+        out[n].avg /= out[n].count;
+        n++;
+    }
+    return n;
+}
+
+// -----------------------------------------------
+
+Tsdb *tsdbOpen(const char *path, int writable)
+{
+    int fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) return NULL;
+
+    Tsdb *db = (Tsdb *) calloc(1, sizeof(Tsdb));
+    if (!db) {
+        close(fd);
+        return NULL;
+    }
+    db->fd = fd;
+    db->writable = writable;
+    if (writable && loadLastChunk(db) < 0) {
+        int error = errno;
+        tsdbClose(db);
+        errno = error;
+        return NULL;
+    }
+    return db;
+}
+
+void tsdbClose(Tsdb *db)
+{
+    if (!db) return;
+    if (db->writable) tsdbFlush(db);
+    if (db->map) munmap((void *) db->map, db->mapSize);
+    close(db->fd);
+    free(db);
+}
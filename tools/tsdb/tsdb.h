@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Time series store for the collected sensor data: one append-only file
+// per sensor of each mote (<data directory>/<mote>/<sensor>.tsd).
+//
+// The file is a sequence of fixed-size chunks, so it can be memory-mapped
+// and the chunk headers used as an index. Each chunk holds a header with
+// the time range, min, max and sum of its samples, followed by the samples:
+//   time:  delta-of-delta from the previous sample, zigzag varint
+//   value: XOR with the previous value (as IEEE double); a control byte
+//          (trailing zero bytes << 4 | number of bytes, 0 if equal)
+//          followed by the nonzero bytes of the XOR, little endian
+// The first sample of a chunk is encoded against time 'firstTime',
+// delta 0 and value 0, so every chunk can be decoded on its own.
+//
+// The interface is plain C, for use from the Python binding (tools/lib/tsdb.py).
+//
+
+#ifndef MANSOS_TSDB_H
+#define MANSOS_TSDB_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSDB_CHUNK_SIZE   4096
+#define TSDB_CHUNK_MAGIC  0x31445354  // "TSD1"
+
+typedef struct TsdbChunkHeader {
+    uint32_t magic;
+    uint16_t count;      // number of samples
+    uint16_t used;       // payload bytes used
+    int64_t firstTime;   // milliseconds since 1970
+    int64_t lastTime;
+    double min;
+    double max;
+    double sum;
+} TsdbChunkHeader;
+
+#define TSDB_PAYLOAD_SIZE (TSDB_CHUNK_SIZE - sizeof(TsdbChunkHeader))
+
+typedef struct TsdbInfo {
+    int64_t firstTime;
+    int64_t lastTime;
+    uint64_t samples;
+    uint64_t chunks;
+} TsdbInfo;
+
+// one point of a downsampled query
+typedef struct TsdbBucket {
+    int64_t time;        // time of the first sample in the bucket
+    double min;
+    double max;
+    double avg;
+    uint32_t count;
+    uint32_t reserved;
+} TsdbBucket;
+
+typedef struct Tsdb Tsdb;
+
+// open a series; a writable one is created if it does not exist.
+// Returns NULL on error (with errno set)
+Tsdb *tsdbOpen(const char *path, int writable);
+// flush the written data and close
+void tsdbClose(Tsdb *db);
+
+// append a sample; time must not go backwards (returns -1 and EINVAL then)
+int tsdbAppend(Tsdb *db, int64_t timeMs, double value);
+// write out the last chunk; appended data is visible to the readers after this
+int tsdbFlush(Tsdb *db);
+
+int tsdbInfo(Tsdb *db, TsdbInfo *info);
+
+// read the samples in time range [from, to]; returns their number (at most 'max')
+long tsdbRead(Tsdb *db, int64_t from, int64_t to,
+              int64_t *times, double *values, long max);
+
+// split [from, to] (limited to the stored time range) in 'buckets' equal
+// intervals and aggregate the samples in each of them. Returns the number
+// of nonempty buckets written to 'out' (in time order), or -1 on error.
+long tsdbDownsample(Tsdb *db, int64_t from, int64_t to,
+                    long buckets, TsdbBucket *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
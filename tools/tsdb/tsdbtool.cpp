@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2008-2014 the MansOS team. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of  conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//
+// Command line access to the time series files:
+// info, queries, import of the web server's CSV files and a benchmark.
+//
+
+#include "tsdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+using namespace std;
+
+static double nowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static Tsdb *openOrDie(const char *path, bool writable)
+{
+    Tsdb *db = tsdbOpen(path, writable);
+    if (!db) {
+        perror(path);
+        exit(1);
+    }
+    return db;
+}
+
+static int info(const char *path)
+{
+    Tsdb *db = openOrDie(path, false);
+    TsdbInfo info;
+    if (tsdbInfo(db, &info) < 0) {
+        perror(path);
+        return 1;
+    }
+    printf("samples: %llu\nchunks: %llu\nfirst: %lld\nlast: %lld\n",
+           (unsigned long long) info.samples, (unsigned long long) info.chunks,
+           (long long) info.firstTime, (long long) info.lastTime);
+    if (info.samples) {
+        printf("bytes per sample: %.2f\n",
+               (double) info.chunks * TSDB_CHUNK_SIZE / info.samples);
+    }
+    tsdbClose(db);
+    return 0;
+}
+
+static int query(const char *path, int64_t from, int64_t to, long points)
+{
+    Tsdb *db = openOrDie(path, false);
+    if (points <= 0) {
+        vector<int64_t> times(1024);
+        vector<double> values(1024);
+        for (;;) {
+            long n = tsdbRead(db, from, to, &times[0], &values[0], times.size());
+            if (n < 0) {
+                perror(path);
+                return 1;
+            }
+            for (long i = 0; i < n; i++) {
+                printf("%lld\t%.15g\n", (long long) times[i], values[i]);
+            }
+            if (n < (long) times.size() || times[n - 1] == INT64_MAX) break;
+            from = times[n - 1] + 1;
+        }
+    } else {
+        vector<TsdbBucket> buckets(points);
+        long n = tsdbDownsample(db, from, to, points, &buckets[0]);
+        if (n < 0) {
+            perror(path);
+            return 1;
+        }
+        for (long i = 0; i < n; i++) {
+            printf("%lld\t%.15g\t%.15g\t%.15g\t%u\n", (long long) buckets[i].time,
+                   buckets[i].min, buckets[i].max, buckets[i].avg, buckets[i].count);
+        }
+    }
+    tsdbClose(db);
+    return 0;
+}
+
+// import a data file of the web server: "<unix time>\t<date>\t<value>" rows
+static int import(const char *csvPath, const char *path)
+{
+    FILE *f = fopen(csvPath, "r");
+    if (!f) {
+        perror(csvPath);
+        return 1;
+    }
+    Tsdb *db = openOrDie(path, true);
+    char line[256];
+    unsigned long imported = 0, skipped = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *end;
+        long long t = strtoll(line, &end, 10);
+        char *value = strrchr(line, '\t');
+        if (end == line || !value) {
+            continue; // the header
+        }
+        double v = strtod(value + 1, &end);
+        if (end == value + 1 || tsdbAppend(db, t * 1000, v) < 0) {
+            skipped++;
+            continue;
+        }
+        imported++;
+    }
+    fclose(f);
+    tsdbClose(db);
+    printf("%lu samples imported, %lu skipped\n", imported, skipped);
+    return 0;
+}
+
+// write a year of 1-minute samples, then time typical graph queries
+static int bench(const char *path)
+{
+    const long samples = 365L * 24 * 60;
+    const int64_t start = 1388534400000LL; // 2014-01-01
+    remove(path);
+
+    double t0 = nowMs();
+    Tsdb *db = openOrDie(path, true);
+    for (long i = 0; i < samples; i++) {
+        // integer readings (as the motes send them): a daily cycle with noise
+        double v = floor(500 + 100 * sin(i * 2 * M_PI / 1440)) + rand() % 10;
+        int64_t jitter = rand() % 16 == 0 ? rand() % 50 : 0;
+        tsdbAppend(db, start + i * 60000 + jitter, v);
+    }
+    tsdbClose(db);
+    double t1 = nowMs();
+    printf("append: %ld samples in %.1f ms\n", samples, t1 - t0);
+
+    db = openOrDie(path, false);
+    TsdbInfo info;
+    tsdbInfo(db, &info);
+    printf("size: %llu bytes, %.2f bytes per sample\n",
+           (unsigned long long) info.chunks * TSDB_CHUNK_SIZE,
+           (double) info.chunks * TSDB_CHUNK_SIZE / info.samples);
+
+    vector<TsdbBucket> buckets(1000);
+    t0 = nowMs();
+    long n = tsdbDownsample(db, info.firstTime, info.lastTime, 1000, &buckets[0]);
+    t1 = nowMs();
+    printf("year, 1000 points: %ld buckets in %.2f ms\n", n, t1 - t0);
+
+    t0 = nowMs();
+    n = tsdbDownsample(db, info.firstTime + 100 * 86400000LL,
+                       info.firstTime + 130 * 86400000LL, 1000, &buckets[0]);
+    t1 = nowMs();
+    printf("month, 1000 points: %ld buckets in %.2f ms\n", n, t1 - t0);
+
+    vector<int64_t> times(1440);
+    vector<double> values(1440);
+    t0 = nowMs();
+    n = tsdbRead(db, info.firstTime + 200 * 86400000LL,
+                 info.firstTime + 201 * 86400000LL - 1, &times[0], &values[0], 1440);
+    t1 = nowMs();
+    printf("day, raw: %ld samples in %.2f ms\n", n, t1 - t0);
+    tsdbClose(db);
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("Usage:\n");
+    printf("  tsdbtool info <file.tsd>\n");
+    printf("  tsdbtool query <file.tsd> [<from ms> <to ms> [<points>]]\n");
+    printf("  tsdbtool import <file.csv> <file.tsd>\n");
+    printf("  tsdbtool bench <file.tsd>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    const char *command = argv[1];
+    if (!strcmp(command, "info")) {
+        return info(argv[2]);
+    }
+    if (!strcmp(command, "query")) {
+        int64_t from = argc > 3 ? strtoll(argv[3], NULL, 0) : INT64_MIN;
+        int64_t to = argc > 4 ? strtoll(argv[4], NULL, 0) : INT64_MAX;
+        long points = argc > 5 ? strtol(argv[5], NULL, 0) : 0;
+        return query(argv[2], from, to, points);
+    }
+    if (!strcmp(command, "import") && argc > 3) {
+        return import(argv[2], argv[3]);
+    }
+    if (!strcmp(command, "bench")) {
+        return bench(argv[2]);
+    }
+    usage();
+    return 1;
+}
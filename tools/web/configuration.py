@@ -16,6 +16,9 @@ c = configfile.ConfigFile("server.cfg", automaticSections = True)
 c.setCfgValue("port", HTTP_SERVER_PORT)
 c.setCfgValue("baudrate", SERIAL_BAUDRATE)
 c.setCfgValue("motes", [])
+# when set, the data is read from the base station gateway (tools/gateway)
+# listening on this socket instead of the serial ports
+c.setCfgValue("gatewaySocket", "")
 c.setCfgValue("selectedMotes", [])
  # in format <port>:<platform>, e.g. /dev/ttyUSB0:telosb
 c.setCfgValue("motePlatforms", [])
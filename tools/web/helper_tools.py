@@ -2,6 +2,7 @@
 
 import threading
 import time
+import socket
 
 from motes import motes
 import moteconfig
@@ -47,7 +48,43 @@ def listenSerial():
         sensor_data.moteData.fixSizes()
         # pause for a bit
         time.sleep(0.01)
+    sensor_data.moteData.flushSeries(True)
    
+# Listen to the base station gateway, which reads all serial ports
+def listenGateway():
+    global isListening
+
+    sock = None
+    buffer = ""
+    while isListening:
+        if sock is None:
+            try:
+                sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                sock.settimeout(0.5)
+                sock.connect(configuration.c.getCfgValue("gatewaySocket"))
+            except socket.error:
+                sock = None
+                # the gateway is not running (yet)
+                time.sleep(1)
+                continue
+        try:
+            data = sock.recv(65536)
+        except socket.timeout:
+            continue
+        except socket.error:
+            data = ""
+        if not data:
+            sock.close()
+            sock = None
+            continue
+        lines = (buffer + data).split("\n")
+        buffer = lines.pop()
+        for line in lines:
+            sensor_data.moteData.addGatewayLine(line)
+        sensor_data.moteData.fixSizes()
+    if sock:
+        sock.close()
+
 # Listen to single selected mote    
 def listenSerialSingle():
     global isListening
@@ -58,6 +95,7 @@ def listenSerialSingle():
         sensor_data.moteData.fixSizes()
         # pause for a bit
         time.sleep(0.01)        
+    sensor_data.moteData.flushSeries(True)
 
 # Open all serial ports to listen for data
 def openAllSerial():
@@ -66,6 +104,11 @@ def openAllSerial():
     
     if isListening: return
     isListening = True
+    if configuration.c.getCfgValue("gatewaySocket"):
+        # the serial ports are used by the gateway
+        listenThread = threading.Thread(target = listenGateway)
+        listenThread.start()
+        return
     listenThread = threading.Thread(target = listenSerial)
     listenThread.start()
     for m in motes.getMotes():
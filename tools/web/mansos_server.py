@@ -595,6 +595,8 @@ class HttpServerHandler(BaseHTTPRequestHandler,
             self.serveGraphs(qs)
         elif o.path == "/graph-data":
             self.serveGraphData(qs)
+        elif o.path == "/graph-history":
+            self.serveGraphHistory(qs)
         elif o.path == "/graph-form":
             self.serveGraphForm(qs)
         elif o.path == "/upload":
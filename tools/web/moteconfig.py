@@ -15,6 +15,7 @@ supportedPlatforms = ["telosb", "testbed", "testbed2", "sm3", "xm1000"]
 
 MAX_TIME_WAIT_FOR_REPLY = 0.1 # max time to wait for a single reply, seconds
 MAX_RETRIES = 3               # send 3 times before giving up
+BULK_TIMEOUT = 2.0            # max time without bulk transfer progress, seconds
 
 
 def isFatCharacterAcceptable(c):
@@ -68,8 +69,9 @@ class Platform(object):
         self.leds = leds
 
 
-def wmpSendCommand(ser, command, args):
-    print("send cmd=" + str(command) + " args=" + str(map(hex, args)))
+def wmpSendCommand(ser, command, args, verbose = True):
+    if verbose:
+        print("send cmd=" + str(command) + " args=" + str(map(hex, args)))
     txFrame = "%c%c%c" % (WMP_START_CHARACTER, command, len(args))
     for a in args:
         txFrame += chr(a)
@@ -115,6 +117,7 @@ class MoteConfig(object):
         self.state = self.READ_START_CHARACTER
         self.currentSp = SerialPacket()
         self.lastSp = None
+        self.bulk = None   # BulkFileReceiver of the transfer in progress
         self.filenameOnMote = configuration.c.getCfgValue("saveToFilenameOnMote")
         for platform in supportedPlatforms:
             try:
@@ -127,6 +130,13 @@ class MoteConfig(object):
 
 
     def wmpProcessCommand(self):
+        if self.bulk and self.currentSp.command == WMP_CMD_FILE_DATA | WMP_CMD_REPLY_FLAG:
+            # acknowledge right away from the reader thread to keep the data flowing
+            ack = self.bulk.frameReceived(self.currentSp.arguments)
+            if ack:
+                self.wmpSendFileAck(*ack)
+            return
+
         print("rcdv command=" + str(self.currentSp.command & ~WMP_CMD_REPLY_FLAG) +\
             " args=" + str(map(hex, self.currentSp.arguments)))
         if not (self.currentSp.command & WMP_CMD_REPLY_FLAG):
@@ -211,6 +221,55 @@ class MoteConfig(object):
         if not ok: print("reply NOT received!")
         return (returnArguments, ok)
 
+    def wmpSendFileAck(self, offset, flags):
+        args = utils.le32write(offset) + [flags]
+        try:
+            wmpSendCommand(self.mote.port, WMP_CMD_FILE_ACK, args, verbose = False)
+        except Exception as e:
+            pass
+
+    # Fetch a file with bulk transfer, starting from 'offset'.
+    # Returns (data, ok); on failure the data received so far is returned,
+    # and the transfer can be resumed from offset + len(data).
+    def wmpGetFileBulk(self, filename, offset = 0, compress = True):
+        receiver = BulkFileReceiver(offset)
+        flags = WMP_BULK_COMPRESS if compress else 0
+        args = utils.le32write(offset) + [WMP_BULK_MAX_WINDOW, flags]
+        args = bytearray(args) + bytearray(filename)
+
+        # data frames may arrive before the reply is processed
+        self.bulk = receiver
+        (reply, ok) = self.wmpExchangeCommand(WMP_CMD_GET_FILE_BULK, args)
+        if not ok or len(reply) < 5 or reply[0] != WMP_SUCCESS:
+            self.bulk = None
+            return (receiver.data, False)
+        receiver.setFileSize(utils.le32read(reply[1:]))
+
+        lastOffset = receiver.offset
+        lastProgress = time.time()
+        retries = 0
+        while not receiver.done:
+            time.sleep(0.01)
+            if receiver.offset != lastOffset:
+                lastOffset = receiver.offset
+                lastProgress = time.time()
+                retries = 0
+            elif time.time() - lastProgress > BULK_TIMEOUT:
+                retries += 1
+                if retries > MAX_RETRIES:
+                    break
+                # ask to resend everything after the last received byte
+                receiver.nakOffset = None
+                self.wmpSendFileAck(receiver.offset, WMP_ACK_NAK)
+                lastProgress = time.time()
+
+        self.bulk = None
+        if not receiver.done:
+            print("bulk transfer of " + filename + " failed at offset " + str(receiver.offset))
+            self.wmpSendFileAck(receiver.offset, WMP_ACK_ABORT)
+            return (receiver.data, False)
+        return (receiver.data, True)
+
     def wmpGetSensorConfig(self, sensorCode):
         (args, ok) = self.wmpExchangeCommand(WMP_CMD_GET_SENSOR, [sensorCode])
         if not ok or len(args) < 5:
@@ -369,14 +428,17 @@ class MoteConfig(object):
             return (errst, False)
 
         self.configMode = True
-        (args, ok) = self.wmpExchangeCommand(WMP_CMD_GET_FILE, bytearray(filename))
+        (data, ok) = self.wmpGetFileBulk(filename)
+        if not ok and len(data) == 0:
+            # motes without bulk transfer support return the start of the file only
+            (data, ok) = self.wmpExchangeCommand(WMP_CMD_GET_FILE, bytearray(filename))
         self.configMode = False
 
         if not ok:
             errst = 'communication failed!'
             return (errst, False)
 
-        contents = str(bytearray(args))
+        contents = str(bytearray(data))
 
         text = '<em>File ' + filename + ' contents:</em><br/>\n'
         text += contents
@@ -8,7 +8,7 @@ from motelist import Motelist
 import configuration
 import utils
 
-def runSubprocess(args, server):
+def runSubprocess(args, server, env = None):
 #    print("runSubprocess: " + ",".join(args))
     retcode = -1
     try:
@@ -18,7 +18,7 @@ def runSubprocess(args, server):
         except:
             outFile = None
         proc = subprocess.Popen(args, stderr = subprocess.STDOUT, stdout = outFile,
-                                shell = False)
+                                shell = False, env = env)
         proc.wait()
         if outFile: outFile.close()
 #        print("proc finished, retcode={}".format(proc.returncode))
@@ -33,6 +33,25 @@ def runSubprocess(args, server):
     finally:
         return retcode
 
+outputLock = threading.Lock()
+
+# The web server rebuilds the same project with varying configurations:
+# share the compiled MansOS objects between them (see OBJECT_CACHE in
+# mos/make/Makefile), in a cache kept in the server's build directory
+def objectCacheArgs():
+    return ["OBJECT_CACHE=y",
+            "OBJECT_CACHE_DIR=" + os.path.abspath(os.path.join("build", "objcache"))]
+
+# add a line to the output shown on the upload page
+def reportProgress(text):
+    print(text)
+    with outputLock:
+        try:
+            with open(os.path.join("build", "child_output.txt"), "a") as f:
+                f.write(text + "\n")
+        except IOError:
+            pass
+
 
 class Mote(object):
     def __init__(self, moteDescription):
@@ -163,13 +182,15 @@ class Mote(object):
     def tryToUpload(self, server, filename):
         # print("tryToUpload for " + self.getPortName() + " filename=" + filename)
 
+        # several motes may be uploaded at the same time: do not change os.environ
+        env = dict(os.environ)
         if self.isLocal():
             if not self.port: return 1
-            os.environ['BSLPORT'] = self.moteDescription.getPort()
+            env['BSLPORT'] = self.moteDescription.getPort()
             bslScript = "ubsl.py"
         else:
             if not self.isSelected: return 0
-            os.environ['BSLPROXY'] = self.moteDescription.getHost()
+            env['BSLPROXY'] = self.moteDescription.getHost()
             bslScript = "netbsl.py"
 
         bslPath = os.path.join(configuration.c.getCfgValue("mansosDirectory"), 
@@ -191,7 +212,7 @@ class Mote(object):
         arglist.append("-p")
         arglist.append(filename)
 
-        return runSubprocess(arglist, server)
+        return runSubprocess(arglist, server, env)
 
     def tryToCompileAndUpload(self, server, codeType):
         # print("tryToCompileAndUpload for " + self.getPortName() + " codeType=" + codeType)
@@ -212,7 +233,7 @@ class Mote(object):
             arglist = ["make", "-C", "build"]
         else:
             # mansos build system
-            arglist = ["make", "-C", "build", self.platform, "upload"]
+            arglist = ["make", "-C", "build", self.platform, "upload"] + objectCacheArgs()
 
         retcode = runSubprocess(arglist, server)
         if retcode: return retcode
@@ -340,6 +361,67 @@ class MoteCollection(object):
     def isEmpty(self):
         return len(self.motes) == 0
 
+    # Build the MansOS (or SEAL) application in "build" directory once
+    # for each platform, then upload it to all motes at the same time.
+    # The compiled MansOS objects are reused between the builds (see
+    # objectCacheArgs()), so only the application is compiled.
+    def compileAndUploadAll(self, server):
+        targets = []
+        for m in self.getMotes():
+            if m.isLocal():
+                if not m.tryToOpenSerial(False) or not m.port: continue
+            elif not m.isSelected:
+                continue
+            targets.append(m)
+        if not targets:
+            return 0
+
+        retcode = 0
+        startTime = time.time()
+        built = set()
+        for platform in sorted(set([m.platform for m in targets])):
+            reportProgress("==== Building for " + platform)
+            t = time.time()
+            r = runSubprocess(["make", "-C", "build", platform] + objectCacheArgs(), server)
+            if r == 0:
+                built.add(platform)
+                reportProgress("==== Built for {} in {:.1f} s".format(platform, time.time() - t))
+            else:
+                reportProgress("==== Build for " + platform + " failed")
+                retcode = r
+
+        uploads = [m for m in targets if m.platform in built]
+        results = {}
+        def upload(m):
+            t = time.time()
+            reportProgress("==== Uploading to " + m.getFullName())
+            filename = os.path.join("build", "build", m.platform, "image.ihex")
+            try:
+                r = m.tryToUpload(server, filename)
+            except Exception as e:
+                print("upload exception:" + str(e))
+                r = 1
+            results[m] = (r, time.time() - t)
+            reportProgress("==== {} {}: {:.1f} s".format(m.getFullName(),
+                    "done" if r == 0 else "failed", time.time() - t))
+
+        uploadStart = time.time()
+        threads = [threading.Thread(target = upload, args = (m,)) for m in uploads]
+        for th in threads: th.start()
+        for th in threads: th.join()
+
+        succeeded = 0
+        for (r, duration) in results.values():
+            if r == 0:
+                succeeded += 1
+            else:
+                retcode = r
+        reportProgress("==== Uploaded to {} of {} motes in {:.1f} s "
+                       "(uploads {:.1f} s, {:.1f} s if done one by one)".format(
+                succeeded, len(targets), time.time() - startTime,
+                time.time() - uploadStart, sum([d for (r, d) in results.values()])))
+        return retcode
+
     def anySelected(self):
         for m in self.motes.values():
             if m.isSelected: return True
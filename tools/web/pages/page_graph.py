@@ -4,6 +4,7 @@ import random
 import os
 import json
 import configuration
+import tsdb
 
 class PageGraph():
     def serveGraphs(self, qs):
@@ -37,6 +38,44 @@ class PageGraph():
                     allData += "|"
         lastData = allData
         self.writeChunk(allData)
+
+    # stored data of a sensor for a longer period, downsampled to at most
+    # 'points' values; the same format as graph-data
+    # (e.g. /graph-history?mote=ttyUSB0&sensor=light&from=0&to=1400000000000&points=500)
+    def serveGraphHistory(self, qs):
+        self.send_response(200)
+        self.sendDefaultHeaders()
+        self.end_headers()
+
+        try:
+            mote = os.path.basename(qs["mote"][0])
+            sensor = os.path.basename(qs["sensor"][0]).lower()
+            start = int(qs.get("from", [tsdb.MIN_TIME])[0])
+            end = int(qs.get("to", [tsdb.MAX_TIME])[0])
+            points = min(int(qs.get("points", [500])[0]), 10000)
+        except (KeyError, ValueError):
+            return
+        if not tsdb.available or not mote or not sensor or points <= 0:
+            return
+
+        moteDir = mote
+        if moteDir[:3].lower() == "com":
+            moteDir = "_" + moteDir
+        filename = os.path.join(configuration.c.getCfgValue("dataDirectory"),
+                                moteDir, sensor + tsdb.TSDB_EXTENSION)
+        if not os.path.isfile(filename):
+            return
+        try:
+            with tsdb.TimeSeries(filename) as ts:
+                buckets = ts.downsample(start, end, points)
+        except IOError:
+            return
+
+        allData = sensor + "@" + mote + ":"
+        for (timestamp, minimum, maximum, avg, count) in buckets:
+            allData += str(timestamp) + "," + str(avg) + ";"
+        allData += "|"
+        self.writeChunk(allData)
         
     def serveGraphForm(self, qs):
         self.send_response(200)
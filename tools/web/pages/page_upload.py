@@ -368,12 +368,16 @@ class PageUpload():
                    print("compileAndUpload: unknow code type: " + codeType)
                    return 1
 
-               retcode = 0
-               for m in motes.getMotes():
-                   if m.isLocal():
-                       if not m.tryToOpenSerial(False): continue
-                   r = m.tryToCompileAndUpload(self, codeType)
-                   if r != 0: retcode = r
+               if codeType in ["c", "plain_c", "seal"]:
+                   # MansOS build system: build once per platform, upload in parallel
+                   retcode = motes.compileAndUploadAll(self)
+               else:
+                   retcode = 0
+                   for m in motes.getMotes():
+                       if m.isLocal():
+                           if not m.tryToOpenSerial(False): continue
+                       r = m.tryToCompileAndUpload(self, codeType)
+                       if r != 0: retcode = r
 
         finally:
             maybeIsInSubprocess = False
@@ -6,6 +6,10 @@ from __future__ import print_function
 import time, os
 import configuration
 import utils
+import tsdb
+
+# how often the time series are written to disk, seconds
+SERIES_FLUSH_INTERVAL = 1.0
 
 # Polynomial ^8 + ^5 + ^4 + 1
 def crc8Add(acc, byte):
@@ -32,6 +36,10 @@ class SensorData(object):
         self.tempData = []
         self.seenInThisPacket = set()
         self.firstPacket = True
+        # open time series files (tools/tsdb), by sensor name
+        self.series = {}
+        self.seriesDirty = False
+        self.lastSeriesFlush = time.time()
         baseDir = os.path.basename(motename)
         if baseDir[:3].lower() == "com":
             baseDir = "_" + baseDir
@@ -56,10 +64,6 @@ class SensorData(object):
         if not utils.isasciiString(dataName):
             return
         
-        if not dataName in self.seenInThisPacket:
-            self.seenInThisPacket.add(dataName)
-            self.data[dataName + "@" + motename] = []
-
         valueString = string[eqSignPos + 1:].strip()
 
         try:
@@ -72,7 +76,7 @@ class SensorData(object):
             except:
                 print("Sensor " + dataName + " value is in unknown format: " + valueString + "\n")
                 value = 0
-        self.data[dataName + "@" + motename].append([int(round(time.time()*1000)),value])#miliseconds since 1970
+        self.addValue(dataName, motename, int(round(time.time()*1000)), value) #miliseconds since 1970
         # save to file if required (multiple files)
         if configuration.c.getCfgValue("saveToFilename") \
                 and configuration.c.getCfgValue("saveProcessedData"):
@@ -91,8 +95,42 @@ class SensorData(object):
                     time.strftime("%d %b %Y %H:%M:%S", time.localtime()),
                     value))
                 f.close()
+            # the same data in the time series store, for graphs of long periods
+            if tsdb.available:
+                self.addToSeries(dataName, int(round(time.time()*1000)), value)
+
+    def addToSeries(self, dataName, timestamp, value):
+        try:
+            if dataName not in self.series:
+                filename = os.path.join(self.dirname, dataName + tsdb.TSDB_EXTENSION)
+                self.series[dataName] = tsdb.TimeSeries(filename, True)
+            self.series[dataName].append(timestamp, value)
+            self.seriesDirty = True
+        except IOError as e:
+            print("Failed to store " + dataName + ": " + str(e))
+
+    # write the new samples to disk, at most once per SERIES_FLUSH_INTERVAL
+    def flushSeries(self, force=False):
+        if not self.seriesDirty:
+            return
+        now = time.time()
+        if not force and now - self.lastSeriesFlush < SERIES_FLUSH_INTERVAL:
+            return
+        self.seriesDirty = False
+        self.lastSeriesFlush = now
+        for (dataName, series) in self.series.items():
+            try:
+                series.flush()
+            except IOError as e:
+                print("Failed to store " + dataName + ": " + str(e))
 
 
+    def addValue(self, dataName, motename, timestamp, value):
+        if not dataName in self.seenInThisPacket:
+            self.seenInThisPacket.add(dataName)
+            self.data[dataName + "@" + motename] = []
+        self.data[dataName + "@" + motename].append([timestamp, value])
+
     def resize(self, newMaxSize):
         for datalist in self.data.keys():
             self.data[datalist] = self.data[datalist][-newMaxSize:]
@@ -165,12 +203,36 @@ class MoteData(object):
             self.data[motename] = SensorData(motename)
         self.data[motename].addNewData(newString, motename)
 
+    # a line from the base station gateway (tools/gateway); the data is
+    # already decoded, checked and stored by it
+    def addGatewayLine(self, line):
+        if line[:2] == "L ":
+            parts = line.split(" ", 2)
+            if len(parts) == 3:
+                self.listenTxt.append(parts[2])
+        elif line[:2] == "D ":
+            parts = line.split(" ")
+            if len(parts) != 5: return
+            (timestamp, motename, dataName, valueString) = parts[1:]
+            try:
+                value = int(valueString)
+            except ValueError:
+                value = float(valueString)
+            if motename not in self.data:
+                self.data[motename] = SensorData(motename)
+            self.data[motename].addValue(dataName, motename, int(timestamp), value)
+
     def fixSizes(self):
         # use only last 27 lines of all motes - fits in screen ("listen_div")
         self.listenTxt = self.listenTxt[-27:]
         # use only last 40 readings for graphing
         for sensorData in self.data.itervalues():
             sensorData.resize(40)
+        self.flushSeries()
+
+    def flushSeries(self, force=False):
+        for sensorData in self.data.itervalues():
+            sensorData.flushSeries(force)
 
     def hasData(self):
         for sensorData in self.data.itervalues():
@@ -50,6 +50,130 @@ WMP_CMD_GET_FILE     = 12
 WMP_CMD_SET_DAC      = 13
 # get DAC channel value
 WMP_CMD_GET_DAC      = 14
+# start bulk transfer of a file
+WMP_CMD_GET_FILE_BULK = 15
+# acknowledge received bulk transfer data
+WMP_CMD_FILE_ACK     = 16
+# a frame of bulk transfer data (sent by the mote only)
+WMP_CMD_FILE_DATA    = 17
 
 # this bit is set in replies to commands
 WMP_CMD_REPLY_FLAG   = 0x80
+
+
+#
+# Bulk file transfer (the protocol is described in mos/wmp/wmp.h)
+#
+
+# bulk transfer flag: compress the data if possible
+WMP_BULK_COMPRESS    = 0x1
+# acknowledgement flags
+WMP_ACK_NAK          = 0x1
+WMP_ACK_ABORT        = 0x2
+# data frame encodings
+WMP_ENCODING_RAW     = 0
+WMP_ENCODING_DELTA   = 1
+
+WMP_BULK_MAX_WINDOW  = 8
+
+
+# CRC-16/CCITT, reflected (polynomial 0x8408, initial value 0), as crc16() on motes
+def crc16(data, crc = 0):
+    for b in data:
+        crc ^= b
+        for i in range(8):
+            if crc & 1:
+                crc = (crc >> 1) ^ 0x8408
+            else:
+                crc >>= 1
+    return crc
+
+
+# Decode zigzag varints of 16-bit word deltas; returns None on malformed data
+def deltaDecode(data, rawLength):
+    result = bytearray()
+    previous = 0
+    pos = 0
+    while len(result) + 1 < rawLength:
+        zigzag = 0
+        shift = 0
+        while True:
+            if pos >= len(data) or shift > 14:
+                return None
+            b = data[pos]
+            pos += 1
+            zigzag |= (b & 0x7f) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        delta = (zigzag >> 1) ^ -(zigzag & 1)
+        previous = (previous + delta) & 0xffff
+        result.append(previous & 0xff)
+        result.append(previous >> 8)
+    if rawLength & 1:
+        if pos >= len(data):
+            return None
+        result.append(data[pos])
+        pos += 1
+    if pos != len(data):
+        return None
+    return result
+
+
+#
+# Receiving side of a bulk transfer. Feed it the arguments of data frames;
+# it tells what to acknowledge.
+#
+class BulkFileReceiver(object):
+    def __init__(self, offset = 0):
+        self.offset = offset    # offset of the next expected byte
+        self.fileSize = None    # known after the reply to WMP_CMD_GET_FILE_BULK
+        self.data = bytearray()
+        self.done = False
+        self.nakOffset = None   # do not repeat a NAK for the same data
+
+    def setFileSize(self, fileSize):
+        self.fileSize = fileSize
+        if self.offset >= fileSize:
+            self.done = True
+
+    def nak(self):
+        if self.nakOffset == self.offset:
+            return None
+        self.nakOffset = self.offset
+        return (self.offset, WMP_ACK_NAK)
+
+    # Returns (offset, flags) for WMP_CMD_FILE_ACK, or None if nothing to send
+    def frameReceived(self, args):
+        args = bytearray(args)
+        if len(args) < 8 or crc16(args[:-2]) != args[-2] | (args[-1] << 8):
+            return self.nak()
+        offset = args[0] | (args[1] << 8) | (args[2] << 16) | (args[3] << 24)
+        encoding = args[4]
+        rawLength = args[5]
+        payload = args[6:-2]
+
+        if offset < self.offset:
+            # a duplicate
+            return (self.offset, 0)
+        if offset > self.offset:
+            # a frame was lost
+            return self.nak()
+
+        if rawLength == 0:
+            self.done = True
+            return (self.offset, 0)
+
+        if encoding == WMP_ENCODING_DELTA:
+            payload = deltaDecode(payload, rawLength)
+        elif encoding != WMP_ENCODING_RAW:
+            payload = None
+        if payload is None or len(payload) != rawLength:
+            return self.nak()
+
+        self.data += payload
+        self.offset += rawLength
+        self.nakOffset = None
+        if self.fileSize is not None and self.offset >= self.fileSize:
+            self.done = True
+        return (self.offset, 0)
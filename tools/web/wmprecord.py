@@ -0,0 +1,157 @@
+#!/usr/bin/env python
+
+#
+# MansOS WMP binary record files: decoding and conversion to CSV.
+#
+# Motes write files with .bin extension in the binary format described
+# in mos/wmp/record.h. The CSV output is the same as the one motes write
+# in text mode.
+#
+# Usage:
+#   wmprecord.py DATA.BIN > data.csv
+#   wmprecord.py --since 1400000000 --until 1400086400 DATA.BIN
+#
+
+from __future__ import print_function
+import struct
+import sys
+import argparse
+
+RECORD_BLOCK_SIZE = 512
+RECORD_FORMAT_VERSION = 1
+
+RECORD_PAD = 0x00
+RECORD_INDEX = ord('T')
+RECORD_SCHEMA = ord('S')
+RECORD_DATA = ord('D')
+
+RECORD_TYPE_SIGNED = 0x80
+RECORD_NO_SCHEMA = 0xffffffff
+
+VALUE_FORMATS = {1: 'b', 2: 'h', 4: 'i'}
+
+
+class RecordError(Exception):
+    pass
+
+
+class Column(object):
+    def __init__(self, code, type, name):
+        self.code = code
+        self.type = type
+        self.name = name
+        self.size = type & ~RECORD_TYPE_SIGNED
+        if self.size not in VALUE_FORMATS:
+            raise RecordError("bad column type 0x%x" % type)
+        fmt = VALUE_FORMATS[self.size]
+        self.format = fmt if type & RECORD_TYPE_SIGNED else fmt.upper()
+
+
+def parseSchema(data, pos):
+    """Parse a schema record starting at 'pos'; return (columns, new pos)."""
+    version, count = struct.unpack_from("<BB", data, pos + 1)
+    if version != RECORD_FORMAT_VERSION:
+        raise RecordError("unsupported format version %d" % version)
+    pos += 3
+    columns = []
+    for _ in range(count):
+        code, type, nameLength = struct.unpack_from("<BBB", data, pos)
+        pos += 3
+        name = data[pos:pos + nameLength].decode("latin-1")
+        pos += nameLength
+        columns.append(Column(code, type, name))
+    return columns, pos
+
+
+def decode(data, start=0, columns=None):
+    """Decode records starting at block-aligned offset 'start'.
+
+    Yields (columns, timestamp, values) for each data record, where
+    'columns' is the list of Column objects in effect.
+    """
+    pos = start
+    end = len(data)
+    baseTime = 0
+    while pos < end:
+        blockEnd = (pos // RECORD_BLOCK_SIZE + 1) * RECORD_BLOCK_SIZE
+        type = data[pos] if isinstance(data[pos], int) else ord(data[pos])
+        if type == RECORD_PAD:
+            pos = blockEnd
+        elif type == RECORD_INDEX:
+            baseTime, schemaOffset = struct.unpack_from("<II", data, pos + 1)
+            if columns is None and schemaOffset != RECORD_NO_SCHEMA:
+                columns, _ = parseSchema(data, schemaOffset)
+            pos += 9
+        elif type == RECORD_SCHEMA:
+            columns, pos = parseSchema(data, pos)
+        elif type == RECORD_DATA:
+            if columns is None:
+                raise RecordError("data record without schema at offset %d" % pos)
+            delta, = struct.unpack_from("<H", data, pos + 1)
+            pos += 3
+            values = []
+            for c in columns:
+                values.append(struct.unpack_from("<" + c.format, data, pos)[0])
+                pos += c.size
+            yield columns, baseTime + delta, values
+        else:
+            raise RecordError("bad record type 0x%02x at offset %d" % (type, pos))
+
+
+def blockTime(data, blockStart):
+    """Time in the index record at the start of a block, or None."""
+    if blockStart + 9 > len(data):
+        return None
+    if bytearray(data[blockStart:blockStart + 1])[0] != RECORD_INDEX:
+        return None
+    return struct.unpack_from("<I", data, blockStart + 1)[0]
+
+
+def findStart(data, since):
+    """Use the block index to find the last block starting before 'since'."""
+    start = 0
+    for blockStart in range(0, len(data), RECORD_BLOCK_SIZE):
+        t = blockTime(data, blockStart)
+        # blocks without an index record (e.g. the first, partial one) are skipped
+        if t is None:
+            continue
+        if t >= since:
+            break
+        start = blockStart
+    return start
+
+
+def toCsv(data, write, since=None, until=None):
+    start = findStart(data, since) if since is not None else 0
+    lastColumns = None
+    for columns, timestamp, values in decode(data, start):
+        if since is not None and timestamp < since:
+            continue
+        if until is not None and timestamp > until:
+            break
+        if columns is not lastColumns:
+            # the same header line as motes write in text mode
+            write("\ntimestamp," + "".join(c.name + "," for c in columns) + "\n")
+            lastColumns = columns
+        write(str(timestamp) + "," + "".join(str(v) + "," for v in values) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert WMP binary record files to CSV")
+    parser.add_argument("file", help="binary record file (.bin)")
+    parser.add_argument("-s", "--since", type=int, help="skip records before this time")
+    parser.add_argument("-u", "--until", type=int, help="stop after this time")
+    args = parser.parse_args()
+
+    with open(args.file, "rb") as f:
+        data = f.read()
+    try:
+        toCsv(data, sys.stdout.write, args.since, args.until)
+    except (RecordError, struct.error) as e:
+        sys.stderr.write("wmprecord: {}\n".format(e))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())